@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_session.h"
+#include "lterm_session_loop.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Broadcast (linked) input: one encoded key or paste goes to every member
+// session. The bytes are copied once into a refcounted buffer that each
+// member's write queue references until its PTY has taken them, and with a
+// loop the members' writes are batched into one reactor wakeup.
+typedef struct lterm_broadcast_group lterm_broadcast_group;
+
+// loop may be NULL for sessions driven by their own threads; members should
+// otherwise all belong to it.
+lterm_broadcast_group *lterm_broadcast_group_new(lterm_session_loop *loop);
+void lterm_broadcast_group_free(lterm_broadcast_group *group);
+
+// Adding a member twice is a no-op. Members must be removed before they are
+// freed.
+bool lterm_broadcast_group_add(lterm_broadcast_group *group, lterm_session *session);
+void lterm_broadcast_group_remove(lterm_broadcast_group *group, lterm_session *session);
+bool lterm_broadcast_group_contains(lterm_broadcast_group *group, const lterm_session *session);
+size_t lterm_broadcast_group_count(lterm_broadcast_group *group);
+
+// Queues data to every member in order. Returns the number of members that
+// accepted it; members whose PTY has failed are skipped.
+size_t lterm_broadcast_send(lterm_broadcast_group *group, const uint8_t *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
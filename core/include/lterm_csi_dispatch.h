@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_csi_param.h"
+#include "lterm_screen.h"
+#include "lterm_token_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Dense index over every CSI command the parser can produce:
+// prefix (none, '<', '=', '>', '?') x intermediate (none, 0x20-0x2F) x final (0x40-0x7E).
+#define LTERM_CSI_PREFIX_SLOTS 5
+#define LTERM_CSI_INTERMEDIATE_SLOTS 17
+#define LTERM_CSI_FINAL_SLOTS 63
+#define LTERM_CSI_DISPATCH_SIZE \
+    (LTERM_CSI_PREFIX_SLOTS * LTERM_CSI_INTERMEDIATE_SLOTS * LTERM_CSI_FINAL_SLOTS)
+
+#define LTERM_CSI_DISPATCH_INDEX(prefix, intermediate, final)                          \
+    ((((prefix) ? (prefix) - 0x3B : 0) * LTERM_CSI_INTERMEDIATE_SLOTS +               \
+      ((intermediate) ? (intermediate) - 0x1F : 0)) * LTERM_CSI_FINAL_SLOTS +          \
+     ((final) - 0x40))
+
+#define LTERM_CSI_OVERRIDE_MAX 64
+
+typedef bool (*lterm_csi_handler)(lterm_screen *screen, const lterm_csi_param *param, void *user_data);
+
+typedef struct {
+    uint16_t index;
+    lterm_csi_handler handler;
+    void *user_data;
+} lterm_csi_override;
+
+typedef struct {
+    uint8_t override_bits[(LTERM_CSI_DISPATCH_SIZE + 7) / 8];
+    lterm_csi_override overrides[LTERM_CSI_OVERRIDE_MAX];
+    size_t override_count;
+} lterm_csi_dispatch;
+
+int lterm_csi_dispatch_index(int32_t packed);
+lterm_token_type lterm_csi_dispatch_token_type(int32_t packed);
+
+void lterm_csi_dispatch_init(lterm_csi_dispatch *dispatch);
+void lterm_csi_dispatch_reset(lterm_csi_dispatch *dispatch);
+bool lterm_csi_dispatch_set_handler(lterm_csi_dispatch *dispatch,
+                                    int32_t packed,
+                                    lterm_csi_handler handler,
+                                    void *user_data);
+bool lterm_csi_dispatch_has_override(const lterm_csi_dispatch *dispatch, int32_t packed);
+bool lterm_csi_dispatch_apply(const lterm_csi_dispatch *dispatch,
+                              lterm_screen *screen,
+                              const lterm_csi_param *param);
+
+#ifdef __cplusplus
+}
+#endif
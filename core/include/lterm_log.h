@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_LOG_RING_CAPACITY (1024u * 1024u)
+#define LTERM_LOG_FLUSH_MS 100
+#define LTERM_LOG_ROTATE_KEEP 5
+
+typedef enum {
+    // Bytes exactly as the PTY produced them.
+    LTERM_LOG_RAW,
+    // Escape sequences and control characters other than LF and TAB removed.
+    LTERM_LOG_PLAIN,
+} lterm_log_format;
+
+typedef enum {
+    LTERM_LOG_TIMESTAMP_NONE,
+    // "[YYYY-MM-DD HH:MM:SS.mmm] " before each line, local time of arrival.
+    LTERM_LOG_TIMESTAMP_LINE,
+} lterm_log_timestamps;
+
+// Zero fields take the defaults above.
+typedef struct {
+    const char *path;
+    lterm_log_format format;
+    lterm_log_timestamps timestamps;
+    size_t ring_capacity;
+    // Once the file reaches rotate_bytes it becomes path.1 (path.1 becomes
+    // path.2 and so on, keeping rotate_keep files) and a new one is started.
+    // Checked between batches; 0 never rotates.
+    size_t rotate_bytes;
+    unsigned rotate_keep;
+    // gzip the stream, flushed after every batch so the file stays readable.
+    // Fails unless lterm_log_compression_supported().
+    bool compress;
+    unsigned flush_ms;
+} lterm_log_options;
+
+typedef struct {
+    unsigned long long bytes_logged;
+    // Bytes that arrived while the ring was full; logging never stalls the
+    // parser.
+    unsigned long long bytes_dropped;
+    unsigned long long bytes_written;
+    unsigned long long writes;
+    unsigned long long rotations;
+} lterm_log_stats;
+
+// A session log: lterm_log_append() copies into a lock-free ring and one
+// writer thread per log drains it with batched writev() calls (gzip and
+// formatting happen there too). Attach it with lterm_session_set_log().
+typedef struct lterm_log lterm_log;
+
+bool lterm_log_compression_supported(void);
+lterm_log *lterm_log_open(const lterm_log_options *options);
+// Writes out everything appended so far, then closes the file.
+void lterm_log_close(lterm_log *log);
+// Single producer. Returns false when the bytes were dropped.
+bool lterm_log_append(lterm_log *log, const uint8_t *data, size_t length);
+// Blocks until everything appended so far is written; false on timeout.
+bool lterm_log_flush(lterm_log *log, int timeout_ms);
+void lterm_log_get_stats(lterm_log *log, lterm_log_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
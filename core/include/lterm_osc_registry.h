@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_token_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    LTERM_OSC_WINICON_TITLE = 0,
+    LTERM_OSC_ICON_TITLE = 1,
+    LTERM_OSC_WIN_TITLE = 2,
+    LTERM_OSC_SET_COLOR = 4,
+    LTERM_OSC_CURRENT_DIRECTORY = 7,
+    LTERM_OSC_HYPERLINK = 8,
+    LTERM_OSC_FOREGROUND_COLOR = 10,
+    LTERM_OSC_BACKGROUND_COLOR = 11,
+    LTERM_OSC_CLIPBOARD = 52,
+    LTERM_OSC_SHELL_INTEGRATION = 133,
+    LTERM_OSC_PROPRIETARY = 1337,
+} lterm_osc_code;
+
+// Must stay a power of two; lookups probe linearly from a multiplicative hash.
+#define LTERM_OSC_REGISTRY_CAPACITY 64
+
+typedef bool (*lterm_osc_handler)(int code, const uint8_t *payload, size_t length, void *user_data);
+
+typedef struct {
+    int code;
+    lterm_osc_handler handler;
+    void *user_data;
+} lterm_osc_entry;
+
+typedef struct {
+    lterm_osc_entry slots[LTERM_OSC_REGISTRY_CAPACITY];
+    size_t count;
+} lterm_osc_registry;
+
+lterm_token_type lterm_osc_token_type(int code);
+
+void lterm_osc_registry_init(lterm_osc_registry *registry);
+bool lterm_osc_registry_register(lterm_osc_registry *registry,
+                                 int code,
+                                 lterm_osc_handler handler,
+                                 void *user_data);
+void lterm_osc_registry_unregister(lterm_osc_registry *registry, int code);
+const lterm_osc_entry *lterm_osc_registry_lookup(const lterm_osc_registry *registry, int code);
+bool lterm_osc_registry_dispatch(const lterm_osc_registry *registry,
+                                 int code,
+                                 const uint8_t *payload,
+                                 size_t length);
+
+#ifdef __cplusplus
+}
+#endif
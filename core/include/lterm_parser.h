@@ -3,6 +3,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "lterm_csi_dispatch.h"
+#include "lterm_osc_registry.h"
+#include "lterm_sequence_cache.h"
 #include "lterm_token.h"
 #include "lterm_screen.h"
 
@@ -20,6 +23,17 @@ void lterm_parser_feed(lterm_parser *parser,
                        size_t length,
                        lterm_parser_callback callback,
                        void *user_data);
+bool lterm_parser_set_csi_handler(lterm_parser *parser,
+                                  int32_t packed,
+                                  lterm_csi_handler handler,
+                                  void *user_data);
+bool lterm_parser_register_osc_handler(lterm_parser *parser,
+                                       int code,
+                                       lterm_osc_handler handler,
+                                       void *user_data);
+void lterm_parser_unregister_osc_handler(lterm_parser *parser, int code);
+void lterm_parser_set_cache_enabled(lterm_parser *parser, bool enabled);
+void lterm_parser_get_cache_stats(const lterm_parser *parser, lterm_sequence_cache_stats *stats);
 
 #ifdef __cplusplus
 }
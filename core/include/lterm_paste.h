@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_PASTE_CHUNK (16u * 1024u)
+// The paste stops taking data while this much input is still queued on the
+// session and resumes on LTERM_SESSION_EVENT_WRITE_DRAINED.
+#define LTERM_PASTE_HIGH_WATER (64u * 1024u)
+
+typedef enum {
+    LTERM_PASTE_BRACKET_AUTO,  // follow DECSET 2004 on the session's screen
+    LTERM_PASTE_BRACKET_ALWAYS,
+    LTERM_PASTE_BRACKET_NEVER,
+} lterm_paste_bracket;
+
+typedef struct {
+    lterm_paste_bracket bracket;
+    // Drop C0/C1 controls other than TAB, CR and LF.
+    bool sanitize;
+    // Expected source length for progress reporting; 0 if unknown.
+    size_t total;
+} lterm_paste_options;
+
+typedef enum {
+    LTERM_PASTE_RUNNING,  // waiting for more source data
+    LTERM_PASTE_BLOCKED,  // waiting for the session's input queue to drain
+    LTERM_PASTE_DONE,
+    LTERM_PASTE_CANCELLED,
+    LTERM_PASTE_FAILED,
+} lterm_paste_status;
+
+// Streams a paste into a session a chunk at a time so only a few chunks are
+// ever held in memory. Newlines are sent as CR. When bracketed, the data is
+// wrapped in ESC[200~ ... ESC[201~ and ESC bytes inside it are dropped so the
+// text cannot end the bracket early. Not thread-safe; drive it from one loop.
+typedef struct lterm_paste lterm_paste;
+
+lterm_paste *lterm_paste_new(lterm_session *session, const lterm_paste_options *options);
+void lterm_paste_free(lterm_paste *paste);
+
+// Push-style sources (e.g. async stream reads): feed at most one chunk
+// whenever lterm_paste_ready() is true, then lterm_paste_finish() at the end.
+bool lterm_paste_ready(const lterm_paste *paste);
+bool lterm_paste_feed(lterm_paste *paste, const uint8_t *data, size_t length);
+bool lterm_paste_finish(lterm_paste *paste);
+
+// Pull-style sources: reads a non-blocking fd until it would block, the
+// session backs up, or EOF. Call again when the fd is readable (RUNNING) or
+// the session's input drained (BLOCKED).
+lterm_paste_status lterm_paste_pump_fd(lterm_paste *paste, int fd);
+
+// Stops the paste and closes an open bracket. Input already handed to the
+// session (at most LTERM_PASTE_HIGH_WATER plus a chunk) is still delivered.
+void lterm_paste_cancel(lterm_paste *paste);
+
+lterm_paste_status lterm_paste_get_status(const lterm_paste *paste);
+bool lterm_paste_bracketed(const lterm_paste *paste);
+// Source bytes consumed so far and the expected total (0 if unknown).
+size_t lterm_paste_consumed(const lterm_paste *paste);
+size_t lterm_paste_total(const lterm_paste *paste);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_pty.h"
+#include "lterm_screen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_PREDICT_MAX 128
+#define LTERM_PREDICT_TIMEOUT_MS 2000
+
+typedef struct {
+    size_t row;
+    size_t col;
+    uint32_t codepoint;
+    int64_t typed_ns;
+} lterm_prediction;
+
+typedef struct {
+    unsigned long long predicted;
+    // Predictions that were drawn when typed; the rest were tracked unseen
+    // until the echo had been confirmed.
+    unsigned long long displayed;
+    unsigned long long confirmed;
+    unsigned long long rolled_back;
+    // Sum of keystroke-to-echo delays over confirmed predictions: the round
+    // trip that displayed predictions hid.
+    unsigned long long echo_ns_total;
+} lterm_predict_stats;
+
+// Speculative local echo (in the style of mosh). Printable keystrokes typed
+// on the cursor row become predicted cells ahead of the real echo; parsed
+// output confirms them once the cursor moves past a matching cell and rolls
+// all of them back on a mismatch, a cursor jump or a timeout.
+//
+// Predictions are drawn when the slave is in canonical echo mode, or, for
+// raw-mode programs that echo themselves (ssh, a remote shell), once an
+// earlier prediction has been confirmed; a rollback withdraws that trust.
+// Nothing is predicted while echo is off (password prompts).
+//
+// Thread-safe: keys come from the UI thread and updates from the parser.
+typedef struct lterm_predictor lterm_predictor;
+
+lterm_predictor *lterm_predictor_new(void);
+void lterm_predictor_free(lterm_predictor *predictor);
+
+// Records input about to be written. Backspace withdraws the last
+// prediction; other control bytes and escape sequences clear the overlay
+// and pause predicting until output arrives. Returns true when the input
+// was predicted and is displayed.
+bool lterm_predictor_key(lterm_predictor *predictor,
+                         const lterm_screen *screen,
+                         lterm_pty_input_mode mode,
+                         const uint8_t *data,
+                         size_t length,
+                         int64_t now_ns);
+// Reconciles predictions with the screen after output has been applied.
+void lterm_predictor_update(lterm_predictor *predictor, const lterm_screen *screen, int64_t now_ns);
+// Predictions to draw over the screen, in typing order. Output may never
+// come for a key, so both of these also roll back once the oldest
+// prediction is older than LTERM_PREDICT_TIMEOUT_MS; a renderer showing
+// predictions should redraw after that long.
+size_t lterm_predictor_overlay(lterm_predictor *predictor, lterm_prediction *out, size_t max, int64_t now_ns);
+// Where the cursor will be once the predictions are echoed; false when
+// nothing is displayed.
+bool lterm_predictor_cursor(lterm_predictor *predictor, size_t *row, size_t *col, int64_t now_ns);
+void lterm_predictor_reset(lterm_predictor *predictor);
+void lterm_predictor_get_stats(lterm_predictor *predictor, lterm_predict_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "lterm_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_PROC_TRACKER_INTERVAL_MS 1000
+#define LTERM_PROC_NAME_MAX 64
+#define LTERM_PROC_CWD_MAX 4096
+
+typedef struct {
+    // Foreground process group of the PTY and the process it is named after
+    // (the group leader, or the shell if the leader is gone).
+    pid_t foreground_pgrp;
+    pid_t foreground_pid;
+    // The shell itself is in the foreground, i.e. no job is running.
+    bool shell_foreground;
+    char name[LTERM_PROC_NAME_MAX];
+    char cwd[LTERM_PROC_CWD_MAX];
+    // cwd came from OSC 7 rather than /proc.
+    bool cwd_reported;
+} lterm_proc_info;
+
+// Called on the sampler thread whenever a session's info changed. Must not
+// add or remove sessions; hand the info to the UI loop instead.
+typedef void (*lterm_proc_tracker_cb)(lterm_session *session,
+                                      const lterm_proc_info *info,
+                                      void *user_data);
+
+// One sampler thread for all sessions. Each tick costs one tcgetpgrp() per
+// session; /proc/<pid>/stat is only read when the foreground group changes
+// and /proc/<pid>/cwd only while the shell has not reported its directory
+// with OSC 7.
+typedef struct lterm_proc_tracker lterm_proc_tracker;
+
+// interval_ms 0 uses LTERM_PROC_TRACKER_INTERVAL_MS.
+lterm_proc_tracker *lterm_proc_tracker_new(unsigned interval_ms);
+void lterm_proc_tracker_free(lterm_proc_tracker *tracker);
+
+// The session's PTY must stay open until it is removed again.
+bool lterm_proc_tracker_add(lterm_proc_tracker *tracker,
+                            lterm_session *session,
+                            lterm_proc_tracker_cb callback,
+                            void *user_data);
+void lterm_proc_tracker_remove(lterm_proc_tracker *tracker, lterm_session *session);
+
+// Feeds an OSC 7 payload ("file://host/path", percent-encoded, or a plain
+// path); an empty one goes back to reading /proc.
+void lterm_proc_tracker_report_cwd(lterm_proc_tracker *tracker,
+                                   lterm_session *session,
+                                   const char *payload,
+                                   size_t length);
+// Samples on the next wakeup instead of waiting out the interval, e.g. after
+// the user pressed Enter.
+void lterm_proc_tracker_refresh(lterm_proc_tracker *tracker);
+// The cached info from the last sample; false for unknown sessions.
+bool lterm_proc_tracker_get(lterm_proc_tracker *tracker, lterm_session *session, lterm_proc_info *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,26 +3,131 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define LTERM_PTY_DRAIN_MIN_BUFFER (4u * 1024u)
+#define LTERM_PTY_DRAIN_MAX_BUFFER (1024u * 1024u)
+#define LTERM_PTY_DRAIN_SHRINK_AFTER 8
+
+typedef struct {
+    bool exited;
+    pid_t pid;
+    // Raw wait status, decoded: exit_code is -1 when the child was killed
+    // (signal says by what) or another waiter took the status first.
+    int status;
+    int exit_code;
+    int signal;
+    struct rusage usage;
+} lterm_pty_exit;
+
 typedef struct {
     int master_fd;
     pid_t child_pid;
+    // Readable once the child exits; -1 where pidfd_open() is unavailable.
+    int pidfd;
+    lterm_pty_exit exit;
+    uint8_t *drain_buffer;
+    size_t drain_capacity;
+    unsigned quiet_drains;
 } lterm_pty;
 
+// Line discipline of the slave side, from tcgetattr() on the master.
+typedef enum {
+    LTERM_PTY_INPUT_UNKNOWN,
+    // ICANON and ECHO: a shell-style line is being typed and echoed locally.
+    LTERM_PTY_INPUT_LINE,
+    // ICANON without ECHO: e.g. a password prompt.
+    LTERM_PTY_INPUT_SILENT,
+    // Non-canonical: the program (or a remote end, as with ssh) echoes.
+    LTERM_PTY_INPUT_RAW,
+} lterm_pty_input_mode;
+
+typedef struct {
+    void (*write)(const uint8_t *data, size_t length, void *user_data);
+    void *user_data;
+} lterm_pty_sink;
+
+// Zero fields mean "no limit".
+typedef struct {
+    size_t max_bytes;
+    long long max_ns;
+} lterm_pty_budget;
+
+typedef struct {
+    size_t bytes;
+    size_t syscalls;
+    size_t buffer_size;
+    bool more_pending;
+    bool closed;
+} lterm_pty_drain_stats;
+
+typedef enum {
+    // posix_spawn when the platform can set up the child with it, else fork.
+    LTERM_PTY_SPAWN_AUTO,
+    LTERM_PTY_SPAWN_FORK,
+    // Fails when unsupported; see lterm_pty_posix_spawn_supported().
+    LTERM_PTY_SPAWN_POSIX,
+} lterm_pty_spawn_method;
+
+typedef struct {
+    lterm_pty_spawn_method method;
+    // NULL inherits the caller's environment / working directory.
+    char *const *envp;
+    const char *cwd;
+    // Initial window size; 0 leaves the PTY default.
+    size_t rows;
+    size_t cols;
+} lterm_pty_spawn_options;
+
 void lterm_pty_init(lterm_pty *pty);
 bool lterm_pty_spawn(lterm_pty *pty, const char *program, char *const argv[], char *const envp[]);
+// The child gets a new session with the PTY slave as its controlling
+// terminal and stdio. posix_spawn (vfork-style, no page-table copy) keeps
+// spawn latency flat as the host process grows and reports exec failures;
+// fork only notices them when the child exits.
+bool lterm_pty_spawn_with_options(lterm_pty *pty,
+                                  const char *program,
+                                  char *const argv[],
+                                  const lterm_pty_spawn_options *options);
+bool lterm_pty_posix_spawn_supported(void);
 bool lterm_pty_spawn_shell(lterm_pty *pty, const char *shell_path);
+bool lterm_pty_spawn_shell_with_options(lterm_pty *pty,
+                                        const char *shell_path,
+                                        const lterm_pty_spawn_options *options);
 bool lterm_pty_resize(lterm_pty *pty, size_t rows, size_t cols);
 ssize_t lterm_pty_read(lterm_pty *pty, uint8_t *buffer, size_t length);
+// Reads until EAGAIN, EOF or the budget runs out, handing each chunk to sink.
+// The reusable read buffer doubles under sustained load (up to 1 MB) and
+// halves after LTERM_PTY_DRAIN_SHRINK_AFTER mostly idle drains.
+bool lterm_pty_drain(lterm_pty *pty,
+                     const lterm_pty_sink *sink,
+                     const lterm_pty_budget *budget,
+                     lterm_pty_drain_stats *stats);
+// Single write(); returns 0 when the PTY is full. lterm_session_write() queues
+// the remainder instead.
 ssize_t lterm_pty_write(lterm_pty *pty, const uint8_t *data, size_t length);
 int lterm_pty_get_fd(const lterm_pty *pty);
 bool lterm_pty_is_active(const lterm_pty *pty);
+lterm_pty_input_mode lterm_pty_get_input_mode(const lterm_pty *pty);
 pid_t lterm_pty_child_pid(const lterm_pty *pty);
+// Event loops watch this fd instead of handling SIGCHLD. It stays readable
+// after the exit until lterm_pty_close(), so drop it from level-triggered
+// poll sets once reaped. -1 without pidfd support, in which case
+// lterm_pty_reap() is simply retried (e.g. after the PTY hangs up).
+int lterm_pty_get_pidfd(const lterm_pty *pty);
+// Collects the child's exit status and rusage without blocking. Returns true
+// once the child has been reaped; child_pid is cleared at that point.
+bool lterm_pty_reap(lterm_pty *pty);
+// The last child's exit, kept across lterm_pty_close() until the next spawn.
+bool lterm_pty_exit_status(const lterm_pty *pty, lterm_pty_exit *info);
+// A child that has not exited yet (it normally does on the hangup that
+// follows) is handed to a process-wide reaper thread so it never lingers as
+// a zombie.
 void lterm_pty_close(lterm_pty *pty);
 
 #ifdef __cplusplus
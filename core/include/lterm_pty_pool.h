@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lterm_pty.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_PTY_POOL_MAX 16
+
+// What a pooled shell was started with; a shell is only handed out for an
+// identical spec.
+typedef struct {
+    const char *shell_path;  // NULL: lterm_pty_spawn_shell()'s default shell
+    char *const *envp;       // NULL: inherit
+    const char *cwd;         // NULL: inherit
+} lterm_pty_pool_spec;
+
+typedef struct {
+    size_t ready;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long spawned;
+    unsigned long long discarded;
+} lterm_pty_pool_stats;
+
+// Keeps up to size shells (capped at LTERM_PTY_POOL_MAX) spawned ahead of
+// time, each on its own PTY at the last known geometry, and replenishes them
+// from a background thread. One pool serves one spec, e.g. one profile.
+typedef struct lterm_pty_pool lterm_pty_pool;
+
+lterm_pty_pool *lterm_pty_pool_new(const lterm_pty_pool_spec *spec, size_t size, size_t rows, size_t cols);
+void lterm_pty_pool_free(lterm_pty_pool *pool);
+
+// Replaces the spec; shells started for the old one are discarded.
+bool lterm_pty_pool_configure(lterm_pty_pool *pool, const lterm_pty_pool_spec *spec);
+// Resizes the waiting shells and sizes future ones.
+void lterm_pty_pool_set_geometry(lterm_pty_pool *pool, size_t rows, size_t cols);
+
+// Moves a ready shell into the inactive pty when spec matches the pool's.
+// Returns false (a miss) otherwise; the caller then spawns directly.
+bool lterm_pty_pool_take(lterm_pty_pool *pool, const lterm_pty_pool_spec *spec, lterm_pty *pty);
+void lterm_pty_pool_get_stats(lterm_pty_pool *pool, lterm_pty_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
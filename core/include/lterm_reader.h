@@ -28,6 +28,7 @@ void lterm_reader_init(lterm_reader *reader);
 void lterm_reader_free(lterm_reader *reader);
 void lterm_reader_reset(lterm_reader *reader);
 void lterm_reader_append(lterm_reader *reader, const uint8_t *data, size_t length);
+size_t lterm_reader_pending(const lterm_reader *reader);
 
 void lterm_reader_cursor_init(lterm_reader_cursor *cursor, const lterm_reader *reader);
 size_t lterm_reader_cursor_size(const lterm_reader_cursor *cursor);
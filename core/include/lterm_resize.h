@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_RESIZE_SETTLE_MS 100
+
+typedef struct {
+    unsigned long long requests;
+    unsigned long long screen_resizes;
+    unsigned long long pty_resizes;
+} lterm_resize_stats;
+
+// Debounces geometry changes, e.g. while a window edge is dragged. Requests
+// only record the latest size; each frame tick resizes the screen at most
+// once, and the PTY (TIOCSWINSZ, and with it the child's SIGWINCH) is told
+// only once a size has held for the settle time and differs from the last
+// one sent. Single-threaded: request and tick from the UI thread.
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t screen_rows;
+    size_t screen_cols;
+    size_t pty_rows;
+    size_t pty_cols;
+    int64_t requested_ns;
+    int64_t settle_ns;
+    lterm_resize_stats stats;
+} lterm_resize_coordinator;
+
+// settle_ms 0 takes LTERM_RESIZE_SETTLE_MS. Times are CLOCK_MONOTONIC (or a
+// frame clock) in nanoseconds.
+void lterm_resize_coordinator_init(lterm_resize_coordinator *resize, unsigned settle_ms);
+void lterm_resize_coordinator_request(lterm_resize_coordinator *resize, size_t rows, size_t cols, int64_t now_ns);
+// Call once per frame. Returns true while a PTY resize is still waiting to
+// settle, i.e. while the caller should keep ticking.
+bool lterm_resize_coordinator_tick(lterm_resize_coordinator *resize, lterm_session *session, int64_t now_ns);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #include "lterm_csi_param.h"
+#include "lterm_sgr.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,12 +14,37 @@ extern "C" {
 #define LTERM_CELL_FLAG_BOLD (1u << 0)
 #define LTERM_CELL_FLAG_UNDERLINE (1u << 1)
 #define LTERM_CELL_FLAG_INVERSE (1u << 2)
+#define LTERM_CELL_FLAG_DIM (1u << 3)
+#define LTERM_CELL_FLAG_ITALIC (1u << 4)
+#define LTERM_CELL_FLAG_BLINK (1u << 5)
+#define LTERM_CELL_FLAG_INVISIBLE (1u << 6)
+#define LTERM_CELL_FLAG_STRIKETHROUGH (1u << 7)
+#define LTERM_CELL_FLAG_DOUBLE_UNDERLINE (1u << 8)
+#define LTERM_CELL_FLAG_CURLY_UNDERLINE (1u << 9)
+#define LTERM_CELL_UNDERLINE_MASK \
+    (LTERM_CELL_FLAG_UNDERLINE | LTERM_CELL_FLAG_DOUBLE_UNDERLINE | LTERM_CELL_FLAG_CURLY_UNDERLINE)
+
+// DEC private modes (CSI ? Pm h / l) the screen tracks.
+#define LTERM_DEC_MODE_BRACKETED_PASTE 2004
+
+#define LTERM_SCREEN_MODE_BRACKETED_PASTE (1u << 0)
+
+// Colors are palette indices (0-255) unless LTERM_COLOR_RGB_FLAG is set, in
+// which case the low 24 bits hold 0xRRGGBB.
+typedef uint32_t lterm_color;
+
+#define LTERM_COLOR_RGB_FLAG 0x01000000u
+#define LTERM_COLOR_RGB(r, g, b) \
+    (LTERM_COLOR_RGB_FLAG | ((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(b))
+#define LTERM_COLOR_IS_RGB(color) (((color) & LTERM_COLOR_RGB_FLAG) != 0)
+#define LTERM_COLOR_DEFAULT_FG 7u
+#define LTERM_COLOR_DEFAULT_BG 0u
 
 typedef struct {
     uint32_t codepoint;
-    uint8_t fg;
-    uint8_t bg;
-    uint8_t flags;
+    lterm_color fg;
+    lterm_color bg;
+    uint16_t flags;
 } lterm_cell;
 
 typedef struct {
@@ -37,15 +64,20 @@ typedef struct {
     size_t cursor_row;
     size_t cursor_col;
     lterm_scrollback scrollback;
-    uint8_t current_fg;
-    uint8_t current_bg;
+    lterm_color current_fg;
+    lterm_color current_bg;
     uint16_t current_flags;
+    uint32_t modes;
+    // One flag per grid row, set whenever a cell in the row changes and
+    // cleared by lterm_screen_take_dirty().
+    uint8_t *dirty_rows;
 } lterm_screen;
 
 void lterm_screen_init(lterm_screen *screen, size_t rows, size_t cols);
 void lterm_screen_free(lterm_screen *screen);
 void lterm_screen_clear(lterm_screen *screen);
 void lterm_screen_put_text(lterm_screen *screen, const char *text);
+void lterm_screen_put_bytes(lterm_screen *screen, const uint8_t *bytes, size_t length);
 void lterm_screen_move_cursor(lterm_screen *screen, int drow, int dcol);
 void lterm_screen_set_cursor(lterm_screen *screen, size_t row, size_t col);
 void lterm_screen_carriage_return(lterm_screen *screen);
@@ -55,7 +87,17 @@ void lterm_screen_clear_line(lterm_screen *screen, int mode);
 void lterm_screen_clear_screen(lterm_screen *screen, int mode);
 void lterm_screen_reset_attributes(lterm_screen *screen);
 void lterm_screen_apply_sgr(lterm_screen *screen, const lterm_csi_param *param);
+void lterm_screen_apply_sgr_delta(lterm_screen *screen, const lterm_sgr_delta *delta);
+// Returns false for modes the screen does not track.
+bool lterm_screen_set_dec_mode(lterm_screen *screen, int mode, bool enabled);
+bool lterm_screen_dec_mode(const lterm_screen *screen, int mode);
 const lterm_scrollback *lterm_screen_scrollback(const lterm_screen *screen);
+// For code that writes grid.cells directly.
+void lterm_screen_mark_dirty(lterm_screen *screen, size_t first_row, size_t count);
+// Copies the dirty flags of the first `rows` rows into out (1 = changed since
+// the previous call), clears them and returns how many were set. Meant for a
+// single consumer, normally the renderer.
+size_t lterm_screen_take_dirty(lterm_screen *screen, uint8_t *out, size_t rows);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lterm_csi_param.h"
+#include "lterm_sgr.h"
+#include "lterm_token_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_SEQUENCE_CACHE_KEY_MAX 32
+#define LTERM_SEQUENCE_CACHE_SLOTS 256
+
+typedef struct {
+    uint32_t hash;
+    uint8_t length;
+    uint8_t key[LTERM_SEQUENCE_CACHE_KEY_MAX];
+    lterm_token_type type;
+    int32_t cmd;
+    int count;
+    int p[LTERM_CSI_PARAM_MAX];
+    bool has_sgr;
+    lterm_sgr_delta sgr;
+} lterm_sequence_cache_entry;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} lterm_sequence_cache_stats;
+
+typedef struct {
+    lterm_sequence_cache_entry entries[LTERM_SEQUENCE_CACHE_SLOTS];
+    lterm_sequence_cache_stats stats;
+} lterm_sequence_cache;
+
+void lterm_sequence_cache_init(lterm_sequence_cache *cache);
+void lterm_sequence_cache_clear(lterm_sequence_cache *cache);
+
+// Returns the length of a complete, cacheable "ESC [ ... final" sequence at the
+// start of data (0 if it is incomplete, too long or uses sub-parameters).
+size_t lterm_sequence_cache_scan(const uint8_t *data, size_t length, uint32_t *hash);
+
+const lterm_sequence_cache_entry *lterm_sequence_cache_lookup(lterm_sequence_cache *cache,
+                                                              const uint8_t *key,
+                                                              size_t length,
+                                                              uint32_t hash);
+void lterm_sequence_cache_store(lterm_sequence_cache *cache,
+                                const uint8_t *key,
+                                size_t length,
+                                uint32_t hash,
+                                lterm_token_type type,
+                                const lterm_csi_param *param);
+void lterm_sequence_cache_restore(const lterm_sequence_cache_entry *entry, lterm_csi_param *param);
+
+#ifdef __cplusplus
+}
+#endif
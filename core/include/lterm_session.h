@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "lterm_log.h"
+#include "lterm_parser.h"
+#include "lterm_predict.h"
+#include "lterm_pty.h"
+#include "lterm_pty_pool.h"
+#include "lterm_screen.h"
+#include "lterm_write_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_SESSION_RING_CAPACITY (1u << 20)
+#define LTERM_SESSION_PARSE_CHUNK (64u * 1024u)
+// With a deadline, the clock is checked every this many bytes.
+#define LTERM_SESSION_PARSE_STEP (8u * 1024u)
+#define LTERM_SESSION_FRAME_NS 16666667ll
+#define LTERM_SESSION_HIGH_WATER (512u * 1024u)
+#define LTERM_SESSION_LOW_WATER (128u * 1024u)
+
+typedef struct lterm_session lterm_session;
+
+typedef enum {
+    LTERM_SESSION_EVENT_FRAME,
+    LTERM_SESSION_EVENT_EXIT,
+    // Input that had to be queued has now been fully written to the PTY.
+    LTERM_SESSION_EVENT_WRITE_DRAINED,
+    // lterm_session_throttled() may have changed.
+    LTERM_SESSION_EVENT_THROTTLE,
+    // The child was reaped; see lterm_session_exit_status(). Independent of
+    // EXIT, which follows the PTY hanging up and its output being parsed.
+    LTERM_SESSION_EVENT_CHILD_EXIT,
+} lterm_session_event;
+
+// Invoked from whichever thread parses the session (the parse thread once
+// lterm_session_start() has been called); WRITE_DRAINED comes from the thread
+// that flushed the input and THROTTLE from the reading or parsing thread.
+// FRAME is raised at most once until the consumer calls
+// lterm_session_frame_done(). Callbacks should hand work off to their own
+// loop rather than write to the session from inside the callback.
+typedef void (*lterm_session_event_cb)(lterm_session *session,
+                                       lterm_session_event event,
+                                       void *user_data);
+
+lterm_session *lterm_session_new(size_t rows, size_t cols);
+void lterm_session_free(lterm_session *session);
+
+lterm_screen *lterm_session_screen(lterm_session *session);
+lterm_parser *lterm_session_parser(lterm_session *session);
+lterm_pty *lterm_session_pty(lterm_session *session);
+
+void lterm_session_set_token_callback(lterm_session *session,
+                                      lterm_parser_callback callback,
+                                      void *user_data);
+void lterm_session_set_event_callback(lterm_session *session,
+                                      lterm_session_event_cb callback,
+                                      void *user_data);
+// Tees parsed output into log (NULL stops); the session does not own it.
+// Costs the parse path one copy into the log's ring.
+void lterm_session_set_log(lterm_session *session, lterm_log *log);
+// Reconciles predictor with parsed output (NULL stops); not owned.
+void lterm_session_set_predictor(lterm_session *session, lterm_predictor *predictor);
+// Feeds input about to be written to the predictor against the current
+// screen and the PTY's line discipline; true if it is displayed predicted.
+bool lterm_session_predict(lterm_session *session, const uint8_t *data, size_t length);
+
+bool lterm_session_spawn_shell(lterm_session *session, const char *shell_path);
+// Takes a pre-spawned shell from pool if it was started for spec.
+bool lterm_session_spawn_pooled(lterm_session *session, lterm_pty_pool *pool, const lterm_pty_pool_spec *spec);
+
+// Starts a reader thread (PTY -> ring) and a parse thread (ring -> screen).
+bool lterm_session_start(lterm_session *session);
+void lterm_session_stop(lterm_session *session);
+bool lterm_session_is_running(const lterm_session *session);
+
+// Producer side for embedders that feed the session themselves instead of
+// starting its threads. Returns how many bytes were accepted.
+size_t lterm_session_ingest(lterm_session *session, const uint8_t *data, size_t length);
+// Marks the end of ingested input; EXIT follows once the ring drains.
+void lterm_session_close_input(lterm_session *session);
+// Consumer side: parse up to budget queued bytes under the screen lock.
+size_t lterm_session_process(lterm_session *session, size_t budget);
+// Same, but also stops once CLOCK_MONOTONIC passes deadline_ns (0: none);
+// at least one step is parsed.
+size_t lterm_session_process_until(lterm_session *session, size_t budget, int64_t deadline_ns);
+size_t lterm_session_pending(const lterm_session *session);
+
+// Output flow control. Once high unparsed bytes are waiting the PTY is no
+// longer read, so the kernel's buffer stalls the child, until parsing brings
+// the backlog down to low. Set before reading starts; low must be below high
+// and high must fit the ring.
+bool lterm_session_set_watermarks(lterm_session *session, size_t high, size_t low);
+bool lterm_session_throttled(const lterm_session *session);
+
+// Reads from the PTY into the ring without blocking, until EAGAIN, the ring is
+// full, the high watermark is reached or budget bytes were read. Only one
+// thread may fill a session. When syscalls is non-NULL it receives the number
+// of read() calls made.
+size_t lterm_session_fill(lterm_session *session, size_t budget, size_t *syscalls);
+// Bytes the producer may add now; 0 while throttled. ingest() itself still
+// takes whatever fits the ring.
+size_t lterm_session_space(const lterm_session *session);
+bool lterm_session_input_closed(const lterm_session *session);
+// True while queued bytes or the EXIT event still need a process() call.
+bool lterm_session_has_work(const lterm_session *session);
+
+// The screen must be locked while it is read from another thread.
+void lterm_session_lock(lterm_session *session);
+void lterm_session_unlock(lterm_session *session);
+void lterm_session_frame_done(lterm_session *session);
+
+// Sends input to the child. Whatever the PTY does not take at once is queued
+// in order and never dropped; the queue is flushed when the PTY becomes
+// writable by the session threads, a session loop, or an embedder calling
+// lterm_session_flush(). Returns false only if the bytes could not be queued
+// or the PTY has failed.
+bool lterm_session_write(lterm_session *session, const uint8_t *data, size_t length);
+// Same, but whatever is not written at once is queued by reference to buffer
+// rather than copied, so one buffer can be sent to many sessions.
+bool lterm_session_write_shared(lterm_session *session, lterm_shared_buffer *buffer);
+// Backpressure: bytes accepted by lterm_session_write() but not yet written.
+size_t lterm_session_write_queued(lterm_session *session);
+// Writes queued input with one writev(). Returns the bytes written (0 if the
+// PTY would block), or -1 on a PTY error, which discards the queue.
+ssize_t lterm_session_flush(lterm_session *session);
+
+// For event loops that own writability. With a handler set, write() only
+// queues and calls it (on the writing thread) whenever the queue goes from
+// empty to non-empty; the loop then flushes, or submits the spans from
+// lterm_session_output_iov() and reports completion with
+// lterm_session_consume_output().
+typedef void (*lterm_session_output_cb)(lterm_session *session, void *user_data);
+void lterm_session_set_output_handler(lterm_session *session,
+                                      lterm_session_output_cb callback,
+                                      void *user_data);
+int lterm_session_output_iov(lterm_session *session, struct iovec *iov, int max);
+void lterm_session_consume_output(lterm_session *session, size_t length);
+bool lterm_session_resize(lterm_session *session, size_t rows, size_t cols);
+// The two halves of resize(), for callers that debounce the PTY while the
+// screen follows every frame (lterm_resize_coordinator).
+bool lterm_session_resize_screen(lterm_session *session, size_t rows, size_t cols);
+bool lterm_session_resize_pty(lterm_session *session, size_t rows, size_t cols);
+// For whoever watches lterm_pty_get_pidfd() (the session threads and session
+// loops do): collects the exit once the pidfd is readable and raises
+// CHILD_EXIT on the calling thread. Returns true once the child is reaped.
+bool lterm_session_reap(lterm_session *session);
+// Exit code, signal and rusage of the last child; also tries the reap itself,
+// which is all that notices the exit on kernels without pidfds.
+bool lterm_session_exit_status(lterm_session *session, lterm_pty_exit *info);
+
+#ifdef __cplusplus
+}
+#endif
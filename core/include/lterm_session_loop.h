@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lterm_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_SESSION_LOOP_READ_BUDGET (256u * 1024u)
+#define LTERM_SESSION_LOOP_MAX_EVENTS 64
+#define LTERM_SESSION_LOOP_URING_ENTRIES 256
+#define LTERM_SESSION_LOOP_URING_BUFFERS 1024
+#define LTERM_SESSION_LOOP_URING_BUFFER_SIZE 4096
+#define LTERM_SESSION_LOOP_SLICE_BYTES (64u * 1024u)
+#define LTERM_SESSION_LOOP_SLICE_US 2000u
+#define LTERM_SESSION_LOOP_FOCUS_SHARE 4u
+
+// One epoll reactor for many sessions. The reactor reads ready PTYs into each
+// session's ring; parsing runs on a pool of worker threads where every
+// session has a home worker, idle workers steal queued sessions, and a
+// session is never parsed by two workers at once. With zero workers the
+// sessions are parsed inline by lterm_session_loop_dispatch().
+//
+// Parsing is time-sliced so one flooding session cannot starve the rest:
+// each turn parses at most a slice of bytes and microseconds, and whatever
+// is left goes to the back of the queue. Focused sessions get a bigger slice
+// and new output for them is queued in front, which bounds their echo
+// latency while other sessions flood.
+//
+// The loop also flushes each session's queued input (lterm_session_write())
+// when its PTY becomes writable.
+//
+// The io_uring backend replaces per-PTY readiness and read() calls with one
+// multishot read per session into a ring of provided buffers, and batches the
+// sessions' queued input as writev submissions into one io_uring_enter() per
+// reactor wakeup. AUTO picks it when the kernel supports
+// it and LTERM_IO_URING is not "0", and falls back to epoll + read()
+// otherwise.
+//
+// Sessions added to a loop must not be started with lterm_session_start().
+typedef struct lterm_session_loop lterm_session_loop;
+
+typedef enum {
+    LTERM_SESSION_LOOP_BACKEND_AUTO,
+    LTERM_SESSION_LOOP_BACKEND_EPOLL,
+    LTERM_SESSION_LOOP_BACKEND_IO_URING,
+} lterm_session_loop_backend;
+
+typedef struct {
+    size_t sessions;
+    size_t workers;
+    lterm_session_loop_backend backend;
+    unsigned long long wakeups;
+    unsigned long long steals;
+    // Turns that ended with work left over for a later turn.
+    unsigned long long slices_cut;
+    // PTY reads/writes, readiness and submission calls made by the loop.
+    unsigned long long syscalls;
+    unsigned long long bytes_read;
+    unsigned long long bytes_written;
+} lterm_session_loop_stats;
+
+lterm_session_loop *lterm_session_loop_new(size_t worker_count);
+// Returns NULL when IO_URING is requested but unavailable.
+lterm_session_loop *lterm_session_loop_new_with_backend(size_t worker_count,
+                                                        lterm_session_loop_backend backend);
+lterm_session_loop_backend lterm_session_loop_get_backend(const lterm_session_loop *loop);
+void lterm_session_loop_free(lterm_session_loop *loop);
+
+bool lterm_session_loop_add(lterm_session_loop *loop, lterm_session *session);
+void lterm_session_loop_remove(lterm_session_loop *loop, lterm_session *session);
+// Returns false if session is not in the loop.
+bool lterm_session_loop_set_focused(lterm_session_loop *loop, lterm_session *session, bool focused);
+// Zero takes the default.
+void lterm_session_loop_set_slice(lterm_session_loop *loop, size_t bytes, unsigned usec);
+
+// Brackets writes to many member sessions, e.g. broadcast input. With
+// io_uring the queued writevs go out in one io_uring_enter() after
+// end_batch() instead of waking the reactor per session; epoll writes are
+// already made inline by the writing thread. Batches may nest.
+void lterm_session_loop_begin_batch(lterm_session_loop *loop);
+void lterm_session_loop_end_batch(lterm_session_loop *loop);
+
+// Embedding: watch fd for readability (e.g. g_unix_fd_add) and call dispatch
+// with a zero timeout. Returns the number of PTY events handled, or -1.
+int lterm_session_loop_fd(const lterm_session_loop *loop);
+int lterm_session_loop_dispatch(lterm_session_loop *loop, int timeout_ms);
+
+// Alternatively run the reactor on its own thread.
+bool lterm_session_loop_start(lterm_session_loop *loop);
+void lterm_session_loop_stop(lterm_session_loop *loop);
+
+void lterm_session_loop_get_stats(lterm_session_loop *loop, lterm_session_loop_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
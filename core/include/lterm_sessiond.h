@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "lterm_pty.h"
+#include "lterm_screen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_SESSIOND_SOCKET_NAME "lterm-sessiond.sock"
+#define LTERM_SESSIOND_IO_TIMEOUT_MS 5000
+
+// $XDG_RUNTIME_DIR/lterm-sessiond.sock, else /tmp/lterm-sessiond-<uid>.sock.
+bool lterm_sessiond_default_path(char *path, size_t size);
+
+// lterm-sessiond owns PTYs, parsers and screens so sessions survive UI
+// restarts. Only processes of the same user may connect. A client that
+// attaches gets the PTY master fd (to write input directly), the state and
+// visible rows, then incremental row and state updates after every frame.
+// Scrollback stays in the daemon and is fetched on demand, so reattaching
+// costs the visible rows regardless of history length.
+typedef struct lterm_sessiond_server lterm_sessiond_server;
+
+lterm_sessiond_server *lterm_sessiond_server_new(const char *socket_path);
+void lterm_sessiond_server_free(lterm_sessiond_server *server);
+// Serves until lterm_sessiond_server_stop(), which any thread may call.
+bool lterm_sessiond_server_run(lterm_sessiond_server *server);
+void lterm_sessiond_server_stop(lterm_sessiond_server *server);
+
+typedef enum {
+    LTERM_SESSIOND_UPDATE_ROWS,
+    LTERM_SESSIOND_UPDATE_STATE,
+    LTERM_SESSIOND_UPDATE_EXITED,
+} lterm_sessiond_update;
+
+typedef void (*lterm_sessiond_update_cb)(uint32_t id, lterm_sessiond_update update, void *user_data);
+
+// Client side. Not thread-safe; updates are applied to the attached screens
+// from whichever thread calls lterm_sessiond_dispatch() (or waits for a
+// reply).
+typedef struct lterm_sessiond_client lterm_sessiond_client;
+
+lterm_sessiond_client *lterm_sessiond_connect(const char *socket_path);
+void lterm_sessiond_disconnect(lterm_sessiond_client *client);
+void lterm_sessiond_set_update_callback(lterm_sessiond_client *client,
+                                        lterm_sessiond_update_cb callback,
+                                        void *user_data);
+// Poll this for readability, then call lterm_sessiond_dispatch().
+int lterm_sessiond_client_fd(const lterm_sessiond_client *client);
+// Applies pending updates without blocking; false once the daemon is gone.
+bool lterm_sessiond_dispatch(lterm_sessiond_client *client);
+
+// shell_path NULL uses lterm_pty_spawn_shell()'s default shell.
+bool lterm_sessiond_create(lterm_sessiond_client *client,
+                           size_t rows,
+                           size_t cols,
+                           const char *shell_path,
+                           uint32_t *id);
+// Fills ids with up to max session ids; returns how many sessions exist.
+size_t lterm_sessiond_list(lterm_sessiond_client *client, uint32_t *ids, size_t max);
+// Sizes screen to the session and fills its visible rows; screen must stay
+// valid until detach. *master_fd receives the PTY (the caller closes it);
+// write input to it directly. The daemon keeps reading the PTY.
+bool lterm_sessiond_attach(lterm_sessiond_client *client, uint32_t id, lterm_screen *screen, int *master_fd);
+void lterm_sessiond_detach(lterm_sessiond_client *client, uint32_t id);
+bool lterm_sessiond_resize(lterm_sessiond_client *client, uint32_t id, size_t rows, size_t cols);
+// Scrollback lines held by the daemon for an attached session.
+size_t lterm_sessiond_scrollback_lines(const lterm_sessiond_client *client, uint32_t id);
+// Copies scrollback lines [first, first + count) (0 is the oldest) into
+// cells, cols cells per line. Returns the number of lines copied.
+size_t lterm_sessiond_fetch_scrollback(lterm_sessiond_client *client,
+                                       uint32_t id,
+                                       size_t first,
+                                       size_t count,
+                                       lterm_cell *cells,
+                                       size_t cols);
+// Exit status once LTERM_SESSIOND_UPDATE_EXITED was delivered.
+bool lterm_sessiond_exit_status(const lterm_sessiond_client *client, uint32_t id, int *exit_code, int *signal);
+bool lterm_sessiond_close(lterm_sessiond_client *client, uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
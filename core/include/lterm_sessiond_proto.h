@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "lterm_screen.h"
+#include "lterm_write_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Wire format between lterm-sessiond and its clients on a local stream
+// socket: a header followed by `length` payload bytes, in host byte order
+// since both ends are on the same machine. Cells travel as raw lterm_cell.
+#define LTERM_SESSIOND_MAX_MESSAGE (8u * 1024u * 1024u)
+
+typedef enum {
+    // Client -> daemon.
+    LTERM_SESSIOND_MSG_CREATE = 1,  // create_msg + shell path (may be empty)
+    LTERM_SESSIOND_MSG_LIST,
+    LTERM_SESSIOND_MSG_ATTACH,      // id_msg
+    LTERM_SESSIOND_MSG_DETACH,      // id_msg
+    LTERM_SESSIOND_MSG_RESIZE,      // resize_msg
+    LTERM_SESSIOND_MSG_FETCH,       // fetch_msg: scrollback lines on demand
+    LTERM_SESSIOND_MSG_CLOSE,       // id_msg: hang up and forget the session
+
+    // Daemon -> client.
+    LTERM_SESSIOND_MSG_CREATED = 64,  // id_msg
+    LTERM_SESSIOND_MSG_SESSIONS,      // uint32_t count, then count ids
+    LTERM_SESSIOND_MSG_ATTACHED,      // state_msg; carries the PTY master fd
+    LTERM_SESSIOND_MSG_STATE,         // state_msg
+    LTERM_SESSIOND_MSG_ROWS,          // rows_msg + cells of visible rows
+    LTERM_SESSIOND_MSG_SCROLLBACK,    // rows_msg + cells, reply to FETCH
+    LTERM_SESSIOND_MSG_EXITED,        // exited_msg
+    LTERM_SESSIOND_MSG_ERROR,         // error_msg
+} lterm_sessiond_msg_type;
+
+typedef struct {
+    uint32_t type;
+    uint32_t length;
+} lterm_sessiond_header;
+
+typedef struct {
+    uint32_t id;
+} lterm_sessiond_id_msg;
+
+typedef struct {
+    uint32_t rows;
+    uint32_t cols;
+} lterm_sessiond_create_msg;
+
+typedef struct {
+    uint32_t id;
+    uint32_t rows;
+    uint32_t cols;
+} lterm_sessiond_resize_msg;
+
+typedef struct {
+    uint32_t id;
+    uint32_t first;
+    uint32_t count;
+} lterm_sessiond_fetch_msg;
+
+typedef struct {
+    uint32_t id;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t cursor_row;
+    uint32_t cursor_col;
+    uint32_t modes;
+    // Lines of scrollback held by the daemon; fetched with FETCH.
+    uint64_t scrollback_lines;
+} lterm_sessiond_state_msg;
+
+typedef struct {
+    uint32_t id;
+    uint32_t first;
+    uint32_t count;
+    uint32_t cols;
+} lterm_sessiond_rows_msg;
+
+typedef struct {
+    uint32_t id;
+    int32_t exit_code;
+    int32_t signal;
+} lterm_sessiond_exited_msg;
+
+typedef struct {
+    uint32_t id;
+    uint32_t request;
+} lterm_sessiond_error_msg;
+
+// Frames one message into queue; the payload is head followed by tail.
+bool lterm_sessiond_queue_message(lterm_write_queue *queue,
+                                  uint32_t type,
+                                  const void *head,
+                                  size_t head_length,
+                                  const void *tail,
+                                  size_t tail_length);
+
+// Inbound byte buffer that yields whole messages.
+typedef struct {
+    uint8_t *data;
+    size_t start;
+    size_t length;
+    size_t capacity;
+} lterm_sessiond_inbox;
+
+void lterm_sessiond_inbox_free(lterm_sessiond_inbox *inbox);
+// recvmsg() into the inbox. A passed fd is stored in *fd if that is -1 and
+// closed otherwise. Returns bytes read, 0 on EOF, -1 on error or EAGAIN.
+ssize_t lterm_sessiond_inbox_read(lterm_sessiond_inbox *inbox, int socket_fd, int *fd);
+// Points at the first complete message, or returns false. Oversized
+// messages set *error.
+bool lterm_sessiond_inbox_peek(const lterm_sessiond_inbox *inbox,
+                               lterm_sessiond_header *header,
+                               const uint8_t **payload,
+                               bool *error);
+void lterm_sessiond_inbox_pop(lterm_sessiond_inbox *inbox);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "lterm_csi_param.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A compiled SGR sequence: applying it to a pen is two mask operations plus
+// at most two color stores, regardless of how many parameters it had.
+typedef struct {
+    uint16_t set_flags;
+    uint16_t clear_flags;
+    uint8_t set_fg;
+    uint8_t set_bg;
+    uint32_t fg;
+    uint32_t bg;
+} lterm_sgr_delta;
+
+void lterm_sgr_compile(const lterm_csi_param *param, lterm_sgr_delta *delta);
+
+static inline void
+lterm_sgr_apply(const lterm_sgr_delta *delta, uint32_t *fg, uint32_t *bg, uint16_t *flags)
+{
+    *flags = (uint16_t)((*flags & ~delta->clear_flags) | delta->set_flags);
+    if (delta->set_fg) {
+        *fg = delta->fg;
+    }
+    if (delta->set_bg) {
+        *bg = delta->bg;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
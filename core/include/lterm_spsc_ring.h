@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lock-free single-producer/single-consumer byte ring. Capacity is rounded up
+// to a power of two; head and tail are free-running counters.
+typedef struct {
+    uint8_t *data;
+    size_t capacity;
+    size_t mask;
+    _Atomic size_t head;
+    _Atomic size_t tail;
+} lterm_spsc_ring;
+
+bool lterm_spsc_ring_init(lterm_spsc_ring *ring, size_t capacity);
+void lterm_spsc_ring_free(lterm_spsc_ring *ring);
+
+size_t lterm_spsc_ring_readable(const lterm_spsc_ring *ring);
+size_t lterm_spsc_ring_writable(const lterm_spsc_ring *ring);
+
+// Producer side. write_span returns the largest contiguous free region; the
+// producer fills it and publishes with commit.
+uint8_t *lterm_spsc_ring_write_span(lterm_spsc_ring *ring, size_t *length);
+void lterm_spsc_ring_commit(lterm_spsc_ring *ring, size_t count);
+size_t lterm_spsc_ring_write(lterm_spsc_ring *ring, const uint8_t *data, size_t length);
+
+// Consumer side. read_span returns the largest contiguous readable region.
+const uint8_t *lterm_spsc_ring_read_span(lterm_spsc_ring *ring, size_t *length);
+void lterm_spsc_ring_consume(lterm_spsc_ring *ring, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef LTERM_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Minimal io_uring wrapper over the raw syscalls (no liburing). Not
+// thread-safe: callers serialise submission and completion themselves.
+
+// Not in older kernel headers; probed at runtime.
+#define LTERM_IORING_OP_READ_MULTISHOT 49
+
+// True when the kernel supports everything the session loop needs and the
+// LTERM_IO_URING environment variable is not "0".
+bool lterm_uring_supported(void);
+
+#ifdef LTERM_HAVE_IO_URING
+
+typedef struct {
+    int fd;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned *sq_flags;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;
+    unsigned long long enters;
+
+    struct io_uring_buf_ring *buf_ring;
+    uint8_t *buffers;
+    unsigned buf_count;
+    unsigned buf_size;
+    uint16_t buf_group;
+} lterm_uring;
+
+// The completion queue is sized at 16 * entries so multishot reads from many
+// sessions rarely overflow it.
+bool lterm_uring_init(lterm_uring *ring, unsigned entries, unsigned buf_count, unsigned buf_size);
+void lterm_uring_free(lterm_uring *ring);
+
+// Returns a zeroed SQE, submitting queued ones first if the SQ is full.
+struct io_uring_sqe *lterm_uring_get_sqe(lterm_uring *ring);
+int lterm_uring_submit(lterm_uring *ring);
+// Blocks until at least one completion is available.
+int lterm_uring_wait(lterm_uring *ring);
+
+void lterm_uring_prep_read_multishot(struct io_uring_sqe *sqe, int fd, uint16_t buf_group, uint64_t user_data);
+void lterm_uring_prep_write(struct io_uring_sqe *sqe, int fd, const void *data, size_t length, uint64_t user_data);
+void lterm_uring_prep_writev(struct io_uring_sqe *sqe, int fd, const struct iovec *iov, unsigned count, uint64_t user_data);
+void lterm_uring_prep_poll(struct io_uring_sqe *sqe, int fd, unsigned events, uint64_t user_data);
+void lterm_uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target, uint64_t user_data);
+
+struct io_uring_cqe *lterm_uring_peek_cqe(lterm_uring *ring);
+void lterm_uring_cqe_seen(lterm_uring *ring);
+
+const uint8_t *lterm_uring_buffer(const lterm_uring *ring, uint16_t bid);
+void lterm_uring_recycle_buffer(lterm_uring *ring, uint16_t bid);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LTERM_WRITE_QUEUE_CHUNK (4u * 1024u)
+#define LTERM_WRITE_QUEUE_MAX_IOV 64
+
+// Immutable, reference-counted bytes that several queues can hold at once,
+// e.g. one broadcast keystroke or paste queued to many sessions.
+typedef struct {
+    atomic_size_t refs;
+    size_t length;
+    uint8_t data[];
+} lterm_shared_buffer;
+
+lterm_shared_buffer *lterm_shared_buffer_new(const uint8_t *data, size_t length);
+lterm_shared_buffer *lterm_shared_buffer_ref(lterm_shared_buffer *buffer);
+void lterm_shared_buffer_unref(lterm_shared_buffer *buffer);
+
+// FIFO of outbound bytes. Small appends are coalesced into shared chunks and
+// the queue is written with one writev() per flush. Not thread-safe.
+typedef struct lterm_write_chunk {
+    struct lterm_write_chunk *next;
+    size_t length;
+    size_t capacity;
+    // data for copied bytes, or into shared for a referenced buffer.
+    uint8_t *bytes;
+    lterm_shared_buffer *shared;
+    uint8_t data[];
+} lterm_write_chunk;
+
+typedef struct {
+    lterm_write_chunk *head;
+    lterm_write_chunk *tail;
+    size_t head_offset;
+    size_t queued;
+} lterm_write_queue;
+
+void lterm_write_queue_init(lterm_write_queue *queue);
+void lterm_write_queue_free(lterm_write_queue *queue);
+
+bool lterm_write_queue_append(lterm_write_queue *queue, const uint8_t *data, size_t length);
+// Queues buffer's bytes from offset on without copying them; the queue holds
+// a reference until they are consumed.
+bool lterm_write_queue_append_shared(lterm_write_queue *queue, lterm_shared_buffer *buffer, size_t offset);
+size_t lterm_write_queue_queued(const lterm_write_queue *queue);
+
+// Describes up to max queued spans, oldest first; returns how many.
+int lterm_write_queue_iov(const lterm_write_queue *queue, struct iovec *iov, int max);
+void lterm_write_queue_consume(lterm_write_queue *queue, size_t length);
+
+// One writev() of the queued spans. Returns bytes written, 0 when the fd would
+// block or nothing is queued, or -1 on error.
+ssize_t lterm_write_queue_flush(lterm_write_queue *queue, int fd);
+
+#ifdef __cplusplus
+}
+#endif
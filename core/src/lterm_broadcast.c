@@ -0,0 +1,141 @@
+#include "lterm_broadcast.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lterm_write_queue.h"
+
+struct lterm_broadcast_group {
+    lterm_session_loop *loop;
+    pthread_mutex_t lock;
+    lterm_session **members;
+    size_t count;
+    size_t capacity;
+};
+
+lterm_broadcast_group *
+lterm_broadcast_group_new(lterm_session_loop *loop)
+{
+    lterm_broadcast_group *group = calloc(1, sizeof(*group));
+    if (!group) {
+        return NULL;
+    }
+    group->loop = loop;
+    pthread_mutex_init(&group->lock, NULL);
+    return group;
+}
+
+void
+lterm_broadcast_group_free(lterm_broadcast_group *group)
+{
+    if (!group) {
+        return;
+    }
+    pthread_mutex_destroy(&group->lock);
+    free(group->members);
+    free(group);
+}
+
+static size_t
+find_locked(const lterm_broadcast_group *group, const lterm_session *session)
+{
+    for (size_t i = 0; i < group->count; ++i) {
+        if (group->members[i] == session) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+bool
+lterm_broadcast_group_add(lterm_broadcast_group *group, lterm_session *session)
+{
+    if (!group || !session) {
+        return false;
+    }
+    pthread_mutex_lock(&group->lock);
+    bool ok = true;
+    if (find_locked(group, session) == SIZE_MAX) {
+        if (group->count == group->capacity) {
+            size_t capacity = group->capacity ? group->capacity * 2 : 8;
+            lterm_session **members = realloc(group->members, capacity * sizeof(*members));
+            if (!members) {
+                ok = false;
+            } else {
+                group->members = members;
+                group->capacity = capacity;
+            }
+        }
+        if (ok) {
+            group->members[group->count++] = session;
+        }
+    }
+    pthread_mutex_unlock(&group->lock);
+    return ok;
+}
+
+void
+lterm_broadcast_group_remove(lterm_broadcast_group *group, lterm_session *session)
+{
+    if (!group || !session) {
+        return;
+    }
+    pthread_mutex_lock(&group->lock);
+    size_t index = find_locked(group, session);
+    if (index != SIZE_MAX) {
+        memmove(group->members + index,
+                group->members + index + 1,
+                (group->count - index - 1) * sizeof(*group->members));
+        group->count--;
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+bool
+lterm_broadcast_group_contains(lterm_broadcast_group *group, const lterm_session *session)
+{
+    if (!group || !session) {
+        return false;
+    }
+    pthread_mutex_lock(&group->lock);
+    bool found = find_locked(group, session) != SIZE_MAX;
+    pthread_mutex_unlock(&group->lock);
+    return found;
+}
+
+size_t
+lterm_broadcast_group_count(lterm_broadcast_group *group)
+{
+    if (!group) {
+        return 0;
+    }
+    pthread_mutex_lock(&group->lock);
+    size_t count = group->count;
+    pthread_mutex_unlock(&group->lock);
+    return count;
+}
+
+size_t
+lterm_broadcast_send(lterm_broadcast_group *group, const uint8_t *data, size_t length)
+{
+    if (!group || !data || !length) {
+        return 0;
+    }
+    lterm_shared_buffer *buffer = lterm_shared_buffer_new(data, length);
+    if (!buffer) {
+        return 0;
+    }
+    size_t accepted = 0;
+    pthread_mutex_lock(&group->lock);
+    lterm_session_loop_begin_batch(group->loop);
+    for (size_t i = 0; i < group->count; ++i) {
+        if (lterm_session_write_shared(group->members[i], buffer)) {
+            accepted++;
+        }
+    }
+    lterm_session_loop_end_batch(group->loop);
+    pthread_mutex_unlock(&group->lock);
+    lterm_shared_buffer_unref(buffer);
+    return accepted;
+}
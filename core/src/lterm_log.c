@@ -0,0 +1,648 @@
+#define _GNU_SOURCE
+
+#include "lterm_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef LTERM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "lterm_spsc_ring.h"
+
+#define LOG_IOV_MAX 64
+#define LOG_STAMP_MAX 32
+#define LOG_ZLIB_CHUNK (64u * 1024u)
+
+// Each append is one record in the ring: this header, then the bytes.
+typedef struct {
+    int64_t realtime_ns;
+    uint32_t length;
+    uint32_t reserved;
+} record_header;
+
+typedef enum {
+    PLAIN_GROUND,
+    PLAIN_ESC,
+    PLAIN_ESC_INTERMEDIATE,
+    PLAIN_CSI,
+    PLAIN_STRING,
+    PLAIN_STRING_ESC,
+} plain_state;
+
+struct lterm_log {
+    lterm_log_options options;
+    char *path;
+    lterm_spsc_ring ring;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t flushed;
+    bool stopping;
+    atomic_bool wake_pending;
+    atomic_ullong bytes_logged;
+    atomic_ullong bytes_dropped;
+    atomic_ullong bytes_written;
+    atomic_ullong writes;
+    atomic_ullong rotations;
+
+    // Writer thread only.
+    int fd;
+    size_t file_bytes;
+    struct iovec iov[LOG_IOV_MAX];
+    int iov_count;
+    uint8_t *stage;
+    size_t stage_length;
+    size_t stage_capacity;
+    plain_state plain;
+    bool line_start;
+    time_t stamp_second;
+    char stamp_prefix[LOG_STAMP_MAX];
+#ifdef LTERM_HAVE_ZLIB
+    z_stream zlib;
+    bool zlib_active;
+    uint8_t *zlib_out;
+#endif
+};
+
+bool
+lterm_log_compression_supported(void)
+{
+#ifdef LTERM_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+static bool
+direct_mode(const lterm_log *log)
+{
+    return log->options.format == LTERM_LOG_RAW && log->options.timestamps == LTERM_LOG_TIMESTAMP_NONE &&
+           !log->options.compress;
+}
+
+static void
+ring_copy(const lterm_spsc_ring *ring, size_t position, void *out, size_t length)
+{
+    uint8_t *bytes = out;
+    for (size_t copied = 0; copied < length;) {
+        size_t index = (position + copied) & ring->mask;
+        size_t chunk = ring->capacity - index;
+        if (chunk > length - copied) {
+            chunk = length - copied;
+        }
+        memcpy(bytes + copied, ring->data + index, chunk);
+        copied += chunk;
+    }
+}
+
+static bool
+write_all(lterm_log *log, struct iovec *iov, int count)
+{
+    while (count > 0) {
+        ssize_t written = writev(log->fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        atomic_fetch_add(&log->writes, 1);
+        atomic_fetch_add(&log->bytes_written, (unsigned long long)written);
+        log->file_bytes += (size_t)written;
+        size_t left = (size_t)written;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+#ifdef LTERM_HAVE_ZLIB
+static bool
+zlib_start(lterm_log *log)
+{
+    memset(&log->zlib, 0, sizeof(log->zlib));
+    // 15 + 16: gzip framing, so each rotated file is a plain .gz stream.
+    log->zlib_active = deflateInit2(&log->zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                                    Z_DEFAULT_STRATEGY) == Z_OK;
+    return log->zlib_active;
+}
+
+static bool
+zlib_run(lterm_log *log, const uint8_t *data, size_t length, int flush)
+{
+    log->zlib.next_in = (Bytef *)data;
+    log->zlib.avail_in = (uInt)length;
+    do {
+        log->zlib.next_out = log->zlib_out;
+        log->zlib.avail_out = LOG_ZLIB_CHUNK;
+        int status = deflate(&log->zlib, flush);
+        if (status == Z_STREAM_ERROR) {
+            return false;
+        }
+        size_t produced = LOG_ZLIB_CHUNK - log->zlib.avail_out;
+        struct iovec iov = {.iov_base = log->zlib_out, .iov_len = produced};
+        if (produced && !write_all(log, &iov, 1)) {
+            return false;
+        }
+    } while (log->zlib.avail_out == 0);
+    return true;
+}
+
+static void
+zlib_finish(lterm_log *log)
+{
+    if (log->zlib_active) {
+        zlib_run(log, NULL, 0, Z_FINISH);
+        deflateEnd(&log->zlib);
+        log->zlib_active = false;
+    }
+}
+#endif
+
+// Sends a batch to the file, through gzip when enabled.
+static void
+output(lterm_log *log, struct iovec *iov, int count)
+{
+#ifdef LTERM_HAVE_ZLIB
+    if (log->options.compress) {
+        if (!log->zlib_active) {
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            // uInt is 32 bits; the stage and ring never get near that.
+            zlib_run(log, iov[i].iov_base, iov[i].iov_len, Z_NO_FLUSH);
+        }
+        zlib_run(log, NULL, 0, Z_SYNC_FLUSH);
+        return;
+    }
+#endif
+    write_all(log, iov, count);
+}
+
+static bool
+stage_reserve(lterm_log *log, size_t extra)
+{
+    if (log->stage_capacity - log->stage_length >= extra) {
+        return true;
+    }
+    size_t capacity = log->stage_capacity ? log->stage_capacity : 64u * 1024u;
+    while (capacity - log->stage_length < extra) {
+        capacity *= 2;
+    }
+    uint8_t *stage = realloc(log->stage, capacity);
+    if (!stage) {
+        return false;
+    }
+    log->stage = stage;
+    log->stage_capacity = capacity;
+    return true;
+}
+
+static void
+stage_stamp(lterm_log *log, int64_t realtime_ns)
+{
+    time_t second = (time_t)(realtime_ns / 1000000000ll);
+    if (second != log->stamp_second || !log->stamp_prefix[0]) {
+        struct tm local;
+        localtime_r(&second, &local);
+        strftime(log->stamp_prefix, sizeof(log->stamp_prefix), "[%Y-%m-%d %H:%M:%S", &local);
+        log->stamp_second = second;
+    }
+    char stamp[LOG_STAMP_MAX + 8];
+    int length = snprintf(stamp, sizeof(stamp), "%s.%03d] ", log->stamp_prefix,
+                          (int)(realtime_ns / 1000000ll % 1000));
+    if (length > 0 && stage_reserve(log, (size_t)length)) {
+        memcpy(log->stage + log->stage_length, stamp, (size_t)length);
+        log->stage_length += (size_t)length;
+    }
+}
+
+// Appends bytes that survive the format to the stage, stamping line starts.
+static void
+stage_text(lterm_log *log, const record_header *header, const uint8_t *data, size_t length)
+{
+    bool stamps = log->options.timestamps == LTERM_LOG_TIMESTAMP_LINE;
+    for (size_t i = 0; i < length;) {
+        size_t run = length - i;
+        if (log->options.format == LTERM_LOG_RAW) {
+            const uint8_t *newline = stamps ? memchr(data + i, '\n', run) : NULL;
+            if (newline) {
+                run = (size_t)(newline - (data + i)) + 1;
+            }
+        } else {
+            // Plain text: pass runs of printable bytes (UTF-8 included),
+            // LF and TAB; drop everything else and whole escape sequences.
+            uint8_t byte = data[i];
+            bool keep = false;
+            switch (log->plain) {
+            case PLAIN_GROUND:
+                if (byte == 0x1b) {
+                    log->plain = PLAIN_ESC;
+                } else {
+                    keep = byte >= 0x20 ? byte != 0x7f : byte == '\n' || byte == '\t';
+                }
+                break;
+            case PLAIN_ESC:
+                if (byte == '[') {
+                    log->plain = PLAIN_CSI;
+                } else if (byte == ']' || byte == 'P' || byte == 'X' || byte == '^' || byte == '_') {
+                    log->plain = PLAIN_STRING;
+                } else if (byte >= 0x20 && byte <= 0x2f) {
+                    log->plain = PLAIN_ESC_INTERMEDIATE;
+                } else {
+                    log->plain = PLAIN_GROUND;
+                }
+                break;
+            case PLAIN_ESC_INTERMEDIATE:
+                if (byte < 0x20 || byte > 0x2f) {
+                    log->plain = PLAIN_GROUND;
+                }
+                break;
+            case PLAIN_CSI:
+                if (byte >= 0x40 && byte <= 0x7e) {
+                    log->plain = PLAIN_GROUND;
+                }
+                break;
+            case PLAIN_STRING:
+                if (byte == 0x07) {
+                    log->plain = PLAIN_GROUND;
+                } else if (byte == 0x1b) {
+                    log->plain = PLAIN_STRING_ESC;
+                }
+                break;
+            case PLAIN_STRING_ESC:
+                log->plain = byte == '\\' ? PLAIN_GROUND : PLAIN_STRING;
+                break;
+            }
+            if (!keep) {
+                i++;
+                continue;
+            }
+            run = 1;
+            while (byte >= 0x20 && i + run < length && data[i + run] >= 0x20 && data[i + run] != 0x7f) {
+                run++;
+            }
+        }
+        if (stamps && log->line_start) {
+            stage_stamp(log, header->realtime_ns);
+        }
+        if (!stage_reserve(log, run)) {
+            return;
+        }
+        memcpy(log->stage + log->stage_length, data + i, run);
+        log->stage_length += run;
+        log->line_start = data[i + run - 1] == '\n';
+        i += run;
+    }
+}
+
+static void
+emit(lterm_log *log, const record_header *header, const uint8_t *data, size_t length)
+{
+    if (!direct_mode(log)) {
+        stage_text(log, header, data, length);
+        return;
+    }
+    // Raw bytes go out straight from the ring.
+    if (log->iov_count == LOG_IOV_MAX) {
+        output(log, log->iov, log->iov_count);
+        log->iov_count = 0;
+    }
+    log->iov[log->iov_count++] = (struct iovec){.iov_base = (void *)data, .iov_len = length};
+}
+
+static void
+emit_flush(lterm_log *log)
+{
+    if (log->iov_count > 0) {
+        output(log, log->iov, log->iov_count);
+        log->iov_count = 0;
+    }
+    if (log->stage_length > 0) {
+        struct iovec iov = {.iov_base = log->stage, .iov_len = log->stage_length};
+        output(log, &iov, 1);
+        log->stage_length = 0;
+    }
+}
+
+static bool
+open_file(lterm_log *log)
+{
+    log->fd = open(log->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (log->fd < 0) {
+        return false;
+    }
+    struct stat st;
+    log->file_bytes = fstat(log->fd, &st) == 0 ? (size_t)st.st_size : 0;
+#ifdef LTERM_HAVE_ZLIB
+    if (log->options.compress && !zlib_start(log)) {
+        close(log->fd);
+        log->fd = -1;
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void
+close_file(lterm_log *log)
+{
+#ifdef LTERM_HAVE_ZLIB
+    zlib_finish(log);
+#endif
+    if (log->fd >= 0) {
+        close(log->fd);
+        log->fd = -1;
+    }
+}
+
+static void
+rotate(lterm_log *log)
+{
+    close_file(log);
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    for (unsigned i = log->options.rotate_keep; i > 0; --i) {
+        if (i > 1) {
+            snprintf(from, sizeof(from), "%s.%u", log->path, i - 1);
+        } else {
+            snprintf(from, sizeof(from), "%s", log->path);
+        }
+        snprintf(to, sizeof(to), "%s.%u", log->path, i);
+        rename(from, to);
+    }
+    atomic_fetch_add(&log->rotations, 1);
+    open_file(log);
+}
+
+// Writes out every complete record in the ring, then releases the space.
+static void
+drain(lterm_log *log)
+{
+    lterm_spsc_ring *ring = &log->ring;
+    size_t available = lterm_spsc_ring_readable(ring);
+    // The ring's head is the consumer end.
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t offset = 0;
+    while (available - offset >= sizeof(record_header)) {
+        record_header header;
+        ring_copy(ring, head + offset, &header, sizeof(header));
+        size_t record = sizeof(header) + header.length;
+        if (available - offset < record) {
+            break;
+        }
+        size_t position = head + offset + sizeof(header);
+        for (size_t left = header.length; left > 0;) {
+            size_t index = position & ring->mask;
+            size_t chunk = ring->capacity - index;
+            if (chunk > left) {
+                chunk = left;
+            }
+            emit(log, &header, ring->data + index, chunk);
+            position += chunk;
+            left -= chunk;
+        }
+        offset += record;
+    }
+    if (offset == 0) {
+        return;
+    }
+    if (log->fd >= 0) {
+        emit_flush(log);
+    } else {
+        log->iov_count = 0;
+        log->stage_length = 0;
+    }
+    lterm_spsc_ring_consume(ring, offset);
+    if (log->options.rotate_bytes && log->file_bytes >= log->options.rotate_bytes) {
+        rotate(log);
+    }
+}
+
+static void *
+writer_main(void *user_data)
+{
+    lterm_log *log = user_data;
+    pthread_mutex_lock(&log->lock);
+    while (!log->stopping) {
+        if (lterm_spsc_ring_readable(&log->ring) < log->ring.capacity / 2) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_nsec += (long)log->options.flush_ms * 1000000l;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000l;
+            deadline.tv_nsec %= 1000000000l;
+            pthread_cond_timedwait(&log->wake, &log->lock, &deadline);
+        }
+        atomic_store(&log->wake_pending, false);
+        pthread_mutex_unlock(&log->lock);
+        drain(log);
+        pthread_mutex_lock(&log->lock);
+        pthread_cond_broadcast(&log->flushed);
+    }
+    pthread_mutex_unlock(&log->lock);
+    drain(log);
+    close_file(log);
+    return NULL;
+}
+
+lterm_log *
+lterm_log_open(const lterm_log_options *options)
+{
+    if (!options || !options->path || (options->compress && !lterm_log_compression_supported())) {
+        return NULL;
+    }
+    lterm_log *log = calloc(1, sizeof(*log));
+    if (!log) {
+        return NULL;
+    }
+    log->options = *options;
+    if (!log->options.ring_capacity) {
+        log->options.ring_capacity = LTERM_LOG_RING_CAPACITY;
+    }
+    if (!log->options.rotate_keep) {
+        log->options.rotate_keep = LTERM_LOG_ROTATE_KEEP;
+    }
+    if (!log->options.flush_ms) {
+        log->options.flush_ms = LTERM_LOG_FLUSH_MS;
+    }
+    log->fd = -1;
+    log->line_start = true;
+    log->path = strdup(options->path);
+    log->options.path = log->path;
+    atomic_init(&log->wake_pending, false);
+    atomic_init(&log->bytes_logged, 0);
+    atomic_init(&log->bytes_dropped, 0);
+    atomic_init(&log->bytes_written, 0);
+    atomic_init(&log->writes, 0);
+    atomic_init(&log->rotations, 0);
+#ifdef LTERM_HAVE_ZLIB
+    if (log->options.compress) {
+        log->zlib_out = malloc(LOG_ZLIB_CHUNK);
+    }
+    bool buffers = !log->options.compress || log->zlib_out;
+#else
+    bool buffers = true;
+#endif
+    if (!log->path || !buffers || !lterm_spsc_ring_init(&log->ring, log->options.ring_capacity)) {
+        goto fail;
+    }
+    if (!open_file(log)) {
+        lterm_spsc_ring_free(&log->ring);
+        goto fail;
+    }
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&log->flushed, NULL);
+    pthread_mutex_init(&log->lock, NULL);
+    if (pthread_create(&log->thread, NULL, writer_main, log) != 0) {
+        pthread_mutex_destroy(&log->lock);
+        pthread_cond_destroy(&log->flushed);
+        pthread_cond_destroy(&log->wake);
+        close_file(log);
+        lterm_spsc_ring_free(&log->ring);
+        goto fail;
+    }
+    return log;
+
+fail:
+#ifdef LTERM_HAVE_ZLIB
+    free(log->zlib_out);
+#endif
+    free(log->path);
+    free(log);
+    return NULL;
+}
+
+void
+lterm_log_close(lterm_log *log)
+{
+    if (!log) {
+        return;
+    }
+    pthread_mutex_lock(&log->lock);
+    log->stopping = true;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->thread, NULL);
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->flushed);
+    pthread_cond_destroy(&log->wake);
+    lterm_spsc_ring_free(&log->ring);
+    free(log->stage);
+#ifdef LTERM_HAVE_ZLIB
+    free(log->zlib_out);
+#endif
+    free(log->path);
+    free(log);
+}
+
+bool
+lterm_log_append(lterm_log *log, const uint8_t *data, size_t length)
+{
+    if (!log || !data || !length) {
+        return false;
+    }
+    lterm_spsc_ring *ring = &log->ring;
+    record_header header = {.length = (uint32_t)length};
+    if (length > UINT32_MAX || lterm_spsc_ring_writable(ring) < sizeof(header) + length) {
+        atomic_fetch_add_explicit(&log->bytes_dropped, length, memory_order_relaxed);
+        return false;
+    }
+    if (log->options.timestamps != LTERM_LOG_TIMESTAMP_NONE) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        header.realtime_ns = (int64_t)now.tv_sec * 1000000000ll + now.tv_nsec;
+    }
+    // Write the payload before publishing the header so the writer never
+    // sees half a record: both land in the free space, then one commit.
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t payload = tail + sizeof(header);
+    for (size_t copied = 0; copied < length;) {
+        size_t index = (payload + copied) & ring->mask;
+        size_t chunk = ring->capacity - index;
+        if (chunk > length - copied) {
+            chunk = length - copied;
+        }
+        memcpy(ring->data + index, data + copied, chunk);
+        copied += chunk;
+    }
+    for (size_t copied = 0; copied < sizeof(header);) {
+        size_t index = (tail + copied) & ring->mask;
+        size_t chunk = ring->capacity - index;
+        if (chunk > sizeof(header) - copied) {
+            chunk = sizeof(header) - copied;
+        }
+        memcpy(ring->data + index, (const uint8_t *)&header + copied, chunk);
+        copied += chunk;
+    }
+    lterm_spsc_ring_commit(ring, sizeof(header) + length);
+    atomic_fetch_add_explicit(&log->bytes_logged, length, memory_order_relaxed);
+    if (lterm_spsc_ring_readable(ring) >= ring->capacity / 2 && !atomic_exchange(&log->wake_pending, true)) {
+        pthread_mutex_lock(&log->lock);
+        pthread_cond_signal(&log->wake);
+        pthread_mutex_unlock(&log->lock);
+    }
+    return true;
+}
+
+bool
+lterm_log_flush(lterm_log *log, int timeout_ms)
+{
+    if (!log) {
+        return false;
+    }
+    size_t target = atomic_load(&log->ring.tail);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000l;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000l;
+    deadline.tv_nsec %= 1000000000l;
+    bool done = true;
+    pthread_mutex_lock(&log->lock);
+    pthread_cond_signal(&log->wake);
+    while ((ptrdiff_t)(target - atomic_load(&log->ring.head)) > 0) {
+        if (pthread_cond_timedwait(&log->flushed, &log->lock, &deadline) != 0) {
+            done = (ptrdiff_t)(target - atomic_load(&log->ring.head)) <= 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+    return done;
+}
+
+void
+lterm_log_get_stats(lterm_log *log, lterm_log_stats *stats)
+{
+    if (!log || !stats) {
+        return;
+    }
+    stats->bytes_logged = atomic_load(&log->bytes_logged);
+    stats->bytes_dropped = atomic_load(&log->bytes_dropped);
+    stats->bytes_written = atomic_load(&log->bytes_written);
+    stats->writes = atomic_load(&log->writes);
+    stats->rotations = atomic_load(&log->rotations);
+}
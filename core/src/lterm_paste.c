@@ -0,0 +1,235 @@
+#include "lterm_paste.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const uint8_t kBracketStart[] = "\x1b[200~";
+static const uint8_t kBracketEnd[] = "\x1b[201~";
+
+struct lterm_paste {
+    lterm_session *session;
+    lterm_paste_status status;
+    bool bracketed;
+    bool sanitize;
+    bool started;
+    bool last_cr;
+    bool pending_c2;
+    size_t consumed;
+    size_t total;
+    uint8_t input[LTERM_PASTE_CHUNK];
+    // Filtering never grows the data beyond a held-back UTF-8 lead byte.
+    uint8_t output[LTERM_PASTE_CHUNK + 1];
+};
+
+lterm_paste *
+lterm_paste_new(lterm_session *session, const lterm_paste_options *options)
+{
+    if (!session) {
+        return NULL;
+    }
+    lterm_paste *paste = calloc(1, sizeof(*paste));
+    if (!paste) {
+        return NULL;
+    }
+    paste->session = session;
+    paste->status = LTERM_PASTE_RUNNING;
+    lterm_paste_bracket bracket = options ? options->bracket : LTERM_PASTE_BRACKET_AUTO;
+    if (bracket == LTERM_PASTE_BRACKET_AUTO) {
+        lterm_session_lock(session);
+        paste->bracketed = lterm_screen_dec_mode(lterm_session_screen(session),
+                                                 LTERM_DEC_MODE_BRACKETED_PASTE);
+        lterm_session_unlock(session);
+    } else {
+        paste->bracketed = bracket == LTERM_PASTE_BRACKET_ALWAYS;
+    }
+    paste->sanitize = options && options->sanitize;
+    paste->total = options ? options->total : 0;
+    return paste;
+}
+
+void
+lterm_paste_free(lterm_paste *paste)
+{
+    free(paste);
+}
+
+static bool
+is_active(const lterm_paste *paste)
+{
+    return paste && paste->status == LTERM_PASTE_RUNNING;
+}
+
+bool
+lterm_paste_ready(const lterm_paste *paste)
+{
+    return is_active(paste) &&
+           lterm_session_write_queued(paste->session) < LTERM_PASTE_HIGH_WATER;
+}
+
+static bool
+send_bytes(lterm_paste *paste, const uint8_t *data, size_t length)
+{
+    if (length == 0) {
+        return true;
+    }
+    if (!lterm_session_write(paste->session, data, length)) {
+        paste->status = LTERM_PASTE_FAILED;
+        return false;
+    }
+    return true;
+}
+
+static size_t
+filter(lterm_paste *paste, const uint8_t *data, size_t length)
+{
+    uint8_t *out = paste->output;
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t byte = data[i];
+        if (paste->pending_c2) {
+            paste->pending_c2 = false;
+            if (byte >= 0x80 && byte <= 0x9f) {
+                continue;
+            }
+            out[count++] = 0xc2;
+        }
+        if (paste->last_cr && byte == '\n') {
+            paste->last_cr = false;
+            continue;
+        }
+        paste->last_cr = byte == '\r';
+        if (byte == '\n') {
+            byte = '\r';
+        } else if (byte == 0x1b && (paste->bracketed || paste->sanitize)) {
+            continue;
+        } else if (paste->sanitize) {
+            if ((byte < 0x20 && byte != '\t' && byte != '\r') || byte == 0x7f) {
+                continue;
+            }
+            if (byte == 0xc2) {
+                paste->pending_c2 = true;
+                continue;
+            }
+        }
+        out[count++] = byte;
+    }
+    return count;
+}
+
+bool
+lterm_paste_feed(lterm_paste *paste, const uint8_t *data, size_t length)
+{
+    if (!is_active(paste) || (!data && length)) {
+        return false;
+    }
+    while (length > 0) {
+        size_t slice = length < LTERM_PASTE_CHUNK ? length : LTERM_PASTE_CHUNK;
+        size_t count = filter(paste, data, slice);
+        if (count && !paste->started) {
+            if (paste->bracketed && !send_bytes(paste, kBracketStart, sizeof(kBracketStart) - 1)) {
+                return false;
+            }
+            paste->started = true;
+        }
+        if (!send_bytes(paste, paste->output, count)) {
+            return false;
+        }
+        paste->consumed += slice;
+        data += slice;
+        length -= slice;
+    }
+    return true;
+}
+
+static bool
+close_bracket(lterm_paste *paste)
+{
+    if (paste->pending_c2) {
+        paste->pending_c2 = false;
+        if (!send_bytes(paste, (const uint8_t *)"\xc2", 1)) {
+            return false;
+        }
+    }
+    if (paste->started && paste->bracketed) {
+        return send_bytes(paste, kBracketEnd, sizeof(kBracketEnd) - 1);
+    }
+    return true;
+}
+
+bool
+lterm_paste_finish(lterm_paste *paste)
+{
+    if (!is_active(paste)) {
+        return false;
+    }
+    if (!close_bracket(paste)) {
+        return false;
+    }
+    paste->status = LTERM_PASTE_DONE;
+    return true;
+}
+
+lterm_paste_status
+lterm_paste_pump_fd(lterm_paste *paste, int fd)
+{
+    if (!paste) {
+        return LTERM_PASTE_FAILED;
+    }
+    while (lterm_paste_ready(paste)) {
+        ssize_t count = read(fd, paste->input, sizeof(paste->input));
+        if (count > 0) {
+            lterm_paste_feed(paste, paste->input, (size_t)count);
+        } else if (count == 0) {
+            lterm_paste_finish(paste);
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return LTERM_PASTE_RUNNING;
+        } else if (errno != EINTR) {
+            close_bracket(paste);
+            paste->status = LTERM_PASTE_FAILED;
+        }
+    }
+    return lterm_paste_get_status(paste);
+}
+
+void
+lterm_paste_cancel(lterm_paste *paste)
+{
+    if (!is_active(paste)) {
+        return;
+    }
+    paste->pending_c2 = false;
+    if (close_bracket(paste)) {
+        paste->status = LTERM_PASTE_CANCELLED;
+    }
+}
+
+lterm_paste_status
+lterm_paste_get_status(const lterm_paste *paste)
+{
+    if (!paste) {
+        return LTERM_PASTE_FAILED;
+    }
+    if (paste->status == LTERM_PASTE_RUNNING && !lterm_paste_ready(paste)) {
+        return LTERM_PASTE_BLOCKED;
+    }
+    return paste->status;
+}
+
+bool
+lterm_paste_bracketed(const lterm_paste *paste)
+{
+    return paste && paste->bracketed;
+}
+
+size_t
+lterm_paste_consumed(const lterm_paste *paste)
+{
+    return paste ? paste->consumed : 0;
+}
+
+size_t
+lterm_paste_total(const lterm_paste *paste)
+{
+    return paste ? paste->total : 0;
+}
@@ -0,0 +1,265 @@
+#include "lterm_predict.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Wider or combining characters would need the width tables to place.
+#define PREDICT_MAX_CODEPOINT 0x2ffu
+
+struct lterm_predictor {
+    pthread_mutex_t lock;
+    lterm_prediction items[LTERM_PREDICT_MAX];
+    size_t count;
+    // A raw-mode echo has been confirmed since the last rollback.
+    bool trusted;
+    bool displayed;
+    // Set by control input; nothing more is predicted until output arrives.
+    bool paused;
+    lterm_predict_stats stats;
+};
+
+lterm_predictor *
+lterm_predictor_new(void)
+{
+    lterm_predictor *predictor = calloc(1, sizeof(*predictor));
+    if (!predictor) {
+        return NULL;
+    }
+    pthread_mutex_init(&predictor->lock, NULL);
+    return predictor;
+}
+
+void
+lterm_predictor_free(lterm_predictor *predictor)
+{
+    if (!predictor) {
+        return;
+    }
+    pthread_mutex_destroy(&predictor->lock);
+    free(predictor);
+}
+
+// Decodes one UTF-8 sequence; returns its length, or 0 if data ends inside
+// it. Malformed bytes come back as U+FFFD.
+static size_t
+decode_utf8(const uint8_t *data, size_t length, uint32_t *codepoint)
+{
+    uint8_t lead = data[0];
+    size_t need = lead < 0x80 ? 0 : (lead & 0xe0) == 0xc0 ? 1 : (lead & 0xf0) == 0xe0 ? 2 : (lead & 0xf8) == 0xf0 ? 3 : 4;
+    if (need == 0) {
+        *codepoint = lead;
+        return 1;
+    }
+    if (need == 4) {
+        *codepoint = 0xfffd;
+        return 1;
+    }
+    if (length <= need) {
+        return 0;
+    }
+    uint32_t value = lead & (0x3fu >> need);
+    for (size_t i = 1; i <= need; ++i) {
+        if ((data[i] & 0xc0) != 0x80) {
+            *codepoint = 0xfffd;
+            return 1;
+        }
+        value = (value << 6) | (data[i] & 0x3fu);
+    }
+    *codepoint = value;
+    return need + 1;
+}
+
+static void
+rollback_locked(lterm_predictor *predictor)
+{
+    if (predictor->count) {
+        predictor->stats.rolled_back++;
+    }
+    predictor->count = 0;
+    predictor->trusted = false;
+}
+
+static bool
+expired(const lterm_prediction *prediction, int64_t now_ns)
+{
+    return now_ns - prediction->typed_ns > LTERM_PREDICT_TIMEOUT_MS * 1000000ll;
+}
+
+static void
+expire_locked(lterm_predictor *predictor, int64_t now_ns)
+{
+    if (predictor->count && expired(&predictor->items[0], now_ns)) {
+        rollback_locked(predictor);
+    }
+}
+
+bool
+lterm_predictor_key(lterm_predictor *predictor,
+                    const lterm_screen *screen,
+                    lterm_pty_input_mode mode,
+                    const uint8_t *data,
+                    size_t length,
+                    int64_t now_ns)
+{
+    if (!predictor || !screen || !data || !length) {
+        return false;
+    }
+    pthread_mutex_lock(&predictor->lock);
+    if (mode == LTERM_PTY_INPUT_SILENT || mode == LTERM_PTY_INPUT_UNKNOWN) {
+        predictor->count = 0;
+        pthread_mutex_unlock(&predictor->lock);
+        return false;
+    }
+    bool show = mode == LTERM_PTY_INPUT_LINE || predictor->trusted;
+    bool predicted = false;
+    size_t offset = 0;
+    while (offset < length && !predictor->paused) {
+        uint32_t codepoint = 0;
+        size_t used = decode_utf8(data + offset, length - offset, &codepoint);
+        if (used == 0) {
+            break;
+        }
+        offset += used;
+        // Control input (Enter, backspace, arrows) moves the cursor in ways
+        // only the application knows.
+        if (codepoint < 0x20 || (codepoint >= 0x7f && codepoint < 0xa0) || codepoint > PREDICT_MAX_CODEPOINT) {
+            predictor->count = 0;
+            predictor->paused = true;
+            break;
+        }
+        size_t row = screen->cursor_row;
+        size_t col = screen->cursor_col;
+        if (predictor->count) {
+            const lterm_prediction *last = &predictor->items[predictor->count - 1];
+            row = last->row;
+            col = last->col + 1;
+        }
+        if (col >= screen->grid.cols || predictor->count == LTERM_PREDICT_MAX) {
+            predictor->paused = true;
+            break;
+        }
+        predictor->items[predictor->count++] = (lterm_prediction){
+            .row = row,
+            .col = col,
+            .codepoint = codepoint,
+            .typed_ns = now_ns,
+        };
+        predictor->stats.predicted++;
+        if (show) {
+            predictor->stats.displayed++;
+        }
+        predicted = true;
+    }
+    predictor->displayed = show;
+    pthread_mutex_unlock(&predictor->lock);
+    return predicted && show;
+}
+
+void
+lterm_predictor_update(lterm_predictor *predictor, const lterm_screen *screen, int64_t now_ns)
+{
+    if (!predictor || !screen) {
+        return;
+    }
+    pthread_mutex_lock(&predictor->lock);
+    predictor->paused = false;
+    size_t confirmed = 0;
+    while (confirmed < predictor->count) {
+        const lterm_prediction *prediction = &predictor->items[confirmed];
+        if (expired(prediction, now_ns) || screen->cursor_row != prediction->row ||
+            prediction->col >= screen->grid.cols) {
+            rollback_locked(predictor);
+            confirmed = 0;
+            break;
+        }
+        // Not echoed until the cursor has moved past it.
+        if (screen->cursor_col <= prediction->col) {
+            break;
+        }
+        const lterm_cell *cell = &screen->grid.cells[prediction->row * screen->grid.cols + prediction->col];
+        if (cell->codepoint != prediction->codepoint) {
+            rollback_locked(predictor);
+            confirmed = 0;
+            break;
+        }
+        predictor->stats.confirmed++;
+        predictor->stats.echo_ns_total += (unsigned long long)(now_ns - prediction->typed_ns);
+        predictor->trusted = true;
+        confirmed++;
+    }
+    if (confirmed) {
+        memmove(predictor->items,
+                predictor->items + confirmed,
+                (predictor->count - confirmed) * sizeof(*predictor->items));
+        predictor->count -= confirmed;
+    }
+    pthread_mutex_unlock(&predictor->lock);
+}
+
+size_t
+lterm_predictor_overlay(lterm_predictor *predictor, lterm_prediction *out, size_t max, int64_t now_ns)
+{
+    if (!predictor || !out) {
+        return 0;
+    }
+    pthread_mutex_lock(&predictor->lock);
+    expire_locked(predictor, now_ns);
+    size_t count = predictor->displayed ? predictor->count : 0;
+    if (count > max) {
+        count = max;
+    }
+    memcpy(out, predictor->items, count * sizeof(*out));
+    pthread_mutex_unlock(&predictor->lock);
+    return count;
+}
+
+bool
+lterm_predictor_cursor(lterm_predictor *predictor, size_t *row, size_t *col, int64_t now_ns)
+{
+    if (!predictor) {
+        return false;
+    }
+    pthread_mutex_lock(&predictor->lock);
+    expire_locked(predictor, now_ns);
+    bool shown = predictor->displayed && predictor->count > 0;
+    if (shown) {
+        const lterm_prediction *last = &predictor->items[predictor->count - 1];
+        if (row) {
+            *row = last->row;
+        }
+        if (col) {
+            *col = last->col + 1;
+        }
+    }
+    pthread_mutex_unlock(&predictor->lock);
+    return shown;
+}
+
+void
+lterm_predictor_reset(lterm_predictor *predictor)
+{
+    if (!predictor) {
+        return;
+    }
+    pthread_mutex_lock(&predictor->lock);
+    predictor->count = 0;
+    predictor->trusted = false;
+    predictor->paused = false;
+    pthread_mutex_unlock(&predictor->lock);
+}
+
+void
+lterm_predictor_get_stats(lterm_predictor *predictor, lterm_predict_stats *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!predictor) {
+        return;
+    }
+    pthread_mutex_lock(&predictor->lock);
+    *stats = predictor->stats;
+    pthread_mutex_unlock(&predictor->lock);
+}
@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+
+#include "lterm_proc_tracker.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    lterm_session *session;
+    // Captured at add time so the sampler never reads the live lterm_pty.
+    int master_fd;
+    pid_t shell_pid;
+    lterm_proc_tracker_cb callback;
+    void *user_data;
+    bool sampled;
+    lterm_proc_info info;
+    char reported_cwd[LTERM_PROC_CWD_MAX];
+} tracked_session;
+
+struct lterm_proc_tracker {
+    // Guards the entries' info and reported cwd; the entry array changes only
+    // with pass_lock held as well.
+    pthread_mutex_t lock;
+    // Held for a whole sampling pass so remove() never frees an entry the
+    // sampler is still using.
+    pthread_mutex_t pass_lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool stopping;
+    bool refresh;
+    unsigned interval_ms;
+    tracked_session **entries;
+    size_t count;
+    size_t capacity;
+};
+
+static size_t
+find_entry(const lterm_proc_tracker *tracker, const lterm_session *session)
+{
+    for (size_t i = 0; i < tracker->count; ++i) {
+        if (tracker->entries[i]->session == session) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+static bool
+read_name(pid_t pid, char *name, size_t size)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    char buffer[512];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+    // "pid (comm) state ..."; comm itself may contain ')'.
+    char *start = strchr(buffer, '(');
+    char *end = strrchr(buffer, ')');
+    if (!start || !end || end < start) {
+        return false;
+    }
+    size_t count = (size_t)(end - start - 1);
+    if (count >= size) {
+        count = size - 1;
+    }
+    memcpy(name, start + 1, count);
+    name[count] = '\0';
+    return true;
+}
+
+static bool
+read_cwd(pid_t pid, char *cwd, size_t size)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/cwd", (int)pid);
+    ssize_t length = readlink(path, cwd, size - 1);
+    if (length < 0) {
+        return false;
+    }
+    cwd[length] = '\0';
+    return true;
+}
+
+static void
+sample(const tracked_session *entry, const lterm_proc_info *previous, bool sampled,
+       const char *reported_cwd, lterm_proc_info *next)
+{
+    *next = *previous;
+    pid_t pgrp = tcgetpgrp(entry->master_fd);
+    next->foreground_pgrp = pgrp > 0 ? pgrp : 0;
+    next->shell_foreground = pgrp > 0 && pgrp == entry->shell_pid;
+    if (!sampled || next->foreground_pgrp != previous->foreground_pgrp) {
+        next->foreground_pid = 0;
+        next->name[0] = '\0';
+        if (pgrp > 0 && read_name(pgrp, next->name, sizeof(next->name))) {
+            next->foreground_pid = pgrp;
+        } else if (entry->shell_pid > 0 && read_name(entry->shell_pid, next->name, sizeof(next->name))) {
+            next->foreground_pid = entry->shell_pid;
+        }
+    }
+    next->cwd_reported = reported_cwd[0] != '\0';
+    if (next->cwd_reported) {
+        snprintf(next->cwd, sizeof(next->cwd), "%s", reported_cwd);
+        return;
+    }
+    // A setuid job's cwd is unreadable; the shell's is the next best guess.
+    if ((next->foreground_pid <= 0 || !read_cwd(next->foreground_pid, next->cwd, sizeof(next->cwd))) &&
+        (entry->shell_pid <= 0 || !read_cwd(entry->shell_pid, next->cwd, sizeof(next->cwd)))) {
+        next->cwd[0] = '\0';
+    }
+}
+
+static bool
+same_info(const lterm_proc_info *a, const lterm_proc_info *b)
+{
+    return a->foreground_pgrp == b->foreground_pgrp && a->foreground_pid == b->foreground_pid &&
+           a->shell_foreground == b->shell_foreground && a->cwd_reported == b->cwd_reported &&
+           strcmp(a->name, b->name) == 0 && strcmp(a->cwd, b->cwd) == 0;
+}
+
+static void
+sample_all(lterm_proc_tracker *tracker)
+{
+    pthread_mutex_lock(&tracker->pass_lock);
+    for (size_t i = 0; i < tracker->count; ++i) {
+        tracked_session *entry = tracker->entries[i];
+        lterm_proc_info previous;
+        char reported_cwd[LTERM_PROC_CWD_MAX];
+        pthread_mutex_lock(&tracker->lock);
+        previous = entry->info;
+        bool sampled = entry->sampled;
+        memcpy(reported_cwd, entry->reported_cwd, sizeof(reported_cwd));
+        pthread_mutex_unlock(&tracker->lock);
+
+        lterm_proc_info next;
+        sample(entry, &previous, sampled, reported_cwd, &next);
+
+        pthread_mutex_lock(&tracker->lock);
+        entry->info = next;
+        entry->sampled = true;
+        pthread_mutex_unlock(&tracker->lock);
+        if ((!sampled || !same_info(&previous, &next)) && entry->callback) {
+            entry->callback(entry->session, &next, entry->user_data);
+        }
+    }
+    pthread_mutex_unlock(&tracker->pass_lock);
+}
+
+static void *
+sampler_main(void *data)
+{
+    lterm_proc_tracker *tracker = data;
+    pthread_mutex_lock(&tracker->lock);
+    while (!tracker->stopping) {
+        tracker->refresh = false;
+        pthread_mutex_unlock(&tracker->lock);
+        sample_all(tracker);
+        pthread_mutex_lock(&tracker->lock);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += tracker->interval_ms / 1000;
+        deadline.tv_nsec += (long)(tracker->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!tracker->stopping && !tracker->refresh) {
+            if (pthread_cond_timedwait(&tracker->cond, &tracker->lock, &deadline) != 0) {
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&tracker->lock);
+    return NULL;
+}
+
+lterm_proc_tracker *
+lterm_proc_tracker_new(unsigned interval_ms)
+{
+    lterm_proc_tracker *tracker = calloc(1, sizeof(*tracker));
+    if (!tracker) {
+        return NULL;
+    }
+    tracker->interval_ms = interval_ms ? interval_ms : LTERM_PROC_TRACKER_INTERVAL_MS;
+    pthread_mutex_init(&tracker->lock, NULL);
+    pthread_mutex_init(&tracker->pass_lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&tracker->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&tracker->thread, NULL, sampler_main, tracker) != 0) {
+        pthread_cond_destroy(&tracker->cond);
+        pthread_mutex_destroy(&tracker->pass_lock);
+        pthread_mutex_destroy(&tracker->lock);
+        free(tracker);
+        return NULL;
+    }
+    return tracker;
+}
+
+void
+lterm_proc_tracker_free(lterm_proc_tracker *tracker)
+{
+    if (!tracker) {
+        return;
+    }
+    pthread_mutex_lock(&tracker->lock);
+    tracker->stopping = true;
+    pthread_cond_signal(&tracker->cond);
+    pthread_mutex_unlock(&tracker->lock);
+    pthread_join(tracker->thread, NULL);
+    for (size_t i = 0; i < tracker->count; ++i) {
+        free(tracker->entries[i]);
+    }
+    free(tracker->entries);
+    pthread_cond_destroy(&tracker->cond);
+    pthread_mutex_destroy(&tracker->pass_lock);
+    pthread_mutex_destroy(&tracker->lock);
+    free(tracker);
+}
+
+bool
+lterm_proc_tracker_add(lterm_proc_tracker *tracker,
+                       lterm_session *session,
+                       lterm_proc_tracker_cb callback,
+                       void *user_data)
+{
+    lterm_pty *pty = lterm_session_pty(session);
+    if (!tracker || !session || !lterm_pty_is_active(pty)) {
+        return false;
+    }
+    tracked_session *entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        return false;
+    }
+    entry->session = session;
+    entry->master_fd = lterm_pty_get_fd(pty);
+    entry->shell_pid = lterm_pty_child_pid(pty);
+    entry->callback = callback;
+    entry->user_data = user_data;
+
+    pthread_mutex_lock(&tracker->pass_lock);
+    pthread_mutex_lock(&tracker->lock);
+    bool ok = find_entry(tracker, session) == SIZE_MAX;
+    if (ok && tracker->count == tracker->capacity) {
+        size_t capacity = tracker->capacity ? tracker->capacity * 2 : 16;
+        tracked_session **entries = realloc(tracker->entries, capacity * sizeof(*entries));
+        ok = entries != NULL;
+        if (ok) {
+            tracker->entries = entries;
+            tracker->capacity = capacity;
+        }
+    }
+    if (ok) {
+        tracker->entries[tracker->count++] = entry;
+        // New sessions get their first sample right away.
+        tracker->refresh = true;
+        pthread_cond_signal(&tracker->cond);
+    }
+    pthread_mutex_unlock(&tracker->lock);
+    pthread_mutex_unlock(&tracker->pass_lock);
+    if (!ok) {
+        free(entry);
+    }
+    return ok;
+}
+
+void
+lterm_proc_tracker_remove(lterm_proc_tracker *tracker, lterm_session *session)
+{
+    if (!tracker || !session) {
+        return;
+    }
+    pthread_mutex_lock(&tracker->pass_lock);
+    pthread_mutex_lock(&tracker->lock);
+    size_t index = find_entry(tracker, session);
+    tracked_session *entry = NULL;
+    if (index != SIZE_MAX) {
+        entry = tracker->entries[index];
+        tracker->entries[index] = tracker->entries[--tracker->count];
+    }
+    pthread_mutex_unlock(&tracker->lock);
+    pthread_mutex_unlock(&tracker->pass_lock);
+    free(entry);
+}
+
+static int
+hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// "file://host/some%20dir" -> "/some dir"; plain paths pass through.
+static void
+decode_cwd(const char *payload, size_t length, char *cwd, size_t size)
+{
+    static const char scheme[] = "file://";
+    const char *end = payload + length;
+    if (length >= sizeof(scheme) - 1 && memcmp(payload, scheme, sizeof(scheme) - 1) == 0) {
+        payload += sizeof(scheme) - 1;
+        while (payload < end && *payload != '/') {
+            payload++;
+        }
+    }
+    size_t count = 0;
+    while (payload < end && count + 1 < size) {
+        int high = 0;
+        int low = 0;
+        if (*payload == '%' && end - payload >= 3 && (high = hex_value(payload[1])) >= 0 &&
+            (low = hex_value(payload[2])) >= 0) {
+            cwd[count++] = (char)(high * 16 + low);
+            payload += 3;
+            continue;
+        }
+        cwd[count++] = *payload++;
+    }
+    cwd[count] = '\0';
+}
+
+void
+lterm_proc_tracker_report_cwd(lterm_proc_tracker *tracker,
+                              lterm_session *session,
+                              const char *payload,
+                              size_t length)
+{
+    if (!tracker || !session || (!payload && length)) {
+        return;
+    }
+    pthread_mutex_lock(&tracker->lock);
+    size_t index = find_entry(tracker, session);
+    if (index != SIZE_MAX) {
+        decode_cwd(payload ? payload : "", length, tracker->entries[index]->reported_cwd, LTERM_PROC_CWD_MAX);
+        tracker->refresh = true;
+        pthread_cond_signal(&tracker->cond);
+    }
+    pthread_mutex_unlock(&tracker->lock);
+}
+
+void
+lterm_proc_tracker_refresh(lterm_proc_tracker *tracker)
+{
+    if (!tracker) {
+        return;
+    }
+    pthread_mutex_lock(&tracker->lock);
+    tracker->refresh = true;
+    pthread_cond_signal(&tracker->cond);
+    pthread_mutex_unlock(&tracker->lock);
+}
+
+bool
+lterm_proc_tracker_get(lterm_proc_tracker *tracker, lterm_session *session, lterm_proc_info *info)
+{
+    if (!tracker || !session || !info) {
+        return false;
+    }
+    pthread_mutex_lock(&tracker->lock);
+    size_t index = find_entry(tracker, session);
+    bool found = index != SIZE_MAX && tracker->entries[index]->sampled;
+    if (found) {
+        *info = tracker->entries[index]->info;
+    }
+    pthread_mutex_unlock(&tracker->lock);
+    return found;
+}
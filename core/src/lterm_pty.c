@@ -1,13 +1,21 @@
+#define _GNU_SOURCE
+
 #include "lterm_pty.h"
 
 #include <errno.h>
+#include <stdint.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 
 #if defined(__APPLE__) || defined(__FreeBSD__)
@@ -16,6 +24,14 @@
 #include <pty.h>
 #endif
 
+// glibc runs setsid() before the file actions, so opening the slave by path
+// in the child acquires it as controlling terminal. BSDs need TIOCSCTTY,
+// which posix_spawn cannot issue, so they always fork.
+#if defined(__linux__) && defined(POSIX_SPAWN_SETSID) && defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define LTERM_PTY_HAVE_POSIX_SPAWN 1
+#endif
+
 extern char **environ;
 
 static bool
@@ -32,6 +48,120 @@ has_suffix(const char *value, const char *suffix)
     return strncmp(value + value_len - suffix_len, suffix, suffix_len) == 0;
 }
 
+// Children still running when their PTY is closed. With pidfds the reaper
+// thread sleeps in poll() until one exits; without, it checks every
+// ORPHAN_POLL_MS.
+#define ORPHAN_POLL_MS 100
+
+typedef struct {
+    pid_t pid;
+    int pidfd;
+} orphan;
+
+static pthread_mutex_t orphan_lock = PTHREAD_MUTEX_INITIALIZER;
+static orphan *orphans;
+static size_t orphan_count;
+static size_t orphan_capacity;
+static int orphan_wake[2] = {-1, -1};
+static bool reaper_started;
+
+static int
+open_pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    // Fails with ENOSYS before Linux 5.3.
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+static void *
+reaper_main(void *data)
+{
+    (void)data;
+    struct pollfd *fds = NULL;
+    size_t capacity = 0;
+    for (;;) {
+        pthread_mutex_lock(&orphan_lock);
+        if (orphan_count + 1 > capacity) {
+            struct pollfd *grown = realloc(fds, (orphan_count + 1) * sizeof(*fds));
+            if (grown) {
+                fds = grown;
+                capacity = orphan_count + 1;
+            }
+        }
+        size_t count = 0;
+        int timeout = -1;
+        if (fds) {
+            fds[count++] = (struct pollfd){.fd = orphan_wake[0], .events = POLLIN};
+        }
+        for (size_t i = 0; i < orphan_count; ++i) {
+            if (orphans[i].pidfd < 0 || count >= capacity) {
+                timeout = ORPHAN_POLL_MS;
+                continue;
+            }
+            fds[count++] = (struct pollfd){.fd = orphans[i].pidfd, .events = POLLIN};
+        }
+        pthread_mutex_unlock(&orphan_lock);
+
+        if (count == 0) {
+            struct timespec pause = {0, ORPHAN_POLL_MS * 1000000L};
+            nanosleep(&pause, NULL);
+        } else if (poll(fds, count, timeout) > 0 && fds[0].revents) {
+            uint8_t scratch[64];
+            while (read(orphan_wake[0], scratch, sizeof(scratch)) > 0) {
+            }
+        }
+
+        pthread_mutex_lock(&orphan_lock);
+        for (size_t i = 0; i < orphan_count;) {
+            if (waitpid(orphans[i].pid, NULL, WNOHANG) == 0) {
+                ++i;
+                continue;
+            }
+            if (orphans[i].pidfd >= 0) {
+                close(orphans[i].pidfd);
+            }
+            orphans[i] = orphans[--orphan_count];
+        }
+        pthread_mutex_unlock(&orphan_lock);
+    }
+    return NULL;
+}
+
+static bool
+adopt_orphan(pid_t pid, int pidfd)
+{
+    pthread_mutex_lock(&orphan_lock);
+    bool ok = true;
+    if (!reaper_started) {
+        pthread_t thread;
+        ok = pipe2(orphan_wake, O_CLOEXEC | O_NONBLOCK) == 0 &&
+             pthread_create(&thread, NULL, reaper_main, NULL) == 0;
+        if (ok) {
+            pthread_detach(thread);
+            reaper_started = true;
+        }
+    }
+    if (ok && orphan_count == orphan_capacity) {
+        size_t capacity = orphan_capacity ? orphan_capacity * 2 : 8;
+        orphan *grown = realloc(orphans, capacity * sizeof(*grown));
+        ok = grown != NULL;
+        if (ok) {
+            orphans = grown;
+            orphan_capacity = capacity;
+        }
+    }
+    if (ok) {
+        orphans[orphan_count++] = (orphan){.pid = pid, .pidfd = pidfd};
+        (void)!write(orphan_wake[1], "", 1);
+    }
+    pthread_mutex_unlock(&orphan_lock);
+    return ok;
+}
+
 static void
 set_nonblock(int fd)
 {
@@ -49,54 +179,173 @@ lterm_pty_init(lterm_pty *pty)
     }
     pty->master_fd = -1;
     pty->child_pid = -1;
+    pty->pidfd = -1;
+    memset(&pty->exit, 0, sizeof(pty->exit));
+    pty->drain_buffer = NULL;
+    pty->drain_capacity = 0;
+    pty->quiet_drains = 0;
 }
 
+static pid_t
+spawn_fork(const char *program, char *const argv[], char *const env[], const char *cwd, int master_fd, int slave_fd)
+{
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    setsid();
+#ifdef TIOCSCTTY
+    ioctl(slave_fd, TIOCSCTTY, 0);
+#endif
+    dup2(slave_fd, STDIN_FILENO);
+    dup2(slave_fd, STDOUT_FILENO);
+    dup2(slave_fd, STDERR_FILENO);
+    if (slave_fd > STDERR_FILENO) {
+        close(slave_fd);
+    }
+    close(master_fd);
+    if (cwd && chdir(cwd) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+    execve(program, argv, env);
+    _exit(EXIT_FAILURE);
+}
+
+#ifdef LTERM_PTY_HAVE_POSIX_SPAWN
+static pid_t
+spawn_posix(const char *program, char *const argv[], char *const env[], const char *cwd, int master_fd, int slave_fd)
+{
+    char slave_path[64];
+    if (ttyname_r(slave_fd, slave_path, sizeof(slave_path)) != 0) {
+        return -1;
+    }
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_init(&attr);
+    posix_spawn_file_actions_init(&actions);
+
+    // Start from default signal handling like a fresh login would.
+    sigset_t none;
+    sigset_t all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &all);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    posix_spawn_file_actions_addclose(&actions, master_fd);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, slave_path, O_RDWR, 0);
+    posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, STDIN_FILENO, STDERR_FILENO);
+    if (slave_fd > STDERR_FILENO) {
+        posix_spawn_file_actions_addclose(&actions, slave_fd);
+    }
+    if (cwd) {
+        posix_spawn_file_actions_addchdir_np(&actions, cwd);
+    }
+
+    pid_t pid = -1;
+    int error = posix_spawn(&pid, program, &actions, &attr, argv, env);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+#endif
+
 bool
-lterm_pty_spawn(lterm_pty *pty, const char *program, char *const argv[], char *const envp[])
+lterm_pty_posix_spawn_supported(void)
+{
+#ifdef LTERM_PTY_HAVE_POSIX_SPAWN
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+lterm_pty_spawn_with_options(lterm_pty *pty,
+                             const char *program,
+                             char *const argv[],
+                             const lterm_pty_spawn_options *options)
 {
     if (!pty || !program) {
         return false;
     }
+    lterm_pty_spawn_method method = options ? options->method : LTERM_PTY_SPAWN_AUTO;
+    if (method == LTERM_PTY_SPAWN_POSIX && !lterm_pty_posix_spawn_supported()) {
+        return false;
+    }
 
     int master_fd = -1;
     int slave_fd = -1;
-    if (openpty(&master_fd, &slave_fd, NULL, NULL, NULL) != 0) {
+    struct winsize ws = {
+        .ws_row = options ? (unsigned short)options->rows : 0,
+        .ws_col = options ? (unsigned short)options->cols : 0,
+    };
+    if (openpty(&master_fd, &slave_fd, NULL, NULL, ws.ws_row && ws.ws_col ? &ws : NULL) != 0) {
         return false;
     }
-
-    pid_t pid = fork();
-    if (pid < 0) {
-        close(master_fd);
-        close(slave_fd);
-        return false;
+    // openpty() takes no flags. Without this every later child (pool
+    // replacements, other tabs) holds this master open and the shell never
+    // sees a hangup when its tab closes. The slave is moved onto 0-2 in the
+    // child, which clears the flag there.
+    fcntl(master_fd, F_SETFD, FD_CLOEXEC);
+    if (slave_fd > STDERR_FILENO) {
+        fcntl(slave_fd, F_SETFD, FD_CLOEXEC);
     }
 
-    if (pid == 0) {
-        setsid();
-#ifdef TIOCSCTTY
-        ioctl(slave_fd, TIOCSCTTY, 0);
+    char *const default_argv[] = {(char *)program, NULL};
+    char *const *child_argv = argv ? argv : default_argv;
+    char *const *env = options && options->envp ? options->envp : environ;
+    const char *cwd = options ? options->cwd : NULL;
+    pid_t pid = -1;
+#ifdef LTERM_PTY_HAVE_POSIX_SPAWN
+    if (method != LTERM_PTY_SPAWN_FORK) {
+        pid = spawn_posix(program, child_argv, env, cwd, master_fd, slave_fd);
+    } else
 #endif
-        dup2(slave_fd, STDIN_FILENO);
-        dup2(slave_fd, STDOUT_FILENO);
-        dup2(slave_fd, STDERR_FILENO);
-        if (slave_fd > STDERR_FILENO) {
-            close(slave_fd);
-        }
+    {
+        pid = spawn_fork(program, child_argv, env, cwd, master_fd, slave_fd);
+    }
+    close(slave_fd);
+    if (pid < 0) {
         close(master_fd);
-        char *const *env = envp ? envp : environ;
-        execve(program, argv ? argv : (char *const[]){(char *)program, NULL}, env);
-        _exit(EXIT_FAILURE);
+        return false;
     }
 
-    close(slave_fd);
     set_nonblock(master_fd);
     pty->master_fd = master_fd;
     pty->child_pid = pid;
+    pty->pidfd = open_pidfd(pid);
+    memset(&pty->exit, 0, sizeof(pty->exit));
     return true;
 }
 
+bool
+lterm_pty_spawn(lterm_pty *pty, const char *program, char *const argv[], char *const envp[])
+{
+    lterm_pty_spawn_options options = {
+        .method = LTERM_PTY_SPAWN_AUTO,
+        .envp = envp,
+        .cwd = NULL,
+    };
+    return lterm_pty_spawn_with_options(pty, program, argv, &options);
+}
+
 bool
 lterm_pty_spawn_shell(lterm_pty *pty, const char *shell_path)
+{
+    return lterm_pty_spawn_shell_with_options(pty, shell_path, NULL);
+}
+
+bool
+lterm_pty_spawn_shell_with_options(lterm_pty *pty,
+                                   const char *shell_path,
+                                   const lterm_pty_spawn_options *options)
 {
     if (!pty) {
         return false;
@@ -120,25 +369,38 @@ lterm_pty_spawn_shell(lterm_pty *pty, const char *shell_path)
 
     if (force_login) {
         char *const argv_login[] = {(char *)shell, "-l", NULL};
-        return lterm_pty_spawn(pty, shell, argv_login, NULL);
+        return lterm_pty_spawn_with_options(pty, shell, argv_login, options);
     }
 
     if (has_suffix(shell, "bash")) {
         char *const argv_safe[] = {(char *)shell, "--noprofile", "--norc", "-i", NULL};
-        return lterm_pty_spawn(pty, shell, argv_safe, NULL);
+        return lterm_pty_spawn_with_options(pty, shell, argv_safe, options);
     }
     if (has_suffix(shell, "zsh")) {
         char *const argv_zsh[] = {(char *)shell, "-f", NULL};
-        return lterm_pty_spawn(pty, shell, argv_zsh, NULL);
+        return lterm_pty_spawn_with_options(pty, shell, argv_zsh, options);
     }
 
     char *const argv_interactive[] = {(char *)shell, "-i", NULL};
-    if (lterm_pty_spawn(pty, shell, argv_interactive, NULL)) {
+    if (lterm_pty_spawn_with_options(pty, shell, argv_interactive, options)) {
         return true;
     }
 
     char *const fallback[] = {"/bin/sh", "-i", NULL};
-    return lterm_pty_spawn(pty, "/bin/sh", fallback, NULL);
+    return lterm_pty_spawn_with_options(pty, "/bin/sh", fallback, options);
+}
+
+lterm_pty_input_mode
+lterm_pty_get_input_mode(const lterm_pty *pty)
+{
+    struct termios tio;
+    if (!pty || pty->master_fd < 0 || tcgetattr(pty->master_fd, &tio) != 0) {
+        return LTERM_PTY_INPUT_UNKNOWN;
+    }
+    if (!(tio.c_lflag & ICANON)) {
+        return LTERM_PTY_INPUT_RAW;
+    }
+    return (tio.c_lflag & ECHO) ? LTERM_PTY_INPUT_LINE : LTERM_PTY_INPUT_SILENT;
 }
 
 ssize_t
@@ -155,6 +417,99 @@ lterm_pty_read(lterm_pty *pty, uint8_t *buffer, size_t length)
     return n;
 }
 
+static long long
+monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static bool
+resize_drain_buffer(lterm_pty *pty, size_t capacity)
+{
+    uint8_t *buffer = realloc(pty->drain_buffer, capacity);
+    if (!buffer) {
+        return false;
+    }
+    pty->drain_buffer = buffer;
+    pty->drain_capacity = capacity;
+    return true;
+}
+
+bool
+lterm_pty_drain(lterm_pty *pty,
+                const lterm_pty_sink *sink,
+                const lterm_pty_budget *budget,
+                lterm_pty_drain_stats *stats)
+{
+    lterm_pty_drain_stats local = {0};
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!pty || pty->master_fd < 0 || !sink || !sink->write) {
+        errno = EINVAL;
+        return false;
+    }
+    if (!pty->drain_buffer && !resize_drain_buffer(pty, LTERM_PTY_DRAIN_MIN_BUFFER)) {
+        return false;
+    }
+    size_t max_bytes = budget && budget->max_bytes ? budget->max_bytes : SIZE_MAX;
+    long long deadline = budget && budget->max_ns ? monotonic_ns() + budget->max_ns : 0;
+    bool grew = false;
+
+    for (;;) {
+        if (stats->bytes >= max_bytes || (deadline && monotonic_ns() >= deadline)) {
+            stats->more_pending = true;
+            break;
+        }
+        size_t want = pty->drain_capacity;
+        if (want > max_bytes - stats->bytes) {
+            want = max_bytes - stats->bytes;
+        }
+        ssize_t n = read(pty->master_fd, pty->drain_buffer, want);
+        stats->syscalls++;
+        if (n > 0) {
+            sink->write(pty->drain_buffer, (size_t)n, sink->user_data);
+            stats->bytes += (size_t)n;
+            if ((size_t)n == pty->drain_capacity && pty->drain_capacity < LTERM_PTY_DRAIN_MAX_BUFFER &&
+                resize_drain_buffer(pty, pty->drain_capacity * 2)) {
+                grew = true;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        stats->closed = true;
+        break;
+    }
+
+    // Grow under sustained load (a read filled the buffer, or the drain moved
+    // several buffers' worth; Linux PTYs return at most ~4 KB per read), and
+    // shrink back after a run of drains that needed only a fraction of it.
+    if (grew || stats->bytes >= pty->drain_capacity * 4) {
+        if (!grew && pty->drain_capacity < LTERM_PTY_DRAIN_MAX_BUFFER) {
+            resize_drain_buffer(pty, pty->drain_capacity * 2);
+        }
+        pty->quiet_drains = 0;
+    } else if (stats->bytes < pty->drain_capacity / 4) {
+        if (++pty->quiet_drains >= LTERM_PTY_DRAIN_SHRINK_AFTER &&
+            pty->drain_capacity > LTERM_PTY_DRAIN_MIN_BUFFER) {
+            resize_drain_buffer(pty, pty->drain_capacity / 2);
+            pty->quiet_drains = 0;
+        }
+    } else {
+        pty->quiet_drains = 0;
+    }
+    stats->buffer_size = pty->drain_capacity;
+    return true;
+}
+
 ssize_t
 lterm_pty_write(lterm_pty *pty, const uint8_t *data, size_t length)
 {
@@ -181,6 +536,57 @@ lterm_pty_child_pid(const lterm_pty *pty)
     return pty ? pty->child_pid : -1;
 }
 
+int
+lterm_pty_get_pidfd(const lterm_pty *pty)
+{
+    return pty ? pty->pidfd : -1;
+}
+
+bool
+lterm_pty_reap(lterm_pty *pty)
+{
+    if (!pty || pty->child_pid <= 0) {
+        return pty && pty->exit.exited;
+    }
+    int status = 0;
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    pid_t result;
+    do {
+        result = wait4(pty->child_pid, &status, WNOHANG, &usage);
+    } while (result < 0 && errno == EINTR);
+    if (result == 0) {
+        return false;
+    }
+    lterm_pty_exit *info = &pty->exit;
+    info->exited = true;
+    info->pid = pty->child_pid;
+    info->status = status;
+    info->exit_code = -1;
+    info->signal = 0;
+    info->usage = usage;
+    // ECHILD: someone else (e.g. SIGCHLD set to SIG_IGN) took the status.
+    if (result > 0 && WIFEXITED(status)) {
+        info->exit_code = WEXITSTATUS(status);
+    } else if (result > 0 && WIFSIGNALED(status)) {
+        info->signal = WTERMSIG(status);
+    }
+    pty->child_pid = -1;
+    return true;
+}
+
+bool
+lterm_pty_exit_status(const lterm_pty *pty, lterm_pty_exit *info)
+{
+    if (!pty || !pty->exit.exited) {
+        return false;
+    }
+    if (info) {
+        *info = pty->exit;
+    }
+    return true;
+}
+
 bool
 lterm_pty_is_active(const lterm_pty *pty)
 {
@@ -197,11 +603,19 @@ lterm_pty_close(lterm_pty *pty)
         close(pty->master_fd);
         pty->master_fd = -1;
     }
-    if (pty->child_pid > 0) {
-        int status = 0;
-        waitpid(pty->child_pid, &status, WNOHANG);
-        pty->child_pid = -1;
+    if (!lterm_pty_reap(pty) && pty->child_pid > 0 && adopt_orphan(pty->child_pid, pty->pidfd)) {
+        // The reaper owns the pidfd now.
+        pty->pidfd = -1;
     }
+    if (pty->pidfd >= 0) {
+        close(pty->pidfd);
+        pty->pidfd = -1;
+    }
+    pty->child_pid = -1;
+    free(pty->drain_buffer);
+    pty->drain_buffer = NULL;
+    pty->drain_capacity = 0;
+    pty->quiet_drains = 0;
 }
 
 bool
@@ -216,13 +630,9 @@ lterm_pty_resize(lterm_pty *pty, size_t rows, size_t cols)
         .ws_xpixel = 0,
         .ws_ypixel = 0,
     };
-    if (ioctl(pty->master_fd, TIOCSWINSZ, &ws) != 0) {
-        return false;
-    }
-    if (pty->child_pid > 0) {
-        kill(pty->child_pid, SIGWINCH);
-    }
-    return true;
+    // The kernel signals SIGWINCH to the foreground process group itself,
+    // and only when the size actually changes.
+    return ioctl(pty->master_fd, TIOCSWINSZ, &ws) == 0;
 }
 
 
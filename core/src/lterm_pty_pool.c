@@ -0,0 +1,327 @@
+#include "lterm_pty_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct pool_spec {
+    struct pool_spec *next;
+    char *shell_path;
+    char **envp;
+    char *cwd;
+} pool_spec;
+
+struct lterm_pty_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool stopping;
+    bool spawn_failed;
+    size_t size;
+    size_t rows;
+    size_t cols;
+    pool_spec *spec;
+    // Specs replaced while the thread may still be spawning with them; freed
+    // by the thread between spawns.
+    pool_spec *retired;
+    unsigned long generation;
+    lterm_pty ready[LTERM_PTY_POOL_MAX];
+    size_t count;
+    lterm_pty_pool_stats stats;
+};
+
+static char *
+copy_string(const char *value)
+{
+    if (!value) {
+        return NULL;
+    }
+    size_t length = strlen(value) + 1;
+    char *copy = malloc(length);
+    if (copy) {
+        memcpy(copy, value, length);
+    }
+    return copy;
+}
+
+static void
+free_spec(pool_spec *spec)
+{
+    if (!spec) {
+        return;
+    }
+    if (spec->envp) {
+        for (char **entry = spec->envp; *entry; ++entry) {
+            free(*entry);
+        }
+        free(spec->envp);
+    }
+    free(spec->shell_path);
+    free(spec->cwd);
+    free(spec);
+}
+
+static pool_spec *
+copy_spec(const lterm_pty_pool_spec *source)
+{
+    pool_spec *spec = calloc(1, sizeof(*spec));
+    if (!spec || !source) {
+        return spec;
+    }
+    bool ok = true;
+    if (source->shell_path) {
+        ok = ok && (spec->shell_path = copy_string(source->shell_path));
+    }
+    if (source->cwd) {
+        ok = ok && (spec->cwd = copy_string(source->cwd));
+    }
+    if (ok && source->envp) {
+        size_t count = 0;
+        while (source->envp[count]) {
+            count++;
+        }
+        spec->envp = calloc(count + 1, sizeof(char *));
+        ok = spec->envp != NULL;
+        for (size_t i = 0; ok && i < count; ++i) {
+            ok = (spec->envp[i] = copy_string(source->envp[i])) != NULL;
+        }
+    }
+    if (!ok) {
+        free_spec(spec);
+        return NULL;
+    }
+    return spec;
+}
+
+static bool
+same_string(const char *a, const char *b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static bool
+spec_matches(const pool_spec *spec, const lterm_pty_pool_spec *wanted)
+{
+    const lterm_pty_pool_spec empty = {0};
+    if (!wanted) {
+        wanted = &empty;
+    }
+    if (!same_string(spec->shell_path, wanted->shell_path) || !same_string(spec->cwd, wanted->cwd)) {
+        return false;
+    }
+    if (!spec->envp || !wanted->envp) {
+        return !spec->envp && !wanted->envp;
+    }
+    size_t i = 0;
+    for (; spec->envp[i] && wanted->envp[i]; ++i) {
+        if (strcmp(spec->envp[i], wanted->envp[i]) != 0) {
+            return false;
+        }
+    }
+    return !spec->envp[i] && !wanted->envp[i];
+}
+
+static void
+discard_ready_locked(lterm_pty_pool *pool)
+{
+    for (size_t i = 0; i < pool->count; ++i) {
+        lterm_pty_close(&pool->ready[i]);
+    }
+    pool->stats.discarded += pool->count;
+    pool->count = 0;
+}
+
+static void *
+pool_main(void *data)
+{
+    lterm_pty_pool *pool = data;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping) {
+        while (pool->retired) {
+            pool_spec *next = pool->retired->next;
+            free_spec(pool->retired);
+            pool->retired = next;
+        }
+        if (pool->count >= pool->size || pool->spawn_failed) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            continue;
+        }
+        const pool_spec *spec = pool->spec;
+        unsigned long generation = pool->generation;
+        lterm_pty_spawn_options options = {
+            .method = LTERM_PTY_SPAWN_AUTO,
+            .envp = spec->envp,
+            .cwd = spec->cwd,
+            .rows = pool->rows,
+            .cols = pool->cols,
+        };
+        pthread_mutex_unlock(&pool->lock);
+
+        lterm_pty pty;
+        lterm_pty_init(&pty);
+        bool spawned = lterm_pty_spawn_shell_with_options(&pty, spec->shell_path, &options);
+
+        pthread_mutex_lock(&pool->lock);
+        if (!spawned) {
+            // Retried on the next take() or configure() rather than spinning.
+            pool->spawn_failed = true;
+            continue;
+        }
+        pool->stats.spawned++;
+        if (generation != pool->generation || pool->stopping || pool->count >= pool->size) {
+            lterm_pty_close(&pty);
+            pool->stats.discarded++;
+            continue;
+        }
+        if (pool->rows != options.rows || pool->cols != options.cols) {
+            lterm_pty_resize(&pty, pool->rows, pool->cols);
+        }
+        pool->ready[pool->count++] = pty;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+lterm_pty_pool *
+lterm_pty_pool_new(const lterm_pty_pool_spec *spec, size_t size, size_t rows, size_t cols)
+{
+    lterm_pty_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->spec = copy_spec(spec);
+    if (!pool->spec) {
+        free(pool);
+        return NULL;
+    }
+    pool->size = size < LTERM_PTY_POOL_MAX ? size : LTERM_PTY_POOL_MAX;
+    pool->rows = rows;
+    pool->cols = cols;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    if (pthread_create(&pool->thread, NULL, pool_main, pool) != 0) {
+        pthread_cond_destroy(&pool->cond);
+        pthread_mutex_destroy(&pool->lock);
+        free_spec(pool->spec);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void
+lterm_pty_pool_free(lterm_pty_pool *pool)
+{
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_join(pool->thread, NULL);
+
+    discard_ready_locked(pool);
+    while (pool->retired) {
+        pool_spec *next = pool->retired->next;
+        free_spec(pool->retired);
+        pool->retired = next;
+    }
+    free_spec(pool->spec);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+bool
+lterm_pty_pool_configure(lterm_pty_pool *pool, const lterm_pty_pool_spec *spec)
+{
+    if (!pool) {
+        return false;
+    }
+    pthread_mutex_lock(&pool->lock);
+    if (spec_matches(pool->spec, spec)) {
+        pthread_mutex_unlock(&pool->lock);
+        return true;
+    }
+    pool_spec *copy = copy_spec(spec);
+    if (!copy) {
+        pthread_mutex_unlock(&pool->lock);
+        return false;
+    }
+    pool->spec->next = pool->retired;
+    pool->retired = pool->spec;
+    pool->spec = copy;
+    pool->generation++;
+    pool->spawn_failed = false;
+    discard_ready_locked(pool);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+void
+lterm_pty_pool_set_geometry(lterm_pty_pool *pool, size_t rows, size_t cols)
+{
+    if (!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    if (pool->rows != rows || pool->cols != cols) {
+        pool->rows = rows;
+        pool->cols = cols;
+        for (size_t i = 0; i < pool->count; ++i) {
+            lterm_pty_resize(&pool->ready[i], rows, cols);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+bool
+lterm_pty_pool_take(lterm_pty_pool *pool, const lterm_pty_pool_spec *spec, lterm_pty *pty)
+{
+    if (!pool || !pty || lterm_pty_is_active(pty)) {
+        return false;
+    }
+    pthread_mutex_lock(&pool->lock);
+    bool taken = false;
+    if (spec_matches(pool->spec, spec)) {
+        while (pool->count > 0 && !taken) {
+            lterm_pty candidate = pool->ready[0];
+            pool->count--;
+            memmove(&pool->ready[0], &pool->ready[1], pool->count * sizeof(pool->ready[0]));
+            // A shell that already exited while waiting is no use.
+            if (lterm_pty_reap(&candidate)) {
+                lterm_pty_close(&candidate);
+                pool->stats.discarded++;
+                continue;
+            }
+            pty->master_fd = candidate.master_fd;
+            pty->child_pid = candidate.child_pid;
+            pty->pidfd = candidate.pidfd;
+            pty->exit = candidate.exit;
+            taken = true;
+        }
+    }
+    if (taken) {
+        pool->stats.hits++;
+    } else {
+        pool->stats.misses++;
+    }
+    pool->spawn_failed = false;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return taken;
+}
+
+void
+lterm_pty_pool_get_stats(lterm_pty_pool *pool, lterm_pty_pool_stats *stats)
+{
+    if (!pool || !stats) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    stats->ready = pool->count;
+    pthread_mutex_unlock(&pool->lock);
+}
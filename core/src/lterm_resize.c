@@ -0,0 +1,55 @@
+#include "lterm_resize.h"
+
+#include <string.h>
+
+void
+lterm_resize_coordinator_init(lterm_resize_coordinator *resize, unsigned settle_ms)
+{
+    if (!resize) {
+        return;
+    }
+    memset(resize, 0, sizeof(*resize));
+    resize->settle_ns = (int64_t)(settle_ms ? settle_ms : LTERM_RESIZE_SETTLE_MS) * 1000000;
+}
+
+void
+lterm_resize_coordinator_request(lterm_resize_coordinator *resize, size_t rows, size_t cols, int64_t now_ns)
+{
+    if (!resize) {
+        return;
+    }
+    rows = rows ? rows : 1;
+    cols = cols ? cols : 1;
+    resize->stats.requests++;
+    if (rows == resize->rows && cols == resize->cols) {
+        return;
+    }
+    resize->rows = rows;
+    resize->cols = cols;
+    resize->requested_ns = now_ns;
+}
+
+bool
+lterm_resize_coordinator_tick(lterm_resize_coordinator *resize, lterm_session *session, int64_t now_ns)
+{
+    if (!resize || !session || !resize->rows) {
+        return false;
+    }
+    if (resize->rows != resize->screen_rows || resize->cols != resize->screen_cols) {
+        lterm_session_resize_screen(session, resize->rows, resize->cols);
+        resize->screen_rows = resize->rows;
+        resize->screen_cols = resize->cols;
+        resize->stats.screen_resizes++;
+    }
+    if (resize->rows == resize->pty_rows && resize->cols == resize->pty_cols) {
+        return false;
+    }
+    if (now_ns - resize->requested_ns < resize->settle_ns) {
+        return true;
+    }
+    lterm_session_resize_pty(session, resize->rows, resize->cols);
+    resize->pty_rows = resize->rows;
+    resize->pty_cols = resize->cols;
+    resize->stats.pty_resizes++;
+    return false;
+}
@@ -9,6 +9,13 @@ static void scroll_up(lterm_screen *screen);
 static void ensure_cursor_row(lterm_screen *screen);
 static void write_codepoint(lterm_screen *screen, uint32_t codepoint);
 
+static void mark_all_dirty(lterm_screen *screen)
+{
+    if (screen->dirty_rows) {
+        memset(screen->dirty_rows, 1, screen->grid.rows);
+    }
+}
+
 static void ensure_scrollback_capacity(lterm_screen *screen, size_t additional_cells)
 {
     if (!screen) {
@@ -51,6 +58,7 @@ static void scroll_up(lterm_screen *screen)
                 (screen->grid.rows - 1) * row_size);
     }
     memset(screen->grid.cells + (screen->grid.rows - 1) * cols, 0, row_size);
+    mark_all_dirty(screen);
 }
 
 static void ensure_cursor_row(lterm_screen *screen)
@@ -89,19 +97,22 @@ static void write_codepoint(lterm_screen *screen, uint32_t codepoint)
         return;
     }
     size_t index = screen->cursor_row * screen->grid.cols + screen->cursor_col;
-    uint8_t fg = screen->current_fg;
-    uint8_t bg = screen->current_bg;
+    lterm_color fg = screen->current_fg;
+    lterm_color bg = screen->current_bg;
     uint16_t flags = screen->current_flags;
     if (flags & LTERM_CELL_FLAG_INVERSE) {
-        uint8_t tmp = fg;
+        lterm_color tmp = fg;
         fg = bg;
         bg = tmp;
     }
     lterm_cell *cell = &screen->grid.cells[index];
+    if (screen->dirty_rows) {
+        screen->dirty_rows[screen->cursor_row] = 1;
+    }
     cell->codepoint = codepoint ? codepoint : ' ';
     cell->fg = fg;
     cell->bg = bg;
-    cell->flags = (uint8_t)(flags & 0xFF);
+    cell->flags = flags;
     screen->cursor_col++;
     if (screen->cursor_col >= screen->grid.cols) {
         screen->cursor_col = 0;
@@ -118,11 +129,14 @@ lterm_screen_init(lterm_screen *screen, size_t rows, size_t cols)
     screen->grid.rows = rows;
     screen->grid.cols = cols;
     screen->grid.cells = calloc(rows * cols, sizeof(lterm_cell));
+    screen->dirty_rows = malloc(rows ? rows : 1);
+    mark_all_dirty(screen);
     screen->cursor_row = 0;
     screen->cursor_col = 0;
     screen->scrollback.data = NULL;
     screen->scrollback.length = 0;
     screen->scrollback.capacity = 0;
+    screen->modes = 0;
     lterm_screen_reset_attributes(screen);
 }
 
@@ -142,9 +156,14 @@ lterm_screen_set_size(lterm_screen *screen, size_t rows, size_t cols)
         return;
     }
     lterm_cell *new_cells = calloc(rows * cols, sizeof(lterm_cell));
-    if (!new_cells) {
+    uint8_t *dirty_rows = malloc(rows);
+    if (!new_cells || !dirty_rows) {
+        free(new_cells);
+        free(dirty_rows);
         return;
     }
+    free(screen->dirty_rows);
+    screen->dirty_rows = dirty_rows;
     if (screen->grid.cells) {
         size_t copy_rows = screen->grid.rows < rows ? screen->grid.rows : rows;
         size_t copy_cols = screen->grid.cols < cols ? screen->grid.cols : cols;
@@ -158,6 +177,7 @@ lterm_screen_set_size(lterm_screen *screen, size_t rows, size_t cols)
     screen->grid.cells = new_cells;
     screen->grid.rows = rows;
     screen->grid.cols = cols;
+    mark_all_dirty(screen);
     if (screen->cursor_row >= rows) {
         screen->cursor_row = rows - 1;
     }
@@ -174,6 +194,8 @@ lterm_screen_free(lterm_screen *screen)
     }
     free(screen->grid.cells);
     screen->grid.cells = NULL;
+    free(screen->dirty_rows);
+    screen->dirty_rows = NULL;
     free(screen->scrollback.data);
     screen->scrollback.data = NULL;
     screen->scrollback.length = screen->scrollback.capacity = 0;
@@ -186,19 +208,20 @@ lterm_screen_clear(lterm_screen *screen)
         return;
     }
     memset(screen->grid.cells, 0, screen->grid.rows * screen->grid.cols * sizeof(lterm_cell));
+    mark_all_dirty(screen);
     screen->cursor_row = 0;
     screen->cursor_col = 0;
     lterm_screen_reset_attributes(screen);
 }
 
 void
-lterm_screen_put_text(lterm_screen *screen, const char *text)
+lterm_screen_put_bytes(lterm_screen *screen, const uint8_t *bytes, size_t length)
 {
-    if (!screen || !screen->grid.cells || !text) {
+    if (!screen || !screen->grid.cells || !bytes) {
         return;
     }
-    while (*text) {
-        unsigned char ch = (unsigned char)*text++;
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t ch = bytes[i];
         switch (ch) {
             case '\r':
                 screen->cursor_col = 0;
@@ -232,6 +255,15 @@ lterm_screen_put_text(lterm_screen *screen, const char *text)
     }
 }
 
+void
+lterm_screen_put_text(lterm_screen *screen, const char *text)
+{
+    if (!text) {
+        return;
+    }
+    lterm_screen_put_bytes(screen, (const uint8_t *)text, strlen(text));
+}
+
 void
 lterm_screen_move_cursor(lterm_screen *screen, int drow, int dcol)
 {
@@ -311,6 +343,8 @@ static void clear_cells(lterm_screen *screen, size_t start, size_t count)
         count = total - start;
     }
     memset(screen->grid.cells + start, 0, count * sizeof(lterm_cell));
+    const size_t first_row = start / screen->grid.cols;
+    lterm_screen_mark_dirty(screen, first_row, (start + count - 1) / screen->grid.cols - first_row + 1);
 }
 
 void lterm_screen_clear_line(lterm_screen *screen, int mode)
@@ -384,8 +418,8 @@ void lterm_screen_reset_attributes(lterm_screen *screen)
     if (!screen) {
         return;
     }
-    screen->current_fg = 7;
-    screen->current_bg = 0;
+    screen->current_fg = LTERM_COLOR_DEFAULT_FG;
+    screen->current_bg = LTERM_COLOR_DEFAULT_BG;
     screen->current_flags = 0;
 }
 
@@ -394,68 +428,89 @@ void lterm_screen_apply_sgr(lterm_screen *screen, const lterm_csi_param *param)
     if (!screen) {
         return;
     }
-    if (!param || param->count == 0) {
-        lterm_screen_reset_attributes(screen);
+    lterm_sgr_delta delta;
+    lterm_sgr_compile(param, &delta);
+    lterm_screen_apply_sgr_delta(screen, &delta);
+}
+
+void lterm_screen_apply_sgr_delta(lterm_screen *screen, const lterm_sgr_delta *delta)
+{
+    if (!screen || !delta) {
         return;
     }
-    for (int i = 0; i < param->count; ++i) {
-        int value = param->p[i];
-        if (value == -1) {
-            value = 0;
-        }
-        if (value >= 30 && value <= 37) {
-            screen->current_fg = (uint8_t)(value - 30);
-            continue;
-        }
-        if (value >= 40 && value <= 47) {
-            screen->current_bg = (uint8_t)(value - 40);
-            continue;
-        }
-        if (value >= 90 && value <= 97) {
-            screen->current_fg = (uint8_t)((value - 90) + 8);
-            continue;
-        }
-        if (value >= 100 && value <= 107) {
-            screen->current_bg = (uint8_t)((value - 100) + 8);
-            continue;
-        }
-        switch (value) {
-            case 0:
-                lterm_screen_reset_attributes(screen);
-                break;
-            case 1:
-                screen->current_flags |= LTERM_CELL_FLAG_BOLD;
-                break;
-            case 4:
-                screen->current_flags |= LTERM_CELL_FLAG_UNDERLINE;
-                break;
-            case 7:
-                screen->current_flags |= LTERM_CELL_FLAG_INVERSE;
-                break;
-            case 22:
-                screen->current_flags &= ~LTERM_CELL_FLAG_BOLD;
-                break;
-            case 24:
-                screen->current_flags &= ~LTERM_CELL_FLAG_UNDERLINE;
-                break;
-            case 27:
-                screen->current_flags &= ~LTERM_CELL_FLAG_INVERSE;
-                break;
-            case 39:
-                screen->current_fg = 7;
-                break;
-            case 49:
-                screen->current_bg = 0;
-                break;
-            default:
-                break;
-        }
+    lterm_sgr_apply(delta, &screen->current_fg, &screen->current_bg, &screen->current_flags);
+}
+
+static uint32_t
+dec_mode_bit(int mode)
+{
+    switch (mode) {
+    case LTERM_DEC_MODE_BRACKETED_PASTE:
+        return LTERM_SCREEN_MODE_BRACKETED_PASTE;
+    default:
+        return 0;
     }
 }
 
+bool
+lterm_screen_set_dec_mode(lterm_screen *screen, int mode, bool enabled)
+{
+    uint32_t bit = dec_mode_bit(mode);
+    if (!screen || !bit) {
+        return false;
+    }
+    if (enabled) {
+        screen->modes |= bit;
+    } else {
+        screen->modes &= ~bit;
+    }
+    return true;
+}
+
+bool
+lterm_screen_dec_mode(const lterm_screen *screen, int mode)
+{
+    uint32_t bit = dec_mode_bit(mode);
+    return screen && bit && (screen->modes & bit) != 0;
+}
+
 const lterm_scrollback *
 lterm_screen_scrollback(const lterm_screen *screen)
 {
     return screen ? &screen->scrollback : NULL;
 }
 
+void
+lterm_screen_mark_dirty(lterm_screen *screen, size_t first_row, size_t count)
+{
+    if (!screen || !screen->dirty_rows || first_row >= screen->grid.rows) {
+        return;
+    }
+    if (count > screen->grid.rows - first_row) {
+        count = screen->grid.rows - first_row;
+    }
+    memset(screen->dirty_rows + first_row, 1, count);
+}
+
+size_t
+lterm_screen_take_dirty(lterm_screen *screen, uint8_t *out, size_t rows)
+{
+    if (!screen || !out) {
+        return 0;
+    }
+    if (rows > screen->grid.rows) {
+        rows = screen->grid.rows;
+    }
+    if (!screen->dirty_rows) {
+        // Lost track after a failed allocation: everything may have changed.
+        memset(out, 1, rows);
+        return rows;
+    }
+    size_t dirty = 0;
+    for (size_t row = 0; row < rows; ++row) {
+        out[row] = screen->dirty_rows[row];
+        dirty += out[row];
+    }
+    memset(screen->dirty_rows, 0, rows);
+    return dirty;
+}
@@ -0,0 +1,819 @@
+#define _GNU_SOURCE
+
+#include "lterm_session.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lterm_spsc_ring.h"
+#include "lterm_write_queue.h"
+
+struct lterm_session {
+    lterm_pty pty;
+    lterm_screen screen;
+    lterm_parser *parser;
+    lterm_spsc_ring ring;
+    pthread_mutex_t screen_lock;
+    pthread_mutex_t wait_lock;
+    pthread_cond_t data_ready;
+    pthread_cond_t space_ready;
+    pthread_t reader_thread;
+    pthread_t parse_thread;
+    bool threads_started;
+    atomic_bool stopping;
+    atomic_bool input_closed;
+    atomic_bool frame_pending;
+    atomic_bool exit_raised;
+    atomic_bool throttled;
+    size_t high_water;
+    size_t low_water;
+    int64_t last_frame_ns;
+    int wake_pipe[2];
+    lterm_parser_callback token_cb;
+    void *token_data;
+    lterm_session_event_cb event_cb;
+    void *event_data;
+    pthread_mutex_t write_lock;
+    lterm_write_queue outbound;
+    bool output_backlogged;
+    lterm_session_output_cb output_cb;
+    void *output_data;
+    lterm_log *log;
+    lterm_predictor *predictor;
+};
+
+static int64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static void
+signal_cond(lterm_session *session, pthread_cond_t *cond)
+{
+    pthread_mutex_lock(&session->wait_lock);
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(&session->wait_lock);
+}
+
+static void
+raise_event(lterm_session *session, lterm_session_event event)
+{
+    if (session->event_cb) {
+        session->event_cb(session, event, session->event_data);
+    }
+}
+
+static void
+signal_frame(lterm_session *session)
+{
+    session->last_frame_ns = monotonic_ns();
+    if (!atomic_exchange(&session->frame_pending, true)) {
+        raise_event(session, LTERM_SESSION_EVENT_FRAME);
+    }
+}
+
+static void
+check_low_water(lterm_session *session)
+{
+    if (!atomic_load(&session->throttled) || lterm_spsc_ring_readable(&session->ring) > session->low_water) {
+        return;
+    }
+    bool expected = true;
+    if (atomic_compare_exchange_strong(&session->throttled, &expected, false)) {
+        raise_event(session, LTERM_SESSION_EVENT_THROTTLE);
+    }
+}
+
+// Producer side; only the producer sets the flag, the consumer clears it.
+static void
+check_high_water(lterm_session *session)
+{
+    if (atomic_load(&session->throttled) || lterm_spsc_ring_readable(&session->ring) < session->high_water) {
+        return;
+    }
+    atomic_store(&session->throttled, true);
+    raise_event(session, LTERM_SESSION_EVENT_THROTTLE);
+    // The consumer may have drained the ring before it could see the flag.
+    check_low_water(session);
+}
+
+lterm_session *
+lterm_session_new(size_t rows, size_t cols)
+{
+    lterm_session *session = calloc(1, sizeof(*session));
+    if (!session) {
+        return NULL;
+    }
+    if (!lterm_spsc_ring_init(&session->ring, LTERM_SESSION_RING_CAPACITY)) {
+        free(session);
+        return NULL;
+    }
+    lterm_pty_init(&session->pty);
+    lterm_screen_init(&session->screen, rows, cols);
+    session->parser = lterm_parser_new(&session->screen);
+    pthread_mutex_init(&session->screen_lock, NULL);
+    pthread_mutex_init(&session->wait_lock, NULL);
+    pthread_mutex_init(&session->write_lock, NULL);
+    lterm_write_queue_init(&session->outbound);
+    pthread_cond_init(&session->data_ready, NULL);
+    pthread_cond_init(&session->space_ready, NULL);
+    atomic_init(&session->stopping, false);
+    atomic_init(&session->input_closed, false);
+    atomic_init(&session->frame_pending, false);
+    atomic_init(&session->exit_raised, false);
+    atomic_init(&session->throttled, false);
+    session->high_water = LTERM_SESSION_HIGH_WATER;
+    session->low_water = LTERM_SESSION_LOW_WATER;
+    session->wake_pipe[0] = -1;
+    session->wake_pipe[1] = -1;
+    session->last_frame_ns = monotonic_ns();
+    return session;
+}
+
+void
+lterm_session_free(lterm_session *session)
+{
+    if (!session) {
+        return;
+    }
+    lterm_session_stop(session);
+    lterm_pty_close(&session->pty);
+    lterm_parser_free(session->parser);
+    lterm_screen_free(&session->screen);
+    lterm_spsc_ring_free(&session->ring);
+    pthread_cond_destroy(&session->space_ready);
+    pthread_cond_destroy(&session->data_ready);
+    pthread_mutex_destroy(&session->wait_lock);
+    pthread_mutex_destroy(&session->screen_lock);
+    lterm_write_queue_free(&session->outbound);
+    pthread_mutex_destroy(&session->write_lock);
+    free(session);
+}
+
+lterm_screen *
+lterm_session_screen(lterm_session *session)
+{
+    return session ? &session->screen : NULL;
+}
+
+lterm_parser *
+lterm_session_parser(lterm_session *session)
+{
+    return session ? session->parser : NULL;
+}
+
+lterm_pty *
+lterm_session_pty(lterm_session *session)
+{
+    return session ? &session->pty : NULL;
+}
+
+void
+lterm_session_set_token_callback(lterm_session *session,
+                                 lterm_parser_callback callback,
+                                 void *user_data)
+{
+    if (!session) {
+        return;
+    }
+    session->token_cb = callback;
+    session->token_data = user_data;
+}
+
+void
+lterm_session_set_event_callback(lterm_session *session,
+                                 lterm_session_event_cb callback,
+                                 void *user_data)
+{
+    if (!session) {
+        return;
+    }
+    session->event_cb = callback;
+    session->event_data = user_data;
+}
+
+static void
+attach_child(lterm_session *session)
+{
+    lterm_pty_resize(&session->pty, session->screen.grid.rows, session->screen.grid.cols);
+    atomic_store(&session->input_closed, false);
+    atomic_store(&session->exit_raised, false);
+}
+
+void
+lterm_session_set_log(lterm_session *session, lterm_log *log)
+{
+    if (!session) {
+        return;
+    }
+    pthread_mutex_lock(&session->screen_lock);
+    session->log = log;
+    pthread_mutex_unlock(&session->screen_lock);
+}
+
+void
+lterm_session_set_predictor(lterm_session *session, lterm_predictor *predictor)
+{
+    if (!session) {
+        return;
+    }
+    pthread_mutex_lock(&session->screen_lock);
+    session->predictor = predictor;
+    pthread_mutex_unlock(&session->screen_lock);
+}
+
+bool
+lterm_session_predict(lterm_session *session, const uint8_t *data, size_t length)
+{
+    if (!session) {
+        return false;
+    }
+    lterm_pty_input_mode mode = lterm_pty_get_input_mode(&session->pty);
+    pthread_mutex_lock(&session->screen_lock);
+    bool shown = lterm_predictor_key(session->predictor, &session->screen, mode, data, length, monotonic_ns());
+    pthread_mutex_unlock(&session->screen_lock);
+    return shown;
+}
+
+bool
+lterm_session_spawn_shell(lterm_session *session, const char *shell_path)
+{
+    if (!session || lterm_pty_is_active(&session->pty)) {
+        return false;
+    }
+    if (!lterm_pty_spawn_shell(&session->pty, shell_path)) {
+        return false;
+    }
+    attach_child(session);
+    return true;
+}
+
+bool
+lterm_session_spawn_pooled(lterm_session *session, lterm_pty_pool *pool, const lterm_pty_pool_spec *spec)
+{
+    if (!session || lterm_pty_is_active(&session->pty)) {
+        return false;
+    }
+    if (!lterm_pty_pool_take(pool, spec, &session->pty)) {
+        return false;
+    }
+    attach_child(session);
+    return true;
+}
+
+size_t
+lterm_session_ingest(lterm_session *session, const uint8_t *data, size_t length)
+{
+    if (!session || !data || !length || session->threads_started) {
+        return 0;
+    }
+    size_t accepted = lterm_spsc_ring_write(&session->ring, data, length);
+    check_high_water(session);
+    return accepted;
+}
+
+void
+lterm_session_close_input(lterm_session *session)
+{
+    if (!session || session->threads_started) {
+        return;
+    }
+    atomic_store(&session->input_closed, true);
+}
+
+size_t
+lterm_session_pending(const lterm_session *session)
+{
+    return session ? lterm_spsc_ring_readable(&session->ring) : 0;
+}
+
+bool
+lterm_session_set_watermarks(lterm_session *session, size_t high, size_t low)
+{
+    if (!session || low >= high || high > session->ring.capacity) {
+        return false;
+    }
+    session->high_water = high;
+    session->low_water = low;
+    return true;
+}
+
+bool
+lterm_session_throttled(const lterm_session *session)
+{
+    return session && atomic_load(&session->throttled);
+}
+
+size_t
+lterm_session_process(lterm_session *session, size_t budget)
+{
+    return lterm_session_process_until(session, budget, 0);
+}
+
+size_t
+lterm_session_process_until(lterm_session *session, size_t budget, int64_t deadline_ns)
+{
+    if (!session) {
+        return 0;
+    }
+    size_t processed = 0;
+    while (processed < budget) {
+        if (deadline_ns && processed && monotonic_ns() >= deadline_ns) {
+            break;
+        }
+        size_t span = 0;
+        const uint8_t *data = lterm_spsc_ring_read_span(&session->ring, &span);
+        if (span == 0) {
+            break;
+        }
+        if (span > budget - processed) {
+            span = budget - processed;
+        }
+        if (deadline_ns && span > LTERM_SESSION_PARSE_STEP) {
+            span = LTERM_SESSION_PARSE_STEP;
+        }
+        pthread_mutex_lock(&session->screen_lock);
+        lterm_parser_feed(session->parser, data, span, session->token_cb, session->token_data);
+        if (session->log) {
+            lterm_log_append(session->log, data, span);
+        }
+        if (session->predictor) {
+            lterm_predictor_update(session->predictor, &session->screen, monotonic_ns());
+        }
+        pthread_mutex_unlock(&session->screen_lock);
+        lterm_spsc_ring_consume(&session->ring, span);
+        processed += span;
+    }
+    check_low_water(session);
+    // Load input_closed first: the producer publishes its last bytes before
+    // setting it, so a drained ring afterwards really is the end.
+    bool closed = atomic_load(&session->input_closed);
+    bool drained = lterm_spsc_ring_readable(&session->ring) == 0;
+    if (processed && (drained || monotonic_ns() - session->last_frame_ns >= LTERM_SESSION_FRAME_NS)) {
+        signal_frame(session);
+    }
+    if (drained && closed && !atomic_exchange(&session->exit_raised, true)) {
+        raise_event(session, LTERM_SESSION_EVENT_EXIT);
+    }
+    return processed;
+}
+
+size_t
+lterm_session_fill(lterm_session *session, size_t budget, size_t *syscalls)
+{
+    if (syscalls) {
+        *syscalls = 0;
+    }
+    if (!session || atomic_load(&session->input_closed)) {
+        return 0;
+    }
+    int fd = lterm_pty_get_fd(&session->pty);
+    if (fd < 0) {
+        atomic_store(&session->input_closed, true);
+        return 0;
+    }
+    size_t filled = 0;
+    while (filled < budget && !atomic_load(&session->throttled)) {
+        size_t span = 0;
+        uint8_t *dest = lterm_spsc_ring_write_span(&session->ring, &span);
+        if (span == 0) {
+            break;
+        }
+        if (span > budget - filled) {
+            span = budget - filled;
+        }
+        ssize_t n = read(fd, dest, span);
+        if (syscalls) {
+            ++*syscalls;
+        }
+        if (n > 0) {
+            lterm_spsc_ring_commit(&session->ring, (size_t)n);
+            filled += (size_t)n;
+            check_high_water(session);
+            if ((size_t)n < span) {
+                break;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        atomic_store(&session->input_closed, true);
+        break;
+    }
+    return filled;
+}
+
+size_t
+lterm_session_space(const lterm_session *session)
+{
+    if (!session || atomic_load(&session->throttled)) {
+        return 0;
+    }
+    return lterm_spsc_ring_writable(&session->ring);
+}
+
+bool
+lterm_session_has_work(const lterm_session *session)
+{
+    if (!session) {
+        return false;
+    }
+    return lterm_spsc_ring_readable(&session->ring) > 0 ||
+           (atomic_load(&session->input_closed) && !atomic_load(&session->exit_raised));
+}
+
+bool
+lterm_session_input_closed(const lterm_session *session)
+{
+    return !session || atomic_load(&session->input_closed);
+}
+
+static void *
+reader_main(void *data)
+{
+    lterm_session *session = data;
+    int fd = lterm_pty_get_fd(&session->pty);
+    int pidfd = lterm_pty_get_pidfd(&session->pty);
+    while (!atomic_load(&session->stopping) && !atomic_load(&session->input_closed)) {
+        if (lterm_session_space(session) == 0) {
+            pthread_mutex_lock(&session->wait_lock);
+            while (lterm_session_space(session) == 0 && !atomic_load(&session->stopping)) {
+                pthread_cond_wait(&session->space_ready, &session->wait_lock);
+            }
+            pthread_mutex_unlock(&session->wait_lock);
+            continue;
+        }
+        short events = POLLIN;
+        if (lterm_session_write_queued(session) > 0) {
+            events |= POLLOUT;
+        }
+        // poll() skips negative fds, so the pidfd drops out once reaped.
+        struct pollfd fds[3] = {
+            {.fd = fd, .events = events},
+            {.fd = session->wake_pipe[0], .events = POLLIN},
+            {.fd = pidfd, .events = POLLIN},
+        };
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            uint8_t scratch[64];
+            (void)!read(session->wake_pipe[0], scratch, sizeof(scratch));
+            if (atomic_load(&session->stopping)) {
+                break;
+            }
+        }
+        if (fds[2].revents && lterm_session_reap(session)) {
+            pidfd = -1;
+        }
+        if (fds[0].revents & POLLOUT) {
+            lterm_session_flush(session);
+        }
+        if (fds[0].revents & POLLIN) {
+            if (lterm_session_fill(session, SIZE_MAX, NULL)) {
+                signal_cond(session, &session->data_ready);
+            }
+            continue;
+        }
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+            break;
+        }
+    }
+    atomic_store(&session->input_closed, true);
+    signal_cond(session, &session->data_ready);
+    // The hangup can come before the exit; keep watching the child.
+    while (!lterm_session_reap(session) && pidfd >= 0 && !atomic_load(&session->stopping)) {
+        struct pollfd fds[2] = {
+            {.fd = pidfd, .events = POLLIN},
+            {.fd = session->wake_pipe[0], .events = POLLIN},
+        };
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            break;
+        }
+        if (fds[1].revents) {
+            uint8_t scratch[64];
+            (void)!read(session->wake_pipe[0], scratch, sizeof(scratch));
+        }
+    }
+    return NULL;
+}
+
+static void *
+parse_main(void *data)
+{
+    lterm_session *session = data;
+    for (;;) {
+        pthread_mutex_lock(&session->wait_lock);
+        while (lterm_spsc_ring_readable(&session->ring) == 0 && !atomic_load(&session->stopping) &&
+               !atomic_load(&session->input_closed)) {
+            pthread_cond_wait(&session->data_ready, &session->wait_lock);
+        }
+        pthread_mutex_unlock(&session->wait_lock);
+        if (atomic_load(&session->stopping)) {
+            break;
+        }
+        lterm_session_process(session, LTERM_SESSION_PARSE_CHUNK);
+        signal_cond(session, &session->space_ready);
+        if (atomic_load(&session->exit_raised)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+bool
+lterm_session_start(lterm_session *session)
+{
+    if (!session || session->threads_started || !lterm_pty_is_active(&session->pty)) {
+        return false;
+    }
+    if (pipe(session->wake_pipe) != 0) {
+        return false;
+    }
+    atomic_store(&session->stopping, false);
+    atomic_store(&session->input_closed, false);
+    atomic_store(&session->exit_raised, false);
+    if (pthread_create(&session->reader_thread, NULL, reader_main, session) != 0) {
+        close(session->wake_pipe[0]);
+        close(session->wake_pipe[1]);
+        session->wake_pipe[0] = session->wake_pipe[1] = -1;
+        return false;
+    }
+    if (pthread_create(&session->parse_thread, NULL, parse_main, session) != 0) {
+        atomic_store(&session->stopping, true);
+        (void)!write(session->wake_pipe[1], "", 1);
+        pthread_join(session->reader_thread, NULL);
+        close(session->wake_pipe[0]);
+        close(session->wake_pipe[1]);
+        session->wake_pipe[0] = session->wake_pipe[1] = -1;
+        return false;
+    }
+    session->threads_started = true;
+    return true;
+}
+
+void
+lterm_session_stop(lterm_session *session)
+{
+    if (!session || !session->threads_started) {
+        return;
+    }
+    atomic_store(&session->stopping, true);
+    (void)!write(session->wake_pipe[1], "", 1);
+    pthread_mutex_lock(&session->wait_lock);
+    pthread_cond_broadcast(&session->data_ready);
+    pthread_cond_broadcast(&session->space_ready);
+    pthread_mutex_unlock(&session->wait_lock);
+    pthread_join(session->reader_thread, NULL);
+    pthread_join(session->parse_thread, NULL);
+    close(session->wake_pipe[0]);
+    close(session->wake_pipe[1]);
+    session->wake_pipe[0] = session->wake_pipe[1] = -1;
+    session->threads_started = false;
+}
+
+bool
+lterm_session_is_running(const lterm_session *session)
+{
+    return session && session->threads_started && !atomic_load(&session->input_closed);
+}
+
+void
+lterm_session_lock(lterm_session *session)
+{
+    if (!session) {
+        return;
+    }
+    pthread_mutex_lock(&session->screen_lock);
+}
+
+void
+lterm_session_unlock(lterm_session *session)
+{
+    if (!session) {
+        return;
+    }
+    pthread_mutex_unlock(&session->screen_lock);
+}
+
+void
+lterm_session_frame_done(lterm_session *session)
+{
+    if (!session) {
+        return;
+    }
+    atomic_store(&session->frame_pending, false);
+}
+
+// Called with write_lock held once queued bytes have been written; the
+// caller raises WRITE_DRAINED after unlocking when this returns true.
+static bool
+note_drained_locked(lterm_session *session)
+{
+    if (!session->output_backlogged || lterm_write_queue_queued(&session->outbound) > 0) {
+        return false;
+    }
+    session->output_backlogged = false;
+    return true;
+}
+
+// shared, when set, holds data and is queued by reference instead of copied.
+static bool
+write_bytes(lterm_session *session, const uint8_t *data, size_t length, lterm_shared_buffer *shared)
+{
+    if (!session || !data || !length || !lterm_pty_is_active(&session->pty)) {
+        return false;
+    }
+    pthread_mutex_lock(&session->write_lock);
+    bool was_empty = lterm_write_queue_queued(&session->outbound) == 0;
+    lterm_session_output_cb output_cb = session->output_cb;
+    void *output_data = session->output_data;
+    size_t written = 0;
+    // Nothing queued and nobody else driving writability: write through from
+    // the caller's buffer and only queue what the PTY did not take.
+    if (was_empty && !output_cb) {
+        ssize_t n = lterm_pty_write(&session->pty, data, length);
+        if (n < 0) {
+            pthread_mutex_unlock(&session->write_lock);
+            return false;
+        }
+        written = (size_t)n;
+    }
+    bool ok = true;
+    if (written < length) {
+        ok = shared ? lterm_write_queue_append_shared(&session->outbound, shared, written)
+                    : lterm_write_queue_append(&session->outbound, data + written, length - written);
+        session->output_backlogged = true;
+    }
+    bool wake = ok && was_empty && written < length;
+    pthread_mutex_unlock(&session->write_lock);
+
+    if (wake && output_cb) {
+        output_cb(session, output_data);
+    } else if (wake && session->threads_started) {
+        (void)!write(session->wake_pipe[1], "", 1);
+    }
+    return ok;
+}
+
+bool
+lterm_session_write(lterm_session *session, const uint8_t *data, size_t length)
+{
+    return write_bytes(session, data, length, NULL);
+}
+
+bool
+lterm_session_write_shared(lterm_session *session, lterm_shared_buffer *buffer)
+{
+    if (!buffer) {
+        return false;
+    }
+    return write_bytes(session, buffer->data, buffer->length, buffer);
+}
+
+size_t
+lterm_session_write_queued(lterm_session *session)
+{
+    if (!session) {
+        return 0;
+    }
+    pthread_mutex_lock(&session->write_lock);
+    size_t queued = lterm_write_queue_queued(&session->outbound);
+    pthread_mutex_unlock(&session->write_lock);
+    return queued;
+}
+
+ssize_t
+lterm_session_flush(lterm_session *session)
+{
+    if (!session) {
+        return -1;
+    }
+    pthread_mutex_lock(&session->write_lock);
+    ssize_t written = lterm_write_queue_flush(&session->outbound, lterm_pty_get_fd(&session->pty));
+    if (written < 0) {
+        // The child is gone; nothing will ever read the rest.
+        lterm_write_queue_consume(&session->outbound, SIZE_MAX);
+    }
+    bool drained = note_drained_locked(session);
+    pthread_mutex_unlock(&session->write_lock);
+    if (drained) {
+        raise_event(session, LTERM_SESSION_EVENT_WRITE_DRAINED);
+    }
+    return written;
+}
+
+void
+lterm_session_set_output_handler(lterm_session *session, lterm_session_output_cb callback, void *user_data)
+{
+    if (!session) {
+        return;
+    }
+    pthread_mutex_lock(&session->write_lock);
+    session->output_cb = callback;
+    session->output_data = user_data;
+    pthread_mutex_unlock(&session->write_lock);
+}
+
+int
+lterm_session_output_iov(lterm_session *session, struct iovec *iov, int max)
+{
+    if (!session) {
+        return 0;
+    }
+    pthread_mutex_lock(&session->write_lock);
+    int count = lterm_write_queue_iov(&session->outbound, iov, max);
+    pthread_mutex_unlock(&session->write_lock);
+    return count;
+}
+
+void
+lterm_session_consume_output(lterm_session *session, size_t length)
+{
+    if (!session) {
+        return;
+    }
+    pthread_mutex_lock(&session->write_lock);
+    lterm_write_queue_consume(&session->outbound, length);
+    bool drained = note_drained_locked(session);
+    pthread_mutex_unlock(&session->write_lock);
+    if (drained) {
+        raise_event(session, LTERM_SESSION_EVENT_WRITE_DRAINED);
+    }
+}
+
+bool
+lterm_session_resize(lterm_session *session, size_t rows, size_t cols)
+{
+    return lterm_session_resize_screen(session, rows, cols) && lterm_session_resize_pty(session, rows, cols);
+}
+
+bool
+lterm_session_resize_screen(lterm_session *session, size_t rows, size_t cols)
+{
+    if (!session) {
+        return false;
+    }
+    pthread_mutex_lock(&session->screen_lock);
+    lterm_screen_set_size(&session->screen, rows, cols);
+    pthread_mutex_unlock(&session->screen_lock);
+    return true;
+}
+
+bool
+lterm_session_resize_pty(lterm_session *session, size_t rows, size_t cols)
+{
+    if (!session) {
+        return false;
+    }
+    if (!lterm_pty_is_active(&session->pty)) {
+        return true;
+    }
+    return lterm_pty_resize(&session->pty, rows, cols);
+}
+
+bool
+lterm_session_reap(lterm_session *session)
+{
+    if (!session) {
+        return false;
+    }
+    pthread_mutex_lock(&session->wait_lock);
+    bool running = lterm_pty_child_pid(&session->pty) > 0;
+    bool reaped = lterm_pty_reap(&session->pty);
+    pthread_mutex_unlock(&session->wait_lock);
+    if (running && reaped) {
+        raise_event(session, LTERM_SESSION_EVENT_CHILD_EXIT);
+    }
+    return reaped;
+}
+
+bool
+lterm_session_exit_status(lterm_session *session, lterm_pty_exit *info)
+{
+    if (!session) {
+        return false;
+    }
+    lterm_session_reap(session);
+    pthread_mutex_lock(&session->wait_lock);
+    bool exited = lterm_pty_exit_status(&session->pty, info);
+    pthread_mutex_unlock(&session->wait_lock);
+    return exited;
+}
@@ -0,0 +1,1365 @@
+#define _GNU_SOURCE
+
+#include "lterm_session_loop.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lterm_uring.h"
+#include "lterm_write_queue.h"
+
+#define WAKE_TOKEN UINT64_MAX
+#define URING_TOKEN (UINT64_MAX - 1)
+
+// Tokens carry the operation in the top byte, a 24-bit slot generation and
+// the slot index.
+enum {
+    OP_READ,
+    OP_WRITE,
+    OP_POLL,
+    OP_CANCEL,
+    // epoll only: the child's pidfd became readable.
+    OP_CHILD,
+};
+
+typedef struct loop_entry {
+    lterm_session *session;
+    uint32_t slot;
+    size_t home;
+    struct loop_entry *next;
+    int queued_on;
+    bool running;
+    bool reading;
+    bool removed;
+    // Focused sessions jump the queue when new output arrives and get
+    // LTERM_SESSION_LOOP_FOCUS_SHARE times the slice.
+    atomic_bool focused;
+    // epoll: the PTY is in the epoll set. io_uring: a multishot read is armed.
+    bool registered;
+    // The child's pidfd is in the epoll set (with either backend).
+    bool child_watched;
+    atomic_bool scheduled;
+    // io_uring only: the read is cancelled once the session is throttled;
+    // bytes already in flight that did not fit the ring wait in overflow
+    // until a worker has drained it and asks the reactor to rearm the read.
+    bool throttled;
+    bool rearm;
+    bool eof;
+    uint8_t *overflow;
+    size_t overflow_length;
+    size_t overflow_capacity;
+    // Provided buffers kept out of the ring, oldest first, when overflow could
+    // not grow; their bytes follow the overflow's. -1 when empty.
+    int32_t held_head;
+    int32_t held_tail;
+    // epoll: EPOLLOUT is armed for queued input. io_uring: a writev of the
+    // spans in iov is in flight.
+    bool write_armed;
+    bool write_inflight;
+    size_t write_length;
+    struct iovec iov[LTERM_WRITE_QUEUE_MAX_IOV];
+} loop_entry;
+
+typedef struct {
+    pthread_t thread;
+    pthread_cond_t cond;
+    loop_entry *head;
+    loop_entry *tail;
+    size_t length;
+    bool idle;
+} loop_worker;
+
+struct lterm_session_loop {
+    lterm_session_loop_backend backend;
+    int epoll_fd;
+    int wake_pipe[2];
+    atomic_bool wake_pending;
+    // Between begin_batch() and end_batch() queued writes wait for one wakeup.
+    atomic_uint batch_depth;
+    atomic_bool batch_wake;
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    loop_entry **slots;
+    uint32_t *generations;
+    size_t slot_capacity;
+    size_t session_count;
+    loop_worker *workers;
+    size_t queue_count;
+    size_t thread_count;
+    size_t next_home;
+    bool stopping;
+    pthread_t reactor;
+    bool reactor_started;
+    atomic_bool reactor_stopping;
+    atomic_ullong wakeups;
+    atomic_ullong syscalls;
+    atomic_ullong bytes_read;
+    atomic_ullong bytes_written;
+    unsigned long long steals;
+    atomic_ullong slices_cut;
+    size_t rearm_count;
+    // Per-slice parse budget; work left over is requeued behind the others.
+    atomic_size_t slice_bytes;
+    atomic_llong slice_ns;
+#ifdef LTERM_HAVE_IO_URING
+    lterm_uring uring;
+    // Indexed by buffer id: the unconsumed part of a held buffer and the next
+    // buffer held by the same session.
+    struct {
+        uint16_t start;
+        uint16_t end;
+        int32_t next;
+    } *held;
+#endif
+};
+
+typedef struct {
+    lterm_session_loop *loop;
+    size_t index;
+} worker_start;
+
+static uint64_t
+entry_token(const lterm_session_loop *loop, const loop_entry *entry, unsigned op)
+{
+    uint64_t generation = loop->generations[entry->slot] & 0xffffffu;
+    return ((uint64_t)op << 56) | (generation << 32) | entry->slot;
+}
+
+static loop_entry *
+lookup_locked(lterm_session_loop *loop, uint64_t token)
+{
+    uint32_t slot = (uint32_t)(token & 0xffffffffu);
+    uint32_t generation = (uint32_t)(token >> 32) & 0xffffffu;
+    loop_entry *entry = slot < loop->slot_capacity ? loop->slots[slot] : NULL;
+    if (!entry || (loop->generations[slot] & 0xffffffu) != generation || entry->removed) {
+        return NULL;
+    }
+    return entry;
+}
+
+static int
+entry_fd(const loop_entry *entry)
+{
+    return lterm_pty_get_fd(lterm_session_pty(entry->session));
+}
+
+static void
+wake_reactor(lterm_session_loop *loop)
+{
+    if (!atomic_exchange(&loop->wake_pending, true)) {
+        (void)!write(loop->wake_pipe[1], "", 1);
+        atomic_fetch_add(&loop->syscalls, 1);
+    }
+}
+
+static int64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static void
+enqueue_locked(lterm_session_loop *loop, loop_entry *entry, bool front)
+{
+    loop_worker *home = &loop->workers[entry->home];
+    if (front) {
+        entry->next = home->head;
+        home->head = entry;
+        if (!home->tail) {
+            home->tail = entry;
+        }
+    } else {
+        entry->next = NULL;
+        if (home->tail) {
+            home->tail->next = entry;
+        } else {
+            home->head = entry;
+        }
+        home->tail = entry;
+    }
+    home->length++;
+    entry->queued_on = (int)entry->home;
+    if (loop->thread_count == 0) {
+        return;
+    }
+    if (home->idle) {
+        pthread_cond_signal(&home->cond);
+        return;
+    }
+    for (size_t i = 0; i < loop->thread_count; ++i) {
+        if (loop->workers[i].idle) {
+            pthread_cond_signal(&loop->workers[i].cond);
+            return;
+        }
+    }
+}
+
+static loop_entry *
+pop_queue(loop_worker *worker)
+{
+    loop_entry *entry = worker->head;
+    if (!entry) {
+        return NULL;
+    }
+    worker->head = entry->next;
+    if (!worker->head) {
+        worker->tail = NULL;
+    }
+    worker->length--;
+    entry->next = NULL;
+    entry->queued_on = -1;
+    return entry;
+}
+
+static void
+unlink_queue(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (entry->queued_on < 0) {
+        return;
+    }
+    loop_worker *worker = &loop->workers[entry->queued_on];
+    loop_entry *prev = NULL;
+    for (loop_entry *it = worker->head; it; prev = it, it = it->next) {
+        if (it != entry) {
+            continue;
+        }
+        if (prev) {
+            prev->next = it->next;
+        } else {
+            worker->head = it->next;
+        }
+        if (worker->tail == it) {
+            worker->tail = prev;
+        }
+        worker->length--;
+        break;
+    }
+    entry->next = NULL;
+    entry->queued_on = -1;
+}
+
+// Takes the next session from this worker's queue, or steals from the
+// longest other queue.
+static loop_entry *
+pop_locked(lterm_session_loop *loop, size_t index)
+{
+    loop_entry *entry = pop_queue(&loop->workers[index]);
+    if (!entry) {
+        size_t victim = index;
+        size_t longest = 0;
+        for (size_t i = 0; i < loop->queue_count; ++i) {
+            if (i != index && loop->workers[i].length > longest) {
+                longest = loop->workers[i].length;
+                victim = i;
+            }
+        }
+        if (victim != index) {
+            entry = pop_queue(&loop->workers[victim]);
+            loop->steals++;
+        }
+    }
+    if (entry) {
+        entry->running = true;
+    }
+    return entry;
+}
+
+// New output for a focused session goes ahead of the queue so its echo is
+// not stuck behind flooding sessions; carried-over work goes to the back.
+static void
+schedule_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (entry->removed || atomic_exchange(&entry->scheduled, true)) {
+        return;
+    }
+    enqueue_locked(loop, entry, atomic_load(&entry->focused));
+}
+
+static void
+requeue_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (entry->removed || atomic_exchange(&entry->scheduled, true)) {
+        return;
+    }
+    enqueue_locked(loop, entry, false);
+}
+
+static unsigned
+token_op(uint64_t token)
+{
+    return (unsigned)(token >> 56);
+}
+
+#ifdef LTERM_HAVE_IO_URING
+
+static bool
+arm_read_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    struct io_uring_sqe *sqe = lterm_uring_get_sqe(&loop->uring);
+    if (!sqe) {
+        return false;
+    }
+    lterm_uring_prep_read_multishot(sqe, entry_fd(entry), loop->uring.buf_group,
+                                    entry_token(loop, entry, OP_READ));
+    entry->registered = true;
+    return true;
+}
+
+static void
+cancel_locked(lterm_session_loop *loop, uint64_t target)
+{
+    struct io_uring_sqe *sqe = lterm_uring_get_sqe(&loop->uring);
+    if (sqe) {
+        lterm_uring_prep_cancel(sqe, target, (target & ~(0xffull << 56)) | ((uint64_t)OP_CANCEL << 56));
+    }
+}
+
+// Submits the session's queued input as one writev, behind a POLLOUT poll
+// when the PTY last refused or short-wrote.
+static void
+submit_write_locked(lterm_session_loop *loop, loop_entry *entry, bool after_poll)
+{
+    int count = lterm_session_output_iov(entry->session, entry->iov, LTERM_WRITE_QUEUE_MAX_IOV);
+    if (count == 0) {
+        return;
+    }
+    int fd = entry_fd(entry);
+    if (after_poll) {
+        struct io_uring_sqe *poll = lterm_uring_get_sqe(&loop->uring);
+        if (poll) {
+            lterm_uring_prep_poll(poll, fd, POLLOUT, entry_token(loop, entry, OP_POLL));
+            poll->flags |= IOSQE_IO_LINK;
+        }
+    }
+    struct io_uring_sqe *sqe = lterm_uring_get_sqe(&loop->uring);
+    if (!sqe) {
+        return;
+    }
+    entry->write_length = 0;
+    for (int i = 0; i < count; ++i) {
+        entry->write_length += entry->iov[i].iov_len;
+    }
+    lterm_uring_prep_writev(sqe, fd, entry->iov, (unsigned)count, entry_token(loop, entry, OP_WRITE));
+    entry->write_inflight = true;
+}
+
+static void
+throttle_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (entry->throttled) {
+        return;
+    }
+    entry->throttled = true;
+    if (entry->registered) {
+        cancel_locked(loop, entry_token(loop, entry, OP_READ));
+    }
+}
+
+static bool
+grow_overflow(loop_entry *entry, size_t length)
+{
+    if (entry->overflow_length + length <= entry->overflow_capacity) {
+        return true;
+    }
+    size_t capacity = entry->overflow_capacity ? entry->overflow_capacity : LTERM_SESSION_LOOP_URING_BUFFER_SIZE;
+    while (capacity < entry->overflow_length + length) {
+        capacity *= 2;
+    }
+    uint8_t *overflow = realloc(entry->overflow, capacity);
+    if (!overflow) {
+        return false;
+    }
+    entry->overflow = overflow;
+    entry->overflow_capacity = capacity;
+    return true;
+}
+
+// Returns true when the buffer was kept for later instead of copied; the
+// caller must not recycle it then.
+static bool
+deliver_locked(lterm_session_loop *loop, loop_entry *entry, uint16_t bid, size_t length)
+{
+    const uint8_t *data = lterm_uring_buffer(&loop->uring, bid);
+    // Once throttled, reads still in flight wait in overflow rather than
+    // pushing the ring past its high watermark.
+    bool spill = entry->overflow_length || entry->held_head >= 0 || entry->throttled;
+    size_t accepted = spill ? 0 : lterm_session_ingest(entry->session, data, length);
+    if (accepted == length) {
+        if (lterm_session_space(entry->session) == 0) {
+            throttle_locked(loop, entry);
+        }
+        return false;
+    }
+    size_t rest = length - accepted;
+    throttle_locked(loop, entry);
+    if (entry->held_head < 0 && grow_overflow(entry, rest)) {
+        memcpy(entry->overflow + entry->overflow_length, data + accepted, rest);
+        entry->overflow_length += rest;
+        return false;
+    }
+    // Out of memory: hold on to the buffer itself. The read is cancelled, so
+    // at most the reads already in flight end up here.
+    loop->held[bid].start = (uint16_t)accepted;
+    loop->held[bid].end = (uint16_t)length;
+    loop->held[bid].next = -1;
+    if (entry->held_tail >= 0) {
+        loop->held[entry->held_tail].next = bid;
+    } else {
+        entry->held_head = bid;
+    }
+    entry->held_tail = bid;
+    return true;
+}
+
+static size_t
+ingest_held_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    size_t accepted = 0;
+    while (entry->held_head >= 0 && lterm_session_space(entry->session) > 0) {
+        const uint16_t bid = (uint16_t)entry->held_head;
+        const uint8_t *data = lterm_uring_buffer(&loop->uring, bid);
+        size_t n = lterm_session_ingest(entry->session, data + loop->held[bid].start,
+                                        loop->held[bid].end - loop->held[bid].start);
+        if (n == 0) {
+            break;
+        }
+        accepted += n;
+        loop->held[bid].start += (uint16_t)n;
+        if (loop->held[bid].start == loop->held[bid].end) {
+            entry->held_head = loop->held[bid].next;
+            if (entry->held_head < 0) {
+                entry->held_tail = -1;
+            }
+            lterm_uring_recycle_buffer(&loop->uring, bid);
+        }
+    }
+    return accepted;
+}
+
+static void
+release_held_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    while (entry->held_head >= 0) {
+        const uint16_t bid = (uint16_t)entry->held_head;
+        entry->held_head = loop->held[bid].next;
+        lterm_uring_recycle_buffer(&loop->uring, bid);
+    }
+    entry->held_tail = -1;
+}
+
+static void
+finish_input_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (entry->eof && !entry->throttled && !lterm_session_input_closed(entry->session)) {
+        lterm_session_close_input(entry->session);
+        schedule_locked(loop, entry);
+    }
+}
+
+static bool
+handle_read_cqe_locked(lterm_session_loop *loop, uint64_t token, int res, unsigned flags)
+{
+    loop_entry *entry = lookup_locked(loop, token);
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+        bool held = false;
+        if (entry && res > 0) {
+            held = deliver_locked(loop, entry, bid, (size_t)res);
+            atomic_fetch_add(&loop->bytes_read, (unsigned long long)res);
+        }
+        if (!held) {
+            lterm_uring_recycle_buffer(&loop->uring, bid);
+        }
+    }
+    if (!entry) {
+        return false;
+    }
+    if (!(flags & IORING_CQE_F_MORE)) {
+        entry->registered = false;
+    }
+    if (res == 0 || (res < 0 && res != -ENOBUFS && res != -ECANCELED)) {
+        entry->eof = true;
+    }
+    if (!entry->registered && !entry->eof && !entry->throttled) {
+        arm_read_locked(loop, entry);
+    }
+    finish_input_locked(loop, entry);
+    if (res > 0) {
+        schedule_locked(loop, entry);
+    }
+    return res > 0;
+}
+
+static void
+handle_write_cqe_locked(lterm_session_loop *loop, uint64_t token, int res)
+{
+    // Removed entries are still resolved: remove() waits for this completion.
+    uint32_t slot = (uint32_t)(token & 0xffffffffu);
+    loop_entry *entry = slot < loop->slot_capacity ? loop->slots[slot] : NULL;
+    if (!entry || !entry->write_inflight) {
+        return;
+    }
+    entry->write_inflight = false;
+    if (res > 0) {
+        atomic_fetch_add(&loop->bytes_written, (unsigned long long)res);
+        lterm_session_consume_output(entry->session, (size_t)res);
+    } else if (res != -EAGAIN && res != -EINTR && !entry->removed) {
+        // The PTY failed; the queued input can never be delivered.
+        lterm_session_consume_output(entry->session, SIZE_MAX);
+    }
+    if (!entry->removed) {
+        submit_write_locked(loop, entry, res <= 0 || (size_t)res < entry->write_length);
+    }
+}
+
+static int
+reap_locked(lterm_session_loop *loop)
+{
+    int handled = 0;
+    struct io_uring_cqe *cqe;
+    while ((cqe = lterm_uring_peek_cqe(&loop->uring))) {
+        uint64_t token = cqe->user_data;
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        lterm_uring_cqe_seen(&loop->uring);
+        switch (token_op(token)) {
+        case OP_READ:
+            handled += handle_read_cqe_locked(loop, token, res, flags);
+            break;
+        case OP_WRITE:
+            handle_write_cqe_locked(loop, token, res);
+            break;
+        default:
+            break;
+        }
+    }
+    return handled;
+}
+
+static void
+rearm_locked(lterm_session_loop *loop)
+{
+    for (size_t i = 0; i < loop->slot_capacity && loop->rearm_count > 0; ++i) {
+        loop_entry *entry = loop->slots[i];
+        if (!entry || !entry->rearm) {
+            continue;
+        }
+        entry->rearm = false;
+        loop->rearm_count--;
+        size_t accepted = 0;
+        while (accepted < entry->overflow_length && lterm_session_space(entry->session) > 0) {
+            size_t step = entry->overflow_length - accepted;
+            if (step > LTERM_SESSION_LOOP_URING_BUFFER_SIZE) {
+                step = LTERM_SESSION_LOOP_URING_BUFFER_SIZE;
+            }
+            size_t n = lterm_session_ingest(entry->session, entry->overflow + accepted, step);
+            if (n == 0) {
+                break;
+            }
+            accepted += n;
+        }
+        if (accepted) {
+            memmove(entry->overflow, entry->overflow + accepted, entry->overflow_length - accepted);
+            entry->overflow_length -= accepted;
+        }
+        if (entry->overflow_length == 0) {
+            accepted += ingest_held_locked(loop, entry);
+        }
+        if (entry->overflow_length == 0 && entry->held_head < 0 && lterm_session_space(entry->session) > 0) {
+            entry->throttled = false;
+            if (!entry->registered && !entry->eof) {
+                arm_read_locked(loop, entry);
+            }
+            finish_input_locked(loop, entry);
+        }
+        if (accepted) {
+            schedule_locked(loop, entry);
+        }
+    }
+}
+
+#endif
+
+// Brings the PTY's epoll interest in line with reading/writing wants.
+static bool
+update_epoll_locked(lterm_session_loop *loop, loop_entry *entry, bool read, bool write)
+{
+    uint32_t current = (entry->registered ? EPOLLIN : 0) | (entry->write_armed ? EPOLLOUT : 0);
+    uint32_t wanted = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+    if (current == wanted) {
+        return true;
+    }
+    struct epoll_event event = {
+        .events = wanted,
+        .data.u64 = entry_token(loop, entry, OP_READ),
+    };
+    int op = current == 0 ? EPOLL_CTL_ADD : wanted == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+    bool ok = epoll_ctl(loop->epoll_fd, op, entry_fd(entry), &event) == 0;
+    atomic_fetch_add(&loop->syscalls, 1);
+    if (ok || op == EPOLL_CTL_DEL) {
+        entry->registered = read;
+        entry->write_armed = write;
+    }
+    return ok;
+}
+
+// The pidfd goes into the epoll set with either backend; the reactor reaps
+// the child as soon as it exits instead of relying on SIGCHLD.
+static void
+watch_child_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    int pidfd = lterm_pty_get_pidfd(lterm_session_pty(entry->session));
+    if (pidfd < 0 || lterm_pty_child_pid(lterm_session_pty(entry->session)) <= 0) {
+        return;
+    }
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.u64 = entry_token(loop, entry, OP_CHILD),
+    };
+    entry->child_watched = epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, pidfd, &event) == 0;
+    atomic_fetch_add(&loop->syscalls, 1);
+}
+
+static void
+unwatch_child_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (!entry->child_watched) {
+        return;
+    }
+    int pidfd = lterm_pty_get_pidfd(lterm_session_pty(entry->session));
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, pidfd, NULL);
+    atomic_fetch_add(&loop->syscalls, 1);
+    entry->child_watched = false;
+}
+
+static bool
+register_fd(lterm_session_loop *loop, loop_entry *entry)
+{
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        return arm_read_locked(loop, entry);
+    }
+#endif
+    return update_epoll_locked(loop, entry, true, entry->write_armed);
+}
+
+static void
+unregister_fd(lterm_session_loop *loop, loop_entry *entry)
+{
+    if (!entry->registered) {
+        return;
+    }
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        cancel_locked(loop, entry_token(loop, entry, OP_READ));
+        entry->registered = false;
+        return;
+    }
+#endif
+    update_epoll_locked(loop, entry, false, entry->write_armed);
+}
+
+// Starts writing a session's queued input: with io_uring a writev is queued
+// for the next submission, with epoll writability is watched.
+static void
+arm_write_locked(lterm_session_loop *loop, loop_entry *entry)
+{
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        if (!entry->write_inflight) {
+            submit_write_locked(loop, entry, false);
+        }
+        return;
+    }
+#endif
+    update_epoll_locked(loop, entry, entry->registered, true);
+}
+
+static void
+run_entry(lterm_session_loop *loop, loop_entry *entry)
+{
+    lterm_session *session = entry->session;
+    size_t bytes = atomic_load(&loop->slice_bytes);
+    int64_t ns = atomic_load(&loop->slice_ns);
+    if (atomic_load(&entry->focused)) {
+        bytes *= LTERM_SESSION_LOOP_FOCUS_SHARE;
+        ns *= LTERM_SESSION_LOOP_FOCUS_SHARE;
+    }
+    lterm_session_process_until(session, bytes, monotonic_ns() + ns);
+
+    pthread_mutex_lock(&loop->lock);
+    entry->running = false;
+    if (entry->removed) {
+        atomic_store(&entry->scheduled, false);
+        pthread_cond_broadcast(&loop->done_cond);
+        pthread_mutex_unlock(&loop->lock);
+        return;
+    }
+    // Re-arm a PTY the reactor stopped reading while throttled. With
+    // io_uring the reactor owns the overflow, so it is asked to do that.
+    bool wake = false;
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        if (entry->throttled && !entry->rearm && lterm_session_space(session) > 0) {
+            entry->rearm = true;
+            loop->rearm_count++;
+            wake = true;
+        }
+    } else if (!entry->registered && !lterm_session_input_closed(session) && lterm_session_space(session) > 0) {
+        register_fd(loop, entry);
+    }
+    atomic_store(&entry->scheduled, false);
+    if (lterm_session_has_work(session)) {
+        atomic_fetch_add(&loop->slices_cut, 1);
+        requeue_locked(loop, entry);
+    }
+    pthread_mutex_unlock(&loop->lock);
+    if (wake) {
+        wake_reactor(loop);
+    }
+}
+
+static void *
+worker_main(void *data)
+{
+    worker_start *start = data;
+    lterm_session_loop *loop = start->loop;
+    size_t index = start->index;
+    free(start);
+    loop_worker *worker = &loop->workers[index];
+
+    pthread_mutex_lock(&loop->lock);
+    while (!loop->stopping) {
+        loop_entry *entry = pop_locked(loop, index);
+        if (!entry) {
+            worker->idle = true;
+            pthread_cond_wait(&worker->cond, &loop->lock);
+            worker->idle = false;
+            continue;
+        }
+        pthread_mutex_unlock(&loop->lock);
+        run_entry(loop, entry);
+        pthread_mutex_lock(&loop->lock);
+    }
+    pthread_mutex_unlock(&loop->lock);
+    return NULL;
+}
+
+static void
+stop_workers(lterm_session_loop *loop, size_t started)
+{
+    pthread_mutex_lock(&loop->lock);
+    loop->stopping = true;
+    for (size_t i = 0; i < started; ++i) {
+        pthread_cond_signal(&loop->workers[i].cond);
+    }
+    pthread_mutex_unlock(&loop->lock);
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(loop->workers[i].thread, NULL);
+    }
+}
+
+static bool
+setup_backend(lterm_session_loop *loop, lterm_session_loop_backend backend)
+{
+    loop->backend = LTERM_SESSION_LOOP_BACKEND_EPOLL;
+    if (backend == LTERM_SESSION_LOOP_BACKEND_EPOLL ||
+        (backend == LTERM_SESSION_LOOP_BACKEND_AUTO && !lterm_uring_supported())) {
+        return true;
+    }
+#ifdef LTERM_HAVE_IO_URING
+    loop->held = calloc(LTERM_SESSION_LOOP_URING_BUFFERS, sizeof(*loop->held));
+    if (loop->held && lterm_uring_init(&loop->uring, LTERM_SESSION_LOOP_URING_ENTRIES,
+                                       LTERM_SESSION_LOOP_URING_BUFFERS, LTERM_SESSION_LOOP_URING_BUFFER_SIZE)) {
+        struct epoll_event completions = {.events = EPOLLIN, .data.u64 = URING_TOKEN};
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->uring.fd, &completions) == 0) {
+            loop->backend = LTERM_SESSION_LOOP_BACKEND_IO_URING;
+            return true;
+        }
+        lterm_uring_free(&loop->uring);
+    }
+    free(loop->held);
+    loop->held = NULL;
+#endif
+    return backend == LTERM_SESSION_LOOP_BACKEND_AUTO;
+}
+
+lterm_session_loop *
+lterm_session_loop_new(size_t worker_count)
+{
+    return lterm_session_loop_new_with_backend(worker_count, LTERM_SESSION_LOOP_BACKEND_AUTO);
+}
+
+lterm_session_loop *
+lterm_session_loop_new_with_backend(size_t worker_count, lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = calloc(1, sizeof(*loop));
+    if (!loop) {
+        return NULL;
+    }
+#ifdef LTERM_HAVE_IO_URING
+    loop->uring.fd = -1;
+#endif
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        free(loop);
+        return NULL;
+    }
+    if (pipe(loop->wake_pipe) != 0) {
+        close(loop->epoll_fd);
+        free(loop);
+        return NULL;
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(loop->wake_pipe[i], F_SETFL, fcntl(loop->wake_pipe[i], F_GETFL, 0) | O_NONBLOCK);
+    }
+    struct epoll_event wake = {.events = EPOLLIN, .data.u64 = WAKE_TOKEN};
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_pipe[0], &wake);
+
+    pthread_mutex_init(&loop->lock, NULL);
+    pthread_cond_init(&loop->done_cond, NULL);
+    atomic_init(&loop->wake_pending, false);
+    atomic_init(&loop->reactor_stopping, false);
+    atomic_init(&loop->batch_depth, 0);
+    atomic_init(&loop->batch_wake, false);
+    atomic_init(&loop->slices_cut, 0);
+    atomic_init(&loop->slice_bytes, LTERM_SESSION_LOOP_SLICE_BYTES);
+    atomic_init(&loop->slice_ns, LTERM_SESSION_LOOP_SLICE_US * 1000ll);
+    atomic_init(&loop->wakeups, 0);
+    atomic_init(&loop->syscalls, 0);
+    atomic_init(&loop->bytes_read, 0);
+    atomic_init(&loop->bytes_written, 0);
+    if (!setup_backend(loop, backend)) {
+        lterm_session_loop_free(loop);
+        return NULL;
+    }
+    loop->queue_count = worker_count ? worker_count : 1;
+    loop->workers = calloc(loop->queue_count, sizeof(*loop->workers));
+    if (!loop->workers) {
+        lterm_session_loop_free(loop);
+        return NULL;
+    }
+    for (size_t i = 0; i < loop->queue_count; ++i) {
+        pthread_cond_init(&loop->workers[i].cond, NULL);
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        worker_start *start = malloc(sizeof(*start));
+        if (!start) {
+            break;
+        }
+        start->loop = loop;
+        start->index = i;
+        if (pthread_create(&loop->workers[i].thread, NULL, worker_main, start) != 0) {
+            free(start);
+            break;
+        }
+        loop->thread_count++;
+    }
+    if (loop->thread_count != worker_count) {
+        lterm_session_loop_free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void
+lterm_session_loop_free(lterm_session_loop *loop)
+{
+    if (!loop) {
+        return;
+    }
+    lterm_session_loop_stop(loop);
+    if (loop->workers) {
+        stop_workers(loop, loop->thread_count);
+        for (size_t i = 0; i < loop->queue_count; ++i) {
+            pthread_cond_destroy(&loop->workers[i].cond);
+        }
+    }
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        lterm_uring_free(&loop->uring);
+    }
+    free(loop->held);
+#endif
+    for (size_t i = 0; i < loop->slot_capacity; ++i) {
+        if (loop->slots[i]) {
+            lterm_session_set_output_handler(loop->slots[i]->session, NULL, NULL);
+            free(loop->slots[i]->overflow);
+            free(loop->slots[i]);
+        }
+    }
+    free(loop->slots);
+    free(loop->generations);
+    free(loop->workers);
+    close(loop->wake_pipe[0]);
+    close(loop->wake_pipe[1]);
+    close(loop->epoll_fd);
+    pthread_cond_destroy(&loop->done_cond);
+    pthread_mutex_destroy(&loop->lock);
+    free(loop);
+}
+
+static bool
+claim_slot(lterm_session_loop *loop, uint32_t *slot)
+{
+    for (size_t i = 0; i < loop->slot_capacity; ++i) {
+        if (!loop->slots[i]) {
+            *slot = (uint32_t)i;
+            return true;
+        }
+    }
+    size_t capacity = loop->slot_capacity ? loop->slot_capacity * 2 : 16;
+    loop_entry **slots = realloc(loop->slots, capacity * sizeof(*slots));
+    if (!slots) {
+        return false;
+    }
+    loop->slots = slots;
+    uint32_t *generations = realloc(loop->generations, capacity * sizeof(*generations));
+    if (!generations) {
+        return false;
+    }
+    loop->generations = generations;
+    for (size_t i = loop->slot_capacity; i < capacity; ++i) {
+        loop->slots[i] = NULL;
+        loop->generations[i] = 0;
+    }
+    *slot = (uint32_t)loop->slot_capacity;
+    loop->slot_capacity = capacity;
+    return true;
+}
+
+static loop_entry *
+find_locked(lterm_session_loop *loop, const lterm_session *session)
+{
+    for (size_t i = 0; i < loop->slot_capacity; ++i) {
+        if (loop->slots[i] && loop->slots[i]->session == session && !loop->slots[i]->removed) {
+            return loop->slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Output handler installed on every session in the loop; runs on the thread
+// that called lterm_session_write() once input had to be queued.
+static void
+output_ready(lterm_session *session, void *user_data)
+{
+    lterm_session_loop *loop = user_data;
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_EPOLL) {
+        // Try right away; only watch for writability if the PTY is full.
+        ssize_t written = lterm_session_flush(session);
+        atomic_fetch_add(&loop->syscalls, 1);
+        if (written > 0) {
+            atomic_fetch_add(&loop->bytes_written, (unsigned long long)written);
+        }
+        if (lterm_session_write_queued(session) == 0) {
+            return;
+        }
+    }
+    pthread_mutex_lock(&loop->lock);
+    loop_entry *entry = find_locked(loop, session);
+    if (entry) {
+        arm_write_locked(loop, entry);
+    }
+    pthread_mutex_unlock(&loop->lock);
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        if (atomic_load(&loop->batch_depth) > 0) {
+            // Checked again after the store so a batch that just ended
+            // cannot miss this write.
+            atomic_store(&loop->batch_wake, true);
+            if (atomic_load(&loop->batch_depth) > 0) {
+                return;
+            }
+        }
+        wake_reactor(loop);
+    }
+}
+
+void
+lterm_session_loop_begin_batch(lterm_session_loop *loop)
+{
+    if (loop) {
+        atomic_fetch_add(&loop->batch_depth, 1);
+    }
+}
+
+void
+lterm_session_loop_end_batch(lterm_session_loop *loop)
+{
+    if (!loop) {
+        return;
+    }
+    if (atomic_fetch_sub(&loop->batch_depth, 1) == 1 && atomic_exchange(&loop->batch_wake, false)) {
+        wake_reactor(loop);
+    }
+}
+
+bool
+lterm_session_loop_add(lterm_session_loop *loop, lterm_session *session)
+{
+    if (!loop || !session || !lterm_pty_is_active(lterm_session_pty(session))) {
+        return false;
+    }
+    loop_entry *entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        return false;
+    }
+    entry->session = session;
+    entry->queued_on = -1;
+    entry->held_head = -1;
+    entry->held_tail = -1;
+    atomic_init(&entry->scheduled, false);
+    atomic_init(&entry->focused, false);
+
+    pthread_mutex_lock(&loop->lock);
+    if (!claim_slot(loop, &entry->slot)) {
+        pthread_mutex_unlock(&loop->lock);
+        free(entry);
+        return false;
+    }
+    loop->slots[entry->slot] = entry;
+    entry->home = loop->next_home++ % loop->queue_count;
+    if (!register_fd(loop, entry)) {
+        loop->slots[entry->slot] = NULL;
+        pthread_mutex_unlock(&loop->lock);
+        free(entry);
+        return false;
+    }
+    loop->session_count++;
+    watch_child_locked(loop, entry);
+    if (lterm_session_has_work(session)) {
+        schedule_locked(loop, entry);
+    }
+    lterm_session_set_output_handler(session, output_ready, loop);
+    if (lterm_session_write_queued(session) > 0) {
+        arm_write_locked(loop, entry);
+    }
+    pthread_mutex_unlock(&loop->lock);
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        wake_reactor(loop);
+    }
+    return true;
+}
+
+void
+lterm_session_loop_remove(lterm_session_loop *loop, lterm_session *session)
+{
+    if (!loop || !session) {
+        return;
+    }
+    pthread_mutex_lock(&loop->lock);
+    loop_entry *entry = find_locked(loop, session);
+    if (!entry) {
+        pthread_mutex_unlock(&loop->lock);
+        return;
+    }
+    lterm_session_set_output_handler(session, NULL, NULL);
+    unregister_fd(loop, entry);
+    update_epoll_locked(loop, entry, false, false);
+    unwatch_child_locked(loop, entry);
+    entry->removed = true;
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        // The kernel reads the session's queue while a writev is in flight, so
+        // wait for it here; cancels go out now so the caller can close the PTY
+        // right after this returns.
+        if (entry->write_inflight) {
+            cancel_locked(loop, entry_token(loop, entry, OP_POLL));
+        }
+        lterm_uring_submit(&loop->uring);
+        while (entry->write_inflight) {
+            lterm_uring_wait(&loop->uring);
+            reap_locked(loop);
+        }
+        release_held_locked(loop, entry);
+    }
+#endif
+    if (entry->rearm) {
+        loop->rearm_count--;
+    }
+    unlink_queue(loop, entry);
+    while (entry->running || entry->reading) {
+        pthread_cond_wait(&loop->done_cond, &loop->lock);
+    }
+    loop->slots[entry->slot] = NULL;
+    loop->generations[entry->slot]++;
+    loop->session_count--;
+    pthread_mutex_unlock(&loop->lock);
+    free(entry->overflow);
+    free(entry);
+}
+
+bool
+lterm_session_loop_set_focused(lterm_session_loop *loop, lterm_session *session, bool focused)
+{
+    if (!loop || !session) {
+        return false;
+    }
+    pthread_mutex_lock(&loop->lock);
+    loop_entry *entry = find_locked(loop, session);
+    if (entry) {
+        atomic_store(&entry->focused, focused);
+    }
+    pthread_mutex_unlock(&loop->lock);
+    return entry != NULL;
+}
+
+void
+lterm_session_loop_set_slice(lterm_session_loop *loop, size_t bytes, unsigned usec)
+{
+    if (!loop) {
+        return;
+    }
+    atomic_store(&loop->slice_bytes, bytes ? bytes : LTERM_SESSION_LOOP_SLICE_BYTES);
+    atomic_store(&loop->slice_ns, (usec ? usec : LTERM_SESSION_LOOP_SLICE_US) * 1000ll);
+}
+
+lterm_session_loop_backend
+lterm_session_loop_get_backend(const lterm_session_loop *loop)
+{
+    return loop ? loop->backend : LTERM_SESSION_LOOP_BACKEND_EPOLL;
+}
+
+int
+lterm_session_loop_fd(const lterm_session_loop *loop)
+{
+    return loop ? loop->epoll_fd : -1;
+}
+
+// One round: every session queued now gets one slice. Leftover work waits
+// for the next dispatch, which the wake pipe makes return at once.
+static void
+drain_inline(lterm_session_loop *loop)
+{
+    pthread_mutex_lock(&loop->lock);
+    size_t round = loop->workers[0].length;
+    pthread_mutex_unlock(&loop->lock);
+    for (; round > 0; --round) {
+        pthread_mutex_lock(&loop->lock);
+        loop_entry *entry = pop_locked(loop, 0);
+        pthread_mutex_unlock(&loop->lock);
+        if (!entry) {
+            break;
+        }
+        run_entry(loop, entry);
+    }
+    pthread_mutex_lock(&loop->lock);
+    bool more = loop->workers[0].length > 0;
+    pthread_mutex_unlock(&loop->lock);
+    if (more) {
+        wake_reactor(loop);
+    }
+}
+
+static void
+handle_ready(lterm_session_loop *loop, uint64_t token, uint32_t events)
+{
+    pthread_mutex_lock(&loop->lock);
+    loop_entry *entry = lookup_locked(loop, token);
+    if (!entry) {
+        pthread_mutex_unlock(&loop->lock);
+        return;
+    }
+    bool write = entry->write_armed && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP));
+    bool read = entry->registered && (events & (EPOLLIN | EPOLLERR | EPOLLHUP));
+    bool reap = !entry->child_watched;
+    entry->reading = true;
+    pthread_mutex_unlock(&loop->lock);
+
+    lterm_session *session = entry->session;
+    if (write) {
+        ssize_t written = lterm_session_flush(session);
+        atomic_fetch_add(&loop->syscalls, 1);
+        if (written > 0) {
+            atomic_fetch_add(&loop->bytes_written, (unsigned long long)written);
+        }
+    }
+    size_t filled = 0;
+    if (read) {
+        size_t reads = 0;
+        filled = lterm_session_fill(session, LTERM_SESSION_LOOP_READ_BUDGET, &reads);
+        atomic_fetch_add(&loop->syscalls, reads);
+        atomic_fetch_add(&loop->bytes_read, filled);
+    }
+    bool closed = lterm_session_input_closed(session);
+    if (closed && reap) {
+        // No pidfd: the hangup is the best hint that the child is gone.
+        lterm_session_reap(session);
+    }
+
+    pthread_mutex_lock(&loop->lock);
+    entry->reading = false;
+    if (entry->removed) {
+        pthread_cond_broadcast(&loop->done_cond);
+        pthread_mutex_unlock(&loop->lock);
+        return;
+    }
+    // Checked under the loop lock so a concurrent output_ready() that queued
+    // more input either sees EPOLLOUT still armed or re-arms it afterwards.
+    if (write && lterm_session_write_queued(session) == 0) {
+        update_epoll_locked(loop, entry, entry->registered, false);
+    }
+    // Stop watching a PTY that is throttled (or closed) so level-triggered
+    // readiness does not spin; the worker re-arms it below the low watermark.
+    if (read && (closed || lterm_session_space(session) == 0)) {
+        unregister_fd(loop, entry);
+    }
+    if (filled || (read && closed)) {
+        schedule_locked(loop, entry);
+    }
+    pthread_mutex_unlock(&loop->lock);
+}
+
+static void
+handle_child(lterm_session_loop *loop, uint64_t token)
+{
+    pthread_mutex_lock(&loop->lock);
+    loop_entry *entry = lookup_locked(loop, token);
+    if (!entry || !entry->child_watched) {
+        pthread_mutex_unlock(&loop->lock);
+        return;
+    }
+    entry->reading = true;
+    pthread_mutex_unlock(&loop->lock);
+
+    bool reaped = lterm_session_reap(entry->session);
+
+    pthread_mutex_lock(&loop->lock);
+    entry->reading = false;
+    if (entry->removed) {
+        pthread_cond_broadcast(&loop->done_cond);
+    } else if (reaped) {
+        // The pidfd stays readable until the PTY is closed.
+        unwatch_child_locked(loop, entry);
+    }
+    pthread_mutex_unlock(&loop->lock);
+}
+
+int
+lterm_session_loop_dispatch(lterm_session_loop *loop, int timeout_ms)
+{
+    if (!loop) {
+        return -1;
+    }
+    struct epoll_event events[LTERM_SESSION_LOOP_MAX_EVENTS];
+    int count = epoll_wait(loop->epoll_fd, events, LTERM_SESSION_LOOP_MAX_EVENTS, timeout_ms);
+    atomic_fetch_add(&loop->syscalls, 1);
+    if (count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    atomic_fetch_add(&loop->wakeups, 1);
+    int handled = 0;
+    for (int i = 0; i < count; ++i) {
+        if (events[i].data.u64 == WAKE_TOKEN) {
+            // Clear first so a wake requested from here on writes again.
+            atomic_store(&loop->wake_pending, false);
+            uint8_t scratch[64];
+            while (read(loop->wake_pipe[0], scratch, sizeof(scratch)) > 0) {
+                atomic_fetch_add(&loop->syscalls, 1);
+            }
+            atomic_fetch_add(&loop->syscalls, 1);
+            continue;
+        }
+        if (events[i].data.u64 == URING_TOKEN) {
+            continue;
+        }
+        if (token_op(events[i].data.u64) == OP_CHILD) {
+            handle_child(loop, events[i].data.u64);
+            continue;
+        }
+        handle_ready(loop, events[i].data.u64, events[i].events);
+        handled++;
+    }
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        // Completions are reaped from shared memory; everything queued since
+        // the last wakeup (rearms, reads, writes for any session) goes to the
+        // kernel in one io_uring_enter().
+        pthread_mutex_lock(&loop->lock);
+        handled += reap_locked(loop);
+        rearm_locked(loop);
+        lterm_uring_submit(&loop->uring);
+        pthread_mutex_unlock(&loop->lock);
+    }
+#endif
+    if (loop->thread_count == 0) {
+        drain_inline(loop);
+    }
+    return handled;
+}
+
+static void *
+reactor_main(void *data)
+{
+    lterm_session_loop *loop = data;
+    while (!atomic_load(&loop->reactor_stopping)) {
+        if (lterm_session_loop_dispatch(loop, -1) < 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+bool
+lterm_session_loop_start(lterm_session_loop *loop)
+{
+    if (!loop || loop->reactor_started) {
+        return false;
+    }
+    atomic_store(&loop->reactor_stopping, false);
+    if (pthread_create(&loop->reactor, NULL, reactor_main, loop) != 0) {
+        return false;
+    }
+    loop->reactor_started = true;
+    return true;
+}
+
+void
+lterm_session_loop_stop(lterm_session_loop *loop)
+{
+    if (!loop || !loop->reactor_started) {
+        return;
+    }
+    atomic_store(&loop->reactor_stopping, true);
+    (void)!write(loop->wake_pipe[1], "", 1);
+    pthread_join(loop->reactor, NULL);
+    loop->reactor_started = false;
+}
+
+void
+lterm_session_loop_get_stats(lterm_session_loop *loop, lterm_session_loop_stats *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!loop) {
+        return;
+    }
+    pthread_mutex_lock(&loop->lock);
+    stats->sessions = loop->session_count;
+    stats->workers = loop->thread_count;
+    stats->backend = loop->backend;
+    stats->wakeups = atomic_load(&loop->wakeups);
+    stats->steals = loop->steals;
+    stats->slices_cut = atomic_load(&loop->slices_cut);
+    stats->syscalls = atomic_load(&loop->syscalls);
+#ifdef LTERM_HAVE_IO_URING
+    if (loop->backend == LTERM_SESSION_LOOP_BACKEND_IO_URING) {
+        stats->syscalls += loop->uring.enters;
+    }
+#endif
+    stats->bytes_read = atomic_load(&loop->bytes_read);
+    stats->bytes_written = atomic_load(&loop->bytes_written);
+    pthread_mutex_unlock(&loop->lock);
+}
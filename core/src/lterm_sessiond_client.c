@@ -0,0 +1,526 @@
+#define _GNU_SOURCE
+
+#include "lterm_sessiond.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lterm_sessiond_proto.h"
+
+typedef struct {
+    uint32_t id;
+    lterm_screen *screen;
+    lterm_sessiond_state_msg state;
+    bool exited;
+    int exit_code;
+    int signal;
+} client_session;
+
+struct lterm_sessiond_client {
+    int fd;
+    bool broken;
+    lterm_sessiond_inbox inbox;
+    lterm_write_queue outbox;
+    // Master fd that arrived with the latest ATTACHED.
+    int passed_fd;
+    lterm_sessiond_update_cb callback;
+    void *user_data;
+    client_session *sessions;
+    size_t session_count;
+    size_t session_capacity;
+};
+
+// A reply copied out of the inbox, which later reads may move.
+typedef struct {
+    lterm_sessiond_header header;
+    uint8_t *payload;
+} reply;
+
+static client_session *
+find_session(const lterm_sessiond_client *client, uint32_t id)
+{
+    for (size_t i = 0; i < client->session_count; ++i) {
+        if (client->sessions[i].id == id) {
+            return &client->sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+notify(lterm_sessiond_client *client, uint32_t id, lterm_sessiond_update update)
+{
+    if (client->callback) {
+        client->callback(id, update, client->user_data);
+    }
+}
+
+static void
+apply_state(lterm_sessiond_client *client, client_session *session, const lterm_sessiond_state_msg *state)
+{
+    session->state = *state;
+    lterm_screen *screen = session->screen;
+    if (screen->grid.rows != state->rows || screen->grid.cols != state->cols) {
+        lterm_screen_set_size(screen, state->rows, state->cols);
+    }
+    lterm_screen_set_cursor(screen, state->cursor_row, state->cursor_col);
+    screen->modes = state->modes;
+    notify(client, session->id, LTERM_SESSIOND_UPDATE_STATE);
+}
+
+static void
+apply_rows(lterm_sessiond_client *client, client_session *session, const uint8_t *payload, size_t length)
+{
+    lterm_sessiond_rows_msg rows;
+    if (length < sizeof(rows)) {
+        return;
+    }
+    memcpy(&rows, payload, sizeof(rows));
+    lterm_screen *screen = session->screen;
+    size_t cells = (size_t)rows.count * rows.cols;
+    if (rows.cols != screen->grid.cols || (size_t)rows.first + rows.count > screen->grid.rows ||
+        length - sizeof(rows) < cells * sizeof(lterm_cell)) {
+        return;
+    }
+    memcpy(screen->grid.cells + (size_t)rows.first * rows.cols, payload + sizeof(rows), cells * sizeof(lterm_cell));
+    lterm_screen_mark_dirty(screen, rows.first, rows.count);
+    notify(client, session->id, LTERM_SESSIOND_UPDATE_ROWS);
+}
+
+static void
+apply_update(lterm_sessiond_client *client, const lterm_sessiond_header *header, const uint8_t *payload)
+{
+    lterm_sessiond_id_msg target;
+    if (header->length < sizeof(target)) {
+        return;
+    }
+    memcpy(&target, payload, sizeof(target));
+    client_session *session = find_session(client, target.id);
+    if (!session) {
+        return;
+    }
+    switch (header->type) {
+    case LTERM_SESSIOND_MSG_STATE: {
+        lterm_sessiond_state_msg state;
+        if (header->length >= sizeof(state)) {
+            memcpy(&state, payload, sizeof(state));
+            apply_state(client, session, &state);
+        }
+        break;
+    }
+    case LTERM_SESSIOND_MSG_ROWS:
+        apply_rows(client, session, payload, header->length);
+        break;
+    case LTERM_SESSIOND_MSG_EXITED: {
+        lterm_sessiond_exited_msg exited;
+        if (header->length >= sizeof(exited)) {
+            memcpy(&exited, payload, sizeof(exited));
+            session->exited = true;
+            session->exit_code = exited.exit_code;
+            session->signal = exited.signal;
+            notify(client, session->id, LTERM_SESSIOND_UPDATE_EXITED);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static bool
+is_update(uint32_t type)
+{
+    return type == LTERM_SESSIOND_MSG_STATE || type == LTERM_SESSIOND_MSG_ROWS || type == LTERM_SESSIOND_MSG_EXITED;
+}
+
+// Returns false once the socket has nothing more to read right now.
+static bool
+read_socket(lterm_sessiond_client *client)
+{
+    ssize_t count = lterm_sessiond_inbox_read(&client->inbox, client->fd, &client->passed_fd);
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        client->broken = true;
+    }
+    return count > 0;
+}
+
+static bool
+flush_outbox(lterm_sessiond_client *client)
+{
+    while (!client->broken && lterm_write_queue_queued(&client->outbox) > 0) {
+        if (lterm_write_queue_flush(&client->outbox, client->fd) < 0) {
+            client->broken = true;
+            break;
+        }
+        if (lterm_write_queue_queued(&client->outbox) == 0) {
+            break;
+        }
+        struct pollfd pfd = {.fd = client->fd, .events = POLLOUT};
+        int ready = poll(&pfd, 1, LTERM_SESSIOND_IO_TIMEOUT_MS);
+        if (ready == 0 || (ready < 0 && errno != EINTR)) {
+            client->broken = true;
+        }
+    }
+    return !client->broken;
+}
+
+static bool
+send_message(lterm_sessiond_client *client, uint32_t type, const void *head, size_t head_length, const void *tail,
+             size_t tail_length)
+{
+    if (client->broken ||
+        !lterm_sessiond_queue_message(&client->outbox, type, head, head_length, tail, tail_length)) {
+        return false;
+    }
+    return flush_outbox(client);
+}
+
+static long long
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Applies updates until the reply of the given type, or an ERROR answering
+// request, arrives for id. ids of 0 match any reply of that type. ERRORs for
+// other requests, such as a fire-and-forget RESIZE, are dropped.
+static bool
+wait_for(lterm_sessiond_client *client, uint32_t request, uint32_t type, uint32_t id, reply *out)
+{
+    long long deadline = now_ms() + LTERM_SESSIOND_IO_TIMEOUT_MS;
+    while (!client->broken) {
+        lterm_sessiond_header header;
+        const uint8_t *payload = NULL;
+        bool error = false;
+        while (lterm_sessiond_inbox_peek(&client->inbox, &header, &payload, &error)) {
+            // Every reply starts with the session id; ERROR adds the request.
+            lterm_sessiond_error_msg target = {0};
+            size_t known = header.length < sizeof(target) ? header.length : sizeof(target);
+            if (known) {
+                memcpy(&target, payload, known);
+            }
+            bool match = (header.type == type ||
+                          (header.type == LTERM_SESSIOND_MSG_ERROR && target.request == request)) &&
+                         (id == 0 || target.id == id);
+            if (match) {
+                out->header = header;
+                out->payload = malloc(header.length ? header.length : 1);
+                if (out->payload) {
+                    memcpy(out->payload, payload, header.length);
+                }
+                lterm_sessiond_inbox_pop(&client->inbox);
+                return out->payload && header.type == type;
+            }
+            if (is_update(header.type)) {
+                apply_update(client, &header, payload);
+            }
+            lterm_sessiond_inbox_pop(&client->inbox);
+        }
+        if (error) {
+            client->broken = true;
+            break;
+        }
+        long long remaining = deadline - now_ms();
+        if (remaining <= 0) {
+            break;
+        }
+        struct pollfd pfd = {.fd = client->fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, (int)remaining);
+        if (ready < 0 && errno != EINTR) {
+            client->broken = true;
+        } else if (ready > 0) {
+            read_socket(client);
+        }
+    }
+    return false;
+}
+
+lterm_sessiond_client *
+lterm_sessiond_connect(const char *socket_path)
+{
+    char default_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (!socket_path) {
+        if (!lterm_sessiond_default_path(default_path, sizeof(default_path))) {
+            return NULL;
+        }
+        socket_path = default_path;
+    }
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        return NULL;
+    }
+    memcpy(address.sun_path, socket_path, strlen(socket_path) + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    lterm_sessiond_client *client = calloc(1, sizeof(*client));
+    if (!client || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        free(client);
+        close(fd);
+        return NULL;
+    }
+    client->fd = fd;
+    client->passed_fd = -1;
+    lterm_write_queue_init(&client->outbox);
+    return client;
+}
+
+void
+lterm_sessiond_disconnect(lterm_sessiond_client *client)
+{
+    if (!client) {
+        return;
+    }
+    close(client->fd);
+    if (client->passed_fd >= 0) {
+        close(client->passed_fd);
+    }
+    lterm_sessiond_inbox_free(&client->inbox);
+    lterm_write_queue_free(&client->outbox);
+    free(client->sessions);
+    free(client);
+}
+
+void
+lterm_sessiond_set_update_callback(lterm_sessiond_client *client, lterm_sessiond_update_cb callback, void *user_data)
+{
+    if (!client) {
+        return;
+    }
+    client->callback = callback;
+    client->user_data = user_data;
+}
+
+int
+lterm_sessiond_client_fd(const lterm_sessiond_client *client)
+{
+    return client ? client->fd : -1;
+}
+
+bool
+lterm_sessiond_dispatch(lterm_sessiond_client *client)
+{
+    if (!client) {
+        return false;
+    }
+    while (!client->broken && read_socket(client)) {
+    }
+    lterm_sessiond_header header;
+    const uint8_t *payload = NULL;
+    bool error = false;
+    while (lterm_sessiond_inbox_peek(&client->inbox, &header, &payload, &error)) {
+        if (is_update(header.type)) {
+            apply_update(client, &header, payload);
+        }
+        lterm_sessiond_inbox_pop(&client->inbox);
+    }
+    if (error) {
+        client->broken = true;
+    }
+    return !client->broken;
+}
+
+bool
+lterm_sessiond_create(lterm_sessiond_client *client, size_t rows, size_t cols, const char *shell_path, uint32_t *id)
+{
+    if (!client || !id) {
+        return false;
+    }
+    lterm_sessiond_create_msg create = {.rows = (uint32_t)rows, .cols = (uint32_t)cols};
+    size_t shell_length = shell_path ? strlen(shell_path) : 0;
+    reply answer = {0};
+    if (!send_message(client, LTERM_SESSIOND_MSG_CREATE, &create, sizeof(create), shell_path, shell_length) ||
+        !wait_for(client, LTERM_SESSIOND_MSG_CREATE, LTERM_SESSIOND_MSG_CREATED, 0, &answer) ||
+        answer.header.length < sizeof(*id)) {
+        free(answer.payload);
+        return false;
+    }
+    memcpy(id, answer.payload, sizeof(*id));
+    free(answer.payload);
+    return true;
+}
+
+size_t
+lterm_sessiond_list(lterm_sessiond_client *client, uint32_t *ids, size_t max)
+{
+    reply answer = {0};
+    uint32_t count = 0;
+    if (!client || !send_message(client, LTERM_SESSIOND_MSG_LIST, NULL, 0, NULL, 0) ||
+        !wait_for(client, LTERM_SESSIOND_MSG_LIST, LTERM_SESSIOND_MSG_SESSIONS, 0, &answer) ||
+        answer.header.length < sizeof(count)) {
+        free(answer.payload);
+        return 0;
+    }
+    memcpy(&count, answer.payload, sizeof(count));
+    if (count > (answer.header.length - sizeof(count)) / sizeof(uint32_t)) {
+        count = 0;
+    }
+    if (ids) {
+        memcpy(ids, answer.payload + sizeof(count), (count < max ? count : max) * sizeof(uint32_t));
+    }
+    free(answer.payload);
+    return count;
+}
+
+bool
+lterm_sessiond_attach(lterm_sessiond_client *client, uint32_t id, lterm_screen *screen, int *master_fd)
+{
+    if (!client || !screen || find_session(client, id)) {
+        return false;
+    }
+    if (client->session_count == client->session_capacity) {
+        size_t capacity = client->session_capacity ? client->session_capacity * 2 : 4;
+        client_session *sessions = realloc(client->sessions, capacity * sizeof(*sessions));
+        if (!sessions) {
+            return false;
+        }
+        client->sessions = sessions;
+        client->session_capacity = capacity;
+    }
+    lterm_sessiond_id_msg attach = {.id = id};
+    reply answer = {0};
+    if (client->passed_fd >= 0) {
+        close(client->passed_fd);
+        client->passed_fd = -1;
+    }
+    if (!send_message(client, LTERM_SESSIOND_MSG_ATTACH, &attach, sizeof(attach), NULL, 0) ||
+        !wait_for(client, LTERM_SESSIOND_MSG_ATTACH, LTERM_SESSIOND_MSG_ATTACHED, id, &answer) ||
+        answer.header.length < sizeof(lterm_sessiond_state_msg)) {
+        free(answer.payload);
+        return false;
+    }
+    client_session *session = &client->sessions[client->session_count++];
+    *session = (client_session){.id = id, .screen = screen};
+    lterm_sessiond_state_msg state;
+    memcpy(&state, answer.payload, sizeof(state));
+    free(answer.payload);
+    apply_state(client, session, &state);
+
+    // The snapshot of the visible rows follows ATTACHED directly.
+    if (!wait_for(client, LTERM_SESSIOND_MSG_ATTACH, LTERM_SESSIOND_MSG_ROWS, id, &answer)) {
+        free(answer.payload);
+        lterm_sessiond_detach(client, id);
+        return false;
+    }
+    session = find_session(client, id);
+    apply_rows(client, session, answer.payload, answer.header.length);
+    free(answer.payload);
+    if (master_fd) {
+        *master_fd = client->passed_fd;
+    } else if (client->passed_fd >= 0) {
+        close(client->passed_fd);
+    }
+    client->passed_fd = -1;
+    return true;
+}
+
+void
+lterm_sessiond_detach(lterm_sessiond_client *client, uint32_t id)
+{
+    client_session *session = client ? find_session(client, id) : NULL;
+    if (!session) {
+        return;
+    }
+    *session = client->sessions[--client->session_count];
+    lterm_sessiond_id_msg detach = {.id = id};
+    send_message(client, LTERM_SESSIOND_MSG_DETACH, &detach, sizeof(detach), NULL, 0);
+}
+
+bool
+lterm_sessiond_resize(lterm_sessiond_client *client, uint32_t id, size_t rows, size_t cols)
+{
+    if (!client || rows == 0 || cols == 0) {
+        return false;
+    }
+    lterm_sessiond_resize_msg resize = {.id = id, .rows = (uint32_t)rows, .cols = (uint32_t)cols};
+    return send_message(client, LTERM_SESSIOND_MSG_RESIZE, &resize, sizeof(resize), NULL, 0);
+}
+
+size_t
+lterm_sessiond_scrollback_lines(const lterm_sessiond_client *client, uint32_t id)
+{
+    const client_session *session = client ? find_session(client, id) : NULL;
+    return session ? (size_t)session->state.scrollback_lines : 0;
+}
+
+size_t
+lterm_sessiond_fetch_scrollback(lterm_sessiond_client *client,
+                                uint32_t id,
+                                size_t first,
+                                size_t count,
+                                lterm_cell *cells,
+                                size_t cols)
+{
+    if (!client || !cells || count == 0) {
+        return 0;
+    }
+    lterm_sessiond_fetch_msg fetch = {.id = id, .first = (uint32_t)first, .count = (uint32_t)count};
+    reply answer = {0};
+    lterm_sessiond_rows_msg rows;
+    if (!send_message(client, LTERM_SESSIOND_MSG_FETCH, &fetch, sizeof(fetch), NULL, 0) ||
+        !wait_for(client, LTERM_SESSIOND_MSG_FETCH, LTERM_SESSIOND_MSG_SCROLLBACK, id, &answer) ||
+        answer.header.length < sizeof(rows)) {
+        free(answer.payload);
+        return 0;
+    }
+    memcpy(&rows, answer.payload, sizeof(rows));
+    size_t lines = rows.count < count ? rows.count : count;
+    if ((size_t)rows.count * rows.cols * sizeof(lterm_cell) > answer.header.length - sizeof(rows)) {
+        lines = 0;
+    }
+    size_t copy = rows.cols < cols ? rows.cols : cols;
+    const lterm_cell *source = (const lterm_cell *)(answer.payload + sizeof(rows));
+    for (size_t line = 0; line < lines; ++line) {
+        memcpy(cells + line * cols, source + line * rows.cols, copy * sizeof(lterm_cell));
+        for (size_t col = copy; col < cols; ++col) {
+            cells[line * cols + col] = (lterm_cell){
+                .codepoint = ' ',
+                .fg = LTERM_COLOR_DEFAULT_FG,
+                .bg = LTERM_COLOR_DEFAULT_BG,
+            };
+        }
+    }
+    free(answer.payload);
+    return lines;
+}
+
+bool
+lterm_sessiond_exit_status(const lterm_sessiond_client *client, uint32_t id, int *exit_code, int *signal)
+{
+    const client_session *session = client ? find_session(client, id) : NULL;
+    if (!session || !session->exited) {
+        return false;
+    }
+    if (exit_code) {
+        *exit_code = session->exit_code;
+    }
+    if (signal) {
+        *signal = session->signal;
+    }
+    return true;
+}
+
+bool
+lterm_sessiond_close(lterm_sessiond_client *client, uint32_t id)
+{
+    if (!client) {
+        return false;
+    }
+    client_session *session = find_session(client, id);
+    if (session) {
+        *session = client->sessions[--client->session_count];
+    }
+    lterm_sessiond_id_msg close_msg = {.id = id};
+    return send_message(client, LTERM_SESSIOND_MSG_CLOSE, &close_msg, sizeof(close_msg), NULL, 0);
+}
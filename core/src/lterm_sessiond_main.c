@@ -0,0 +1,39 @@
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lterm_sessiond.h"
+
+static lterm_sessiond_server *running_server;
+
+static void
+handle_stop(int signal_number)
+{
+    (void)signal_number;
+    lterm_sessiond_server_stop(running_server);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *socket_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--socket PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    running_server = lterm_sessiond_server_new(socket_path);
+    if (!running_server) {
+        fprintf(stderr, "lterm-sessiond: cannot listen (already running?)\n");
+        return 1;
+    }
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+    bool ok = lterm_sessiond_server_run(running_server);
+    lterm_sessiond_server_free(running_server);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+
+#include "lterm_sessiond_proto.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define INBOX_READ_SIZE (64u * 1024u)
+
+bool
+lterm_sessiond_queue_message(lterm_write_queue *queue,
+                             uint32_t type,
+                             const void *head,
+                             size_t head_length,
+                             const void *tail,
+                             size_t tail_length)
+{
+    if (!queue || head_length + tail_length > LTERM_SESSIOND_MAX_MESSAGE) {
+        return false;
+    }
+    lterm_sessiond_header header = {
+        .type = type,
+        .length = (uint32_t)(head_length + tail_length),
+    };
+    return lterm_write_queue_append(queue, (const uint8_t *)&header, sizeof(header)) &&
+           (!head_length || lterm_write_queue_append(queue, head, head_length)) &&
+           (!tail_length || lterm_write_queue_append(queue, tail, tail_length));
+}
+
+void
+lterm_sessiond_inbox_free(lterm_sessiond_inbox *inbox)
+{
+    if (!inbox) {
+        return;
+    }
+    free(inbox->data);
+    inbox->data = NULL;
+    inbox->start = inbox->length = inbox->capacity = 0;
+}
+
+ssize_t
+lterm_sessiond_inbox_read(lterm_sessiond_inbox *inbox, int socket_fd, int *fd)
+{
+    if (inbox->start > 0) {
+        memmove(inbox->data, inbox->data + inbox->start, inbox->length - inbox->start);
+        inbox->length -= inbox->start;
+        inbox->start = 0;
+    }
+    if (inbox->capacity - inbox->length < INBOX_READ_SIZE) {
+        size_t capacity = inbox->capacity ? inbox->capacity : INBOX_READ_SIZE;
+        while (capacity - inbox->length < INBOX_READ_SIZE) {
+            capacity *= 2;
+        }
+        uint8_t *data = realloc(inbox->data, capacity);
+        if (!data) {
+            return -1;
+        }
+        inbox->data = data;
+        inbox->capacity = capacity;
+    }
+    struct iovec iov = {
+        .iov_base = inbox->data + inbox->length,
+        .iov_len = inbox->capacity - inbox->length,
+    };
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    ssize_t count;
+    do {
+        count = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        return -1;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        int passed;
+        memcpy(&passed, CMSG_DATA(cmsg), sizeof(passed));
+        if (fd && *fd < 0) {
+            *fd = passed;
+        } else {
+            close(passed);
+        }
+    }
+    inbox->length += (size_t)count;
+    return count;
+}
+
+bool
+lterm_sessiond_inbox_peek(const lterm_sessiond_inbox *inbox,
+                          lterm_sessiond_header *header,
+                          const uint8_t **payload,
+                          bool *error)
+{
+    size_t available = inbox->length - inbox->start;
+    if (available < sizeof(*header)) {
+        return false;
+    }
+    memcpy(header, inbox->data + inbox->start, sizeof(*header));
+    if (header->length > LTERM_SESSIOND_MAX_MESSAGE) {
+        if (error) {
+            *error = true;
+        }
+        return false;
+    }
+    if (available - sizeof(*header) < header->length) {
+        return false;
+    }
+    *payload = inbox->data + inbox->start + sizeof(*header);
+    return true;
+}
+
+void
+lterm_sessiond_inbox_pop(lterm_sessiond_inbox *inbox)
+{
+    lterm_sessiond_header header;
+    size_t available = inbox->length - inbox->start;
+    if (available < sizeof(header)) {
+        return;
+    }
+    memcpy(&header, inbox->data + inbox->start, sizeof(header));
+    size_t used = sizeof(header) + header.length;
+    if (used > available) {
+        return;
+    }
+    inbox->start += used;
+    if (inbox->start == inbox->length) {
+        inbox->start = inbox->length = 0;
+    }
+}
@@ -0,0 +1,846 @@
+#define _GNU_SOURCE
+
+#include "lterm_sessiond.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "lterm_session.h"
+#include "lterm_session_loop.h"
+#include "lterm_sessiond_proto.h"
+
+// A client that stops reading is dropped rather than buffered forever.
+#define CLIENT_OUTBOX_LIMIT (64u * 1024u * 1024u)
+#define REAP_POLL_MS 100
+
+typedef struct daemon_session {
+    struct daemon_session *next;
+    lterm_sessiond_server *server;
+    uint32_t id;
+    lterm_session *session;
+    // Set from the loop's worker threads.
+    atomic_bool dirty;
+    atomic_bool ended;
+    bool exited;
+    lterm_pty_exit exit;
+    // What clients were last sent; each frame is diffed against it by row.
+    lterm_cell *shadow;
+    bool *changed;
+    size_t rows;
+    size_t cols;
+    lterm_sessiond_state_msg state;
+} daemon_session;
+
+// A PTY master waiting in the outbox; it is passed with the byte at offset,
+// the start of its ATTACHED message.
+typedef struct {
+    size_t offset;
+    int fd;
+} pending_fd;
+
+typedef struct daemon_client {
+    struct daemon_client *next;
+    int fd;
+    bool closing;
+    lterm_sessiond_inbox inbox;
+    lterm_write_queue outbox;
+    pending_fd *passing;
+    size_t passing_count;
+    size_t passing_capacity;
+    uint32_t *attached;
+    size_t attached_count;
+    size_t attached_capacity;
+} daemon_client;
+
+struct lterm_sessiond_server {
+    char *path;
+    int listen_fd;
+    int wake_pipe[2];
+    atomic_bool wake_pending;
+    atomic_bool stopping;
+    lterm_session_loop *loop;
+    daemon_session *sessions;
+    daemon_client *clients;
+    uint32_t next_id;
+};
+
+bool
+lterm_sessiond_default_path(char *path, size_t size)
+{
+    if (!path || size == 0) {
+        return false;
+    }
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    int length = runtime && runtime[0]
+        ? snprintf(path, size, "%s/%s", runtime, LTERM_SESSIOND_SOCKET_NAME)
+        : snprintf(path, size, "/tmp/lterm-sessiond-%u.sock", (unsigned)getuid());
+    return length > 0 && (size_t)length < size;
+}
+
+static void
+wake(lterm_sessiond_server *server)
+{
+    if (!atomic_exchange(&server->wake_pending, true)) {
+        (void)!write(server->wake_pipe[1], "", 1);
+    }
+}
+
+static void
+session_event(lterm_session *session, lterm_session_event event, void *user_data)
+{
+    (void)session;
+    daemon_session *entry = user_data;
+    if (event == LTERM_SESSION_EVENT_FRAME) {
+        atomic_store(&entry->dirty, true);
+    } else if (event == LTERM_SESSION_EVENT_EXIT) {
+        atomic_store(&entry->ended, true);
+    } else if (event != LTERM_SESSION_EVENT_CHILD_EXIT) {
+        return;
+    }
+    wake(entry->server);
+}
+
+// The parser leaves C0 controls to its caller; the daemon has no other
+// consumer, so apply the ones that move the cursor.
+static void
+apply_control(const lterm_token *token, void *user_data)
+{
+    lterm_screen *screen = lterm_session_screen(((daemon_session *)user_data)->session);
+    switch (token->type) {
+    case LTERM_CC_CR:
+        lterm_screen_carriage_return(screen);
+        break;
+    case LTERM_CC_LF:
+    case LTERM_CC_VT:
+    case LTERM_CC_FF:
+        lterm_screen_line_feed(screen);
+        break;
+    case LTERM_CC_BS:
+        lterm_screen_move_cursor(screen, 0, -1);
+        break;
+    case LTERM_CC_HT:
+        lterm_screen_move_cursor(screen, 0, (int)(8 - screen->cursor_col % 8));
+        break;
+    default:
+        break;
+    }
+}
+
+static bool
+is_attached(const daemon_client *client, uint32_t id)
+{
+    for (size_t i = 0; i < client->attached_count; ++i) {
+        if (client->attached[i] == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+detach(daemon_client *client, uint32_t id)
+{
+    for (size_t i = 0; i < client->attached_count; ++i) {
+        if (client->attached[i] == id) {
+            client->attached[i] = client->attached[--client->attached_count];
+            return;
+        }
+    }
+}
+
+static void
+queue(daemon_client *client, uint32_t type, const void *head, size_t head_length, const void *tail,
+      size_t tail_length)
+{
+    if (client->closing) {
+        return;
+    }
+    if (!lterm_sessiond_queue_message(&client->outbox, type, head, head_length, tail, tail_length) ||
+        lterm_write_queue_queued(&client->outbox) > CLIENT_OUTBOX_LIMIT) {
+        client->closing = true;
+    }
+}
+
+static void
+queue_error(daemon_client *client, uint32_t id, uint32_t request)
+{
+    lterm_sessiond_error_msg error = {.id = id, .request = request};
+    queue(client, LTERM_SESSIOND_MSG_ERROR, &error, sizeof(error), NULL, 0);
+}
+
+static void
+queue_rows(daemon_client *client, const daemon_session *entry, size_t first, size_t count)
+{
+    lterm_sessiond_rows_msg rows = {
+        .id = entry->id,
+        .first = (uint32_t)first,
+        .count = (uint32_t)count,
+        .cols = (uint32_t)entry->cols,
+    };
+    queue(client, LTERM_SESSIOND_MSG_ROWS, &rows, sizeof(rows), entry->shadow + first * entry->cols,
+          count * entry->cols * sizeof(lterm_cell));
+}
+
+static void
+queue_exited(daemon_client *client, const daemon_session *entry)
+{
+    lterm_sessiond_exited_msg exited = {
+        .id = entry->id,
+        .exit_code = entry->exit.exited ? entry->exit.exit_code : -1,
+        .signal = entry->exit.exited ? entry->exit.signal : 0,
+    };
+    queue(client, LTERM_SESSIOND_MSG_EXITED, &exited, sizeof(exited), NULL, 0);
+}
+
+// Brings the shadow up to date with the screen and sends the changed rows
+// (coalesced into runs) and state to every attached client.
+static void
+sync_session(lterm_sessiond_server *server, daemon_session *entry)
+{
+    atomic_store(&entry->dirty, false);
+    lterm_session_lock(entry->session);
+    const lterm_screen *screen = lterm_session_screen(entry->session);
+    size_t rows = screen->grid.rows;
+    size_t cols = screen->grid.cols;
+    bool resized = rows != entry->rows || cols != entry->cols;
+    if (resized) {
+        lterm_cell *shadow = calloc(rows * cols, sizeof(*shadow));
+        bool *changed = calloc(rows, sizeof(*changed));
+        if (!shadow || !changed) {
+            free(shadow);
+            free(changed);
+            lterm_session_unlock(entry->session);
+            return;
+        }
+        free(entry->shadow);
+        free(entry->changed);
+        entry->shadow = shadow;
+        entry->changed = changed;
+        entry->rows = rows;
+        entry->cols = cols;
+    }
+    size_t row_bytes = cols * sizeof(lterm_cell);
+    for (size_t r = 0; r < rows; ++r) {
+        const lterm_cell *row = screen->grid.cells + r * cols;
+        lterm_cell *copy = entry->shadow + r * cols;
+        entry->changed[r] = resized || memcmp(row, copy, row_bytes) != 0;
+        if (entry->changed[r]) {
+            memcpy(copy, row, row_bytes);
+        }
+    }
+    lterm_sessiond_state_msg state = {
+        .id = entry->id,
+        .rows = (uint32_t)rows,
+        .cols = (uint32_t)cols,
+        .cursor_row = (uint32_t)screen->cursor_row,
+        .cursor_col = (uint32_t)screen->cursor_col,
+        .modes = screen->modes,
+        .scrollback_lines = cols ? screen->scrollback.length / cols : 0,
+    };
+    lterm_session_unlock(entry->session);
+    lterm_session_frame_done(entry->session);
+
+    bool state_changed = memcmp(&state, &entry->state, sizeof(state)) != 0;
+    entry->state = state;
+    for (daemon_client *client = server->clients; client; client = client->next) {
+        if (!is_attached(client, entry->id)) {
+            continue;
+        }
+        if (state_changed) {
+            queue(client, LTERM_SESSIOND_MSG_STATE, &state, sizeof(state), NULL, 0);
+        }
+        for (size_t r = 0; r < rows;) {
+            if (!entry->changed[r]) {
+                ++r;
+                continue;
+            }
+            size_t end = r;
+            while (end < rows && entry->changed[end]) {
+                ++end;
+            }
+            queue_rows(client, entry, r, end - r);
+            r = end;
+        }
+    }
+}
+
+static void
+finish_session(lterm_sessiond_server *server, daemon_session *entry)
+{
+    sync_session(server, entry);
+    lterm_session_loop_remove(server->loop, entry->session);
+    lterm_session_exit_status(entry->session, &entry->exit);
+    lterm_pty_close(lterm_session_pty(entry->session));
+    entry->exited = true;
+    for (daemon_client *client = server->clients; client; client = client->next) {
+        if (is_attached(client, entry->id)) {
+            queue_exited(client, entry);
+        }
+    }
+}
+
+static void
+free_session(daemon_session *entry)
+{
+    lterm_session_free(entry->session);
+    free(entry->shadow);
+    free(entry->changed);
+    free(entry);
+}
+
+static daemon_session *
+find_session(lterm_sessiond_server *server, uint32_t id)
+{
+    for (daemon_session *entry = server->sessions; entry; entry = entry->next) {
+        if (entry->id == id) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void
+handle_create(lterm_sessiond_server *server, daemon_client *client, const uint8_t *payload, size_t length)
+{
+    lterm_sessiond_create_msg create;
+    if (length < sizeof(create)) {
+        queue_error(client, 0, LTERM_SESSIOND_MSG_CREATE);
+        return;
+    }
+    memcpy(&create, payload, sizeof(create));
+    char *shell = NULL;
+    if (length > sizeof(create)) {
+        shell = strndup((const char *)payload + sizeof(create), length - sizeof(create));
+    }
+    daemon_session *entry = calloc(1, sizeof(*entry));
+    lterm_session *session = lterm_session_new(create.rows ? create.rows : 24, create.cols ? create.cols : 80);
+    bool ok = entry && session;
+    if (ok) {
+        entry->server = server;
+        entry->session = session;
+        entry->id = server->next_id++;
+        atomic_init(&entry->dirty, true);
+        atomic_init(&entry->ended, false);
+        lterm_session_set_event_callback(session, session_event, entry);
+        lterm_session_set_token_callback(session, apply_control, entry);
+        ok = lterm_session_spawn_shell(session, shell) && lterm_session_loop_add(server->loop, session);
+    }
+    free(shell);
+    if (!ok) {
+        lterm_session_free(session);
+        free(entry);
+        queue_error(client, 0, LTERM_SESSIOND_MSG_CREATE);
+        return;
+    }
+    entry->next = server->sessions;
+    server->sessions = entry;
+    lterm_sessiond_id_msg created = {.id = entry->id};
+    queue(client, LTERM_SESSIOND_MSG_CREATED, &created, sizeof(created), NULL, 0);
+}
+
+// ATTACHED carries a duplicate of the master fd, so the reply can wait in
+// the outbox behind earlier updates without blocking the daemon loop.
+static void
+queue_attached(daemon_client *client, const lterm_sessiond_state_msg *state, int master_fd)
+{
+    if (client->closing) {
+        return;
+    }
+    if (master_fd >= 0) {
+        if (client->passing_count == client->passing_capacity) {
+            size_t capacity = client->passing_capacity ? client->passing_capacity * 2 : 4;
+            pending_fd *passing = realloc(client->passing, capacity * sizeof(*passing));
+            if (!passing) {
+                client->closing = true;
+                return;
+            }
+            client->passing = passing;
+            client->passing_capacity = capacity;
+        }
+        int fd = fcntl(master_fd, F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) {
+            client->closing = true;
+            return;
+        }
+        client->passing[client->passing_count++] = (pending_fd){
+            .offset = lterm_write_queue_queued(&client->outbox),
+            .fd = fd,
+        };
+    }
+    queue(client, LTERM_SESSIOND_MSG_ATTACHED, state, sizeof(*state), NULL, 0);
+}
+
+static void
+handle_attach(lterm_sessiond_server *server, daemon_client *client, uint32_t id)
+{
+    daemon_session *entry = find_session(server, id);
+    if (!entry) {
+        queue_error(client, id, LTERM_SESSIOND_MSG_ATTACH);
+        return;
+    }
+    // Bring everyone attached so far up to date so the snapshot and the
+    // updates that follow it start from the same shadow.
+    if (!entry->exited) {
+        sync_session(server, entry);
+    }
+    if (!is_attached(client, id)) {
+        if (client->attached_count == client->attached_capacity) {
+            size_t capacity = client->attached_capacity ? client->attached_capacity * 2 : 4;
+            uint32_t *attached = realloc(client->attached, capacity * sizeof(*attached));
+            if (!attached) {
+                queue_error(client, id, LTERM_SESSIOND_MSG_ATTACH);
+                return;
+            }
+            client->attached = attached;
+            client->attached_capacity = capacity;
+        }
+        client->attached[client->attached_count++] = id;
+    }
+    queue_attached(client, &entry->state, lterm_pty_get_fd(lterm_session_pty(entry->session)));
+    queue_rows(client, entry, 0, entry->rows);
+    if (entry->exited) {
+        queue_exited(client, entry);
+    }
+}
+
+static void
+handle_fetch(lterm_sessiond_server *server, daemon_client *client, const lterm_sessiond_fetch_msg *fetch)
+{
+    daemon_session *entry = find_session(server, fetch->id);
+    if (!entry) {
+        queue_error(client, fetch->id, LTERM_SESSIOND_MSG_FETCH);
+        return;
+    }
+    lterm_session_lock(entry->session);
+    const lterm_screen *screen = lterm_session_screen(entry->session);
+    size_t cols = screen->grid.cols;
+    size_t lines = cols ? screen->scrollback.length / cols : 0;
+    size_t first = fetch->first < lines ? fetch->first : lines;
+    size_t count = fetch->count < lines - first ? fetch->count : lines - first;
+    size_t limit = (LTERM_SESSIOND_MAX_MESSAGE - sizeof(lterm_sessiond_rows_msg)) / (cols * sizeof(lterm_cell));
+    if (count > limit) {
+        count = limit;
+    }
+    lterm_sessiond_rows_msg rows = {
+        .id = fetch->id,
+        .first = (uint32_t)first,
+        .count = (uint32_t)count,
+        .cols = (uint32_t)cols,
+    };
+    queue(client, LTERM_SESSIOND_MSG_SCROLLBACK, &rows, sizeof(rows),
+          count ? screen->scrollback.data + first * cols : NULL, count * cols * sizeof(lterm_cell));
+    lterm_session_unlock(entry->session);
+}
+
+static void
+close_session(lterm_sessiond_server *server, uint32_t id)
+{
+    for (daemon_session **link = &server->sessions; *link; link = &(*link)->next) {
+        daemon_session *entry = *link;
+        if (entry->id != id) {
+            continue;
+        }
+        if (!entry->exited) {
+            finish_session(server, entry);
+        }
+        for (daemon_client *client = server->clients; client; client = client->next) {
+            detach(client, id);
+        }
+        *link = entry->next;
+        free_session(entry);
+        return;
+    }
+}
+
+static void
+handle_message(lterm_sessiond_server *server, daemon_client *client, const lterm_sessiond_header *header,
+               const uint8_t *payload)
+{
+    lterm_sessiond_id_msg target = {0};
+    if (header->length >= sizeof(target)) {
+        memcpy(&target, payload, sizeof(target));
+    }
+    switch (header->type) {
+    case LTERM_SESSIOND_MSG_CREATE:
+        handle_create(server, client, payload, header->length);
+        break;
+    case LTERM_SESSIOND_MSG_LIST: {
+        uint32_t count = 0;
+        for (daemon_session *entry = server->sessions; entry; entry = entry->next) {
+            count++;
+        }
+        uint32_t *ids = calloc(count ? count : 1, sizeof(*ids));
+        if (!ids) {
+            queue_error(client, 0, header->type);
+            break;
+        }
+        uint32_t index = 0;
+        for (daemon_session *entry = server->sessions; entry; entry = entry->next) {
+            ids[index++] = entry->id;
+        }
+        queue(client, LTERM_SESSIOND_MSG_SESSIONS, &count, sizeof(count), ids, count * sizeof(*ids));
+        free(ids);
+        break;
+    }
+    case LTERM_SESSIOND_MSG_ATTACH:
+        handle_attach(server, client, target.id);
+        break;
+    case LTERM_SESSIOND_MSG_DETACH:
+        detach(client, target.id);
+        break;
+    case LTERM_SESSIOND_MSG_RESIZE: {
+        lterm_sessiond_resize_msg resize;
+        daemon_session *entry = NULL;
+        if (header->length >= sizeof(resize)) {
+            memcpy(&resize, payload, sizeof(resize));
+            entry = find_session(server, resize.id);
+        }
+        if (!entry || entry->exited) {
+            queue_error(client, target.id, header->type);
+            break;
+        }
+        lterm_session_resize(entry->session, resize.rows, resize.cols);
+        sync_session(server, entry);
+        break;
+    }
+    case LTERM_SESSIOND_MSG_FETCH: {
+        lterm_sessiond_fetch_msg fetch;
+        if (header->length < sizeof(fetch)) {
+            queue_error(client, target.id, header->type);
+            break;
+        }
+        memcpy(&fetch, payload, sizeof(fetch));
+        handle_fetch(server, client, &fetch);
+        break;
+    }
+    case LTERM_SESSIOND_MSG_CLOSE:
+        close_session(server, target.id);
+        break;
+    default:
+        queue_error(client, target.id, header->type);
+        break;
+    }
+}
+
+static void
+read_client(lterm_sessiond_server *server, daemon_client *client)
+{
+    ssize_t count = lterm_sessiond_inbox_read(&client->inbox, client->fd, NULL);
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        client->closing = true;
+        lterm_write_queue_free(&client->outbox);
+        lterm_write_queue_init(&client->outbox);
+        return;
+    }
+    lterm_sessiond_header header;
+    const uint8_t *payload = NULL;
+    bool error = false;
+    while (!client->closing && lterm_sessiond_inbox_peek(&client->inbox, &header, &payload, &error)) {
+        handle_message(server, client, &header, payload);
+        lterm_sessiond_inbox_pop(&client->inbox);
+    }
+    if (error) {
+        client->closing = true;
+    }
+}
+
+static void
+accept_clients(lterm_sessiond_server *server)
+{
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            return;
+        }
+        struct ucred peer;
+        socklen_t length = sizeof(peer);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != getuid()) {
+            close(fd);
+            continue;
+        }
+        daemon_client *client = calloc(1, sizeof(*client));
+        if (!client) {
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        lterm_write_queue_init(&client->outbox);
+        client->next = server->clients;
+        server->clients = client;
+    }
+}
+
+static void
+free_client(daemon_client *client)
+{
+    close(client->fd);
+    lterm_sessiond_inbox_free(&client->inbox);
+    lterm_write_queue_free(&client->outbox);
+    for (size_t i = 0; i < client->passing_count; ++i) {
+        close(client->passing[i].fd);
+    }
+    free(client->passing);
+    free(client->attached);
+    free(client);
+}
+
+// One sendmsg() of the outbox, like lterm_write_queue_flush(), except that a
+// write never runs past the next pending master fd and that fd goes out with
+// the first byte of its ATTACHED message. Returns false on error.
+static bool
+flush_outbox(daemon_client *client)
+{
+    struct iovec iov[LTERM_WRITE_QUEUE_MAX_IOV];
+    int count = lterm_write_queue_iov(&client->outbox, iov, LTERM_WRITE_QUEUE_MAX_IOV);
+    if (count == 0) {
+        return true;
+    }
+    struct msghdr header = {.msg_iov = iov, .msg_iovlen = (size_t)count};
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    size_t next = 0;
+    if (client->passing_count > 0 && client->passing[0].offset == 0) {
+        memset(&control, 0, sizeof(control));
+        header.msg_control = control.buffer;
+        header.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &client->passing[0].fd, sizeof(int));
+        next = 1;
+    }
+    if (next < client->passing_count) {
+        size_t limit = client->passing[next].offset;
+        int clipped = 0;
+        while (clipped < count && limit > 0) {
+            if (iov[clipped].iov_len > limit) {
+                iov[clipped].iov_len = limit;
+            }
+            limit -= iov[clipped++].iov_len;
+        }
+        header.msg_iovlen = (size_t)clipped;
+    }
+    ssize_t sent;
+    do {
+        sent = sendmsg(client->fd, &header, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (next == 1) {
+        close(client->passing[0].fd);
+        memmove(client->passing, client->passing + 1, --client->passing_count * sizeof(*client->passing));
+    }
+    for (size_t i = 0; i < client->passing_count; ++i) {
+        client->passing[i].offset -= (size_t)sent;
+    }
+    lterm_write_queue_consume(&client->outbox, (size_t)sent);
+    return true;
+}
+
+// Flushes outboxes and drops clients that went away or fell too far behind.
+static void
+service_clients(lterm_sessiond_server *server)
+{
+    for (daemon_client **link = &server->clients; *link;) {
+        daemon_client *client = *link;
+        if (!client->closing && lterm_write_queue_queued(&client->outbox) > 0 && !flush_outbox(client)) {
+            client->closing = true;
+        }
+        if (client->closing) {
+            *link = client->next;
+            free_client(client);
+            continue;
+        }
+        link = &client->next;
+    }
+}
+
+lterm_sessiond_server *
+lterm_sessiond_server_new(const char *socket_path)
+{
+    char default_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (!socket_path) {
+        if (!lterm_sessiond_default_path(default_path, sizeof(default_path))) {
+            return NULL;
+        }
+        socket_path = default_path;
+    }
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        return NULL;
+    }
+    memcpy(address.sun_path, socket_path, strlen(socket_path) + 1);
+
+    lterm_sessiond_server *server = calloc(1, sizeof(*server));
+    if (!server) {
+        return NULL;
+    }
+    server->listen_fd = -1;
+    server->wake_pipe[0] = server->wake_pipe[1] = -1;
+    server->next_id = 1;
+    atomic_init(&server->wake_pending, false);
+    atomic_init(&server->stopping, false);
+    server->path = strdup(socket_path);
+    server->loop = lterm_session_loop_new(1);
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (!server->path || !server->loop || server->listen_fd < 0 ||
+        pipe2(server->wake_pipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+        lterm_sessiond_server_free(server);
+        return NULL;
+    }
+    // Replace a stale socket, but never one a live daemon is serving.
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        close(probe);
+        free(server->path);
+        server->path = NULL;
+        lterm_sessiond_server_free(server);
+        return NULL;
+    }
+    if (probe >= 0) {
+        close(probe);
+    }
+    unlink(socket_path);
+    mode_t mask = umask(077);
+    bool bound = bind(server->listen_fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || listen(server->listen_fd, 16) != 0 || !lterm_session_loop_start(server->loop)) {
+        lterm_sessiond_server_free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void
+lterm_sessiond_server_free(lterm_sessiond_server *server)
+{
+    if (!server) {
+        return;
+    }
+    while (server->clients) {
+        daemon_client *client = server->clients;
+        server->clients = client->next;
+        free_client(client);
+    }
+    while (server->sessions) {
+        daemon_session *entry = server->sessions;
+        server->sessions = entry->next;
+        lterm_session_loop_remove(server->loop, entry->session);
+        free_session(entry);
+    }
+    lterm_session_loop_free(server->loop);
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        if (server->path) {
+            unlink(server->path);
+        }
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (server->wake_pipe[i] >= 0) {
+            close(server->wake_pipe[i]);
+        }
+    }
+    free(server->path);
+    free(server);
+}
+
+void
+lterm_sessiond_server_stop(lterm_sessiond_server *server)
+{
+    if (!server) {
+        return;
+    }
+    atomic_store(&server->stopping, true);
+    (void)!write(server->wake_pipe[1], "", 1);
+}
+
+bool
+lterm_sessiond_server_run(lterm_sessiond_server *server)
+{
+    if (!server) {
+        return false;
+    }
+    struct pollfd *fds = NULL;
+    size_t capacity = 0;
+    int timeout = -1;
+    bool ok = true;
+    while (ok && !atomic_load(&server->stopping)) {
+        size_t count = 2;
+        for (daemon_client *client = server->clients; client; client = client->next) {
+            count++;
+        }
+        if (count > capacity) {
+            struct pollfd *grown = realloc(fds, count * sizeof(*fds));
+            if (!grown) {
+                ok = false;
+                break;
+            }
+            fds = grown;
+            capacity = count;
+        }
+        fds[0] = (struct pollfd){.fd = server->wake_pipe[0], .events = POLLIN};
+        fds[1] = (struct pollfd){.fd = server->listen_fd, .events = POLLIN};
+        size_t index = 2;
+        for (daemon_client *client = server->clients; client; client = client->next) {
+            short events = POLLIN;
+            if (lterm_write_queue_queued(&client->outbox) > 0) {
+                events |= POLLOUT;
+            }
+            fds[index++] = (struct pollfd){.fd = client->fd, .events = events};
+        }
+        if (poll(fds, count, timeout) < 0 && errno != EINTR) {
+            ok = false;
+            break;
+        }
+        if (fds[0].revents) {
+            atomic_store(&server->wake_pending, false);
+            uint8_t scratch[64];
+            while (read(server->wake_pipe[0], scratch, sizeof(scratch)) > 0) {
+            }
+        }
+        // Clients are only added at the head, so the polled ones are still in
+        // the same order after the accept below.
+        index = 2;
+        for (daemon_client *client = server->clients; client && index < count; client = client->next) {
+            if (fds[index++].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_client(server, client);
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_clients(server);
+        }
+        // A hung-up PTY is finished once its child is reaped. Without a pidfd
+        // nothing signals that, so keep checking on a short timeout.
+        timeout = -1;
+        for (daemon_session *entry = server->sessions; entry; entry = entry->next) {
+            if (entry->exited) {
+                continue;
+            }
+            lterm_pty_exit exit_info;
+            if (atomic_load(&entry->ended) && lterm_session_exit_status(entry->session, &exit_info)) {
+                finish_session(server, entry);
+            } else if (atomic_load(&entry->dirty)) {
+                sync_session(server, entry);
+            }
+            if (!entry->exited && atomic_load(&entry->ended)) {
+                timeout = REAP_POLL_MS;
+            }
+        }
+        service_clients(server);
+    }
+    free(fds);
+    return ok;
+}
@@ -0,0 +1,195 @@
+#include "lterm_sgr.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "lterm_screen.h"
+
+#define ALL_FLAGS 0xFFFFu
+
+static void
+set_bits(lterm_sgr_delta *delta, uint16_t bits)
+{
+    delta->set_flags |= bits;
+}
+
+static void
+clear_bits(lterm_sgr_delta *delta, uint16_t bits)
+{
+    delta->set_flags &= (uint16_t)~bits;
+    delta->clear_flags |= bits;
+}
+
+static void
+set_underline(lterm_sgr_delta *delta, int style)
+{
+    clear_bits(delta, LTERM_CELL_UNDERLINE_MASK);
+    switch (style) {
+        case 0:
+            break;
+        case 2:
+            set_bits(delta, LTERM_CELL_FLAG_DOUBLE_UNDERLINE);
+            break;
+        case 3:
+            set_bits(delta, LTERM_CELL_FLAG_CURLY_UNDERLINE);
+            break;
+        default:
+            set_bits(delta, LTERM_CELL_FLAG_UNDERLINE);
+            break;
+    }
+}
+
+static uint8_t
+clamp_component(int value)
+{
+    if (value < 0) {
+        return 0;
+    }
+    return value > 255 ? 255 : (uint8_t)value;
+}
+
+static int
+sub_param_count(const lterm_csi_param *param, int index)
+{
+    int count = 0;
+    while (count < LTERM_CSI_PARAM_MAX && param->sub_params[index][count] != -1) {
+        count++;
+    }
+    return count;
+}
+
+// Decodes the color that follows a 38/48/58 selector. Handles both the
+// "38;5;n" / "38;2;r;g;b" forms and the ITU "38:5:n" / "38:2:[cs]:r:g:b" forms.
+// Returns how many extra top-level parameters were consumed.
+static int
+decode_extended_color(const lterm_csi_param *param, int index, bool *valid, uint32_t *color)
+{
+    *valid = false;
+    int subs = sub_param_count(param, index);
+    if (subs > 0) {
+        const int *sub = param->sub_params[index];
+        if (sub[0] == 5 && subs >= 2) {
+            *color = clamp_component(sub[1]);
+            *valid = true;
+        } else if (sub[0] == 2 && subs >= 4) {
+            int base = subs >= 5 ? 2 : 1;
+            *color = LTERM_COLOR_RGB(clamp_component(sub[base]),
+                                     clamp_component(sub[base + 1]),
+                                     clamp_component(sub[base + 2]));
+            *valid = true;
+        }
+        return 0;
+    }
+    if (index + 1 >= param->count) {
+        return 0;
+    }
+    int mode = param->p[index + 1];
+    if (mode == 5) {
+        if (index + 2 >= param->count) {
+            return param->count - index - 1;
+        }
+        *color = clamp_component(param->p[index + 2]);
+        *valid = true;
+        return 2;
+    }
+    if (mode == 2) {
+        if (index + 4 >= param->count) {
+            return param->count - index - 1;
+        }
+        *color = LTERM_COLOR_RGB(clamp_component(param->p[index + 2]),
+                                 clamp_component(param->p[index + 3]),
+                                 clamp_component(param->p[index + 4]));
+        *valid = true;
+        return 4;
+    }
+    return 1;
+}
+
+void
+lterm_sgr_compile(const lterm_csi_param *param, lterm_sgr_delta *delta)
+{
+    if (!delta) {
+        return;
+    }
+    memset(delta, 0, sizeof(*delta));
+    if (!param || param->count == 0) {
+        clear_bits(delta, ALL_FLAGS);
+        delta->set_fg = delta->set_bg = 1;
+        delta->fg = LTERM_COLOR_DEFAULT_FG;
+        delta->bg = LTERM_COLOR_DEFAULT_BG;
+        return;
+    }
+    for (int i = 0; i < param->count; ++i) {
+        int value = param->p[i];
+        if (value == -1) {
+            value = 0;
+        }
+        switch (value) {
+            case 0:
+                clear_bits(delta, ALL_FLAGS);
+                delta->set_fg = delta->set_bg = 1;
+                delta->fg = LTERM_COLOR_DEFAULT_FG;
+                delta->bg = LTERM_COLOR_DEFAULT_BG;
+                break;
+            case 1: set_bits(delta, LTERM_CELL_FLAG_BOLD); break;
+            case 2: set_bits(delta, LTERM_CELL_FLAG_DIM); break;
+            case 3: set_bits(delta, LTERM_CELL_FLAG_ITALIC); break;
+            case 4: {
+                int style = param->sub_params[i][0];
+                set_underline(delta, style == -1 ? 1 : style);
+                break;
+            }
+            case 5:
+            case 6: set_bits(delta, LTERM_CELL_FLAG_BLINK); break;
+            case 7: set_bits(delta, LTERM_CELL_FLAG_INVERSE); break;
+            case 8: set_bits(delta, LTERM_CELL_FLAG_INVISIBLE); break;
+            case 9: set_bits(delta, LTERM_CELL_FLAG_STRIKETHROUGH); break;
+            case 21: set_underline(delta, 2); break;
+            case 22: clear_bits(delta, LTERM_CELL_FLAG_BOLD | LTERM_CELL_FLAG_DIM); break;
+            case 23: clear_bits(delta, LTERM_CELL_FLAG_ITALIC); break;
+            case 24: clear_bits(delta, LTERM_CELL_UNDERLINE_MASK); break;
+            case 25: clear_bits(delta, LTERM_CELL_FLAG_BLINK); break;
+            case 27: clear_bits(delta, LTERM_CELL_FLAG_INVERSE); break;
+            case 28: clear_bits(delta, LTERM_CELL_FLAG_INVISIBLE); break;
+            case 29: clear_bits(delta, LTERM_CELL_FLAG_STRIKETHROUGH); break;
+            case 38:
+            case 48:
+            case 58: {
+                bool valid = false;
+                uint32_t color = 0;
+                i += decode_extended_color(param, i, &valid, &color);
+                if (valid && value == 38) {
+                    delta->set_fg = 1;
+                    delta->fg = color;
+                } else if (valid && value == 48) {
+                    delta->set_bg = 1;
+                    delta->bg = color;
+                }
+                break;
+            }
+            case 39:
+                delta->set_fg = 1;
+                delta->fg = LTERM_COLOR_DEFAULT_FG;
+                break;
+            case 49:
+                delta->set_bg = 1;
+                delta->bg = LTERM_COLOR_DEFAULT_BG;
+                break;
+            default:
+                if (value >= 30 && value <= 37) {
+                    delta->set_fg = 1;
+                    delta->fg = (uint32_t)(value - 30);
+                } else if (value >= 40 && value <= 47) {
+                    delta->set_bg = 1;
+                    delta->bg = (uint32_t)(value - 40);
+                } else if (value >= 90 && value <= 97) {
+                    delta->set_fg = 1;
+                    delta->fg = (uint32_t)(value - 90 + 8);
+                } else if (value >= 100 && value <= 107) {
+                    delta->set_bg = 1;
+                    delta->bg = (uint32_t)(value - 100 + 8);
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#include "lterm_spsc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool
+lterm_spsc_ring_init(lterm_spsc_ring *ring, size_t capacity)
+{
+    if (!ring) {
+        return false;
+    }
+    size_t size = 64;
+    while (size < capacity) {
+        size *= 2;
+    }
+    ring->data = malloc(size);
+    if (!ring->data) {
+        ring->capacity = 0;
+        ring->mask = 0;
+        return false;
+    }
+    ring->capacity = size;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return true;
+}
+
+void
+lterm_spsc_ring_free(lterm_spsc_ring *ring)
+{
+    if (!ring) {
+        return;
+    }
+    free(ring->data);
+    ring->data = NULL;
+    ring->capacity = 0;
+    ring->mask = 0;
+}
+
+size_t
+lterm_spsc_ring_readable(const lterm_spsc_ring *ring)
+{
+    if (!ring) {
+        return 0;
+    }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return tail - head;
+}
+
+size_t
+lterm_spsc_ring_writable(const lterm_spsc_ring *ring)
+{
+    return ring ? ring->capacity - lterm_spsc_ring_readable(ring) : 0;
+}
+
+uint8_t *
+lterm_spsc_ring_write_span(lterm_spsc_ring *ring, size_t *length)
+{
+    if (!ring || !length || !ring->data) {
+        if (length) {
+            *length = 0;
+        }
+        return NULL;
+    }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t free_bytes = ring->capacity - (tail - head);
+    size_t offset = tail & ring->mask;
+    size_t until_end = ring->capacity - offset;
+    *length = free_bytes < until_end ? free_bytes : until_end;
+    return ring->data + offset;
+}
+
+void
+lterm_spsc_ring_commit(lterm_spsc_ring *ring, size_t count)
+{
+    if (!ring || count == 0) {
+        return;
+    }
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+}
+
+size_t
+lterm_spsc_ring_write(lterm_spsc_ring *ring, const uint8_t *data, size_t length)
+{
+    if (!ring || !data) {
+        return 0;
+    }
+    size_t written = 0;
+    while (written < length) {
+        size_t span = 0;
+        uint8_t *dest = lterm_spsc_ring_write_span(ring, &span);
+        if (span == 0) {
+            break;
+        }
+        size_t chunk = length - written < span ? length - written : span;
+        memcpy(dest, data + written, chunk);
+        lterm_spsc_ring_commit(ring, chunk);
+        written += chunk;
+    }
+    return written;
+}
+
+const uint8_t *
+lterm_spsc_ring_read_span(lterm_spsc_ring *ring, size_t *length)
+{
+    if (!ring || !length || !ring->data) {
+        if (length) {
+            *length = 0;
+        }
+        return NULL;
+    }
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t offset = head & ring->mask;
+    size_t until_end = ring->capacity - offset;
+    size_t available = tail - head;
+    *length = available < until_end ? available : until_end;
+    return ring->data + offset;
+}
+
+void
+lterm_spsc_ring_consume(lterm_spsc_ring *ring, size_t count)
+{
+    if (!ring || count == 0) {
+        return;
+    }
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+}
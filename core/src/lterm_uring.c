@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+
+#include "lterm_uring.h"
+
+#include <stdlib.h>
+
+#ifdef LTERM_HAVE_IO_URING
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int
+uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(SYS_io_uring_setup, entries, params);
+}
+
+static int
+uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int
+uring_register(int fd, unsigned opcode, void *arg, unsigned count)
+{
+    return (int)syscall(SYS_io_uring_register, fd, opcode, arg, count);
+}
+
+static bool
+probe_ops(int fd)
+{
+    const unsigned ops = 256;
+    size_t size = sizeof(struct io_uring_probe) + ops * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe) {
+        return false;
+    }
+    bool ok = uring_register(fd, IORING_REGISTER_PROBE, probe, ops) == 0 &&
+              probe->last_op >= LTERM_IORING_OP_READ_MULTISHOT &&
+              (probe->ops[LTERM_IORING_OP_READ_MULTISHOT].flags & IO_URING_OP_SUPPORTED) &&
+              (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) &&
+              (probe->ops[IORING_OP_POLL_ADD].flags & IO_URING_OP_SUPPORTED) &&
+              (probe->ops[IORING_OP_ASYNC_CANCEL].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return ok;
+}
+
+bool
+lterm_uring_supported(void)
+{
+    const char *env = getenv("LTERM_IO_URING");
+    if (env && env[0] == '0') {
+        return false;
+    }
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = uring_setup(4, &params);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = (params.features & IORING_FEAT_SINGLE_MMAP) && probe_ops(fd);
+    close(fd);
+    return ok;
+}
+
+static bool
+setup_buffers(lterm_uring *ring, unsigned count, unsigned size)
+{
+    size_t ring_bytes = count * sizeof(struct io_uring_buf);
+    void *buf_ring = NULL;
+    if (posix_memalign(&buf_ring, (size_t)sysconf(_SC_PAGESIZE), ring_bytes) != 0) {
+        return false;
+    }
+    memset(buf_ring, 0, ring_bytes);
+    ring->buf_ring = buf_ring;
+    ring->buffers = malloc((size_t)count * size);
+    if (!ring->buffers) {
+        return false;
+    }
+    ring->buf_count = count;
+    ring->buf_size = size;
+    ring->buf_group = 1;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buf_ring;
+    reg.ring_entries = count;
+    reg.bgid = ring->buf_group;
+    if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        return false;
+    }
+    for (unsigned i = 0; i < count; ++i) {
+        struct io_uring_buf *buf = &ring->buf_ring->bufs[i];
+        buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)i * size);
+        buf->len = size;
+        buf->bid = (uint16_t)i;
+    }
+    atomic_store_explicit((_Atomic uint16_t *)&ring->buf_ring->tail, (uint16_t)count, memory_order_release);
+    return true;
+}
+
+bool
+lterm_uring_init(lterm_uring *ring, unsigned entries, unsigned buf_count, unsigned buf_size)
+{
+    if (!ring || (buf_count & (buf_count - 1)) != 0) {
+        return false;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 16;
+    int fd = uring_setup(entries, &params);
+    if (fd < 0) {
+        return false;
+    }
+    ring->fd = fd;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        lterm_uring_free(ring);
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sq_ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        lterm_uring_free(ring);
+        return false;
+    }
+    ring->cq_ring = ring->sq_ring;
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        lterm_uring_free(ring);
+        return false;
+    }
+
+    uint8_t *sq = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_flags = (unsigned *)(sq + params.sq_off.flags);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    uint8_t *cq = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    if (!probe_ops(fd) || !setup_buffers(ring, buf_count, buf_size)) {
+        lterm_uring_free(ring);
+        return false;
+    }
+    return true;
+}
+
+void
+lterm_uring_free(lterm_uring *ring)
+{
+    if (!ring) {
+        return;
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring->buf_ring);
+    free(ring->buffers);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+struct io_uring_sqe *
+lterm_uring_get_sqe(lterm_uring *ring)
+{
+    unsigned head = atomic_load_explicit((_Atomic unsigned *)ring->sq_head, memory_order_acquire);
+    unsigned tail = *ring->sq_tail;
+    if (tail - head >= ring->sq_entries) {
+        if (lterm_uring_submit(ring) < 0) {
+            return NULL;
+        }
+        head = atomic_load_explicit((_Atomic unsigned *)ring->sq_head, memory_order_acquire);
+        if (tail - head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+    unsigned index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    atomic_store_explicit((_Atomic unsigned *)ring->sq_tail, tail + 1, memory_order_release);
+    ring->to_submit++;
+    return sqe;
+}
+
+int
+lterm_uring_submit(lterm_uring *ring)
+{
+    if (!ring || ring->to_submit == 0) {
+        return 0;
+    }
+    int submitted;
+    do {
+        submitted = uring_enter(ring->fd, ring->to_submit, 0, 0);
+    } while (submitted < 0 && errno == EINTR);
+    ring->enters++;
+    if (submitted < 0) {
+        return -1;
+    }
+    ring->to_submit -= (unsigned)submitted;
+    return submitted;
+}
+
+int
+lterm_uring_wait(lterm_uring *ring)
+{
+    int result;
+    do {
+        result = uring_enter(ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS);
+    } while (result < 0 && errno == EINTR);
+    ring->enters++;
+    if (result > 0) {
+        ring->to_submit -= (unsigned)result;
+    }
+    return result < 0 ? -1 : 0;
+}
+
+void
+lterm_uring_prep_read_multishot(struct io_uring_sqe *sqe, int fd, uint16_t buf_group, uint64_t user_data)
+{
+    sqe->opcode = LTERM_IORING_OP_READ_MULTISHOT;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buf_group;
+    sqe->user_data = user_data;
+}
+
+void
+lterm_uring_prep_write(struct io_uring_sqe *sqe, int fd, const void *data, size_t length, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = (uint32_t)length;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = user_data;
+}
+
+void
+lterm_uring_prep_writev(struct io_uring_sqe *sqe, int fd, const struct iovec *iov, unsigned count, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = count;
+    sqe->off = (uint64_t)-1;
+    sqe->user_data = user_data;
+}
+
+void
+lterm_uring_prep_poll(struct io_uring_sqe *sqe, int fd, unsigned events, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void
+lterm_uring_prep_cancel(struct io_uring_sqe *sqe, uint64_t target, uint64_t user_data)
+{
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+struct io_uring_cqe *
+lterm_uring_peek_cqe(lterm_uring *ring)
+{
+    unsigned head = *ring->cq_head;
+    unsigned tail = atomic_load_explicit((_Atomic unsigned *)ring->cq_tail, memory_order_acquire);
+    if (head == tail && (atomic_load_explicit((_Atomic unsigned *)ring->sq_flags, memory_order_relaxed) &
+                         IORING_SQ_CQ_OVERFLOW)) {
+        // Completions the kernel had to hold back are flushed by entering.
+        uring_enter(ring->fd, 0, 0, IORING_ENTER_GETEVENTS);
+        ring->enters++;
+        tail = atomic_load_explicit((_Atomic unsigned *)ring->cq_tail, memory_order_acquire);
+    }
+    return head == tail ? NULL : &ring->cqes[head & ring->cq_mask];
+}
+
+void
+lterm_uring_cqe_seen(lterm_uring *ring)
+{
+    unsigned head = *ring->cq_head;
+    atomic_store_explicit((_Atomic unsigned *)ring->cq_head, head + 1, memory_order_release);
+}
+
+const uint8_t *
+lterm_uring_buffer(const lterm_uring *ring, uint16_t bid)
+{
+    return ring->buffers + (size_t)bid * ring->buf_size;
+}
+
+void
+lterm_uring_recycle_buffer(lterm_uring *ring, uint16_t bid)
+{
+    uint16_t tail = ring->buf_ring->tail;
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[tail & (ring->buf_count - 1)];
+    buf->addr = (uint64_t)(uintptr_t)lterm_uring_buffer(ring, bid);
+    buf->len = ring->buf_size;
+    buf->bid = bid;
+    atomic_store_explicit((_Atomic uint16_t *)&ring->buf_ring->tail, (uint16_t)(tail + 1), memory_order_release);
+}
+
+#else
+
+bool
+lterm_uring_supported(void)
+{
+    return false;
+}
+
+#endif
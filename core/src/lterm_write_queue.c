@@ -0,0 +1,225 @@
+#include "lterm_write_queue.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+lterm_shared_buffer *
+lterm_shared_buffer_new(const uint8_t *data, size_t length)
+{
+    if (!data && length) {
+        return NULL;
+    }
+    lterm_shared_buffer *buffer = malloc(sizeof(*buffer) + length);
+    if (!buffer) {
+        return NULL;
+    }
+    atomic_init(&buffer->refs, 1);
+    buffer->length = length;
+    if (length) {
+        memcpy(buffer->data, data, length);
+    }
+    return buffer;
+}
+
+lterm_shared_buffer *
+lterm_shared_buffer_ref(lterm_shared_buffer *buffer)
+{
+    if (buffer) {
+        atomic_fetch_add_explicit(&buffer->refs, 1, memory_order_relaxed);
+    }
+    return buffer;
+}
+
+void
+lterm_shared_buffer_unref(lterm_shared_buffer *buffer)
+{
+    if (buffer && atomic_fetch_sub_explicit(&buffer->refs, 1, memory_order_acq_rel) == 1) {
+        free(buffer);
+    }
+}
+
+static void
+free_chunk(lterm_write_chunk *chunk)
+{
+    lterm_shared_buffer_unref(chunk->shared);
+    free(chunk);
+}
+
+static void
+link_chunk(lterm_write_queue *queue, lterm_write_chunk *chunk)
+{
+    if (queue->tail) {
+        queue->tail->next = chunk;
+    } else {
+        queue->head = chunk;
+    }
+    queue->tail = chunk;
+}
+
+void
+lterm_write_queue_init(lterm_write_queue *queue)
+{
+    if (!queue) {
+        return;
+    }
+    memset(queue, 0, sizeof(*queue));
+}
+
+void
+lterm_write_queue_free(lterm_write_queue *queue)
+{
+    if (!queue) {
+        return;
+    }
+    while (queue->head) {
+        lterm_write_chunk *next = queue->head->next;
+        free_chunk(queue->head);
+        queue->head = next;
+    }
+    memset(queue, 0, sizeof(*queue));
+}
+
+bool
+lterm_write_queue_append(lterm_write_queue *queue, const uint8_t *data, size_t length)
+{
+    if (!queue || (!data && length)) {
+        return false;
+    }
+    lterm_write_chunk *tail = queue->tail;
+    size_t room = tail ? tail->capacity - tail->length : 0;
+    size_t rest = length > room ? length - room : 0;
+    lterm_write_chunk *chunk = NULL;
+    if (rest) {
+        size_t capacity = rest > LTERM_WRITE_QUEUE_CHUNK ? rest : LTERM_WRITE_QUEUE_CHUNK;
+        chunk = malloc(sizeof(*chunk) + capacity);
+        if (!chunk) {
+            return false;
+        }
+        chunk->next = NULL;
+        chunk->length = 0;
+        chunk->capacity = capacity;
+        chunk->bytes = chunk->data;
+        chunk->shared = NULL;
+    }
+    size_t head = length - rest;
+    if (head) {
+        memcpy(tail->bytes + tail->length, data, head);
+        tail->length += head;
+    }
+    if (chunk) {
+        memcpy(chunk->data, data + head, rest);
+        chunk->length = rest;
+        link_chunk(queue, chunk);
+    }
+    queue->queued += length;
+    return true;
+}
+
+bool
+lterm_write_queue_append_shared(lterm_write_queue *queue, lterm_shared_buffer *buffer, size_t offset)
+{
+    if (!queue || !buffer || offset > buffer->length) {
+        return false;
+    }
+    size_t length = buffer->length - offset;
+    if (!length) {
+        return true;
+    }
+    lterm_write_chunk *chunk = malloc(sizeof(*chunk));
+    if (!chunk) {
+        return false;
+    }
+    // No spare capacity, so later small appends start a chunk of their own.
+    chunk->next = NULL;
+    chunk->length = length;
+    chunk->capacity = length;
+    chunk->bytes = buffer->data + offset;
+    chunk->shared = lterm_shared_buffer_ref(buffer);
+    if (queue->tail && queue->tail->length == 0 && !queue->tail->next) {
+        // Drop the empty chunk kept around for reuse.
+        free_chunk(queue->tail);
+        queue->head = queue->tail = NULL;
+        queue->head_offset = 0;
+    }
+    link_chunk(queue, chunk);
+    queue->queued += length;
+    return true;
+}
+
+size_t
+lterm_write_queue_queued(const lterm_write_queue *queue)
+{
+    return queue ? queue->queued : 0;
+}
+
+int
+lterm_write_queue_iov(const lterm_write_queue *queue, struct iovec *iov, int max)
+{
+    if (!queue || !iov) {
+        return 0;
+    }
+    int count = 0;
+    size_t offset = queue->head_offset;
+    for (const lterm_write_chunk *chunk = queue->head; chunk && count < max; chunk = chunk->next) {
+        if (chunk->length > offset) {
+            iov[count].iov_base = (void *)(chunk->bytes + offset);
+            iov[count].iov_len = chunk->length - offset;
+            count++;
+        }
+        offset = 0;
+    }
+    return count;
+}
+
+void
+lterm_write_queue_consume(lterm_write_queue *queue, size_t length)
+{
+    if (!queue) {
+        return;
+    }
+    if (length > queue->queued) {
+        length = queue->queued;
+    }
+    queue->queued -= length;
+    while (queue->head) {
+        lterm_write_chunk *chunk = queue->head;
+        size_t available = chunk->length - queue->head_offset;
+        if (length < available) {
+            queue->head_offset += length;
+            break;
+        }
+        length -= available;
+        // Keep the last copied chunk so later small appends reuse its memory.
+        if (!chunk->next && !chunk->shared) {
+            chunk->length = 0;
+            queue->head_offset = 0;
+            break;
+        }
+        queue->head = chunk->next;
+        queue->head_offset = 0;
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+        free_chunk(chunk);
+    }
+}
+
+ssize_t
+lterm_write_queue_flush(lterm_write_queue *queue, int fd)
+{
+    struct iovec iov[LTERM_WRITE_QUEUE_MAX_IOV];
+    int count = lterm_write_queue_iov(queue, iov, LTERM_WRITE_QUEUE_MAX_IOV);
+    if (count == 0) {
+        return 0;
+    }
+    ssize_t written;
+    do {
+        written = writev(fd, iov, count);
+    } while (written < 0 && errno == EINTR);
+    if (written < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    lterm_write_queue_consume(queue, (size_t)written);
+    return written;
+}
@@ -0,0 +1,482 @@
+#include "lterm_csi_dispatch.h"
+
+#include <string.h>
+
+typedef enum {
+    CSI_SLOT_NONE = 0,
+    CSI_SLOT_CUU,
+    CSI_SLOT_CUD,
+    CSI_SLOT_CUF,
+    CSI_SLOT_CUB,
+    CSI_SLOT_CNL,
+    CSI_SLOT_CPL,
+    CSI_SLOT_CUP,
+    CSI_SLOT_HVP,
+    CSI_SLOT_ED,
+    CSI_SLOT_EL,
+    CSI_SLOT_SGR,
+    CSI_SLOT_ICH,
+    CSI_SLOT_CHT,
+    CSI_SLOT_INSLN,
+    CSI_SLOT_DELLN,
+    CSI_SLOT_DELCH,
+    CSI_SLOT_SU,
+    CSI_SLOT_SD,
+    CSI_SLOT_HPR,
+    CSI_SLOT_DA,
+    CSI_SLOT_DA2,
+    CSI_SLOT_DA3,
+    CSI_SLOT_TBC,
+    CSI_SLOT_SM,
+    CSI_SLOT_RM,
+    CSI_SLOT_DECSET,
+    CSI_SLOT_DECRST,
+    CSI_SLOT_DSR,
+    CSI_SLOT_DECDSR,
+    CSI_SLOT_DECSTBM,
+    CSI_SLOT_DECSCUSR,
+    CSI_SLOT_DECSTR,
+    CSI_SLOT_DECSED,
+    CSI_SLOT_DECSEL,
+    CSI_SLOT_DECRQM_ANSI,
+    CSI_SLOT_DECRQM_DEC,
+    CSI_SLOT_DECSCA,
+    CSI_SLOT_DECSCL,
+    CSI_SLOT_DECCARA,
+    CSI_SLOT_DECRARA,
+    CSI_SLOT_DECCRA,
+    CSI_SLOT_DECFRA,
+    CSI_SLOT_DECERA,
+    CSI_SLOT_DECSERA,
+    CSI_SLOT_DECSACE,
+    CSI_SLOT_DECIC,
+    CSI_SLOT_DECDC,
+    CSI_SLOT_DECST8C,
+    CSI_SLOT_SL,
+    CSI_SLOT_SR,
+    CSI_SLOT_SET_MODIFIERS,
+    CSI_SLOT_RESET_MODIFIERS,
+    CSI_SLOT_PUSH_SGR,
+    CSI_SLOT_POP_SGR,
+    CSI_SLOT_SET_KEY_REPORT_MODE,
+    CSI_SLOT_PUSH_KEY_REPORT_MODE,
+    CSI_SLOT_POP_KEY_REPORT_MODE,
+    CSI_SLOT_QUERY_KEY_REPORT_MODE,
+    CSI_SLOT_COUNT
+} csi_slot;
+
+typedef struct {
+    lterm_token_type type;
+    lterm_csi_handler handler;
+} csi_entry;
+
+static int csi_param_value(const lterm_csi_param *param, int index, int fallback)
+{
+    if (!param || index < 0 || index >= param->count) {
+        return fallback;
+    }
+    int value = param->p[index];
+    return value == -1 ? fallback : value;
+}
+
+static bool
+handle_cuu(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_move_cursor(screen, -csi_param_value(param, 0, 1), 0);
+    return true;
+}
+
+static bool
+handle_cud(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_move_cursor(screen, csi_param_value(param, 0, 1), 0);
+    return true;
+}
+
+static bool
+handle_cuf(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_move_cursor(screen, 0, csi_param_value(param, 0, 1));
+    return true;
+}
+
+static bool
+handle_cub(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_move_cursor(screen, 0, -csi_param_value(param, 0, 1));
+    return true;
+}
+
+static bool
+handle_cnl(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_move_cursor(screen, csi_param_value(param, 0, 1), 0);
+    lterm_screen_carriage_return(screen);
+    return true;
+}
+
+static bool
+handle_cpl(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_move_cursor(screen, -csi_param_value(param, 0, 1), 0);
+    lterm_screen_carriage_return(screen);
+    return true;
+}
+
+static bool
+handle_cup(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    int row = csi_param_value(param, 0, 1);
+    int col = csi_param_value(param, 1, 1);
+    size_t target_row = row > 0 ? (size_t)(row - 1) : 0;
+    size_t target_col = col > 0 ? (size_t)(col - 1) : 0;
+    lterm_screen_set_cursor(screen, target_row, target_col);
+    return true;
+}
+
+static bool
+handle_ed(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_clear_screen(screen, csi_param_value(param, 0, 0));
+    return true;
+}
+
+static bool
+handle_el(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_clear_line(screen, csi_param_value(param, 0, 0));
+    return true;
+}
+
+static bool
+handle_sgr(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    if (!screen) {
+        return false;
+    }
+    lterm_screen_apply_sgr(screen, param);
+    return true;
+}
+
+// Modes the screen does not track leave the sequence unhandled so it still
+// reaches the token callback.
+static bool
+set_dec_modes(lterm_screen *screen, const lterm_csi_param *param, bool enabled)
+{
+    if (!screen) {
+        return false;
+    }
+    bool handled = param->count > 0;
+    for (int i = 0; i < param->count; ++i) {
+        if (!lterm_screen_set_dec_mode(screen, csi_param_value(param, i, 0), enabled)) {
+            handled = false;
+        }
+    }
+    return handled;
+}
+
+static bool
+handle_decset(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    return set_dec_modes(screen, param, true);
+}
+
+static bool
+handle_decrst(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)user_data;
+    return set_dec_modes(screen, param, false);
+}
+
+static const csi_entry kSlotEntries[CSI_SLOT_COUNT] = {
+    [CSI_SLOT_NONE] = { LTERM_TOKEN_CSI, NULL },
+    [CSI_SLOT_CUU] = { LTERM_TOKEN_CSI_CUU, handle_cuu },
+    [CSI_SLOT_CUD] = { LTERM_TOKEN_CSI_CUD, handle_cud },
+    [CSI_SLOT_CUF] = { LTERM_TOKEN_CSI_CUF, handle_cuf },
+    [CSI_SLOT_CUB] = { LTERM_TOKEN_CSI_CUB, handle_cub },
+    [CSI_SLOT_CNL] = { LTERM_TOKEN_CSI_CNL, handle_cnl },
+    [CSI_SLOT_CPL] = { LTERM_TOKEN_CSI_CPL, handle_cpl },
+    [CSI_SLOT_CUP] = { LTERM_TOKEN_CSI_CUP, handle_cup },
+    [CSI_SLOT_HVP] = { LTERM_TOKEN_CSI_HVP, handle_cup },
+    [CSI_SLOT_ED] = { LTERM_TOKEN_CSI_ED, handle_ed },
+    [CSI_SLOT_EL] = { LTERM_TOKEN_CSI_EL, handle_el },
+    [CSI_SLOT_SGR] = { LTERM_TOKEN_CSI_SGR, handle_sgr },
+    [CSI_SLOT_ICH] = { LTERM_TOKEN_CSI_ICH, NULL },
+    [CSI_SLOT_CHT] = { LTERM_TOKEN_CSI_CHT, NULL },
+    [CSI_SLOT_INSLN] = { LTERM_TOKEN_XTERM_INSLN, NULL },
+    [CSI_SLOT_DELLN] = { LTERM_TOKEN_XTERM_DELLN, NULL },
+    [CSI_SLOT_DELCH] = { LTERM_TOKEN_XTERM_DELCH, NULL },
+    [CSI_SLOT_SU] = { LTERM_TOKEN_CSI_SU, NULL },
+    [CSI_SLOT_SD] = { LTERM_TOKEN_CSI_SD, NULL },
+    [CSI_SLOT_HPR] = { LTERM_TOKEN_CSI_HPR, NULL },
+    [CSI_SLOT_DA] = { LTERM_TOKEN_CSI_DA, NULL },
+    [CSI_SLOT_DA2] = { LTERM_TOKEN_CSI_DA2, NULL },
+    [CSI_SLOT_DA3] = { LTERM_TOKEN_CSI_DA3, NULL },
+    [CSI_SLOT_TBC] = { LTERM_TOKEN_CSI_TBC, NULL },
+    [CSI_SLOT_SM] = { LTERM_TOKEN_CSI_SM, NULL },
+    [CSI_SLOT_RM] = { LTERM_TOKEN_CSI_RM, NULL },
+    [CSI_SLOT_DECSET] = { LTERM_TOKEN_CSI_DECSET, handle_decset },
+    [CSI_SLOT_DECRST] = { LTERM_TOKEN_CSI_DECRST, handle_decrst },
+    [CSI_SLOT_DSR] = { LTERM_TOKEN_CSI_DSR, NULL },
+    [CSI_SLOT_DECDSR] = { LTERM_TOKEN_CSI_DECDSR, NULL },
+    [CSI_SLOT_DECSTBM] = { LTERM_TOKEN_CSI_DECSTBM, NULL },
+    [CSI_SLOT_DECSCUSR] = { LTERM_TOKEN_CSI_DECSCUSR, NULL },
+    [CSI_SLOT_DECSTR] = { LTERM_TOKEN_CSI_DECSTR, NULL },
+    [CSI_SLOT_DECSED] = { LTERM_TOKEN_CSI_DECSED, NULL },
+    [CSI_SLOT_DECSEL] = { LTERM_TOKEN_CSI_DECSEL, NULL },
+    [CSI_SLOT_DECRQM_ANSI] = { LTERM_TOKEN_CSI_DECRQM_ANSI, NULL },
+    [CSI_SLOT_DECRQM_DEC] = { LTERM_TOKEN_CSI_DECRQM_DEC, NULL },
+    [CSI_SLOT_DECSCA] = { LTERM_TOKEN_CSI_DECSCA, NULL },
+    [CSI_SLOT_DECSCL] = { LTERM_TOKEN_CSI_DECSCL, NULL },
+    [CSI_SLOT_DECCARA] = { LTERM_TOKEN_CSI_DECCARA, NULL },
+    [CSI_SLOT_DECRARA] = { LTERM_TOKEN_CSI_DECRARA, NULL },
+    [CSI_SLOT_DECCRA] = { LTERM_TOKEN_CSI_DECCRA, NULL },
+    [CSI_SLOT_DECFRA] = { LTERM_TOKEN_CSI_DECFRA, NULL },
+    [CSI_SLOT_DECERA] = { LTERM_TOKEN_CSI_DECERA, NULL },
+    [CSI_SLOT_DECSERA] = { LTERM_TOKEN_CSI_DECSERA, NULL },
+    [CSI_SLOT_DECSACE] = { LTERM_TOKEN_CSI_DECSACE, NULL },
+    [CSI_SLOT_DECIC] = { LTERM_TOKEN_CSI_DECIC, NULL },
+    [CSI_SLOT_DECDC] = { LTERM_TOKEN_CSI_DECDC, NULL },
+    [CSI_SLOT_DECST8C] = { LTERM_TOKEN_CSI_DECST8C, NULL },
+    [CSI_SLOT_SL] = { LTERM_TOKEN_CSI_SL, NULL },
+    [CSI_SLOT_SR] = { LTERM_TOKEN_CSI_SR, NULL },
+    [CSI_SLOT_SET_MODIFIERS] = { LTERM_TOKEN_CSI_SET_MODIFIERS, NULL },
+    [CSI_SLOT_RESET_MODIFIERS] = { LTERM_TOKEN_CSI_RESET_MODIFIERS, NULL },
+    [CSI_SLOT_PUSH_SGR] = { LTERM_TOKEN_XTERM_PUSH_SGR, NULL },
+    [CSI_SLOT_POP_SGR] = { LTERM_TOKEN_XTERM_POP_SGR, NULL },
+    [CSI_SLOT_SET_KEY_REPORT_MODE] = { LTERM_TOKEN_CSI_SET_KEY_REPORT_MODE, NULL },
+    [CSI_SLOT_PUSH_KEY_REPORT_MODE] = { LTERM_TOKEN_CSI_PUSH_KEY_REPORT_MODE, NULL },
+    [CSI_SLOT_POP_KEY_REPORT_MODE] = { LTERM_TOKEN_CSI_POP_KEY_REPORT_MODE, NULL },
+    [CSI_SLOT_QUERY_KEY_REPORT_MODE] = { LTERM_TOKEN_CSI_QUERY_KEY_REPORT_MODE, NULL },
+};
+
+#define SLOT(prefix, intermediate, final, slot) \
+    [LTERM_CSI_DISPATCH_INDEX(prefix, intermediate, final)] = (slot)
+
+// Resolved entirely at compile time; unlisted commands stay CSI_SLOT_NONE.
+static const uint8_t kDispatchIndex[LTERM_CSI_DISPATCH_SIZE] = {
+    SLOT(0, 0, 'A', CSI_SLOT_CUU),
+    SLOT(0, 0, 'B', CSI_SLOT_CUD),
+    SLOT(0, 0, 'C', CSI_SLOT_CUF),
+    SLOT(0, 0, 'D', CSI_SLOT_CUB),
+    SLOT(0, 0, 'E', CSI_SLOT_CNL),
+    SLOT(0, 0, 'F', CSI_SLOT_CPL),
+    SLOT(0, 0, 'H', CSI_SLOT_CUP),
+    SLOT(0, 0, 'f', CSI_SLOT_HVP),
+    SLOT(0, 0, 'J', CSI_SLOT_ED),
+    SLOT(0, 0, 'K', CSI_SLOT_EL),
+    SLOT(0, 0, 'm', CSI_SLOT_SGR),
+    SLOT(0, 0, '@', CSI_SLOT_ICH),
+    SLOT(0, 0, 'I', CSI_SLOT_CHT),
+    SLOT(0, 0, 'L', CSI_SLOT_INSLN),
+    SLOT(0, 0, 'M', CSI_SLOT_DELLN),
+    SLOT(0, 0, 'P', CSI_SLOT_DELCH),
+    SLOT(0, 0, 'S', CSI_SLOT_SU),
+    SLOT(0, 0, 'T', CSI_SLOT_SD),
+    SLOT(0, 0, 'a', CSI_SLOT_HPR),
+    SLOT(0, 0, 'c', CSI_SLOT_DA),
+    SLOT('>', 0, 'c', CSI_SLOT_DA2),
+    SLOT('=', 0, 'c', CSI_SLOT_DA3),
+    SLOT(0, 0, 'g', CSI_SLOT_TBC),
+    SLOT(0, 0, 'h', CSI_SLOT_SM),
+    SLOT(0, 0, 'l', CSI_SLOT_RM),
+    SLOT('?', 0, 'h', CSI_SLOT_DECSET),
+    SLOT('?', 0, 'l', CSI_SLOT_DECRST),
+    SLOT(0, 0, 'n', CSI_SLOT_DSR),
+    SLOT('?', 0, 'n', CSI_SLOT_DECDSR),
+    SLOT(0, 0, 'r', CSI_SLOT_DECSTBM),
+    SLOT(0, ' ', 'q', CSI_SLOT_DECSCUSR),
+    SLOT(0, '!', 'p', CSI_SLOT_DECSTR),
+    SLOT('?', 0, 'J', CSI_SLOT_DECSED),
+    SLOT('?', 0, 'K', CSI_SLOT_DECSEL),
+    SLOT(0, '$', 'p', CSI_SLOT_DECRQM_ANSI),
+    SLOT('?', '$', 'p', CSI_SLOT_DECRQM_DEC),
+    SLOT(0, '"', 'q', CSI_SLOT_DECSCA),
+    SLOT(0, '"', 'p', CSI_SLOT_DECSCL),
+    SLOT(0, '$', 'r', CSI_SLOT_DECCARA),
+    SLOT(0, '$', 't', CSI_SLOT_DECRARA),
+    SLOT(0, '$', 'v', CSI_SLOT_DECCRA),
+    SLOT(0, '$', 'x', CSI_SLOT_DECFRA),
+    SLOT(0, '$', 'z', CSI_SLOT_DECERA),
+    SLOT(0, '$', '{', CSI_SLOT_DECSERA),
+    SLOT(0, '*', 'x', CSI_SLOT_DECSACE),
+    SLOT(0, '\'', '}', CSI_SLOT_DECIC),
+    SLOT(0, '\'', '~', CSI_SLOT_DECDC),
+    SLOT('?', 0, 'W', CSI_SLOT_DECST8C),
+    SLOT(0, ' ', '@', CSI_SLOT_SL),
+    SLOT(0, ' ', 'A', CSI_SLOT_SR),
+    SLOT('>', 0, 'm', CSI_SLOT_SET_MODIFIERS),
+    SLOT('>', 0, 'n', CSI_SLOT_RESET_MODIFIERS),
+    SLOT(0, '#', '{', CSI_SLOT_PUSH_SGR),
+    SLOT(0, '#', '}', CSI_SLOT_POP_SGR),
+    SLOT('=', 0, 'u', CSI_SLOT_SET_KEY_REPORT_MODE),
+    SLOT('>', 0, 'u', CSI_SLOT_PUSH_KEY_REPORT_MODE),
+    SLOT('<', 0, 'u', CSI_SLOT_POP_KEY_REPORT_MODE),
+    SLOT('?', 0, 'u', CSI_SLOT_QUERY_KEY_REPORT_MODE),
+};
+
+#undef SLOT
+
+int
+lterm_csi_dispatch_index(int32_t packed)
+{
+    int prefix = lterm_csi_prefix_byte(packed);
+    int intermediate = lterm_csi_intermediate_byte(packed);
+    int final = lterm_csi_final_byte(packed);
+    if (prefix && (prefix < '<' || prefix > '?')) {
+        return -1;
+    }
+    if (intermediate && (intermediate < 0x20 || intermediate > 0x2F)) {
+        return -1;
+    }
+    if (final < 0x40 || final > 0x7E) {
+        return -1;
+    }
+    return LTERM_CSI_DISPATCH_INDEX(prefix, intermediate, final);
+}
+
+lterm_token_type
+lterm_csi_dispatch_token_type(int32_t packed)
+{
+    int index = lterm_csi_dispatch_index(packed);
+    if (index < 0) {
+        return LTERM_TOKEN_CSI;
+    }
+    return kSlotEntries[kDispatchIndex[index]].type;
+}
+
+void
+lterm_csi_dispatch_init(lterm_csi_dispatch *dispatch)
+{
+    if (!dispatch) {
+        return;
+    }
+    memset(dispatch, 0, sizeof(*dispatch));
+}
+
+void
+lterm_csi_dispatch_reset(lterm_csi_dispatch *dispatch)
+{
+    lterm_csi_dispatch_init(dispatch);
+}
+
+static bool
+has_override(const lterm_csi_dispatch *dispatch, int index)
+{
+    return (dispatch->override_bits[index >> 3] >> (index & 7)) & 1;
+}
+
+static lterm_csi_override *
+find_override(const lterm_csi_dispatch *dispatch, int index)
+{
+    for (size_t i = 0; i < dispatch->override_count; ++i) {
+        if (dispatch->overrides[i].index == index) {
+            return (lterm_csi_override *)&dispatch->overrides[i];
+        }
+    }
+    return NULL;
+}
+
+bool
+lterm_csi_dispatch_set_handler(lterm_csi_dispatch *dispatch,
+                               int32_t packed,
+                               lterm_csi_handler handler,
+                               void *user_data)
+{
+    if (!dispatch) {
+        return false;
+    }
+    int index = lterm_csi_dispatch_index(packed);
+    if (index < 0) {
+        return false;
+    }
+    lterm_csi_override *existing = has_override(dispatch, index) ? find_override(dispatch, index) : NULL;
+    if (!handler) {
+        if (existing) {
+            *existing = dispatch->overrides[--dispatch->override_count];
+            dispatch->override_bits[index >> 3] &= (uint8_t)~(1u << (index & 7));
+        }
+        return true;
+    }
+    if (!existing) {
+        if (dispatch->override_count == LTERM_CSI_OVERRIDE_MAX) {
+            return false;
+        }
+        existing = &dispatch->overrides[dispatch->override_count++];
+        existing->index = (uint16_t)index;
+        dispatch->override_bits[index >> 3] |= (uint8_t)(1u << (index & 7));
+    }
+    existing->handler = handler;
+    existing->user_data = user_data;
+    return true;
+}
+
+bool
+lterm_csi_dispatch_has_override(const lterm_csi_dispatch *dispatch, int32_t packed)
+{
+    if (!dispatch || dispatch->override_count == 0) {
+        return false;
+    }
+    int index = lterm_csi_dispatch_index(packed);
+    return index >= 0 && has_override(dispatch, index);
+}
+
+bool
+lterm_csi_dispatch_apply(const lterm_csi_dispatch *dispatch,
+                         lterm_screen *screen,
+                         const lterm_csi_param *param)
+{
+    if (!param) {
+        return false;
+    }
+    int index = lterm_csi_dispatch_index(param->cmd);
+    if (index < 0) {
+        return false;
+    }
+    if (dispatch && has_override(dispatch, index)) {
+        const lterm_csi_override *override = find_override(dispatch, index);
+        if (override) {
+            return override->handler(screen, param, override->user_data);
+        }
+    }
+    lterm_csi_handler handler = kSlotEntries[kDispatchIndex[index]].handler;
+    return handler ? handler(screen, param, NULL) : false;
+}
@@ -0,0 +1,132 @@
+#include "lterm_osc_registry.h"
+
+#define REGISTRY_MASK (LTERM_OSC_REGISTRY_CAPACITY - 1)
+#define REGISTRY_MAX_LOAD (LTERM_OSC_REGISTRY_CAPACITY * 3 / 4)
+
+static size_t
+slot_for_code(int code)
+{
+    return (size_t)(((uint32_t)code * 2654435761u) >> 26) & REGISTRY_MASK;
+}
+
+lterm_token_type
+lterm_osc_token_type(int code)
+{
+    switch (code) {
+        case LTERM_OSC_WINICON_TITLE: return LTERM_TOKEN_XTERM_WINICON_TITLE;
+        case LTERM_OSC_ICON_TITLE: return LTERM_TOKEN_XTERM_ICON_TITLE;
+        case LTERM_OSC_WIN_TITLE: return LTERM_TOKEN_XTERM_WIN_TITLE;
+        case LTERM_OSC_SET_COLOR: return LTERM_TOKEN_XTERM_SET_RGB;
+        case LTERM_OSC_CURRENT_DIRECTORY: return LTERM_TOKEN_XTERM_PWD_URL;
+        case LTERM_OSC_HYPERLINK: return LTERM_TOKEN_XTERM_LINK;
+        case LTERM_OSC_FOREGROUND_COLOR: return LTERM_TOKEN_XTERM_TEXT_FOREGROUND_COLOR;
+        case LTERM_OSC_BACKGROUND_COLOR: return LTERM_TOKEN_XTERM_TEXT_BACKGROUND_COLOR;
+        case LTERM_OSC_CLIPBOARD: return LTERM_TOKEN_CLIPBOARD_CONTROL;
+        case LTERM_OSC_SHELL_INTEGRATION: return LTERM_TOKEN_SHELL_PROMPT_MARK;
+        case LTERM_OSC_PROPRIETARY: return LTERM_TOKEN_XTERM_PROPRIETARY_ETERM_EXT;
+        default:
+            return LTERM_TOKEN_OSC;
+    }
+}
+
+void
+lterm_osc_registry_init(lterm_osc_registry *registry)
+{
+    if (!registry) {
+        return;
+    }
+    for (size_t i = 0; i < LTERM_OSC_REGISTRY_CAPACITY; ++i) {
+        registry->slots[i].code = -1;
+        registry->slots[i].handler = NULL;
+        registry->slots[i].user_data = NULL;
+    }
+    registry->count = 0;
+}
+
+static lterm_osc_entry *
+find_slot(const lterm_osc_registry *registry, int code)
+{
+    size_t slot = slot_for_code(code);
+    for (size_t probe = 0; probe < LTERM_OSC_REGISTRY_CAPACITY; ++probe) {
+        const lterm_osc_entry *entry = &registry->slots[(slot + probe) & REGISTRY_MASK];
+        if (entry->code == code || entry->code == -1) {
+            return (lterm_osc_entry *)entry;
+        }
+    }
+    return NULL;
+}
+
+bool
+lterm_osc_registry_register(lterm_osc_registry *registry,
+                            int code,
+                            lterm_osc_handler handler,
+                            void *user_data)
+{
+    if (!registry || code < 0 || !handler) {
+        return false;
+    }
+    lterm_osc_entry *entry = find_slot(registry, code);
+    if (!entry) {
+        return false;
+    }
+    if (entry->code == -1) {
+        if (registry->count >= REGISTRY_MAX_LOAD) {
+            return false;
+        }
+        entry->code = code;
+        registry->count++;
+    }
+    entry->handler = handler;
+    entry->user_data = user_data;
+    return true;
+}
+
+void
+lterm_osc_registry_unregister(lterm_osc_registry *registry, int code)
+{
+    if (!registry || code < 0) {
+        return;
+    }
+    lterm_osc_entry *entry = find_slot(registry, code);
+    if (!entry || entry->code != code) {
+        return;
+    }
+    // Backward-shift deletion keeps probe chains intact without tombstones.
+    size_t hole = (size_t)(entry - registry->slots);
+    size_t next = (hole + 1) & REGISTRY_MASK;
+    while (registry->slots[next].code != -1) {
+        size_t home = slot_for_code(registry->slots[next].code);
+        if (((next - home) & REGISTRY_MASK) >= ((next - hole) & REGISTRY_MASK)) {
+            registry->slots[hole] = registry->slots[next];
+            hole = next;
+        }
+        next = (next + 1) & REGISTRY_MASK;
+    }
+    registry->slots[hole].code = -1;
+    registry->slots[hole].handler = NULL;
+    registry->slots[hole].user_data = NULL;
+    registry->count--;
+}
+
+const lterm_osc_entry *
+lterm_osc_registry_lookup(const lterm_osc_registry *registry, int code)
+{
+    if (!registry || code < 0 || registry->count == 0) {
+        return NULL;
+    }
+    const lterm_osc_entry *entry = find_slot(registry, code);
+    return (entry && entry->code == code) ? entry : NULL;
+}
+
+bool
+lterm_osc_registry_dispatch(const lterm_osc_registry *registry,
+                            int code,
+                            const uint8_t *payload,
+                            size_t length)
+{
+    const lterm_osc_entry *entry = lterm_osc_registry_lookup(registry, code);
+    if (!entry) {
+        return false;
+    }
+    return entry->handler(code, payload, length, entry->user_data);
+}
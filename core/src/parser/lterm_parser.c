@@ -4,7 +4,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "lterm_csi_dispatch.h"
+#include "lterm_osc_registry.h"
 #include "lterm_reader.h"
+#include "lterm_sequence_cache.h"
 #include "lterm_screen.h"
 #include "vt100_control_parser.h"
 #include "vt100_csi_parser.h"
@@ -13,14 +16,7 @@
 #include "vt100_osc_parser.h"
 #include "vt100_dcs_parser.h"
 
-struct buffer {
-    uint8_t *data;
-    size_t length;
-    size_t capacity;
-};
-
 struct lterm_parser {
-    struct buffer ascii_buffer;
     lterm_reader reader;
     vt100_control_parser control_parser;
     vt100_csi_parser csi_parser;
@@ -28,104 +24,29 @@ struct lterm_parser {
     vt100_ansi_parser ansi_parser;
     vt100_osc_parser osc_parser;
     vt100_dcs_parser dcs_parser;
+    lterm_csi_dispatch csi_dispatch;
+    lterm_osc_registry osc_registry;
+    lterm_sequence_cache sequence_cache;
+    lterm_csi_param cached_param;
+    bool cache_enabled;
     lterm_screen *screen;
 };
 
-static int csi_param_value(const lterm_csi_param *param, int index, int fallback)
-{
-    if (!param || index < 0 || index >= param->count) {
-        return fallback;
-    }
-    int value = param->p[index];
-    return value == -1 ? fallback : value;
-}
-
 static bool apply_token_to_screen(lterm_parser *parser, const lterm_token *token)
 {
-    if (!parser || !parser->screen || !token) {
+    if (!parser || !token) {
         return false;
     }
-    switch (token->type) {
-        case LTERM_TOKEN_CSI_CUU: {
-            int count = csi_param_value(&token->csi, 0, 1);
-            lterm_screen_move_cursor(parser->screen, -count, 0);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_CUD: {
-            int count = csi_param_value(&token->csi, 0, 1);
-            lterm_screen_move_cursor(parser->screen, count, 0);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_CUF: {
-            int count = csi_param_value(&token->csi, 0, 1);
-            lterm_screen_move_cursor(parser->screen, 0, count);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_CUB: {
-            int count = csi_param_value(&token->csi, 0, 1);
-            lterm_screen_move_cursor(parser->screen, 0, -count);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_CUP: {
-            int row = csi_param_value(&token->csi, 0, 1);
-            int col = csi_param_value(&token->csi, 1, 1);
-            size_t target_row = row > 0 ? (size_t)(row - 1) : 0;
-            size_t target_col = col > 0 ? (size_t)(col - 1) : 0;
-            lterm_screen_set_cursor(parser->screen, target_row, target_col);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_ED: {
-            int mode = csi_param_value(&token->csi, 0, 0);
-            lterm_screen_clear_screen(parser->screen, mode);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_EL: {
-            int mode = csi_param_value(&token->csi, 0, 0);
-            lterm_screen_clear_line(parser->screen, mode);
-            return true;
-        }
-        case LTERM_TOKEN_CSI_SGR:
-            lterm_screen_apply_sgr(parser->screen, &token->csi);
-            return true;
-        default:
-            return false;
-    }
-}
-
-
-static bool
-buffer_reserve(struct buffer *buffer, size_t extra)
-{
-    if (buffer->length + extra <= buffer->capacity) {
-        return true;
-    }
-    size_t new_capacity = buffer->capacity ? buffer->capacity : 64;
-    while (new_capacity < buffer->length + extra) {
-        new_capacity *= 2;
+    if (token->type == LTERM_TOKEN_OSC) {
+        return lterm_osc_registry_dispatch(&parser->osc_registry,
+                                           token->code,
+                                           token->ascii.buffer,
+                                           token->ascii.length);
     }
-    uint8_t *new_data = realloc(buffer->data, new_capacity);
-    if (!new_data) {
+    if (token->csi.cmd == 0) {
         return false;
     }
-    buffer->data = new_data;
-    buffer->capacity = new_capacity;
-    return true;
-}
-
-static bool
-buffer_append(struct buffer *buffer, uint8_t byte)
-{
-    if (!buffer_reserve(buffer, 1)) {
-        return false;
-    }
-    buffer->data[buffer->length++] = byte;
-    return true;
-}
-
-static void
-buffer_reset(struct buffer *buffer)
-{
-    buffer->length = 0;
+    return lterm_csi_dispatch_apply(&parser->csi_dispatch, parser->screen, &token->csi);
 }
 
 static void
@@ -153,25 +74,47 @@ emit_token(lterm_parser_callback callback,
 }
 
 static void
-flush_ascii(lterm_parser *parser, lterm_parser_callback callback, void *user_data)
+flush_ascii(lterm_parser *parser,
+            const uint8_t *data,
+            size_t length,
+            lterm_parser_callback callback,
+            void *user_data)
 {
-    if (!parser->ascii_buffer.length) {
+    if (!length) {
         return;
     }
     if (parser->screen) {
-        char *temp = malloc(parser->ascii_buffer.length + 1);
-        memcpy(temp, parser->ascii_buffer.data, parser->ascii_buffer.length);
-        temp[parser->ascii_buffer.length] = '\0';
-        lterm_screen_put_text(parser->screen, temp);
-        free(temp);
+        lterm_screen_put_bytes(parser->screen, data, length);
     } else {
-        emit_token(callback,
-                   user_data,
-                   LTERM_TOKEN_ASCII,
-                   parser->ascii_buffer.data,
-                   parser->ascii_buffer.length);
+        emit_token(callback, user_data, LTERM_TOKEN_ASCII, data, length);
     }
-    buffer_reset(&parser->ascii_buffer);
+}
+
+static void
+apply_cached_sequence(lterm_parser *parser,
+                      const lterm_sequence_cache_entry *entry,
+                      lterm_parser_callback callback,
+                      void *user_data)
+{
+    if (entry->has_sgr && parser->screen &&
+        !lterm_csi_dispatch_has_override(&parser->csi_dispatch, entry->cmd)) {
+        lterm_screen_apply_sgr_delta(parser->screen, &entry->sgr);
+        return;
+    }
+    lterm_sequence_cache_restore(entry, &parser->cached_param);
+    if (lterm_csi_dispatch_apply(&parser->csi_dispatch, parser->screen, &parser->cached_param)) {
+        return;
+    }
+    if (!callback) {
+        return;
+    }
+    lterm_token token;
+    lterm_token_init(&token);
+    token.type = entry->type;
+    token.code = lterm_csi_final_byte(entry->cmd);
+    token.csi = parser->cached_param;
+    callback(&token, user_data);
+    lterm_token_free(&token);
 }
 
 lterm_parser *
@@ -188,6 +131,11 @@ lterm_parser_new(lterm_screen *screen)
     vt100_ansi_parser_init(&parser->ansi_parser);
     vt100_osc_parser_init(&parser->osc_parser);
     vt100_dcs_parser_init(&parser->dcs_parser);
+    lterm_csi_dispatch_init(&parser->csi_dispatch);
+    lterm_osc_registry_init(&parser->osc_registry);
+    lterm_sequence_cache_init(&parser->sequence_cache);
+    lterm_csi_param_reset(&parser->cached_param);
+    parser->cache_enabled = true;
     parser->screen = screen;
     return parser;
 }
@@ -198,7 +146,6 @@ lterm_parser_free(lterm_parser *parser)
     if (!parser) {
         return;
     }
-    free(parser->ascii_buffer.data);
     lterm_reader_free(&parser->reader);
     vt100_control_parser_reset(&parser->control_parser);
     vt100_csi_parser_reset(&parser->csi_parser);
@@ -215,7 +162,6 @@ lterm_parser_reset(lterm_parser *parser)
     if (!parser) {
         return;
     }
-    buffer_reset(&parser->ascii_buffer);
     lterm_reader_reset(&parser->reader);
     vt100_control_parser_reset(&parser->control_parser);
     vt100_csi_parser_reset(&parser->csi_parser);
@@ -225,6 +171,85 @@ lterm_parser_reset(lterm_parser *parser)
     vt100_dcs_parser_reset(&parser->dcs_parser);
 }
 
+static bool
+is_control_byte(const lterm_parser *parser, uint8_t byte)
+{
+    if (byte < 0x20 || byte == 0x7F) {
+        return true;
+    }
+    return parser->control_parser.support_8bit_controls && byte >= 0x80 && byte <= 0x9F;
+}
+
+// Parses as much of data as possible and returns the number of bytes
+// consumed; anything left over is an incomplete sequence.
+static size_t
+parse_span(lterm_parser *parser,
+           const uint8_t *data,
+           size_t length,
+           lterm_parser_callback callback,
+           void *user_data)
+{
+    size_t processed = 0;
+    while (processed < length) {
+        const uint8_t *cursor = data + processed;
+        size_t remaining = length - processed;
+        if (!is_control_byte(parser, cursor[0])) {
+            size_t run = 1;
+            while (run < remaining && !is_control_byte(parser, cursor[run])) {
+                run++;
+            }
+            flush_ascii(parser, cursor, run, callback, user_data);
+            processed += run;
+            continue;
+        }
+
+        uint32_t key_hash = 0;
+        size_t key_length = parser->cache_enabled
+                                ? lterm_sequence_cache_scan(cursor, remaining, &key_hash)
+                                : 0;
+        if (key_length) {
+            const lterm_sequence_cache_entry *entry =
+                lterm_sequence_cache_lookup(&parser->sequence_cache, cursor, key_length, key_hash);
+            if (entry) {
+                apply_cached_sequence(parser, entry, callback, user_data);
+                processed += key_length;
+                continue;
+            }
+        }
+        lterm_token token;
+        lterm_token_init(&token);
+        size_t consumed = vt100_control_parser_parse(&parser->control_parser,
+                                                     &parser->csi_parser,
+                                                     &parser->string_parser,
+                                                     &parser->ansi_parser,
+                                                     &parser->osc_parser,
+                                                     &parser->dcs_parser,
+                                                     cursor,
+                                                     remaining,
+                                                     &token);
+        if (consumed == 0) {
+            lterm_token_free(&token);
+            break;
+        }
+        if (key_length == consumed && token.csi.cmd != 0) {
+            lterm_sequence_cache_store(&parser->sequence_cache,
+                                       cursor,
+                                       key_length,
+                                       key_hash,
+                                       token.type,
+                                       &token.csi);
+        }
+        bool token_applied = apply_token_to_screen(parser, &token);
+        if (!token_applied && token.type != LTERM_TOKEN_NONE && token.type != LTERM_TOKEN_WAIT &&
+            callback) {
+            callback(&token, user_data);
+        }
+        lterm_token_free(&token);
+        processed += consumed;
+    }
+    return processed;
+}
+
 void
 lterm_parser_feed(lterm_parser *parser,
                   const uint8_t *bytes,
@@ -235,61 +260,74 @@ lterm_parser_feed(lterm_parser *parser,
     if (!parser || !bytes) {
         return;
     }
+    // Fast path: nothing pending, so parse straight out of the caller's
+    // buffer and only stash an incomplete trailing sequence.
+    if (lterm_reader_pending(&parser->reader) == 0) {
+        size_t processed = parse_span(parser, bytes, length, callback, user_data);
+        lterm_reader_append(&parser->reader, bytes + processed, length - processed);
+        return;
+    }
     lterm_reader_append(&parser->reader, bytes, length);
     lterm_reader_cursor cursor;
     lterm_reader_cursor_init(&cursor, &parser->reader);
-    size_t processed = 0;
-    bool need_more_data = false;
-    while (cursor.length > 0) {
-        uint8_t byte = cursor.data[0];
-        bool is_control = (byte < 0x20 || byte == 0x7F);
-        if (!is_control &&
-            parser->control_parser.support_8bit_controls &&
-            byte >= 0x80 && byte <= 0x9F) {
-            is_control = true;
-        }
+    size_t processed = parse_span(parser, cursor.data, cursor.length, callback, user_data);
+    lterm_reader_consume(&parser->reader, processed);
+}
 
-        if (is_control) {
-            flush_ascii(parser, callback, user_data);
-            lterm_token token;
-            lterm_token_init(&token);
-            size_t consumed = vt100_control_parser_parse(&parser->control_parser,
-                                                         &parser->csi_parser,
-                                                         &parser->string_parser,
-                                                         &parser->ansi_parser,
-                                                         &parser->osc_parser,
-                                                         &parser->dcs_parser,
-                                                         cursor.data,
-                                                         cursor.length,
-                                                         &token);
-            if (consumed == 0) {
-                lterm_token_free(&token);
-                need_more_data = true;
-                break;
-            }
-            bool token_applied = false;
-            if (parser->screen) {
-                token_applied = apply_token_to_screen(parser, &token);
-            }
-            if (!token_applied && token.type != LTERM_TOKEN_NONE && token.type != LTERM_TOKEN_WAIT) {
-                callback(&token, user_data);
-            }
-            lterm_token_free(&token);
-            cursor.data += consumed;
-            cursor.length -= consumed;
-            processed += consumed;
-            continue;
-        }
+bool
+lterm_parser_set_csi_handler(lterm_parser *parser,
+                             int32_t packed,
+                             lterm_csi_handler handler,
+                             void *user_data)
+{
+    if (!parser) {
+        return false;
+    }
+    return lterm_csi_dispatch_set_handler(&parser->csi_dispatch, packed, handler, user_data);
+}
 
-        buffer_append(&parser->ascii_buffer, byte);
-        cursor.data++;
-        cursor.length--;
-        processed++;
+bool
+lterm_parser_register_osc_handler(lterm_parser *parser,
+                                  int code,
+                                  lterm_osc_handler handler,
+                                  void *user_data)
+{
+    if (!parser) {
+        return false;
     }
-    lterm_reader_consume(&parser->reader, processed);
+    return lterm_osc_registry_register(&parser->osc_registry, code, handler, user_data);
+}
 
-    if (!need_more_data) {
-        flush_ascii(parser, callback, user_data);
+void
+lterm_parser_unregister_osc_handler(lterm_parser *parser, int code)
+{
+    if (!parser) {
+        return;
     }
+    lterm_osc_registry_unregister(&parser->osc_registry, code);
 }
 
+void
+lterm_parser_set_cache_enabled(lterm_parser *parser, bool enabled)
+{
+    if (!parser) {
+        return;
+    }
+    parser->cache_enabled = enabled;
+    if (!enabled) {
+        lterm_sequence_cache_clear(&parser->sequence_cache);
+    }
+}
+
+void
+lterm_parser_get_cache_stats(const lterm_parser *parser, lterm_sequence_cache_stats *stats)
+{
+    if (!stats) {
+        return;
+    }
+    if (!parser) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    *stats = parser->sequence_cache.stats;
+}
@@ -11,8 +11,8 @@ lterm_reader_init(lterm_reader *reader)
     if (!reader) {
         return;
     }
-    reader->capacity = READER_DEFAULT_CAPACITY;
-    reader->buffer = malloc(reader->capacity);
+    reader->buffer = NULL;
+    reader->capacity = 0;
     reader->length = 0;
     reader->offset = 0;
 }
@@ -40,8 +40,8 @@ lterm_reader_reset(lterm_reader *reader)
     reader->offset = 0;
     if (reader->capacity > READER_DEFAULT_CAPACITY * 2) {
         free(reader->buffer);
-        reader->capacity = READER_DEFAULT_CAPACITY;
-        reader->buffer = malloc(reader->capacity);
+        reader->buffer = NULL;
+        reader->capacity = 0;
     }
 }
 
@@ -69,9 +69,9 @@ lterm_reader_append(lterm_reader *reader, const uint8_t *data, size_t length)
         remaining_space = reader->capacity - reader->length;
     }
     if (remaining_space < length) {
-        size_t new_capacity = reader->capacity;
+        size_t new_capacity = reader->capacity ? reader->capacity : READER_DEFAULT_CAPACITY;
         while (new_capacity - reader->length < length) {
-            new_capacity += READER_DEFAULT_CAPACITY;
+            new_capacity *= 2;
         }
         uint8_t *new_buffer = realloc(reader->buffer, new_capacity);
         if (!new_buffer) {
@@ -84,13 +84,19 @@ lterm_reader_append(lterm_reader *reader, const uint8_t *data, size_t length)
     reader->length += length;
 }
 
+size_t
+lterm_reader_pending(const lterm_reader *reader)
+{
+    return reader ? reader->length - reader->offset : 0;
+}
+
 void
 lterm_reader_cursor_init(lterm_reader_cursor *cursor, const lterm_reader *reader)
 {
     if (!cursor || !reader) {
         return;
     }
-    cursor->data = reader->buffer + reader->offset;
+    cursor->data = reader->buffer ? reader->buffer + reader->offset : NULL;
     cursor->length = reader->length - reader->offset;
 }
 
@@ -138,6 +144,10 @@ lterm_reader_consume(lterm_reader *reader, size_t count)
         return;
     }
     reader->offset += count;
+    if (reader->offset == reader->length) {
+        reader->offset = 0;
+        reader->length = 0;
+    }
 }
 
 void
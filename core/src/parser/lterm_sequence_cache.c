@@ -0,0 +1,109 @@
+#include "lterm_sequence_cache.h"
+
+#include <string.h>
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+void
+lterm_sequence_cache_init(lterm_sequence_cache *cache)
+{
+    if (!cache) {
+        return;
+    }
+    memset(cache, 0, sizeof(*cache));
+}
+
+void
+lterm_sequence_cache_clear(lterm_sequence_cache *cache)
+{
+    if (!cache) {
+        return;
+    }
+    for (size_t i = 0; i < LTERM_SEQUENCE_CACHE_SLOTS; ++i) {
+        cache->entries[i].length = 0;
+    }
+}
+
+size_t
+lterm_sequence_cache_scan(const uint8_t *data, size_t length, uint32_t *hash)
+{
+    if (!data || length < 3 || data[0] != 0x1b || data[1] != '[') {
+        return 0;
+    }
+    size_t limit = length < LTERM_SEQUENCE_CACHE_KEY_MAX ? length : LTERM_SEQUENCE_CACHE_KEY_MAX;
+    uint32_t h = FNV_OFFSET;
+    h = (h ^ data[0]) * FNV_PRIME;
+    h = (h ^ data[1]) * FNV_PRIME;
+    for (size_t i = 2; i < limit; ++i) {
+        uint8_t c = data[i];
+        h = (h ^ c) * FNV_PRIME;
+        if (c >= 0x40 && c <= 0x7E) {
+            if (hash) {
+                *hash = h;
+            }
+            return i + 1;
+        }
+        if (c < 0x20 || c > 0x3F || c == ':') {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+const lterm_sequence_cache_entry *
+lterm_sequence_cache_lookup(lterm_sequence_cache *cache,
+                            const uint8_t *key,
+                            size_t length,
+                            uint32_t hash)
+{
+    if (!cache || !key || length == 0) {
+        return NULL;
+    }
+    const lterm_sequence_cache_entry *entry = &cache->entries[hash % LTERM_SEQUENCE_CACHE_SLOTS];
+    if (entry->length == length && entry->hash == hash && memcmp(entry->key, key, length) == 0) {
+        cache->stats.hits++;
+        return entry;
+    }
+    cache->stats.misses++;
+    return NULL;
+}
+
+void
+lterm_sequence_cache_store(lterm_sequence_cache *cache,
+                           const uint8_t *key,
+                           size_t length,
+                           uint32_t hash,
+                           lterm_token_type type,
+                           const lterm_csi_param *param)
+{
+    if (!cache || !key || !param || length == 0 || length > LTERM_SEQUENCE_CACHE_KEY_MAX) {
+        return;
+    }
+    lterm_sequence_cache_entry *entry = &cache->entries[hash % LTERM_SEQUENCE_CACHE_SLOTS];
+    if (entry->length) {
+        cache->stats.evictions++;
+    }
+    entry->hash = hash;
+    entry->length = (uint8_t)length;
+    memcpy(entry->key, key, length);
+    entry->type = type;
+    entry->cmd = param->cmd;
+    entry->count = param->count;
+    memcpy(entry->p, param->p, sizeof(entry->p));
+    entry->has_sgr = type == LTERM_TOKEN_CSI_SGR;
+    if (entry->has_sgr) {
+        lterm_sgr_compile(param, &entry->sgr);
+    }
+}
+
+void
+lterm_sequence_cache_restore(const lterm_sequence_cache_entry *entry, lterm_csi_param *param)
+{
+    if (!entry || !param) {
+        return;
+    }
+    param->cmd = entry->cmd;
+    param->count = entry->count;
+    memcpy(param->p, entry->p, sizeof(param->p));
+}
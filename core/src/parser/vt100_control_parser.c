@@ -116,12 +116,8 @@ vt100_control_parser_parse(vt100_control_parser *parser,
                 token->type = LTERM_TOKEN_WAIT;
                 return 0;
             }
-            size_t parsed = vt100_osc_parser_decode(osc_parser, temp.ascii.buffer, temp.ascii.length, token);
+            vt100_osc_parser_decode(osc_parser, temp.ascii.buffer, temp.ascii.length, token);
             lterm_token_free(&temp);
-            if (parsed == 0) {
-                token->type = LTERM_TOKEN_WAIT;
-                return 0;
-            }
             token->type = LTERM_TOKEN_OSC;
             return consumed + prefix;
         }
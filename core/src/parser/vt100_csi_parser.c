@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "lterm_csi_dispatch.h"
 #include "lterm_csi_param.h"
 #include "lterm_parser_context.h"
 #include "vt100_csi_parser.h"
@@ -32,20 +33,18 @@ vt100_csi_parser_reset(vt100_csi_parser *parser)
     reset_param(&parser->param);
 }
 
-static lterm_token_type map_csi_type(uint8_t final)
+static void
+store_value(lterm_csi_param *param, int count, int sub_index, int value, bool have_value)
 {
-    switch (final) {
-        case 'A': return LTERM_TOKEN_CSI_CUU;
-        case 'B': return LTERM_TOKEN_CSI_CUD;
-        case 'C': return LTERM_TOKEN_CSI_CUF;
-        case 'D': return LTERM_TOKEN_CSI_CUB;
-        case 'H':
-        case 'f': return LTERM_TOKEN_CSI_CUP;
-        case 'J': return LTERM_TOKEN_CSI_ED;
-        case 'K': return LTERM_TOKEN_CSI_EL;
-        case 'm': return LTERM_TOKEN_CSI_SGR;
-        default:
-            return LTERM_TOKEN_CSI;
+    if (count >= LTERM_CSI_PARAM_MAX) {
+        return;
+    }
+    if (sub_index < 0) {
+        param->p[count] = have_value ? value : -1;
+    } else if (sub_index < LTERM_CSI_PARAM_MAX) {
+        // Empty sub-parameters (e.g. the color space in 38:2::r:g:b) read as 0;
+        // -1 terminates the list.
+        param->sub_params[count][sub_index] = have_value ? value : 0;
     }
 }
 
@@ -55,33 +54,44 @@ parse_parameters(lterm_parser_context *context, lterm_csi_param *param)
     int current = 0;
     bool have_value = false;
     int count = 0;
+    int sub_index = -1;
 
     while (lterm_parser_can_advance(context)) {
         uint8_t c = lterm_parser_peek(context);
         if (c >= '0' && c <= '9') {
             have_value = true;
-            current = current * 10 + (c - '0');
+            if (current < 100000) {
+                current = current * 10 + (c - '0');
+            }
             lterm_parser_advance(context);
             continue;
         }
         if (c == ';') {
+            store_value(param, count, sub_index, current, have_value);
             if (count < LTERM_CSI_PARAM_MAX) {
-                param->p[count++] = have_value ? current : -1;
+                count++;
             }
             current = 0;
             have_value = false;
+            sub_index = -1;
             lterm_parser_advance(context);
             continue;
         }
         if (c == ':') {
-            return false;
+            store_value(param, count, sub_index, current, have_value);
+            sub_index++;
+            current = 0;
+            have_value = false;
+            lterm_parser_advance(context);
+            continue;
         }
         break;
     }
 
-    if (have_value || count > 0) {
+    if (have_value || count > 0 || sub_index >= 0) {
+        store_value(param, count, sub_index, current, have_value);
         if (count < LTERM_CSI_PARAM_MAX) {
-            param->p[count++] = have_value ? current : -1;
+            count++;
         }
     }
 
@@ -134,10 +144,10 @@ vt100_csi_parser_decode(vt100_csi_parser *parser,
     }
     lterm_parser_advance(context);
 
-    token->type = map_csi_type(final);
-    token->code = final;
     token->csi = parser->param;
     token->csi.cmd = LTERM_PACKED_CSI(prefix, intermediate, final);
+    token->type = lterm_csi_dispatch_token_type(token->csi.cmd);
+    token->code = final;
 
     size_t consumed = (size_t)lterm_parser_bytes_consumed(context);
     return consumed;
@@ -5,10 +5,6 @@
 
 #include "lterm_token_types.h"
 
-#ifndef ARRAY_LENGTH
-#define ARRAY_LENGTH(arr) (sizeof(arr) / sizeof((arr)[0]))
-#endif
-
 void
 vt100_osc_parser_init(vt100_osc_parser *parser)
 {
@@ -35,12 +31,14 @@ parse_code(const uint8_t *data, size_t length, size_t *payload_offset)
     bool has_digits = false;
     while (i < length && data[i] >= '0' && data[i] <= '9') {
         has_digits = true;
-        code = code * 10 + (data[i] - '0');
+        if (code < 1000000) {
+            code = code * 10 + (data[i] - '0');
+        }
         i++;
     }
-    if (has_digits && i < length && data[i] == ';') {
+    if (has_digits && (i == length || data[i] == ';')) {
         if (payload_offset) {
-            *payload_offset = i + 1;
+            *payload_offset = i < length ? i + 1 : i;
         }
         return code;
     }
@@ -50,36 +48,6 @@ parse_code(const uint8_t *data, size_t length, size_t *payload_offset)
     return -1;
 }
 
-typedef struct {
-    const char *prefix;
-    lterm_token_type type;
-} osc_mapping;
-
-static const osc_mapping kOscMappings[] = {
-    { "0", LTERM_TOKEN_XTERM_WINICON_TITLE },
-    { "1", LTERM_TOKEN_XTERM_ICON_TITLE },
-    { "2", LTERM_TOKEN_XTERM_WIN_TITLE },
-    { "52", LTERM_TOKEN_CLIPBOARD_CONTROL },
-};
-
-static const char *
-skip_code_prefix(const uint8_t *data, size_t length, lterm_token_type *out_type)
-{
-    for (size_t i = 0; i < ARRAY_LENGTH(kOscMappings); ++i) {
-        size_t prefix_len = strlen(kOscMappings[i].prefix);
-        if (length > prefix_len && memcmp(data, kOscMappings[i].prefix, prefix_len) == 0 && data[prefix_len] == ';') {
-            if (out_type) {
-                *out_type = kOscMappings[i].type;
-            }
-            return (const char *)(data + prefix_len + 1);
-        }
-    }
-    if (out_type) {
-        *out_type = LTERM_TOKEN_OSC;
-    }
-    return (const char *)data;
-}
-
 size_t
 vt100_osc_parser_decode(vt100_osc_parser *parser,
                         const uint8_t *data,
@@ -91,15 +59,13 @@ vt100_osc_parser_decode(vt100_osc_parser *parser,
         return 0;
     }
 
-    lterm_token_type inferred = LTERM_TOKEN_OSC;
-    const char *payload = skip_code_prefix(data, length, &inferred);
-    size_t payload_len = (payload >= (const char *)data && payload <= (const char *)(data + length))
-                             ? (data + length) - (const uint8_t *)payload
-                             : length;
+    size_t payload_offset = 0;
+    int code = parse_code(data, length, &payload_offset);
 
-    token->type = inferred;
-    if (payload_len > 0) {
-        lterm_token_set_ascii(token, (const uint8_t *)payload, payload_len);
+    token->type = LTERM_TOKEN_OSC;
+    token->code = code;
+    if (length > payload_offset) {
+        lterm_token_set_ascii(token, data + payload_offset, length - payload_offset);
     }
     return length;
 }
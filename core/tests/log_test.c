@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lterm_log.h"
+#include "lterm_session.h"
+
+static char *
+read_file(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    static char buffer[1 << 16];
+    *length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    buffer[*length] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+static void
+log_path(char *path, size_t size, const char *name)
+{
+    snprintf(path, size, "/tmp/lterm-log-test-%d-%s", (int)getpid(), name);
+    unlink(path);
+}
+
+static void
+test_raw(void)
+{
+    char path[128];
+    log_path(path, sizeof(path), "raw");
+    lterm_log *log = lterm_log_open(&(lterm_log_options){.path = path});
+    assert(log);
+    const char *first = "hello \x1b[1mworld\x1b[0m\r\n";
+    const char *second = "$ ";
+    assert(lterm_log_append(log, (const uint8_t *)first, strlen(first)));
+    assert(lterm_log_append(log, (const uint8_t *)second, strlen(second)));
+    assert(lterm_log_flush(log, 5000));
+
+    size_t length = 0;
+    const char *text = read_file(path, &length);
+    assert(text && length == strlen(first) + strlen(second));
+    assert(memcmp(text, first, strlen(first)) == 0);
+
+    lterm_log_stats stats;
+    lterm_log_get_stats(log, &stats);
+    assert(stats.bytes_logged == length && stats.bytes_written == length && stats.bytes_dropped == 0);
+    lterm_log_close(log);
+    unlink(path);
+}
+
+static void
+test_plain_with_timestamps(void)
+{
+    char path[128];
+    log_path(path, sizeof(path), "plain");
+    lterm_log *log = lterm_log_open(&(lterm_log_options){
+        .path = path,
+        .format = LTERM_LOG_PLAIN,
+        .timestamps = LTERM_LOG_TIMESTAMP_LINE,
+    });
+    assert(log);
+    // Sequences split across appends are still removed whole.
+    const char *chunks[] = {
+        "\x1b]0;title\x07red: \x1b[3", "1mon\x1b[0m\r\n",
+        "tab\there\x1b", "(Bdone\x1bP1$r\x1b\\\r\n",
+    };
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
+        assert(lterm_log_append(log, (const uint8_t *)chunks[i], strlen(chunks[i])));
+    }
+    lterm_log_close(log);
+
+    size_t length = 0;
+    const char *text = read_file(path, &length);
+    assert(text);
+    // "[YYYY-MM-DD HH:MM:SS.mmm] " is 26 bytes.
+    const char *line = text;
+    assert(line[0] == '[' && line[24] == ']' && line[25] == ' ');
+    assert(strncmp(line + 26, "red: on\n", 8) == 0);
+    line += 26 + 8;
+    assert(line[0] == '[' && strcmp(line + 26, "tab\theredone\n") == 0);
+    unlink(path);
+}
+
+static void
+test_rotation_and_drops(void)
+{
+    char path[128];
+    char rotated[160];
+    log_path(path, sizeof(path), "rotate");
+    snprintf(rotated, sizeof(rotated), "%s.1", path);
+    unlink(rotated);
+    lterm_log *log = lterm_log_open(&(lterm_log_options){.path = path, .rotate_bytes = 8, .ring_capacity = 64});
+    assert(log);
+    assert(lterm_log_append(log, (const uint8_t *)"0123456789", 10));
+    assert(lterm_log_flush(log, 5000));
+    assert(lterm_log_append(log, (const uint8_t *)"abc", 3));
+    assert(lterm_log_flush(log, 5000));
+    // Larger than the ring: dropped rather than blocking the caller.
+    static const uint8_t big[100];
+    assert(!lterm_log_append(log, big, sizeof(big)));
+    lterm_log_stats stats;
+    lterm_log_get_stats(log, &stats);
+    assert(stats.rotations == 1 && stats.bytes_dropped == sizeof(big));
+    lterm_log_close(log);
+
+    size_t length = 0;
+    assert(read_file(rotated, &length) && length == 10);
+    const char *text = read_file(path, &length);
+    assert(text && length == 3 && memcmp(text, "abc", 3) == 0);
+    unlink(path);
+    unlink(rotated);
+}
+
+static void
+test_compression(void)
+{
+    char path[128];
+    log_path(path, sizeof(path), "gz");
+    lterm_log_options options = {.path = path, .compress = true};
+    if (!lterm_log_compression_supported()) {
+        assert(!lterm_log_open(&options));
+        printf("skipping log compression test (no zlib)\n");
+        return;
+    }
+    lterm_log *log = lterm_log_open(&options);
+    assert(log);
+    char line[64];
+    for (int i = 0; i < 1000; ++i) {
+        int length = snprintf(line, sizeof(line), "line %d of a very repetitive log\n", i);
+        assert(lterm_log_append(log, (const uint8_t *)line, (size_t)length));
+    }
+    lterm_log_close(log);
+
+    size_t length = 0;
+    const unsigned char *data = (const unsigned char *)read_file(path, &length);
+    assert(data && length > 2 && data[0] == 0x1f && data[1] == 0x8b);
+    assert(length < 10000);
+    unlink(path);
+}
+
+static void
+test_session_tee(void)
+{
+    char path[128];
+    log_path(path, sizeof(path), "session");
+    lterm_log *log = lterm_log_open(&(lterm_log_options){.path = path});
+    assert(log);
+    lterm_session *session = lterm_session_new(4, 20);
+    assert(session);
+    lterm_session_set_log(session, log);
+    const uint8_t sample[] = "ls\x1b[31m -l";
+    assert(lterm_session_ingest(session, sample, sizeof(sample) - 1) == sizeof(sample) - 1);
+    lterm_session_process(session, 4);
+    lterm_session_process(session, 64);
+    lterm_session_set_log(session, NULL);
+    lterm_session_ingest(session, (const uint8_t *)"unlogged", 8);
+    lterm_session_process(session, 64);
+    lterm_session_free(session);
+    lterm_log_close(log);
+
+    size_t length = 0;
+    const char *text = read_file(path, &length);
+    assert(text && length == sizeof(sample) - 1 && memcmp(text, sample, length) == 0);
+    unlink(path);
+}
+
+int
+main(void)
+{
+    test_raw();
+    test_plain_with_timestamps();
+    test_rotation_and_drops();
+    test_compression();
+    test_session_tee();
+    printf("log tests passed\n");
+    return 0;
+}
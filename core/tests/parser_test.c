@@ -90,6 +90,312 @@ test_osc_st_termination(void)
     lterm_parser_free(parser);
 }
 
+static void
+test_csi_dispatch_types(void)
+{
+    lterm_parser *parser = lterm_parser_new(NULL);
+    assert(parser);
+    const uint8_t sample[] = "\x1b[?25h\x1b[?25l\x1b[2 q\x1b[1;24r\x1b[>c\x1b[x";
+    token_log log = {0};
+    lterm_parser_feed(parser, sample, sizeof(sample) - 1, log_token, &log);
+    assert(log.count == 6);
+    assert(log.tokens[0].type == LTERM_TOKEN_CSI_DECSET);
+    assert(log.tokens[0].csi.p[0] == 25);
+    assert(log.tokens[1].type == LTERM_TOKEN_CSI_DECRST);
+    assert(log.tokens[2].type == LTERM_TOKEN_CSI_DECSCUSR);
+    assert(log.tokens[2].csi.cmd == LTERM_PACKED_CSI(0, ' ', 'q'));
+    assert(log.tokens[3].type == LTERM_TOKEN_CSI_DECSTBM);
+    assert(log.tokens[4].type == LTERM_TOKEN_CSI_DA2);
+    assert(log.tokens[5].type == LTERM_TOKEN_CSI);
+    reset_log(&log);
+    lterm_parser_free(parser);
+}
+
+static bool
+count_dsr(lterm_screen *screen, const lterm_csi_param *param, void *user_data)
+{
+    (void)screen;
+    int *calls = user_data;
+    if (param->p[0] == 6) {
+        (*calls)++;
+    }
+    return true;
+}
+
+static void
+test_csi_dispatch_override(void)
+{
+    lterm_screen screen;
+    lterm_screen_init(&screen, 24, 80);
+    lterm_parser *parser = lterm_parser_new(&screen);
+    assert(parser);
+
+    int calls = 0;
+    assert(lterm_parser_set_csi_handler(parser, LTERM_PACKED_CSI(0, 0, 'n'), count_dsr, &calls));
+
+    const uint8_t sample[] = "\x1b[5;10H\x1b[6n\x1b[2A";
+    token_log log = {0};
+    lterm_parser_feed(parser, sample, sizeof(sample) - 1, log_token, &log);
+    assert(log.count == 0);
+    assert(calls == 1);
+    assert(screen.cursor_row == 2);
+    assert(screen.cursor_col == 9);
+
+    assert(lterm_parser_set_csi_handler(parser, LTERM_PACKED_CSI(0, 0, 'n'), NULL, NULL));
+    const uint8_t again[] = "\x1b[6n";
+    lterm_parser_feed(parser, again, sizeof(again) - 1, log_token, &log);
+    assert(calls == 1);
+    assert(log.count == 1);
+    assert(log.tokens[0].type == LTERM_TOKEN_CSI_DSR);
+
+    reset_log(&log);
+    lterm_parser_free(parser);
+    lterm_screen_free(&screen);
+}
+
+typedef struct {
+    int code;
+    int calls;
+    char payload[64];
+} osc_capture;
+
+static bool
+capture_osc(int code, const uint8_t *payload, size_t length, void *user_data)
+{
+    osc_capture *capture = user_data;
+    capture->code = code;
+    capture->calls++;
+    size_t copy = length < sizeof(capture->payload) - 1 ? length : sizeof(capture->payload) - 1;
+    memcpy(capture->payload, payload, copy);
+    capture->payload[copy] = '\0';
+    return true;
+}
+
+static void
+test_osc_registry(void)
+{
+    lterm_parser *parser = lterm_parser_new(NULL);
+    assert(parser);
+    osc_capture prompt = {0};
+    osc_capture cwd = {0};
+    assert(lterm_parser_register_osc_handler(parser, LTERM_OSC_SHELL_INTEGRATION, capture_osc, &prompt));
+    assert(lterm_parser_register_osc_handler(parser, LTERM_OSC_CURRENT_DIRECTORY, capture_osc, &cwd));
+
+    const uint8_t sample[] = "\x1b]133;A\x07$ \x1b]7;file://host/tmp\x1b\\\x1b]1337;SetMark\x07";
+    token_log log = {0};
+    lterm_parser_feed(parser, sample, sizeof(sample) - 1, log_token, &log);
+    assert(prompt.calls == 1);
+    assert(prompt.code == 133);
+    assert(strcmp(prompt.payload, "A") == 0);
+    assert(cwd.calls == 1);
+    assert(strcmp(cwd.payload, "file://host/tmp") == 0);
+    assert(log.count == 2);
+    assert(log.tokens[0].type == LTERM_TOKEN_ASCII);
+    assert(log.tokens[1].type == LTERM_TOKEN_OSC);
+    assert(log.tokens[1].code == 1337);
+    assert(lterm_osc_token_type(log.tokens[1].code) == LTERM_TOKEN_XTERM_PROPRIETARY_ETERM_EXT);
+
+    lterm_parser_unregister_osc_handler(parser, LTERM_OSC_SHELL_INTEGRATION);
+    reset_log(&log);
+    const uint8_t again[] = "\x1b]133;B\x07";
+    lterm_parser_feed(parser, again, sizeof(again) - 1, log_token, &log);
+    assert(prompt.calls == 1);
+    assert(log.count == 1);
+    assert(log.tokens[0].code == 133);
+
+    lterm_osc_registry registry;
+    lterm_osc_registry_init(&registry);
+    osc_capture many = {0};
+    for (int code = 0; code < 40; ++code) {
+        assert(lterm_osc_registry_register(&registry, code * 64, capture_osc, &many));
+    }
+    for (int code = 0; code < 40; code += 2) {
+        lterm_osc_registry_unregister(&registry, code * 64);
+    }
+    for (int code = 0; code < 40; ++code) {
+        assert((lterm_osc_registry_lookup(&registry, code * 64) != NULL) == (code % 2 == 1));
+    }
+
+    reset_log(&log);
+    lterm_parser_free(parser);
+}
+
+static bool
+measure_osc(int code, const uint8_t *payload, size_t length, void *user_data)
+{
+    (void)code;
+    (void)payload;
+    *(size_t *)user_data = length;
+    return true;
+}
+
+static void
+test_split_feed(void)
+{
+    lterm_parser *parser = lterm_parser_new(NULL);
+    assert(parser);
+    token_log log = {0};
+
+    const uint8_t first[] = "ab\x1b[3";
+    const uint8_t second[] = "1mcd";
+    lterm_parser_feed(parser, first, sizeof(first) - 1, log_token, &log);
+    assert(log.count == 1);
+    assert(log.tokens[0].type == LTERM_TOKEN_ASCII);
+    lterm_parser_feed(parser, second, sizeof(second) - 1, log_token, &log);
+    assert(log.count == 3);
+    assert(log.tokens[1].type == LTERM_TOKEN_CSI_SGR);
+    assert(log.tokens[1].csi.p[0] == 31);
+    assert(log.tokens[2].type == LTERM_TOKEN_ASCII);
+    assert(memcmp(log.tokens[2].ascii.buffer, "cd", 2) == 0);
+
+    size_t measured = 0;
+    assert(lterm_parser_register_osc_handler(parser, 1337, measure_osc, &measured));
+    const size_t payload = 256 * 1024;
+    uint8_t chunk[4096];
+    memset(chunk, 'x', sizeof(chunk));
+    lterm_parser_feed(parser, (const uint8_t *)"\x1b]1337;", 7, log_token, &log);
+    for (size_t sent = 0; sent < payload; sent += sizeof(chunk)) {
+        lterm_parser_feed(parser, chunk, sizeof(chunk), log_token, &log);
+    }
+    lterm_parser_feed(parser, (const uint8_t *)"\x07", 1, log_token, &log);
+    assert(measured == payload);
+    assert(log.count == 3);
+
+    reset_log(&log);
+    lterm_parser_free(parser);
+}
+
+static void
+test_sequence_cache(void)
+{
+    lterm_screen screen;
+    lterm_screen_init(&screen, 4, 20);
+    lterm_parser *parser = lterm_parser_new(&screen);
+    assert(parser);
+
+    const uint8_t sample[] = "\x1b[1;32mA\x1b[0mB\x1b[1;32mC\x1b[0mD";
+    token_log log = {0};
+    lterm_parser_feed(parser, sample, sizeof(sample) - 1, log_token, &log);
+    assert(log.count == 0);
+    assert(screen.grid.cells[0].fg == 2);
+    assert(screen.grid.cells[0].flags & LTERM_CELL_FLAG_BOLD);
+    assert(screen.grid.cells[2].fg == 2);
+    assert(screen.grid.cells[2].flags & LTERM_CELL_FLAG_BOLD);
+    assert(screen.grid.cells[3].flags == 0);
+
+    lterm_sequence_cache_stats stats;
+    lterm_parser_get_cache_stats(parser, &stats);
+    assert(stats.misses == 2);
+    assert(stats.hits == 2);
+    lterm_parser_free(parser);
+    lterm_screen_free(&screen);
+
+    parser = lterm_parser_new(NULL);
+    const uint8_t tokens[] = "\x1b[?25h\x1b[?25h";
+    lterm_parser_feed(parser, tokens, sizeof(tokens) - 1, log_token, &log);
+    assert(log.count == 2);
+    for (size_t i = 0; i < log.count; ++i) {
+        assert(log.tokens[i].type == LTERM_TOKEN_CSI_DECSET);
+        assert(log.tokens[i].code == 'h');
+        assert(log.tokens[i].csi.count == 1);
+        assert(log.tokens[i].csi.p[0] == 25);
+    }
+    lterm_parser_get_cache_stats(parser, &stats);
+    assert(stats.hits == 1);
+    reset_log(&log);
+    lterm_parser_free(parser);
+}
+
+static void
+test_sgr_extended_colors(void)
+{
+    lterm_screen screen;
+    lterm_screen_init(&screen, 2, 20);
+    lterm_parser *parser = lterm_parser_new(&screen);
+    assert(parser);
+    token_log log = {0};
+
+    const uint8_t sample[] = "\x1b[38;5;245;48;2;10;20;30mA"
+                             "\x1b[0;2;3;9mB"
+                             "\x1b[4:3;38:2::1:2:3mC"
+                             "\x1b[22;23;24;29;39;49mD"
+                             "\x1b[21;7mE";
+    lterm_parser_feed(parser, sample, sizeof(sample) - 1, log_token, &log);
+    assert(log.count == 0);
+
+    const lterm_cell *cells = screen.grid.cells;
+    assert(cells[0].fg == 245);
+    assert(cells[0].bg == LTERM_COLOR_RGB(10, 20, 30));
+    assert(LTERM_COLOR_IS_RGB(cells[0].bg));
+    assert(cells[0].flags == 0);
+
+    assert(cells[1].fg == LTERM_COLOR_DEFAULT_FG);
+    assert(cells[1].bg == LTERM_COLOR_DEFAULT_BG);
+    assert(cells[1].flags == (LTERM_CELL_FLAG_DIM | LTERM_CELL_FLAG_ITALIC | LTERM_CELL_FLAG_STRIKETHROUGH));
+
+    assert(cells[2].fg == LTERM_COLOR_RGB(1, 2, 3));
+    assert(cells[2].flags & LTERM_CELL_FLAG_CURLY_UNDERLINE);
+    assert(!(cells[2].flags & LTERM_CELL_FLAG_UNDERLINE));
+
+    assert(cells[3].flags == 0);
+    assert(cells[3].fg == LTERM_COLOR_DEFAULT_FG);
+
+    assert(cells[4].flags == (LTERM_CELL_FLAG_DOUBLE_UNDERLINE | LTERM_CELL_FLAG_INVERSE));
+    assert(cells[4].fg == LTERM_COLOR_DEFAULT_BG);
+    assert(cells[4].bg == LTERM_COLOR_DEFAULT_FG);
+
+    lterm_sgr_delta delta;
+    lterm_csi_param param;
+    lterm_csi_param_reset(&param);
+    param.count = 2;
+    param.p[0] = 1;
+    param.p[1] = 22;
+    lterm_sgr_compile(&param, &delta);
+    assert(delta.set_flags == 0);
+    assert(delta.clear_flags & LTERM_CELL_FLAG_BOLD);
+
+    lterm_parser_free(parser);
+    lterm_screen_free(&screen);
+}
+
+static void
+test_dirty_rows(void)
+{
+    lterm_screen screen;
+    lterm_screen_init(&screen, 4, 10);
+    lterm_parser *parser = lterm_parser_new(&screen);
+    assert(parser);
+    uint8_t dirty[4];
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 4);
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 0);
+
+    const uint8_t echo[] = "\x1b[3;1Hx";
+    lterm_parser_feed(parser, echo, sizeof(echo) - 1, NULL, NULL);
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 1);
+    assert(dirty[2] && !dirty[0] && !dirty[1] && !dirty[3]);
+
+    // Cursor movement alone changes no cells.
+    const uint8_t move[] = "\x1b[1;1H\x1b[2C";
+    lterm_parser_feed(parser, move, sizeof(move) - 1, NULL, NULL);
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 0);
+
+    const uint8_t erase[] = "\x1b[2;5H\x1b[0J";
+    lterm_parser_feed(parser, erase, sizeof(erase) - 1, NULL, NULL);
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 3);
+    assert(!dirty[0] && dirty[1] && dirty[2] && dirty[3]);
+
+    lterm_screen_set_cursor(&screen, 3, 0);
+    lterm_screen_line_feed(&screen);
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 4);
+
+    lterm_screen_mark_dirty(&screen, 3, 10);
+    assert(lterm_screen_take_dirty(&screen, dirty, 4) == 1);
+    assert(dirty[3]);
+
+    lterm_parser_free(parser);
+    lterm_screen_free(&screen);
+}
+
 int
 main(void)
 {
@@ -99,6 +405,13 @@ main(void)
     test_ascii_and_csi();
     test_osc_termination();
     test_osc_st_termination();
+    test_csi_dispatch_types();
+    test_csi_dispatch_override();
+    test_osc_registry();
+    test_split_feed();
+    test_sequence_cache();
+    test_sgr_extended_colors();
+    test_dirty_rows();
     printf("parser tests passed\n");
     return 0;
 }
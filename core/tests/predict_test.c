@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lterm_predict.h"
+#include "lterm_session.h"
+
+// Harness: PTY output is held back for DELAY_MS before the parser sees it,
+// standing in for a slow link between the shell and the screen.
+#define DELAY_MS 80
+#define MAX_CHUNKS 256
+
+typedef struct {
+    lterm_session *session;
+    uint8_t *data[MAX_CHUNKS];
+    size_t length[MAX_CHUNKS];
+    int64_t release_ns[MAX_CHUNKS];
+    size_t head;
+    size_t tail;
+} delay_line;
+
+static int64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static void
+sleep_ms(long ms)
+{
+    struct timespec pause = {0, ms * 1000 * 1000};
+    nanosleep(&pause, NULL);
+}
+
+static void
+pump(delay_line *line)
+{
+    uint8_t buffer[4096];
+    ssize_t n;
+    while ((n = lterm_pty_read(lterm_session_pty(line->session), buffer, sizeof(buffer))) > 0) {
+        assert(line->tail - line->head < MAX_CHUNKS);
+        size_t slot = line->tail++ % MAX_CHUNKS;
+        line->data[slot] = malloc((size_t)n);
+        memcpy(line->data[slot], buffer, (size_t)n);
+        line->length[slot] = (size_t)n;
+        line->release_ns[slot] = now_ns() + DELAY_MS * 1000000ll;
+    }
+    while (line->head < line->tail && line->release_ns[line->head % MAX_CHUNKS] <= now_ns()) {
+        size_t slot = line->head++ % MAX_CHUNKS;
+        assert(lterm_session_ingest(line->session, line->data[slot], line->length[slot]) == line->length[slot]);
+        lterm_session_process(line->session, line->length[slot]);
+        free(line->data[slot]);
+    }
+}
+
+static void
+drain(delay_line *line)
+{
+    while (line->head < line->tail) {
+        free(line->data[line->head++ % MAX_CHUNKS]);
+    }
+}
+
+static lterm_session *
+spawn(const char *script, lterm_predictor *predictor)
+{
+    lterm_session *session = lterm_session_new(4, 40);
+    char *const argv[] = {"/bin/sh", "-c", (char *)script, NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+    lterm_session_set_predictor(session, predictor);
+    return session;
+}
+
+static void
+wait_mode(lterm_session *session, lterm_pty_input_mode mode)
+{
+    for (int i = 0; i < 500 && lterm_pty_get_input_mode(lterm_session_pty(session)) != mode; ++i) {
+        sleep_ms(5);
+    }
+    assert(lterm_pty_get_input_mode(lterm_session_pty(session)) == mode);
+}
+
+static bool
+type(lterm_session *session, char key)
+{
+    bool shown = lterm_session_predict(session, (const uint8_t *)&key, 1);
+    assert(lterm_session_write(session, (const uint8_t *)&key, 1));
+    return shown;
+}
+
+static void
+pump_until_confirmed(delay_line *line, lterm_predictor *predictor, unsigned long long confirmed)
+{
+    lterm_predict_stats stats;
+    for (int i = 0; i < 1000; ++i) {
+        pump(line);
+        lterm_predictor_get_stats(predictor, &stats);
+        if (stats.confirmed >= confirmed) {
+            return;
+        }
+        sleep_ms(2);
+    }
+    assert(!"echo never confirmed");
+}
+
+// Canonical echo: every keystroke is drawn at once, then confirmed by the
+// delayed echo without a rollback.
+static void
+test_line_echo(void)
+{
+    lterm_predictor *predictor = lterm_predictor_new();
+    lterm_session *session = spawn("read line; printf '<%s>' \"$line\"", predictor);
+    delay_line line = {.session = session};
+    wait_mode(session, LTERM_PTY_INPUT_LINE);
+
+    const char *word = "hello";
+    lterm_prediction overlay[8];
+    for (size_t i = 0; i < strlen(word); ++i) {
+        assert(type(session, word[i]));
+        assert(lterm_predictor_overlay(predictor, overlay, 8, now_ns()) >= 1);
+        pump(&line);
+        sleep_ms(10);
+    }
+    size_t row = 0;
+    size_t col = 0;
+    assert(lterm_predictor_cursor(predictor, &row, &col, now_ns()) && col == 5);
+    pump_until_confirmed(&line, predictor, 5);
+    assert(lterm_predictor_overlay(predictor, overlay, 8, now_ns()) == 0);
+
+    lterm_predict_stats stats;
+    lterm_predictor_get_stats(predictor, &stats);
+    assert(stats.predicted == 5 && stats.displayed == 5 && stats.rolled_back == 0);
+    unsigned long long echo_ms = stats.echo_ns_total / stats.confirmed / 1000000;
+    assert(echo_ms >= DELAY_MS);
+    printf("keystroke echo: predicted 0 ms, real %llu ms\n", echo_ms);
+    const lterm_screen *screen = lterm_session_screen(session);
+    for (size_t i = 0; i < 5; ++i) {
+        assert(screen->grid.cells[i].codepoint == (uint32_t)word[i]);
+    }
+
+    // Enter is not predicted and pauses predictions until output arrives.
+    assert(!type(session, '\r'));
+    assert(!lterm_session_predict(session, (const uint8_t *)"x", 1));
+    drain(&line);
+    lterm_session_set_predictor(session, NULL);
+    lterm_session_free(session);
+    lterm_predictor_free(predictor);
+}
+
+// Nothing is predicted while the slave does not echo.
+static void
+test_silent(void)
+{
+    lterm_predictor *predictor = lterm_predictor_new();
+    lterm_session *session = spawn("stty -echo; read line", predictor);
+    wait_mode(session, LTERM_PTY_INPUT_SILENT);
+    assert(!type(session, 'p'));
+    assert(!type(session, 'w'));
+    lterm_predict_stats stats;
+    lterm_predictor_get_stats(predictor, &stats);
+    assert(stats.predicted == 0);
+    lterm_session_free(session);
+    lterm_predictor_free(predictor);
+}
+
+// In raw mode predictions are shown only once the program's own echo has
+// been seen, and a wrong echo withdraws them.
+static void
+test_raw_echo(void)
+{
+    lterm_predictor *predictor = lterm_predictor_new();
+    lterm_session *session = spawn("stty raw -echo; dd bs=1 count=3 2>/dev/null", predictor);
+    delay_line line = {.session = session};
+    wait_mode(session, LTERM_PTY_INPUT_RAW);
+    assert(!type(session, 'a'));
+    pump_until_confirmed(&line, predictor, 1);
+    assert(type(session, 'b'));
+    pump_until_confirmed(&line, predictor, 2);
+    drain(&line);
+    lterm_session_free(session);
+
+    session = spawn("stty raw -echo; dd bs=1 count=2 2>/dev/null | tr a-z A-Z", predictor);
+    line = (delay_line){.session = session};
+    wait_mode(session, LTERM_PTY_INPUT_RAW);
+    // Still trusted from the echo above, so these are drawn.
+    assert(type(session, 'c'));
+    assert(type(session, 'd'));
+    lterm_predict_stats stats;
+    for (int i = 0; i < 1000; ++i) {
+        pump(&line);
+        lterm_predictor_get_stats(predictor, &stats);
+        if (stats.rolled_back) {
+            break;
+        }
+        sleep_ms(2);
+    }
+    assert(stats.rolled_back == 1 && stats.confirmed == 2);
+    lterm_prediction overlay[4];
+    assert(lterm_predictor_overlay(predictor, overlay, 4, now_ns()) == 0);
+    assert(!type(session, 'e'));
+    drain(&line);
+    lterm_session_free(session);
+    lterm_predictor_free(predictor);
+}
+
+// A key whose echo never comes is withdrawn by the clock alone, without
+// any output to trigger an update.
+static void
+test_timeout(void)
+{
+    lterm_predictor *predictor = lterm_predictor_new();
+    lterm_screen screen;
+    lterm_screen_init(&screen, 2, 10);
+    const int64_t typed = 1000000000ll;
+    assert(lterm_predictor_key(predictor, &screen, LTERM_PTY_INPUT_LINE, (const uint8_t *)"s", 1, typed));
+    lterm_prediction overlay[4];
+    const int64_t timeout_ns = LTERM_PREDICT_TIMEOUT_MS * 1000000ll;
+    assert(lterm_predictor_overlay(predictor, overlay, 4, typed + timeout_ns / 2) == 1);
+    assert(lterm_predictor_cursor(predictor, NULL, NULL, typed + timeout_ns / 2));
+    assert(!lterm_predictor_cursor(predictor, NULL, NULL, typed + timeout_ns + 1));
+    assert(lterm_predictor_overlay(predictor, overlay, 4, typed + timeout_ns + 1) == 0);
+    lterm_predict_stats stats;
+    lterm_predictor_get_stats(predictor, &stats);
+    assert(stats.rolled_back == 1 && stats.confirmed == 0);
+    lterm_screen_free(&screen);
+    lterm_predictor_free(predictor);
+}
+
+int
+main(void)
+{
+    test_line_echo();
+    test_silent();
+    test_raw_echo();
+    test_timeout();
+    printf("predict tests passed\n");
+    return 0;
+}
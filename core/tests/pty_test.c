@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "lterm_pty.h"
+#include "lterm_pty_pool.h"
+
+static void
+count_bytes(const uint8_t *data, size_t length, void *user_data)
+{
+    (void)data;
+    *(size_t *)user_data += length;
+}
+
+static void
+test_adaptive_drain(void)
+{
+    lterm_pty pty;
+    lterm_pty_init(&pty);
+    char *const argv[] = {"/bin/sh", "-c", "head -c 3000000 /dev/zero", NULL};
+    if (!lterm_pty_spawn(&pty, "/bin/sh", argv, NULL)) {
+        printf("skipping pty drain test (no pty)\n");
+        return;
+    }
+
+    size_t received = 0;
+    lterm_pty_sink sink = {count_bytes, &received};
+    lterm_pty_drain_stats stats;
+
+    struct pollfd pfd = {.fd = lterm_pty_get_fd(&pty), .events = POLLIN};
+    assert(poll(&pfd, 1, 5000) == 1);
+    lterm_pty_budget small = {.max_bytes = 1000, .max_ns = 0};
+    assert(lterm_pty_drain(&pty, &sink, &small, &stats));
+    assert(stats.bytes <= 1000);
+    assert(stats.more_pending);
+
+    size_t syscalls = stats.syscalls;
+    size_t largest = stats.buffer_size;
+    while (!stats.closed) {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 5000) != 1) {
+            break;
+        }
+        assert(lterm_pty_drain(&pty, &sink, NULL, &stats));
+        syscalls += stats.syscalls;
+        if (stats.buffer_size > largest) {
+            largest = stats.buffer_size;
+        }
+    }
+    assert(stats.closed);
+    assert(received == 3000000);
+    assert(largest > LTERM_PTY_DRAIN_MIN_BUFFER);
+    assert(largest <= LTERM_PTY_DRAIN_MAX_BUFFER);
+    assert(syscalls < 3000000 / 1024);
+
+    // Idle drains walk the buffer back down.
+    for (int i = 0; i < LTERM_PTY_DRAIN_SHRINK_AFTER * 16; ++i) {
+        lterm_pty_drain(&pty, &sink, NULL, &stats);
+    }
+    assert(stats.buffer_size == LTERM_PTY_DRAIN_MIN_BUFFER);
+    lterm_pty_close(&pty);
+}
+
+static void
+check_spawn(lterm_pty_spawn_method method)
+{
+    lterm_pty pty;
+    lterm_pty_init(&pty);
+    // Opening /dev/tty only works with a controlling terminal.
+    char *const argv[] = {"/bin/sh", "-c", "exec 3</dev/tty && printf 'ctty:%s:%s' \"$PWD\" \"$LTERM_TEST\"", NULL};
+    char *const envp[] = {"LTERM_TEST=env", NULL};
+    lterm_pty_spawn_options options = {.method = method, .envp = envp, .cwd = "/"};
+    assert(lterm_pty_spawn_with_options(&pty, "/bin/sh", argv, &options));
+
+    char output[64] = {0};
+    size_t length = 0;
+    struct pollfd pfd = {.fd = lterm_pty_get_fd(&pty), .events = POLLIN};
+    while (length < sizeof(output) - 1 && poll(&pfd, 1, 5000) == 1) {
+        ssize_t n = lterm_pty_read(&pty, (uint8_t *)output + length, sizeof(output) - 1 - length);
+        if (n <= 0) {
+            break;
+        }
+        length += (size_t)n;
+    }
+    assert(strcmp(output, "ctty:/:env") == 0);
+    lterm_pty_close(&pty);
+}
+
+static void
+test_spawn_methods(void)
+{
+    check_spawn(LTERM_PTY_SPAWN_FORK);
+    if (!lterm_pty_posix_spawn_supported()) {
+        printf("skipping posix_spawn test (unsupported)\n");
+        return;
+    }
+    check_spawn(LTERM_PTY_SPAWN_POSIX);
+
+    lterm_pty pty;
+    lterm_pty_init(&pty);
+    lterm_pty_spawn_options options = {.method = LTERM_PTY_SPAWN_POSIX};
+    assert(!lterm_pty_spawn_with_options(&pty, "/nonexistent/shell", NULL, &options));
+    assert(!lterm_pty_is_active(&pty));
+}
+
+static bool
+read_until(lterm_pty *pty, const char *needle)
+{
+    char output[4096] = {0};
+    size_t length = 0;
+    struct pollfd pfd = {.fd = lterm_pty_get_fd(pty), .events = POLLIN};
+    while (length < sizeof(output) - 1 && poll(&pfd, 1, 5000) == 1) {
+        ssize_t n = lterm_pty_read(pty, (uint8_t *)output + length, sizeof(output) - 1 - length);
+        if (n <= 0) {
+            break;
+        }
+        length += (size_t)n;
+        if (strstr(output, needle)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t
+wait_ready(lterm_pty_pool *pool, size_t wanted)
+{
+    lterm_pty_pool_stats stats = {0};
+    struct timespec pause = {0, 5 * 1000 * 1000};
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        lterm_pty_pool_get_stats(pool, &stats);
+        if (stats.ready >= wanted) {
+            break;
+        }
+        nanosleep(&pause, NULL);
+    }
+    return stats.ready;
+}
+
+static void
+test_pool(void)
+{
+    char *const envp[] = {"PATH=/usr/bin:/bin", "LTERM_TEST=pool", NULL};
+    lterm_pty_pool_spec spec = {.shell_path = "/bin/sh", .envp = envp, .cwd = "/"};
+    lterm_pty_pool *pool = lterm_pty_pool_new(&spec, 2, 24, 80);
+    assert(pool);
+    if (wait_ready(pool, 2) < 2) {
+        printf("skipping pty pool test (no pty)\n");
+        lterm_pty_pool_free(pool);
+        return;
+    }
+    lterm_pty_pool_set_geometry(pool, 30, 100);
+
+    // Only an identical spec gets a pooled shell.
+    lterm_pty pty;
+    lterm_pty_init(&pty);
+    lterm_pty_pool_spec other = spec;
+    other.cwd = "/tmp";
+    assert(!lterm_pty_pool_take(pool, &other, &pty));
+    assert(!lterm_pty_pool_take(pool, NULL, &pty));
+
+    assert(lterm_pty_pool_take(pool, &spec, &pty));
+    assert(lterm_pty_is_active(&pty));
+    const char command[] = "printf 'got:%s:%s:%s\\n' \"$(stty size)\" \"$LTERM_TEST\" \"$PWD\"; exit\n";
+    assert(lterm_pty_write(&pty, (const uint8_t *)command, sizeof(command) - 1) > 0);
+    assert(read_until(&pty, "got:30 100:pool:/"));
+    lterm_pty_close(&pty);
+
+    // The pool refills in the background; a new spec throws the old shells away.
+    assert(wait_ready(pool, 2) == 2);
+    assert(lterm_pty_pool_configure(pool, &other));
+    lterm_pty_pool_stats stats;
+    lterm_pty_pool_get_stats(pool, &stats);
+    assert(stats.hits == 1);
+    assert(stats.misses == 2);
+    assert(stats.discarded >= 2);
+    assert(!lterm_pty_pool_take(pool, &spec, &pty));
+    assert(wait_ready(pool, 1) >= 1);
+    assert(lterm_pty_pool_take(pool, &other, &pty));
+    lterm_pty_close(&pty);
+    lterm_pty_pool_free(pool);
+}
+
+// A child that outlives its PTY must still be reaped, not left as a zombie
+// (kill(pid, 0) keeps succeeding on zombies).
+static void
+test_orphan_reaped(void)
+{
+    lterm_pty pty;
+    lterm_pty_init(&pty);
+    char *const argv[] = {"/bin/sh", "-c", "trap '' HUP; sleep 0.2", NULL};
+    assert(lterm_pty_spawn(&pty, "/bin/sh", argv, NULL));
+    pid_t pid = lterm_pty_child_pid(&pty);
+    lterm_pty_close(&pty);
+    assert(!lterm_pty_exit_status(&pty, NULL));
+
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    for (int i = 0; i < 500 && kill(pid, 0) == 0; ++i) {
+        nanosleep(&pause, NULL);
+    }
+    assert(kill(pid, 0) != 0 && errno == ESRCH);
+}
+
+// Another PTY's master must not leak into a later child, or closing that
+// PTY never hangs up its shell.
+static void
+check_master_not_inherited(lterm_pty_spawn_method method)
+{
+    lterm_pty first;
+    lterm_pty_init(&first);
+    char *const sleeper[] = {"/bin/sh", "-c", "exec sleep 5", NULL};
+    lterm_pty_spawn_options options = {.method = method};
+    assert(lterm_pty_spawn_with_options(&first, "/bin/sh", sleeper, &options));
+
+    lterm_pty second;
+    lterm_pty_init(&second);
+    char *const lister[] = {"/bin/sh", "-c", "for f in /proc/$$/fd/*; do readlink $f; done; echo fds:done", NULL};
+    assert(lterm_pty_spawn_with_options(&second, "/bin/sh", lister, &options));
+    char output[4096] = {0};
+    size_t length = 0;
+    struct pollfd pfd = {.fd = lterm_pty_get_fd(&second), .events = POLLIN};
+    while (!strstr(output, "fds:done") && length < sizeof(output) - 1 && poll(&pfd, 1, 5000) == 1) {
+        ssize_t n = lterm_pty_read(&second, (uint8_t *)output + length, sizeof(output) - 1 - length);
+        if (n <= 0) {
+            break;
+        }
+        length += (size_t)n;
+    }
+    assert(strstr(output, "fds:done"));
+    assert(!strstr(output, "ptmx"));
+    lterm_pty_close(&second);
+
+    pid_t pid = lterm_pty_child_pid(&first);
+    lterm_pty_close(&first);
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    for (int i = 0; i < 200 && kill(pid, 0) == 0; ++i) {
+        nanosleep(&pause, NULL);
+    }
+    assert(kill(pid, 0) != 0);
+}
+
+static void
+test_master_not_inherited(void)
+{
+    check_master_not_inherited(LTERM_PTY_SPAWN_FORK);
+    if (lterm_pty_posix_spawn_supported()) {
+        check_master_not_inherited(LTERM_PTY_SPAWN_POSIX);
+    }
+}
+
+int
+main(void)
+{
+    test_adaptive_drain();
+    test_spawn_methods();
+    test_pool();
+    test_orphan_reaped();
+    test_master_not_inherited();
+    printf("pty tests passed\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "lterm_session.h"
+#include "lterm_session_loop.h"
+
+// 200 sessions that each print many short lines (one write() per line on the
+// child side) and receive a few keystrokes, to compare how many syscalls per
+// MB each loop backend needs.
+#define BENCH_SESSIONS 200
+#define BENCH_WORKERS 2
+#define BENCH_KEYSTROKES 16
+
+static atomic_int exited;
+
+static void
+count_exit(lterm_session *session, lterm_session_event event, void *user_data)
+{
+    (void)session;
+    (void)user_data;
+    if (event == LTERM_SESSION_EVENT_EXIT) {
+        atomic_fetch_add(&exited, 1);
+    } else if (event == LTERM_SESSION_EVENT_FRAME) {
+        lterm_session_frame_done(session);
+    }
+}
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static const char *
+backend_name(lterm_session_loop_backend backend)
+{
+    return backend == LTERM_SESSION_LOOP_BACKEND_IO_URING ? "io_uring" : "epoll";
+}
+
+static int
+run(lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(BENCH_WORKERS, backend);
+    if (!loop) {
+        printf("%-9s unavailable\n", backend_name(backend));
+        return 0;
+    }
+    atomic_store(&exited, 0);
+    lterm_session *sessions[BENCH_SESSIONS];
+    char *const argv[] = {"/bin/sh", "-c",
+                          "sleep 0.2; i=0; while [ $i -lt 400 ]; do echo \"chatty line $i\"; i=$((i+1)); done",
+                          NULL};
+    int count = 0;
+    for (; count < BENCH_SESSIONS; ++count) {
+        sessions[count] = lterm_session_new(24, 80);
+        if (!sessions[count]) {
+            break;
+        }
+        lterm_session_set_event_callback(sessions[count], count_exit, NULL);
+        if (!lterm_pty_spawn(lterm_session_pty(sessions[count]), "/bin/sh", argv, NULL) ||
+            !lterm_session_loop_add(loop, sessions[count])) {
+            lterm_session_free(sessions[count]);
+            break;
+        }
+    }
+    double start = now_seconds();
+    lterm_session_loop_start(loop);
+    for (int key = 0; key < BENCH_KEYSTROKES; ++key) {
+        for (int i = 0; i < count; ++i) {
+            lterm_session_write(sessions[i], (const uint8_t *)"k", 1);
+        }
+    }
+    struct timespec pause = {0, 2 * 1000 * 1000};
+    for (int attempt = 0; attempt < 15000 && atomic_load(&exited) < count; ++attempt) {
+        nanosleep(&pause, NULL);
+    }
+    double elapsed = now_seconds() - start;
+
+    lterm_session_loop_stats stats;
+    lterm_session_loop_get_stats(loop, &stats);
+    double megabytes = (double)stats.bytes_read / (1024.0 * 1024.0);
+    printf("%-9s %3d sessions  %6.2f MB read  %6llu B written  %8llu syscalls  %8.0f syscalls/MB  %.2fs\n",
+           backend_name(stats.backend), count, megabytes, stats.bytes_written, stats.syscalls,
+           megabytes > 0 ? (double)stats.syscalls / megabytes : 0.0, elapsed);
+    int status = atomic_load(&exited) == count ? 0 : 1;
+
+    for (int i = 0; i < count; ++i) {
+        lterm_session_loop_remove(loop, sessions[i]);
+    }
+    lterm_session_loop_free(loop);
+    for (int i = 0; i < count; ++i) {
+        lterm_session_free(sessions[i]);
+    }
+    return status;
+}
+
+int
+main(void)
+{
+    int status = run(LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    status |= run(LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,831 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lterm_broadcast.h"
+#include "lterm_paste.h"
+#include "lterm_proc_tracker.h"
+#include "lterm_resize.h"
+#include "lterm_session.h"
+#include "lterm_session_loop.h"
+#include "lterm_spsc_ring.h"
+#include "lterm_write_queue.h"
+
+static void
+test_ring_wraparound(void)
+{
+    lterm_spsc_ring ring;
+    assert(lterm_spsc_ring_init(&ring, 100));
+    assert(ring.capacity == 128);
+
+    uint8_t input[96];
+    for (size_t i = 0; i < sizeof(input); ++i) {
+        input[i] = (uint8_t)i;
+    }
+    assert(lterm_spsc_ring_write(&ring, input, sizeof(input)) == sizeof(input));
+    size_t span = 0;
+    const uint8_t *data = lterm_spsc_ring_read_span(&ring, &span);
+    assert(span == 96 && data[95] == 95);
+    lterm_spsc_ring_consume(&ring, 80);
+
+    // 96 more bytes fit (16 still queued) and wrap across the end.
+    assert(lterm_spsc_ring_write(&ring, input, sizeof(input)) == sizeof(input));
+    assert(lterm_spsc_ring_writable(&ring) == 16);
+    assert(lterm_spsc_ring_write(&ring, input, sizeof(input)) == 16);
+    assert(lterm_spsc_ring_readable(&ring) == 128);
+
+    data = lterm_spsc_ring_read_span(&ring, &span);
+    assert(span == 48);
+    assert(data[0] == 80);
+    lterm_spsc_ring_consume(&ring, span);
+    data = lterm_spsc_ring_read_span(&ring, &span);
+    assert(span == 80);
+    assert(data[0] == 32);
+    lterm_spsc_ring_free(&ring);
+}
+
+static void
+test_write_queue(void)
+{
+    lterm_write_queue queue;
+    lterm_write_queue_init(&queue);
+    // Small writes share one chunk; a large one gets its own.
+    for (int i = 0; i < 10; ++i) {
+        assert(lterm_write_queue_append(&queue, (const uint8_t *)"key", 3));
+    }
+    static uint8_t large[3 * LTERM_WRITE_QUEUE_CHUNK];
+    memset(large, 'L', sizeof(large));
+    assert(lterm_write_queue_append(&queue, large, sizeof(large)));
+    assert(lterm_write_queue_queued(&queue) == 30 + sizeof(large));
+
+    struct iovec iov[4];
+    int count = lterm_write_queue_iov(&queue, iov, 4);
+    assert(count == 2);
+    assert(iov[0].iov_len == LTERM_WRITE_QUEUE_CHUNK);
+    assert(memcmp(iov[0].iov_base, "keykey", 6) == 0);
+    assert(iov[1].iov_len == 30 + sizeof(large) - LTERM_WRITE_QUEUE_CHUNK);
+
+    lterm_write_queue_consume(&queue, LTERM_WRITE_QUEUE_CHUNK + 5);
+    count = lterm_write_queue_iov(&queue, iov, 4);
+    assert(count == 1);
+    assert(iov[0].iov_len == lterm_write_queue_queued(&queue));
+    lterm_write_queue_consume(&queue, SIZE_MAX);
+    assert(lterm_write_queue_queued(&queue) == 0);
+    assert(lterm_write_queue_iov(&queue, iov, 4) == 0);
+    assert(lterm_write_queue_append(&queue, (const uint8_t *)"again", 5));
+    assert(lterm_write_queue_iov(&queue, iov, 4) == 1 && iov[0].iov_len == 5);
+
+    // Shared buffers are referenced in place, never coalesced into.
+    lterm_shared_buffer *shared = lterm_shared_buffer_new((const uint8_t *)"paste", 5);
+    assert(shared);
+    assert(lterm_write_queue_append_shared(&queue, shared, 2));
+    assert(lterm_write_queue_append(&queue, (const uint8_t *)"!", 1));
+    assert(atomic_load(&shared->refs) == 2);
+    count = lterm_write_queue_iov(&queue, iov, 4);
+    assert(count == 3);
+    assert(iov[1].iov_base == shared->data + 2 && iov[1].iov_len == 3);
+    assert(memcmp(iov[2].iov_base, "!", 1) == 0);
+    lterm_write_queue_consume(&queue, 7);
+    assert(atomic_load(&shared->refs) == 2);
+    lterm_write_queue_consume(&queue, 1);
+    assert(atomic_load(&shared->refs) == 1);
+    assert(lterm_write_queue_queued(&queue) == 1);
+    lterm_write_queue_consume(&queue, 1);
+    assert(lterm_write_queue_append_shared(&queue, shared, 0));
+    lterm_write_queue_consume(&queue, 5);
+    assert(atomic_load(&shared->refs) == 1 && !queue.head && !queue.tail);
+    assert(lterm_write_queue_append(&queue, (const uint8_t *)"x", 1));
+    lterm_write_queue_free(&queue);
+    lterm_shared_buffer_unref(shared);
+}
+
+typedef struct {
+    atomic_int frames;
+    atomic_int exits;
+    atomic_int drained;
+    atomic_int throttles;
+    atomic_int child_exits;
+} event_counts;
+
+static void
+count_event(lterm_session *session, lterm_session_event event, void *user_data)
+{
+    (void)session;
+    event_counts *counts = user_data;
+    if (event == LTERM_SESSION_EVENT_FRAME) {
+        atomic_fetch_add(&counts->frames, 1);
+    } else if (event == LTERM_SESSION_EVENT_EXIT) {
+        atomic_fetch_add(&counts->exits, 1);
+    } else if (event == LTERM_SESSION_EVENT_WRITE_DRAINED) {
+        atomic_fetch_add(&counts->drained, 1);
+    } else if (event == LTERM_SESSION_EVENT_CHILD_EXIT) {
+        atomic_fetch_add(&counts->child_exits, 1);
+    } else {
+        atomic_fetch_add(&counts->throttles, 1);
+    }
+}
+
+static void
+test_ingest_and_process(void)
+{
+    lterm_session *session = lterm_session_new(4, 20);
+    assert(session);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+
+    const uint8_t sample[] = "hi\x1b[31mX";
+    assert(lterm_session_ingest(session, sample, sizeof(sample) - 1) == sizeof(sample) - 1);
+    assert(lterm_session_pending(session) == sizeof(sample) - 1);
+    assert(lterm_session_process(session, 4) == 4);
+    assert(atomic_load(&counts.frames) == 0);
+    assert(lterm_session_process(session, 64) == sizeof(sample) - 5);
+    assert(atomic_load(&counts.frames) == 1);
+
+    // No further FRAME until the consumer acknowledges the last one.
+    lterm_session_ingest(session, (const uint8_t *)"Y", 1);
+    lterm_session_process(session, 64);
+    assert(atomic_load(&counts.frames) == 1);
+    lterm_session_frame_done(session);
+    lterm_session_ingest(session, (const uint8_t *)"Z", 1);
+    lterm_session_process(session, 64);
+    assert(atomic_load(&counts.frames) == 2);
+
+    const lterm_screen *screen = lterm_session_screen(session);
+    assert(screen->grid.cells[0].codepoint == 'h');
+    assert(screen->grid.cells[2].codepoint == 'X');
+    assert(screen->grid.cells[2].fg == 1);
+    assert(screen->grid.cells[4].codepoint == 'Z');
+    lterm_session_free(session);
+}
+
+static void
+test_watermarks(void)
+{
+    lterm_session *session = lterm_session_new(4, 20);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    assert(!lterm_session_set_watermarks(session, 100, 1000));
+    assert(!lterm_session_set_watermarks(session, LTERM_SESSION_RING_CAPACITY + 1, 100));
+    assert(lterm_session_set_watermarks(session, 1000, 100));
+
+    static uint8_t data[1500];
+    memset(data, 'a', sizeof(data));
+    assert(lterm_session_ingest(session, data, 900) == 900);
+    assert(!lterm_session_throttled(session));
+    assert(lterm_session_ingest(session, data, 600) == 600);
+    assert(lterm_session_throttled(session));
+    assert(lterm_session_space(session) == 0);
+    assert(atomic_load(&counts.throttles) == 1);
+
+    // Still above the low watermark after parsing some of the backlog.
+    lterm_session_process(session, 1000);
+    assert(lterm_session_throttled(session));
+    lterm_session_process(session, 400);
+    assert(!lterm_session_throttled(session));
+    assert(lterm_session_space(session) > 0);
+    assert(atomic_load(&counts.throttles) == 2);
+    lterm_session_free(session);
+}
+
+static void
+test_threaded_pty(void)
+{
+    lterm_session *session = lterm_session_new(4, 40);
+    assert(session);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+
+    char *const argv[] = {"/bin/sh", "-c", "printf 'threaded\\n'", NULL};
+    if (!lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL)) {
+        printf("skipping threaded pty test (no pty)\n");
+        lterm_session_free(session);
+        return;
+    }
+    assert(lterm_session_start(session));
+    assert(lterm_session_ingest(session, (const uint8_t *)"x", 1) == 0);
+
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    for (int i = 0; i < 500 && atomic_load(&counts.exits) == 0; ++i) {
+        nanosleep(&pause, NULL);
+    }
+    assert(atomic_load(&counts.exits) == 1);
+    assert(!lterm_session_is_running(session));
+    for (int i = 0; i < 500 && atomic_load(&counts.child_exits) == 0; ++i) {
+        nanosleep(&pause, NULL);
+    }
+    lterm_pty_exit info;
+    assert(lterm_session_exit_status(session, &info));
+    assert(atomic_load(&counts.child_exits) == 1);
+    assert(info.exit_code == 0 && info.signal == 0);
+
+    lterm_session_lock(session);
+    const lterm_screen *screen = lterm_session_screen(session);
+    char row[9] = {0};
+    for (size_t i = 0; i < 8; ++i) {
+        row[i] = (char)screen->grid.cells[i].codepoint;
+    }
+    lterm_session_unlock(session);
+    assert(strcmp(row, "threaded") == 0);
+
+    lterm_session_stop(session);
+    lterm_session_free(session);
+}
+
+// A drag through many sizes resizes the screen once per tick and the PTY
+// once, after the last size has settled.
+static void
+test_resize_coordinator(void)
+{
+    lterm_session *session = lterm_session_new(4, 40);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    char *const argv[] = {"/bin/sh", "-c", "read line; stty size", NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+
+    lterm_resize_coordinator resize;
+    lterm_resize_coordinator_init(&resize, 50);
+    int64_t now = 1000000000;
+    for (size_t step = 0; step < 20; ++step) {
+        lterm_resize_coordinator_request(&resize, 4 + step / 10, 20 + step, now);
+        lterm_resize_coordinator_request(&resize, 5 + step / 10, 20 + step, now);
+        assert(lterm_resize_coordinator_tick(&resize, session, now));
+        now += 16 * 1000000;
+    }
+    assert(resize.stats.requests == 40);
+    assert(resize.stats.screen_resizes == 20 && resize.stats.pty_resizes == 0);
+    assert(lterm_session_screen(session)->grid.cols == 39);
+    // Settled: one TIOCSWINSZ; more ticks and repeats of the size send none.
+    assert(!lterm_resize_coordinator_tick(&resize, session, now + 50 * 1000000));
+    lterm_resize_coordinator_request(&resize, 6, 39, now + 60 * 1000000);
+    assert(!lterm_resize_coordinator_tick(&resize, session, now + 200 * 1000000));
+    assert(resize.stats.pty_resizes == 1 && resize.stats.screen_resizes == 20);
+
+    assert(lterm_session_start(session));
+    assert(lterm_session_write(session, (const uint8_t *)"\r", 1));
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    for (int i = 0; i < 500 && atomic_load(&counts.exits) == 0; ++i) {
+        nanosleep(&pause, NULL);
+    }
+    assert(atomic_load(&counts.exits) == 1);
+    lterm_session_lock(session);
+    const lterm_screen *screen = lterm_session_screen(session);
+    size_t cells = screen->grid.rows * screen->grid.cols;
+    char text[6 * 39 + 1] = {0};
+    for (size_t i = 0; i < cells && i < sizeof(text) - 1; ++i) {
+        uint32_t codepoint = screen->grid.cells[i].codepoint;
+        text[i] = codepoint ? (char)codepoint : ' ';
+    }
+    lterm_session_unlock(session);
+    assert(strstr(text, "6 39"));
+    lterm_session_stop(session);
+    lterm_session_free(session);
+}
+
+#define LOOP_SESSIONS 8
+
+static bool
+spawn_printf(lterm_session *session, int index)
+{
+    char script[64];
+    snprintf(script, sizeof(script), "printf 'session-%d'", index);
+    char *const argv[] = {"/bin/sh", "-c", script, NULL};
+    return lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL);
+}
+
+static void
+check_printf_output(lterm_session *session, int index)
+{
+    char expected[16];
+    snprintf(expected, sizeof(expected), "session-%d", index);
+    lterm_session_lock(session);
+    const lterm_screen *screen = lterm_session_screen(session);
+    for (size_t i = 0; expected[i]; ++i) {
+        assert(screen->grid.cells[i].codepoint == (uint32_t)expected[i]);
+    }
+    lterm_session_unlock(session);
+}
+
+static void
+run_loop_sessions(size_t workers, bool own_thread, lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(workers, backend);
+    assert(loop);
+    lterm_session *sessions[LOOP_SESSIONS];
+    event_counts counts[LOOP_SESSIONS];
+    for (int i = 0; i < LOOP_SESSIONS; ++i) {
+        sessions[i] = lterm_session_new(2, 20);
+        atomic_init(&counts[i].frames, 0);
+        atomic_init(&counts[i].exits, 0);
+        atomic_init(&counts[i].drained, 0);
+        atomic_init(&counts[i].throttles, 0);
+        lterm_session_set_event_callback(sessions[i], count_event, &counts[i]);
+        assert(spawn_printf(sessions[i], i));
+        assert(lterm_session_loop_add(loop, sessions[i]));
+    }
+    if (own_thread) {
+        assert(lterm_session_loop_start(loop));
+    }
+
+    struct timespec pause = {0, 5 * 1000 * 1000};
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        int exited = 0;
+        for (int i = 0; i < LOOP_SESSIONS; ++i) {
+            exited += atomic_load(&counts[i].exits);
+        }
+        if (exited == LOOP_SESSIONS) {
+            break;
+        }
+        if (own_thread) {
+            nanosleep(&pause, NULL);
+        } else {
+            lterm_session_loop_dispatch(loop, 5);
+        }
+    }
+
+    lterm_session_loop_stats stats;
+    lterm_session_loop_get_stats(loop, &stats);
+    assert(stats.sessions == LOOP_SESSIONS);
+    assert(stats.workers == workers);
+    assert(stats.wakeups > 0);
+    assert(stats.backend == backend);
+    assert(stats.bytes_read >= LOOP_SESSIONS * strlen("session-0"));
+    for (int i = 0; i < LOOP_SESSIONS; ++i) {
+        assert(atomic_load(&counts[i].exits) == 1);
+        check_printf_output(sessions[i], i);
+        lterm_session_loop_remove(loop, sessions[i]);
+    }
+    lterm_session_loop_get_stats(loop, &stats);
+    assert(stats.sessions == 0);
+    lterm_session_loop_free(loop);
+    for (int i = 0; i < LOOP_SESSIONS; ++i) {
+        lterm_session_free(sessions[i]);
+    }
+}
+
+static void
+test_loop_write(lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(0, backend);
+    lterm_session *session = lterm_session_new(4, 20);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    char *const argv[] = {"/bin/sh", "-c", "read line; printf 'got:%s' \"$line\"", NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+    assert(lterm_session_loop_add(loop, session));
+    assert(lterm_session_write(session, (const uint8_t *)"ab", 2));
+    assert(lterm_session_write(session, (const uint8_t *)"c\r", 2));
+    for (int attempt = 0; attempt < 1000 && atomic_load(&counts.exits) == 0; ++attempt) {
+        lterm_session_loop_dispatch(loop, 5);
+    }
+    assert(atomic_load(&counts.exits) == 1);
+
+    lterm_session_loop_stats stats;
+    lterm_session_loop_get_stats(loop, &stats);
+    assert(stats.bytes_written == 4);
+    const lterm_screen *screen = lterm_session_screen(session);
+    char text[81] = {0};
+    for (size_t i = 0; i < 80; ++i) {
+        uint32_t codepoint = screen->grid.cells[i].codepoint;
+        text[i] = codepoint ? (char)codepoint : ' ';
+    }
+    assert(strstr(text, "got:abc"));
+    lterm_session_loop_remove(loop, session);
+    lterm_session_loop_free(loop);
+    lterm_session_free(session);
+}
+
+#define BROADCAST_SESSIONS 20
+
+// One send reaches every member through a single shared buffer.
+static void
+test_loop_broadcast(lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(0, backend);
+    lterm_broadcast_group *group = lterm_broadcast_group_new(loop);
+    lterm_session *sessions[BROADCAST_SESSIONS];
+    event_counts counts[BROADCAST_SESSIONS];
+    char *const argv[] = {"/bin/sh", "-c", "read line; printf 'got:%s' \"$line\"", NULL};
+    for (int i = 0; i < BROADCAST_SESSIONS; ++i) {
+        sessions[i] = lterm_session_new(4, 20);
+        memset(&counts[i], 0, sizeof(counts[i]));
+        lterm_session_set_event_callback(sessions[i], count_event, &counts[i]);
+        assert(lterm_pty_spawn(lterm_session_pty(sessions[i]), "/bin/sh", argv, NULL));
+        assert(lterm_session_loop_add(loop, sessions[i]));
+        assert(lterm_broadcast_group_add(group, sessions[i]));
+    }
+    assert(lterm_broadcast_group_add(group, sessions[0]));
+    assert(lterm_broadcast_group_count(group) == BROADCAST_SESSIONS);
+
+    assert(lterm_broadcast_send(group, (const uint8_t *)"fan", 3) == BROADCAST_SESSIONS);
+    assert(lterm_broadcast_send(group, (const uint8_t *)"out\r", 4) == BROADCAST_SESSIONS);
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        int exited = 0;
+        for (int i = 0; i < BROADCAST_SESSIONS; ++i) {
+            exited += atomic_load(&counts[i].exits);
+        }
+        if (exited == BROADCAST_SESSIONS) {
+            break;
+        }
+        lterm_session_loop_dispatch(loop, 5);
+    }
+
+    lterm_session_loop_stats stats;
+    lterm_session_loop_get_stats(loop, &stats);
+    assert(stats.bytes_written == BROADCAST_SESSIONS * 7);
+    for (int i = 0; i < BROADCAST_SESSIONS; ++i) {
+        assert(atomic_load(&counts[i].exits) == 1);
+        const lterm_screen *screen = lterm_session_screen(sessions[i]);
+        char text[81] = {0};
+        for (size_t j = 0; j < 80; ++j) {
+            uint32_t codepoint = screen->grid.cells[j].codepoint;
+            text[j] = codepoint ? (char)codepoint : ' ';
+        }
+        assert(strstr(text, "got:fanout"));
+        lterm_broadcast_group_remove(group, sessions[i]);
+        lterm_session_loop_remove(loop, sessions[i]);
+        lterm_session_free(sessions[i]);
+    }
+    assert(lterm_broadcast_group_count(group) == 0);
+    lterm_broadcast_group_free(group);
+    lterm_session_loop_free(loop);
+}
+
+// A focused session still answers while another session floods the loop.
+static void
+test_loop_fairness(lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(0, backend);
+    lterm_session_loop_set_slice(loop, 8 * 1024, 200);
+    lterm_session *flood = lterm_session_new(4, 20);
+    lterm_session *echo = lterm_session_new(4, 20);
+    event_counts flood_counts = {0};
+    event_counts echo_counts = {0};
+    lterm_session_set_event_callback(flood, count_event, &flood_counts);
+    lterm_session_set_event_callback(echo, count_event, &echo_counts);
+    char *const flood_argv[] = {"/bin/sh", "-c", "exec cat", NULL};
+    char *const echo_argv[] = {"/bin/sh", "-c", "read line; printf 'got:%s' \"$line\"", NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(flood), "/bin/sh", flood_argv, NULL));
+    assert(lterm_pty_spawn(lterm_session_pty(echo), "/bin/sh", echo_argv, NULL));
+
+    // The echo is already waiting in the PTY (the child has answered and hung
+    // up) and the flood has far more than one slice queued, so the outcome
+    // depends on scheduling order alone, not on how fast the host parses.
+    const int echo_fd = lterm_pty_get_fd(lterm_session_pty(echo));
+    assert(write(echo_fd, "hi\r", 3) == 3);
+    struct pollfd pfd = {.fd = echo_fd, .events = POLLIN};
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    for (int attempt = 0; attempt < 500 && poll(&pfd, 1, 0) >= 0 && !(pfd.revents & POLLHUP); ++attempt) {
+        nanosleep(&pause, NULL);
+    }
+    assert(pfd.revents & POLLHUP);
+    static uint8_t backlog[64 * 8 * 1024];
+    memset(backlog, 'y', sizeof(backlog));
+    assert(lterm_session_ingest(flood, backlog, sizeof(backlog)) == sizeof(backlog));
+
+    assert(lterm_session_loop_add(loop, flood));
+    assert(lterm_session_loop_add(loop, echo));
+    assert(!lterm_session_loop_set_focused(loop, NULL, true));
+    assert(lterm_session_loop_set_focused(loop, echo, true));
+    for (int attempt = 0; attempt < 1000 && atomic_load(&echo_counts.exits) == 0; ++attempt) {
+        lterm_session_loop_dispatch(loop, 5);
+    }
+    assert(atomic_load(&echo_counts.exits) == 1);
+    assert(lterm_session_pending(flood) > 0);
+    lterm_session_loop_stats stats;
+    lterm_session_loop_get_stats(loop, &stats);
+    assert(stats.slices_cut > 0);
+    assert(atomic_load(&flood_counts.exits) == 0);
+
+    lterm_session_loop_remove(loop, flood);
+    lterm_session_loop_remove(loop, echo);
+    lterm_session_loop_free(loop);
+    lterm_session_free(flood);
+    lterm_session_free(echo);
+}
+
+#define BACKPRESSURE_BYTES 200000
+
+// The child reads nothing for a while, so most of the input has to wait in
+// the session's queue; all of it must still arrive.
+static void
+run_write_backpressure(lterm_session_loop *loop)
+{
+    lterm_session *session = lterm_session_new(4, 40);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    char *const argv[] = {"/bin/sh", "-c", "stty -echo; sleep 0.2; head -c 200000 | wc -c", NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+    if (loop) {
+        assert(lterm_session_loop_add(loop, session));
+    } else {
+        assert(lterm_session_start(session));
+    }
+
+    static uint8_t input[BACKPRESSURE_BYTES];
+    for (size_t i = 0; i < sizeof(input); ++i) {
+        input[i] = i % 64 == 63 ? '\n' : 'x';
+    }
+    for (size_t offset = 0; offset < sizeof(input); offset += 1000) {
+        assert(lterm_session_write(session, input + offset, 1000));
+    }
+    assert(lterm_session_write_queued(session) > 0);
+
+    struct timespec pause = {0, 5 * 1000 * 1000};
+    for (int attempt = 0; attempt < 1000 && atomic_load(&counts.exits) == 0; ++attempt) {
+        if (loop) {
+            lterm_session_loop_dispatch(loop, 5);
+        } else {
+            nanosleep(&pause, NULL);
+        }
+    }
+    assert(atomic_load(&counts.exits) == 1);
+    assert(atomic_load(&counts.drained) >= 1);
+    assert(lterm_session_write_queued(session) == 0);
+
+    lterm_session_lock(session);
+    const lterm_screen *screen = lterm_session_screen(session);
+    char text[161] = {0};
+    for (size_t i = 0; i < 160; ++i) {
+        uint32_t codepoint = screen->grid.cells[i].codepoint;
+        text[i] = codepoint ? (char)codepoint : ' ';
+    }
+    lterm_session_unlock(session);
+    assert(strstr(text, "200000"));
+    if (loop) {
+        lterm_session_loop_remove(loop, session);
+    }
+    lterm_session_free(session);
+}
+
+static void
+test_write_backpressure(void)
+{
+    run_write_backpressure(NULL);
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(0, LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    run_write_backpressure(loop);
+    lterm_session_loop_free(loop);
+    loop = lterm_session_loop_new_with_backend(0, LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    if (loop) {
+        run_write_backpressure(loop);
+        lterm_session_loop_free(loop);
+    }
+}
+
+// Each record sanitizes to 44 'x' and one CR; the ESC, C0 and C1 bytes are
+// dropped. The child turns on bracketed paste and counts what arrives.
+#define PASTE_RECORDS 2000
+#define PASTE_EXPECTED (PASTE_RECORDS * 45 + 12)
+
+static bool
+bracketed_paste_enabled(lterm_session *session)
+{
+    lterm_session_lock(session);
+    bool enabled = lterm_screen_dec_mode(lterm_session_screen(session), LTERM_DEC_MODE_BRACKETED_PASTE);
+    lterm_session_unlock(session);
+    return enabled;
+}
+
+static void
+test_paste(void)
+{
+    lterm_session *session = lterm_session_new(4, 40);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    char script[96];
+    snprintf(script, sizeof(script), "stty raw -echo; printf '\\033[?2004h'; head -c %d | wc -c", PASTE_EXPECTED);
+    char *const argv[] = {"/bin/sh", "-c", script, NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+    assert(lterm_session_start(session));
+
+    struct timespec pause = {0, 1000 * 1000};
+    for (int attempt = 0; attempt < 5000 && !bracketed_paste_enabled(session); ++attempt) {
+        nanosleep(&pause, NULL);
+    }
+    assert(bracketed_paste_enabled(session));
+
+    FILE *source = tmpfile();
+    assert(source);
+    static const char record[] = "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\x1b\x01\xc2\x9b\r\n";
+    for (int i = 0; i < PASTE_RECORDS; ++i) {
+        fwrite(record, 1, sizeof(record) - 1, source);
+    }
+    fflush(source);
+    rewind(source);
+
+    lterm_paste_options options = {.bracket = LTERM_PASTE_BRACKET_AUTO, .sanitize = true,
+                                   .total = PASTE_RECORDS * (sizeof(record) - 1)};
+    lterm_paste *paste = lterm_paste_new(session, &options);
+    assert(lterm_paste_bracketed(paste));
+    lterm_paste_status status;
+    while ((status = lterm_paste_pump_fd(paste, fileno(source))) == LTERM_PASTE_BLOCKED) {
+        assert(lterm_session_write_queued(session) < LTERM_PASTE_HIGH_WATER + LTERM_PASTE_CHUNK + 16);
+        nanosleep(&pause, NULL);
+    }
+    assert(status == LTERM_PASTE_DONE);
+    assert(lterm_paste_consumed(paste) == lterm_paste_total(paste));
+    assert(!lterm_paste_feed(paste, (const uint8_t *)"x", 1));
+    lterm_paste_free(paste);
+    fclose(source);
+
+    for (int attempt = 0; attempt < 5000 && atomic_load(&counts.exits) == 0; ++attempt) {
+        nanosleep(&pause, NULL);
+    }
+    assert(atomic_load(&counts.exits) == 1);
+    lterm_session_lock(session);
+    const lterm_screen *screen = lterm_session_screen(session);
+    char text[161] = {0};
+    for (size_t i = 0; i < 160; ++i) {
+        uint32_t codepoint = screen->grid.cells[i].codepoint;
+        text[i] = codepoint ? (char)codepoint : ' ';
+    }
+    lterm_session_unlock(session);
+    char expected[16];
+    snprintf(expected, sizeof(expected), "%d", PASTE_EXPECTED);
+    assert(strstr(text, expected));
+    lterm_session_free(session);
+}
+
+// The child fills the PTY before the loop first reads it, so with tiny
+// watermarks the loop has to pause and resume reading to get everything.
+static void
+run_loop_throttle(lterm_session_loop_backend backend)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(0, backend);
+    assert(loop);
+    lterm_session *session = lterm_session_new(4, 40);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    assert(lterm_session_set_watermarks(session, 1024, 256));
+    char *const argv[] = {"/bin/sh", "-c", "head -c 300000 /dev/zero | tr '\\0' x; echo; echo done", NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+    assert(lterm_session_loop_add(loop, session));
+
+    struct timespec pause = {0, 200 * 1000 * 1000};
+    nanosleep(&pause, NULL);
+    for (int attempt = 0; attempt < 2000 && atomic_load(&counts.exits) == 0; ++attempt) {
+        lterm_session_loop_dispatch(loop, 5);
+        assert(lterm_session_pending(session) <= 1024 + LTERM_SESSION_LOOP_READ_BUDGET);
+    }
+    assert(atomic_load(&counts.exits) == 1);
+    assert(atomic_load(&counts.throttles) >= 2);
+    assert(!lterm_session_throttled(session));
+    lterm_session_loop_stats stats;
+    lterm_session_loop_get_stats(loop, &stats);
+    assert(stats.bytes_read >= 300000);
+    lterm_session_loop_remove(loop, session);
+    lterm_session_loop_free(loop);
+    lterm_session_free(session);
+}
+
+// The pidfd is reaped by the loop itself; exit code and signal come back
+// through lterm_session_exit_status().
+static void
+run_loop_child_exit(lterm_session_loop_backend backend, const char *script, int code, int signal)
+{
+    lterm_session_loop *loop = lterm_session_loop_new_with_backend(0, backend);
+    assert(loop);
+    lterm_session *session = lterm_session_new(4, 40);
+    event_counts counts = {0};
+    lterm_session_set_event_callback(session, count_event, &counts);
+    char *const argv[] = {"/bin/sh", "-c", (char *)script, NULL};
+    assert(lterm_pty_spawn(lterm_session_pty(session), "/bin/sh", argv, NULL));
+    pid_t pid = lterm_pty_child_pid(lterm_session_pty(session));
+    assert(lterm_session_loop_add(loop, session));
+
+    for (int attempt = 0; attempt < 2000 && (atomic_load(&counts.exits) == 0 ||
+                                             atomic_load(&counts.child_exits) == 0); ++attempt) {
+        lterm_session_loop_dispatch(loop, 5);
+    }
+    assert(atomic_load(&counts.exits) == 1);
+    assert(atomic_load(&counts.child_exits) == 1);
+    lterm_pty_exit info;
+    assert(lterm_session_exit_status(session, &info));
+    assert(info.exited && info.pid == pid);
+    assert(info.exit_code == code);
+    assert(info.signal == signal);
+    assert(lterm_pty_child_pid(lterm_session_pty(session)) < 0);
+    lterm_session_loop_remove(loop, session);
+    lterm_session_loop_free(loop);
+
+    // Still available once the PTY is closed.
+    lterm_pty_close(lterm_session_pty(session));
+    assert(lterm_session_exit_status(session, &info) && info.exit_code == code);
+    lterm_session_free(session);
+}
+
+static void
+test_session_loop(void)
+{
+    run_loop_sessions(0, false, LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    run_loop_sessions(3, true, LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    test_loop_write(LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    test_loop_broadcast(LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    test_loop_fairness(LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    run_loop_throttle(LTERM_SESSION_LOOP_BACKEND_EPOLL);
+    run_loop_child_exit(LTERM_SESSION_LOOP_BACKEND_EPOLL, "exit 7", 7, 0);
+    run_loop_child_exit(LTERM_SESSION_LOOP_BACKEND_EPOLL, "kill -TERM $$", -1, 15);
+
+    lterm_session_loop *probe = lterm_session_loop_new_with_backend(0, LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    if (!probe) {
+        printf("skipping io_uring loop tests (unsupported)\n");
+        return;
+    }
+    lterm_session_loop_free(probe);
+    run_loop_sessions(0, false, LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    run_loop_sessions(3, true, LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    test_loop_write(LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    test_loop_broadcast(LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    test_loop_fairness(LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    run_loop_throttle(LTERM_SESSION_LOOP_BACKEND_IO_URING);
+    run_loop_child_exit(LTERM_SESSION_LOOP_BACKEND_IO_URING, "exit 3", 3, 0);
+}
+
+static void
+count_proc_change(lterm_session *session, const lterm_proc_info *info, void *user_data)
+{
+    (void)session;
+    (void)info;
+    atomic_fetch_add((atomic_int *)user_data, 1);
+}
+
+static bool
+wait_proc_info(lterm_proc_tracker *tracker, lterm_session *session, const char *name, const char *cwd,
+               lterm_proc_info *info)
+{
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    for (int i = 0; i < 500; ++i) {
+        if (lterm_proc_tracker_get(tracker, session, info) && (!name || strcmp(info->name, name) == 0) &&
+            strcmp(info->cwd, cwd) == 0) {
+            return true;
+        }
+        nanosleep(&pause, NULL);
+    }
+    return false;
+}
+
+// An interactive shell with job control puts "sleep" into its own foreground
+// process group, which the tracker picks up from tcgetpgrp().
+static void
+test_proc_tracker(void)
+{
+    lterm_session *session = lterm_session_new(4, 40);
+    char *const argv[] = {"/bin/sh", "-i", NULL};
+    char *const envp[] = {"PATH=/usr/bin:/bin", "PS1=$ ", NULL};
+    lterm_pty_spawn_options options = {.envp = envp, .cwd = "/"};
+    if (!lterm_pty_spawn_with_options(lterm_session_pty(session), "/bin/sh", argv, &options)) {
+        printf("skipping proc tracker test (no pty)\n");
+        lterm_session_free(session);
+        return;
+    }
+    pid_t shell = lterm_pty_child_pid(lterm_session_pty(session));
+    lterm_proc_tracker *tracker = lterm_proc_tracker_new(20);
+    assert(tracker);
+    atomic_int changes = 0;
+    assert(lterm_proc_tracker_add(tracker, session, count_proc_change, &changes));
+    assert(!lterm_proc_tracker_add(tracker, session, count_proc_change, &changes));
+
+    lterm_proc_info info;
+    assert(wait_proc_info(tracker, session, "sh", "/", &info));
+    assert(info.shell_foreground && info.foreground_pid == shell && !info.cwd_reported);
+
+    const char command[] = "cd /tmp; sleep 5\n";
+    assert(lterm_session_write(session, (const uint8_t *)command, sizeof(command) - 1));
+    assert(wait_proc_info(tracker, session, "sleep", "/tmp", &info));
+    assert(!info.shell_foreground && info.foreground_pgrp != shell);
+
+    const char report[] = "file://localhost/srv/my%20project";
+    lterm_proc_tracker_report_cwd(tracker, session, report, sizeof(report) - 1);
+    assert(wait_proc_info(tracker, session, NULL, "/srv/my project", &info));
+    assert(info.cwd_reported);
+    lterm_proc_tracker_report_cwd(tracker, session, NULL, 0);
+    assert(wait_proc_info(tracker, session, NULL, "/tmp", &info));
+    assert(atomic_load(&changes) >= 4);
+
+    lterm_proc_tracker_remove(tracker, session);
+    assert(!lterm_proc_tracker_get(tracker, session, &info));
+    lterm_proc_tracker_free(tracker);
+    lterm_session_free(session);
+}
+
+int
+main(void)
+{
+    test_ring_wraparound();
+    test_write_queue();
+    test_ingest_and_process();
+    test_watermarks();
+    test_threaded_pty();
+    test_resize_coordinator();
+    test_session_loop();
+    test_write_backpressure();
+    test_paste();
+    test_proc_tracker();
+    printf("session tests passed\n");
+    return 0;
+}
@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lterm_sessiond.h"
+#include "lterm_sessiond_proto.h"
+
+static void *
+server_main(void *user_data)
+{
+    assert(lterm_sessiond_server_run(user_data));
+    return NULL;
+}
+
+static void
+row_text(const lterm_cell *cells, size_t cols, char *text)
+{
+    size_t length = 0;
+    for (size_t col = 0; col < cols; ++col) {
+        uint32_t codepoint = cells[col].codepoint;
+        text[col] = codepoint > ' ' && codepoint < 127 ? (char)codepoint : ' ';
+        if (text[col] != ' ') {
+            length = col + 1;
+        }
+    }
+    text[length] = '\0';
+}
+
+static bool
+screen_has_row(const lterm_screen *screen, const char *expected)
+{
+    char text[256];
+    for (size_t row = 0; row < screen->grid.rows; ++row) {
+        row_text(screen->grid.cells + row * screen->grid.cols, screen->grid.cols, text);
+        if (strcmp(text, expected) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    const lterm_screen *screen;
+    const char *row;
+    size_t rows;
+    uint32_t id;
+    bool want_exit;
+} wait_target;
+
+static bool
+reached(lterm_sessiond_client *client, const wait_target *target)
+{
+    if (target->want_exit) {
+        return lterm_sessiond_exit_status(client, target->id, NULL, NULL);
+    }
+    if (target->rows && target->screen->grid.rows != target->rows) {
+        return false;
+    }
+    return !target->row || screen_has_row(target->screen, target->row);
+}
+
+static bool
+dispatch_until(lterm_sessiond_client *client, const wait_target *target)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!reached(client, target)) {
+        struct pollfd pfd = {.fd = lterm_sessiond_client_fd(client), .events = POLLIN};
+        poll(&pfd, 1, 100);
+        if (!lterm_sessiond_dispatch(client)) {
+            return false;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - start.tv_sec > 10) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+test_detach_reattach(void)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lterm-sessiond-test-%d.sock", (int)getpid());
+    lterm_sessiond_server *server = lterm_sessiond_server_new(path);
+    if (!server) {
+        printf("skipping sessiond test (cannot listen)\n");
+        return;
+    }
+    // A second daemon must not steal a live socket.
+    assert(!lterm_sessiond_server_new(path));
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, server_main, server) == 0);
+
+    lterm_sessiond_client *client = lterm_sessiond_connect(path);
+    assert(client);
+    uint32_t id = 0;
+    if (!lterm_sessiond_create(client, 10, 40, "/bin/sh", &id)) {
+        printf("skipping sessiond test (no pty)\n");
+        lterm_sessiond_disconnect(client);
+        lterm_sessiond_server_stop(server);
+        pthread_join(thread, NULL);
+        lterm_sessiond_server_free(server);
+        return;
+    }
+    lterm_screen screen;
+    lterm_screen_init(&screen, 1, 1);
+    int master_fd = -1;
+    assert(lterm_sessiond_attach(client, id, &screen, &master_fd));
+    assert(master_fd >= 0);
+    assert(screen.grid.rows == 10 && screen.grid.cols == 40);
+
+    const char *command = "seq 1 300; echo mark''er\r";
+    assert(write(master_fd, command, strlen(command)) == (ssize_t)strlen(command));
+    assert(dispatch_until(client, &(wait_target){.screen = &screen, .row = "marker"}));
+    assert(screen_has_row(&screen, "300"));
+
+    // History stays in the daemon until asked for.
+    size_t lines = lterm_sessiond_scrollback_lines(client, id);
+    assert(lines >= 290);
+    lterm_cell history[4 * 40];
+    assert(lterm_sessiond_fetch_scrollback(client, id, 0, 4, history, 40) == 4);
+    // The tty may echo the command before the prompt is drawn, which leaves
+    // "1" sharing a row with the prompt, so look for "2" then "3".
+    char text[41];
+    bool found = false;
+    for (size_t line = 0; line + 1 < 4 && !found; ++line) {
+        row_text(history + line * 40, 40, text);
+        if (strcmp(text, "2") == 0) {
+            row_text(history + (line + 1) * 40, 40, text);
+            found = strcmp(text, "3") == 0;
+        }
+    }
+    assert(found);
+    assert(lterm_sessiond_fetch_scrollback(client, id, lines, 4, history, 40) == 0);
+    close(master_fd);
+    lterm_sessiond_disconnect(client);
+    lterm_screen_free(&screen);
+
+    // A fresh client sees the same session and screen.
+    client = lterm_sessiond_connect(path);
+    assert(client);
+    uint32_t ids[4];
+    assert(lterm_sessiond_list(client, ids, 4) == 1 && ids[0] == id);
+    lterm_screen_init(&screen, 3, 3);
+    master_fd = -1;
+    assert(lterm_sessiond_attach(client, id, &screen, &master_fd));
+    assert(master_fd >= 0);
+    assert(screen.grid.rows == 10 && screen.grid.cols == 40);
+    assert(screen_has_row(&screen, "marker"));
+    assert(lterm_sessiond_scrollback_lines(client, id) == lines);
+    assert(!lterm_sessiond_attach(client, id + 100, &screen, NULL));
+
+    assert(lterm_sessiond_resize(client, id, 12, 50));
+    assert(dispatch_until(client, &(wait_target){.screen = &screen, .rows = 12}));
+    assert(screen.grid.cols == 50);
+
+    command = "exit\r";
+    assert(write(master_fd, command, strlen(command)) == (ssize_t)strlen(command));
+    assert(dispatch_until(client, &(wait_target){.id = id, .want_exit = true}));
+    int exit_code = -1;
+    int signal = -1;
+    assert(lterm_sessiond_exit_status(client, id, &exit_code, &signal));
+    assert(exit_code == 0 && signal == 0);
+    close(master_fd);
+
+    // The daemon answers a resize of an exited session with an ERROR that
+    // no request is waiting on; it must not fail the next one.
+    assert(lterm_sessiond_resize(client, id, 20, 60));
+    assert(lterm_sessiond_list(client, ids, 4) == 1 && ids[0] == id);
+
+    assert(lterm_sessiond_close(client, id));
+    assert(lterm_sessiond_list(client, ids, 4) == 0);
+    lterm_sessiond_disconnect(client);
+    lterm_screen_free(&screen);
+
+    lterm_sessiond_server_stop(server);
+    pthread_join(thread, NULL);
+    lterm_sessiond_server_free(server);
+    assert(access(path, F_OK) != 0);
+}
+
+static long long
+elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000LL + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+static void
+test_stalled_client(void)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lterm-sessiond-stall-%d.sock", (int)getpid());
+    lterm_sessiond_server *server = lterm_sessiond_server_new(path);
+    if (!server) {
+        printf("skipping stalled client test (cannot listen)\n");
+        return;
+    }
+    pthread_t thread;
+    assert(pthread_create(&thread, NULL, server_main, server) == 0);
+    lterm_sessiond_client *client = lterm_sessiond_connect(path);
+    assert(client);
+    uint32_t id = 0;
+    if (!lterm_sessiond_create(client, 50, 200, "/bin/sh", &id)) {
+        printf("skipping stalled client test (no pty)\n");
+        lterm_sessiond_disconnect(client);
+        lterm_sessiond_server_stop(server);
+        pthread_join(thread, NULL);
+        lterm_sessiond_server_free(server);
+        return;
+    }
+
+    // A client that asks for snapshots and never reads them fills its socket;
+    // the daemon must keep serving everyone else meanwhile.
+    int stalled = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    assert(stalled >= 0);
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    memcpy(address.sun_path, path, strlen(path) + 1);
+    assert(connect(stalled, (struct sockaddr *)&address, sizeof(address)) == 0);
+    struct {
+        lterm_sessiond_header header;
+        lterm_sessiond_id_msg attach;
+    } request = {
+        .header = {.type = LTERM_SESSIOND_MSG_ATTACH, .length = sizeof(lterm_sessiond_id_msg)},
+        .attach = {.id = id},
+    };
+    for (int i = 0; i < 64; ++i) {
+        assert(write(stalled, &request, sizeof(request)) == (ssize_t)sizeof(request));
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint32_t ids[4];
+    assert(lterm_sessiond_list(client, ids, 4) == 1 && ids[0] == id);
+    assert(elapsed_ms(&start) < LTERM_SESSIOND_IO_TIMEOUT_MS / 5);
+    close(stalled);
+
+    assert(lterm_sessiond_close(client, id));
+    lterm_sessiond_disconnect(client);
+    lterm_sessiond_server_stop(server);
+    pthread_join(thread, NULL);
+    lterm_sessiond_server_free(server);
+}
+
+int
+main(void)
+{
+    test_detach_reattach();
+    test_stalled_client();
+    printf("sessiond tests passed\n");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#include "lterm_pty.h"
+
+// Tab-open latency (openpty + spawn) with fork and posix_spawn while the host
+// process holds an increasingly large, fully touched heap. The ballast is kept
+// off transparent huge pages so its page tables look like a real UI heap.
+#define BENCH_SPAWNS 40
+
+static const size_t kHostMegabytes[] = {0, 256, 1024};
+
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static const char *
+method_name(lterm_pty_spawn_method method)
+{
+    return method == LTERM_PTY_SPAWN_POSIX ? "posix_spawn" : "fork";
+}
+
+static int
+run(lterm_pty_spawn_method method, size_t megabytes)
+{
+    char *const argv[] = {"/bin/true", NULL};
+    lterm_pty_spawn_options options = {.method = method};
+    double total = 0.0;
+    double worst = 0.0;
+    for (int i = 0; i < BENCH_SPAWNS; ++i) {
+        lterm_pty pty;
+        lterm_pty_init(&pty);
+        double start = now_seconds();
+        if (!lterm_pty_spawn_with_options(&pty, "/bin/true", argv, &options)) {
+            printf("%-11s spawn failed\n", method_name(method));
+            return 1;
+        }
+        double elapsed = now_seconds() - start;
+        total += elapsed;
+        if (elapsed > worst) {
+            worst = elapsed;
+        }
+        waitpid(lterm_pty_child_pid(&pty), NULL, 0);
+        lterm_pty_close(&pty);
+    }
+    printf("%-11s %5zu MB host  %8.1f us avg  %8.1f us max\n", method_name(method), megabytes,
+           total / BENCH_SPAWNS * 1e6, worst * 1e6);
+    return 0;
+}
+
+int
+main(void)
+{
+    int status = 0;
+    for (size_t i = 0; i < sizeof(kHostMegabytes) / sizeof(kHostMegabytes[0]); ++i) {
+        size_t bytes = kHostMegabytes[i] * 1024 * 1024;
+        char *ballast = NULL;
+        if (bytes) {
+            ballast = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ballast == MAP_FAILED) {
+                printf("%5zu MB host unavailable\n", kHostMegabytes[i]);
+                continue;
+            }
+#ifdef MADV_NOHUGEPAGE
+            madvise(ballast, bytes, MADV_NOHUGEPAGE);
+#endif
+            memset(ballast, 1, bytes);
+        }
+        status |= run(LTERM_PTY_SPAWN_FORK, kHostMegabytes[i]);
+        if (lterm_pty_posix_spawn_supported()) {
+            status |= run(LTERM_PTY_SPAWN_POSIX, kHostMegabytes[i]);
+        }
+        if (ballast) {
+            munmap(ballast, bytes);
+        }
+    }
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
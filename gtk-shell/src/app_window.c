@@ -88,11 +88,29 @@ lterm_app_window_new(GtkApplication *app)
     GtkWidget *tmux_value = gtk_label_new("(No activity)");
     gtk_box_append(GTK_BOX(tmux_row), tmux_value);
 
+    GtkWidget *input_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_append(GTK_BOX(status_box), input_row);
+    GtkWidget *input_caption = gtk_label_new("Input:");
+    gtk_widget_add_css_class(input_caption, "dim-label");
+    gtk_box_append(GTK_BOX(input_row), input_caption);
+    GtkWidget *input_value = gtk_label_new("(Idle)");
+    gtk_box_append(GTK_BOX(input_row), input_value);
+
+    GtkWidget *output_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_append(GTK_BOX(status_box), output_row);
+    GtkWidget *output_caption = gtk_label_new("Output:");
+    gtk_widget_add_css_class(output_caption, "dim-label");
+    gtk_box_append(GTK_BOX(output_row), output_caption);
+    GtkWidget *output_value = gtk_label_new("(Flowing)");
+    gtk_box_append(GTK_BOX(output_row), output_value);
+
     CoreBridge *bridge = core_bridge_new(GTK_WINDOW(window),
                                          terminal,
                                          title_value,
                                          clipboard_value,
-                                         tmux_value);
+                                         tmux_value,
+                                         input_value,
+                                         output_value);
     if (!core_bridge_start_shell(bridge, NULL)) {
         core_bridge_feed_demo(bridge);
     }
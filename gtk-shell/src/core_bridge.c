@@ -2,43 +2,160 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkkeysyms.h>
 
 #include "lterm_screen.h"
+#include "lterm_log.h"
+#include "lterm_paste.h"
+#include "lterm_proc_tracker.h"
+#include "lterm_resize.h"
 #include "lterm_pty.h"
+#include "lterm_pty_pool.h"
+#include "lterm_session.h"
+#include "lterm_session_loop.h"
 #include "terminal_view.h"
 #include "lterm_parser.h"
 #include "lterm_token.h"
 #include "lterm_token_types.h"
 
+typedef enum {
+    UI_EVENT_FRAME,
+    UI_EVENT_EXIT,
+    UI_EVENT_TITLE,
+    UI_EVENT_CLIPBOARD,
+    UI_EVENT_TMUX,
+    UI_EVENT_INPUT_DRAINED,
+    UI_EVENT_OUTPUT_THROTTLE,
+    UI_EVENT_CHILD_EXIT,
+    UI_EVENT_PROCESS,
+} UiEventType;
+
+// Session callbacks run on the parse thread; they are marshalled to the GTK
+// main loop through this queue.
+typedef struct {
+    UiEventType type;
+    char payload[256];
+} UiEvent;
+
+// A clipboard paste in flight. Reads are issued one chunk at a time and only
+// while the session can take more input. The job outlives the bridge when a
+// read is still pending; the read callback then frees it.
+typedef struct {
+    CoreBridge *bridge;
+    lterm_paste *paste;
+    GInputStream *stream;
+    GCancellable *cancellable;
+    bool read_pending;
+    uint8_t buffer[LTERM_PASTE_CHUNK];
+} PasteJob;
+
 struct _CoreBridge {
-    lterm_parser *parser;
-    lterm_screen screen;
-    lterm_pty pty;
+    lterm_session *session;
     GtkWindow *window;
     GtkWidget *terminal_view;
     GtkWidget *title_label;
     GtkWidget *clipboard_label;
     GtkWidget *tmux_label;
-    GIOChannel *pty_channel;
-    guint pty_watch_id;
-    gboolean using_screen;
+    GtkWidget *input_label;
+    GtkWidget *output_label;
+    PasteJob *paste_job;
+    // Set while LTERM_SESSION_LOG_DIR asks for a transcript of the shell.
+    lterm_log *log;
+    // An OSC title wins over the foreground process/cwd title.
+    bool has_osc_title;
+    GAsyncQueue *events;
+    gint dispatch_scheduled;
+    gulong active_handler;
+    // Window-edge drags: the screen follows each frame, the shell only the
+    // settled size.
+    lterm_resize_coordinator resize;
+    guint resize_tick;
+    // Speculative local echo; NULL when LTERM_PREDICTIVE_ECHO=0.
+    lterm_predictor *predictor;
 };
 
+#define CORE_BRIDGE_PARSE_WORKERS 2
+#define CORE_BRIDGE_SHELL_POOL 1
+
+// All bridges share one reactor thread and a small parse worker pool.
+static lterm_session_loop *shared_loop;
+static guint shared_loop_users;
+// Default-profile shells spawned ahead of time so new tabs start instantly.
+// LTERM_SHELL_POOL sets how many (0 disables).
+static lterm_pty_pool *shell_pool;
+// Foreground job and cwd of every bridge's shell, for the title.
+static lterm_proc_tracker *proc_tracker;
+
 static void parser_callback(const lterm_token *token, void *user_data);
 static void terminal_view_handle_resize(size_t cols, size_t rows, void *user_data);
+static gboolean dispatch_events(gpointer user_data);
+static void paste_end(CoreBridge *bridge);
+
+static void
+copy_payload(char *dest, size_t dest_size, const uint8_t *payload, size_t length)
+{
+    if (payload && length > 0) {
+        size_t copy = length < dest_size - 1 ? length : dest_size - 1;
+        memcpy(dest, payload, copy);
+    }
+}
+
+static void
+post_event(CoreBridge *bridge, UiEventType type, const uint8_t *payload, size_t length)
+{
+    UiEvent *event = g_new0(UiEvent, 1);
+    event->type = type;
+    copy_payload(event->payload, sizeof(event->payload), payload, length);
+    g_async_queue_push(bridge->events, event);
+    if (g_atomic_int_compare_and_exchange(&bridge->dispatch_scheduled, 0, 1)) {
+        g_idle_add(dispatch_events, bridge);
+    }
+}
+
+static void
+show_input_backlog(CoreBridge *bridge)
+{
+    if (!bridge->input_label) {
+        return;
+    }
+    size_t queued = lterm_session_write_queued(bridge->session);
+    if (bridge->paste_job) {
+        size_t sent = bridge->paste_job->paste ? lterm_paste_consumed(bridge->paste_job->paste) : 0;
+        g_autofree char *text = g_strdup_printf("Pasting\u2026 (%zu KB read, %zu KB queued; Esc cancels)",
+                                                (sent + 1023) / 1024, (queued + 1023) / 1024);
+        gtk_label_set_text(GTK_LABEL(bridge->input_label), text);
+        return;
+    }
+    if (queued == 0) {
+        gtk_label_set_text(GTK_LABEL(bridge->input_label), "(Idle)");
+        return;
+    }
+    g_autofree char *text = g_strdup_printf("Sending\u2026 (%zu KB queued)", (queued + 1023) / 1024);
+    gtk_label_set_text(GTK_LABEL(bridge->input_label), text);
+}
 
 static bool
 pty_write_all(CoreBridge *bridge, const uint8_t *data, size_t length)
 {
-    if (!bridge || !data || !length || !lterm_pty_is_active(&bridge->pty)) {
+    if (!bridge || !data || !length || !lterm_pty_is_active(lterm_session_pty(bridge->session))) {
         return false;
     }
-    ssize_t written = lterm_pty_write(&bridge->pty, data, length);
-    return written == (ssize_t)length;
+    if (bridge->predictor && lterm_session_predict(bridge->session, data, length)) {
+        gtk_widget_queue_draw(bridge->terminal_view);
+    }
+    // Whatever the PTY cannot take right now stays queued in the session
+    // and is flushed by the loop when the PTY becomes writable.
+    if (!lterm_session_write(bridge->session, data, length)) {
+        return false;
+    }
+    if (lterm_session_write_queued(bridge->session) > 0) {
+        show_input_backlog(bridge);
+    }
+    return true;
 }
 
 static bool
@@ -47,13 +164,20 @@ send_bytes_with_alt(CoreBridge *bridge, const uint8_t *data, size_t length, bool
     if (!bridge || !data || !length) {
         return false;
     }
-    if (alt_prefix) {
-        const uint8_t esc = 0x1b;
-        if (!pty_write_all(bridge, &esc, 1)) {
-            return false;
-        }
+    if (!alt_prefix) {
+        return pty_write_all(bridge, data, length);
+    }
+    // ESC and the key go out in a single write so the child never sees a
+    // lone ESC (and we make one syscall, not two).
+    uint8_t stack[64];
+    uint8_t *buffer = length + 1 <= sizeof(stack) ? stack : g_malloc(length + 1);
+    buffer[0] = 0x1b;
+    memcpy(buffer + 1, data, length);
+    bool ok = pty_write_all(bridge, buffer, length + 1);
+    if (buffer != stack) {
+        g_free(buffer);
     }
-    return pty_write_all(bridge, data, length);
+    return ok;
 }
 
 static bool
@@ -71,32 +195,39 @@ attach_screen(CoreBridge *bridge)
     if (!bridge || !bridge->terminal_view) {
         return;
     }
-    if (!bridge->using_screen) {
-        terminal_view_set_screen(bridge->terminal_view, &bridge->screen);
-        bridge->using_screen = TRUE;
-    }
+    terminal_view_set_session(bridge->terminal_view, bridge->session);
     gtk_widget_queue_draw(bridge->terminal_view);
 }
 
+static gboolean
+resize_tick(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data)
+{
+    CoreBridge *bridge = user_data;
+    unsigned long long sent = bridge->resize.stats.pty_resizes;
+    bool pending = lterm_resize_coordinator_tick(&bridge->resize,
+                                                 bridge->session,
+                                                 gdk_frame_clock_get_frame_time(clock) * 1000);
+    if (bridge->resize.stats.pty_resizes != sent) {
+        lterm_pty_pool_set_geometry(shell_pool, bridge->resize.pty_rows, bridge->resize.pty_cols);
+    }
+    gtk_widget_queue_draw(widget);
+    if (pending) {
+        return G_SOURCE_CONTINUE;
+    }
+    bridge->resize_tick = 0;
+    return G_SOURCE_REMOVE;
+}
+
 static void
 terminal_view_handle_resize(size_t cols, size_t rows, void *user_data)
 {
     CoreBridge *bridge = user_data;
-    if (!bridge) {
+    if (!bridge || !bridge->terminal_view) {
         return;
     }
-    if (cols == 0) {
-        cols = 1;
-    }
-    if (rows == 0) {
-        rows = 1;
-    }
-    lterm_screen_set_size(&bridge->screen, rows, cols);
-    if (lterm_pty_is_active(&bridge->pty)) {
-        lterm_pty_resize(&bridge->pty, rows, cols);
-    }
-    if (bridge->terminal_view) {
-        gtk_widget_queue_draw(bridge->terminal_view);
+    lterm_resize_coordinator_request(&bridge->resize, rows, cols, g_get_monotonic_time() * 1000);
+    if (!bridge->resize_tick) {
+        bridge->resize_tick = gtk_widget_add_tick_callback(bridge->terminal_view, resize_tick, bridge, NULL);
     }
 }
 
@@ -107,73 +238,112 @@ stop_pty(CoreBridge *bridge)
     if (!bridge) {
         return;
     }
-    if (bridge->pty_watch_id) {
-        g_source_remove(bridge->pty_watch_id);
-        bridge->pty_watch_id = 0;
-    }
-    if (bridge->pty_channel) {
-        g_io_channel_unref(bridge->pty_channel);
-        bridge->pty_channel = NULL;
+    paste_end(bridge);
+    lterm_proc_tracker_remove(proc_tracker, bridge->session);
+    lterm_session_loop_remove(shared_loop, bridge->session);
+    lterm_pty_close(lterm_session_pty(bridge->session));
+    if (bridge->log) {
+        lterm_session_set_log(bridge->session, NULL);
+        lterm_log_close(bridge->log);
+        bridge->log = NULL;
     }
-    lterm_pty_close(&bridge->pty);
 }
 
-static gboolean
-pty_watch_cb(GIOChannel *source, GIOCondition condition, gpointer user_data)
+// The active window's shell gets the larger parse share in the shared loop.
+static void
+window_active_changed(GObject *object, GParamSpec *pspec, gpointer user_data)
 {
+    (void)object;
+    (void)pspec;
     CoreBridge *bridge = user_data;
-    if (!bridge) {
-        return G_SOURCE_REMOVE;
-    }
+    lterm_session_loop_set_focused(shared_loop, bridge->session, gtk_window_is_active(bridge->window));
+}
 
-    if (condition & (G_IO_HUP | G_IO_ERR)) {
-        stop_pty(bridge);
-        return G_SOURCE_REMOVE;
+// One plain-text, timestamped transcript per shell in LTERM_SESSION_LOG_DIR.
+static void
+start_log(CoreBridge *bridge)
+{
+    const char *dir = g_getenv("LTERM_SESSION_LOG_DIR");
+    if (!dir || !dir[0]) {
+        return;
     }
-
-    uint8_t buffer[4096];
-    ssize_t n = lterm_pty_read(&bridge->pty, buffer, sizeof(buffer));
-    if (n > 0) {
-        lterm_parser_feed(bridge->parser, buffer, (size_t)n, parser_callback, bridge);
-        gtk_widget_queue_draw(bridge->terminal_view);
+    static guint log_serial;
+    g_autoptr(GDateTime) now = g_date_time_new_now_local();
+    g_autofree char *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    g_autofree char *name = g_strdup_printf("lterm-%s-%d-%u.log", stamp, (int)getpid(), ++log_serial);
+    g_autofree char *path = g_build_filename(dir, name, NULL);
+    const lterm_log_options options = {
+        .path = path,
+        .format = LTERM_LOG_PLAIN,
+        .timestamps = LTERM_LOG_TIMESTAMP_LINE,
+    };
+    bridge->log = lterm_log_open(&options);
+    if (!bridge->log) {
+        g_warning("Failed to open session log %s", path);
+        return;
     }
-
-    return TRUE;
+    lterm_session_set_log(bridge->session, bridge->log);
 }
 
-static const char *
-describe_token_type(lterm_token_type type)
+static void
+session_event_cb(lterm_session *session, lterm_session_event event, void *user_data)
 {
-    switch (type) {
-        case LTERM_TOKEN_OSC:
-        case LTERM_TOKEN_XTERM_WIN_TITLE:
-        case LTERM_TOKEN_XTERM_ICON_TITLE:
-        case LTERM_TOKEN_XTERM_WINICON_TITLE:
-            return "OSC";
-        case LTERM_TOKEN_CLIPBOARD_CONTROL:
-            return "Clipboard";
-        case LTERM_TOKEN_DCS:
-            return "DCS";
-        case LTERM_TOKEN_ANSI_RIS:
-            return "ANSI RIS";
-        default:
-            return "Token";
+    (void)session;
+    CoreBridge *bridge = user_data;
+    switch (event) {
+        case LTERM_SESSION_EVENT_FRAME:
+            post_event(bridge, UI_EVENT_FRAME, NULL, 0);
+            break;
+        case LTERM_SESSION_EVENT_EXIT:
+            post_event(bridge, UI_EVENT_EXIT, NULL, 0);
+            break;
+        case LTERM_SESSION_EVENT_WRITE_DRAINED:
+            post_event(bridge, UI_EVENT_INPUT_DRAINED, NULL, 0);
+            break;
+        case LTERM_SESSION_EVENT_THROTTLE:
+            post_event(bridge, UI_EVENT_OUTPUT_THROTTLE, NULL, 0);
+            break;
+        case LTERM_SESSION_EVENT_CHILD_EXIT:
+            post_event(bridge, UI_EVENT_CHILD_EXIT, NULL, 0);
+            break;
     }
 }
 
+// Events can arrive out of order across threads, so the label always shows
+// the session's current state rather than what the event said.
 static void
-handle_osc_title(CoreBridge *bridge, const lterm_token *token)
+show_output_flow(CoreBridge *bridge)
 {
-    if (!bridge || (!bridge->title_label && !bridge->window)) {
+    if (!bridge->output_label) {
         return;
     }
-    char payload[256] = {0};
-    if (token->ascii.length > 0 && token->ascii.buffer) {
-        size_t copy = token->ascii.length < sizeof(payload) - 1
-                          ? token->ascii.length
-                          : sizeof(payload) - 1;
-        memcpy(payload, token->ascii.buffer, copy);
+    if (!lterm_session_throttled(bridge->session)) {
+        gtk_label_set_text(GTK_LABEL(bridge->output_label), "(Flowing)");
+        return;
     }
+    size_t pending = lterm_session_pending(bridge->session);
+    g_autofree char *text = g_strdup_printf("Paused \u2014 parser behind (%zu KB unparsed)", (pending + 1023) / 1024);
+    gtk_label_set_text(GTK_LABEL(bridge->output_label), text);
+}
+
+static void
+show_child_exit(CoreBridge *bridge)
+{
+    lterm_pty_exit info;
+    if (!bridge->output_label || !lterm_session_exit_status(bridge->session, &info)) {
+        return;
+    }
+    double cpu = (double)(info.usage.ru_utime.tv_sec + info.usage.ru_stime.tv_sec) +
+                 (double)(info.usage.ru_utime.tv_usec + info.usage.ru_stime.tv_usec) / 1e6;
+    g_autofree char *text = info.signal
+        ? g_strdup_printf("Shell killed by signal %d (%.2fs CPU)", info.signal, cpu)
+        : g_strdup_printf("Shell exited with code %d (%.2fs CPU)", info.exit_code, cpu);
+    gtk_label_set_text(GTK_LABEL(bridge->output_label), text);
+}
+
+static void
+show_title(CoreBridge *bridge, const char *payload)
+{
     const char *text = payload[0] ? payload : "(Untitled)";
     if (bridge->title_label) {
         gtk_label_set_text(GTK_LABEL(bridge->title_label), text);
@@ -184,18 +354,8 @@ handle_osc_title(CoreBridge *bridge, const lterm_token *token)
 }
 
 static void
-handle_clipboard(CoreBridge *bridge, const lterm_token *token)
+show_clipboard(CoreBridge *bridge, const char *payload)
 {
-    if (!bridge) {
-        return;
-    }
-    char payload[256] = {0};
-    if (token->ascii.length > 0 && token->ascii.buffer) {
-        size_t copy = token->ascii.length < sizeof(payload) - 1
-                          ? token->ascii.length
-                          : sizeof(payload) - 1;
-        memcpy(payload, token->ascii.buffer, copy);
-    }
     if (bridge->clipboard_label) {
         gtk_label_set_text(GTK_LABEL(bridge->clipboard_label),
                            payload[0] ? payload : "(Clipboard updated)");
@@ -223,38 +383,262 @@ handle_clipboard(CoreBridge *bridge, const lterm_token *token)
 }
 
 static void
-handle_tmux(CoreBridge *bridge, const lterm_token *token)
+paste_job_free(PasteJob *job)
+{
+    g_clear_object(&job->stream);
+    g_clear_object(&job->cancellable);
+    lterm_paste_free(job->paste);
+    g_free(job);
+}
+
+static void
+paste_end(CoreBridge *bridge)
 {
-    if (!bridge || !bridge->tmux_label) {
+    PasteJob *job = bridge->paste_job;
+    if (!job) {
         return;
     }
-    char payload[256] = {0};
-    if (token->ascii.length > 0 && token->ascii.buffer) {
-        size_t copy = token->ascii.length < sizeof(payload) - 1
-                          ? token->ascii.length
-                          : sizeof(payload) - 1;
-        memcpy(payload, token->ascii.buffer, copy);
+    bridge->paste_job = NULL;
+    // The paste references the session, so it goes now even if a read is
+    // still in flight.
+    lterm_paste_free(job->paste);
+    job->paste = NULL;
+    job->bridge = NULL;
+    if (job->read_pending) {
+        g_cancellable_cancel(job->cancellable);
+    } else {
+        paste_job_free(job);
+    }
+    show_input_backlog(bridge);
+}
+
+static void paste_read_ready(GObject *source, GAsyncResult *result, gpointer user_data);
+
+static void
+paste_continue(CoreBridge *bridge)
+{
+    PasteJob *job = bridge->paste_job;
+    if (!job || job->read_pending || !job->paste) {
+        return;
+    }
+    show_input_backlog(bridge);
+    switch (lterm_paste_get_status(job->paste)) {
+        case LTERM_PASTE_RUNNING:
+            job->read_pending = true;
+            g_input_stream_read_async(job->stream, job->buffer, sizeof(job->buffer), G_PRIORITY_DEFAULT,
+                                      job->cancellable, paste_read_ready, job);
+            break;
+        case LTERM_PASTE_BLOCKED:
+            // Resumed by UI_EVENT_INPUT_DRAINED.
+            break;
+        default:
+            paste_end(bridge);
+            break;
     }
-    gtk_label_set_text(GTK_LABEL(bridge->tmux_label),
-                       payload[0] ? payload : "(tmux passthrough)");
 }
 
 static void
-handle_text(CoreBridge *bridge, const lterm_token *token)
+paste_read_ready(GObject *source, GAsyncResult *result, gpointer user_data)
 {
-    if (!bridge || !bridge->terminal_view) {
+    PasteJob *job = user_data;
+    GError *error = NULL;
+    gssize count = g_input_stream_read_finish(G_INPUT_STREAM(source), result, &error);
+    job->read_pending = false;
+    if (!job->bridge) {
+        g_clear_error(&error);
+        paste_job_free(job);
         return;
     }
-    if (bridge->using_screen) {
-        gtk_widget_queue_draw(bridge->terminal_view);
+    if (count > 0) {
+        lterm_paste_feed(job->paste, job->buffer, (size_t)count);
+    } else if (count == 0) {
+        lterm_paste_finish(job->paste);
+    } else {
+        g_warning("Clipboard read failed: %s", error ? error->message : "unknown error");
+        lterm_paste_cancel(job->paste);
+    }
+    g_clear_error(&error);
+    paste_continue(job->bridge);
+}
+
+static void
+clipboard_read_ready(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    PasteJob *job = user_data;
+    GError *error = NULL;
+    GInputStream *stream = gdk_clipboard_read_finish(GDK_CLIPBOARD(source), result, NULL, &error);
+    job->read_pending = false;
+    if (!job->bridge) {
+        g_clear_object(&stream);
+        g_clear_error(&error);
+        paste_job_free(job);
+        return;
+    }
+    CoreBridge *bridge = job->bridge;
+    if (!stream) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("Clipboard paste failed: %s", error ? error->message : "no text");
+        }
+        g_clear_error(&error);
+        paste_end(bridge);
         return;
     }
-    if (token->ascii.length == 0 || !token->ascii.buffer) {
+    job->stream = stream;
+    // The clipboard length is unknown up front, so progress is bytes read.
+    lterm_paste_options options = {.bracket = LTERM_PASTE_BRACKET_AUTO, .sanitize = true};
+    job->paste = lterm_paste_new(bridge->session, &options);
+    if (!job->paste) {
+        paste_end(bridge);
         return;
     }
-    gchar *text = g_strndup((const gchar *)token->ascii.buffer, token->ascii.length);
-    terminal_view_append_text(bridge->terminal_view, text);
-    g_free(text);
+    paste_continue(bridge);
+}
+
+static bool
+paste_clipboard(CoreBridge *bridge)
+{
+    if (bridge->paste_job || !bridge->window) {
+        return true;
+    }
+    GdkDisplay *display = gtk_widget_get_display(GTK_WIDGET(bridge->window));
+    GdkClipboard *clipboard = display ? gdk_display_get_clipboard(display) : NULL;
+    if (!clipboard) {
+        return false;
+    }
+    static const char *mime_types[] = {"text/plain;charset=utf-8", "text/plain", NULL};
+    PasteJob *job = g_new0(PasteJob, 1);
+    job->bridge = bridge;
+    job->cancellable = g_cancellable_new();
+    job->read_pending = true;
+    bridge->paste_job = job;
+    gdk_clipboard_read_async(clipboard, mime_types, G_PRIORITY_DEFAULT, job->cancellable,
+                             clipboard_read_ready, job);
+    show_input_backlog(bridge);
+    return true;
+}
+
+static void
+cancel_paste(CoreBridge *bridge)
+{
+    PasteJob *job = bridge->paste_job;
+    if (!job) {
+        return;
+    }
+    if (!job->paste) {
+        paste_end(bridge);
+        return;
+    }
+    // Closes the bracket; a pending read finishes and then ends the job.
+    lterm_paste_cancel(job->paste);
+    paste_continue(bridge);
+}
+
+static void
+show_tmux(CoreBridge *bridge, const char *payload)
+{
+    if (!bridge->tmux_label) {
+        return;
+    }
+    gtk_label_set_text(GTK_LABEL(bridge->tmux_label),
+                       payload[0] ? payload : "(tmux passthrough)");
+}
+
+static gboolean
+dispatch_events(gpointer user_data)
+{
+    CoreBridge *bridge = user_data;
+    g_atomic_int_set(&bridge->dispatch_scheduled, 0);
+    UiEvent *event = NULL;
+    while ((event = g_async_queue_try_pop(bridge->events))) {
+        switch (event->type) {
+            case UI_EVENT_FRAME:
+                if (bridge->terminal_view) {
+                    gtk_widget_queue_draw(bridge->terminal_view);
+                }
+                break;
+            case UI_EVENT_EXIT:
+                stop_pty(bridge);
+                show_child_exit(bridge);
+                break;
+            case UI_EVENT_TITLE:
+                bridge->has_osc_title = event->payload[0] != '\0';
+                show_title(bridge, event->payload);
+                break;
+            case UI_EVENT_PROCESS:
+                if (!bridge->has_osc_title) {
+                    show_title(bridge, event->payload);
+                }
+                break;
+            case UI_EVENT_CLIPBOARD:
+                show_clipboard(bridge, event->payload);
+                break;
+            case UI_EVENT_TMUX:
+                show_tmux(bridge, event->payload);
+                break;
+            case UI_EVENT_INPUT_DRAINED:
+                show_input_backlog(bridge);
+                paste_continue(bridge);
+                break;
+            case UI_EVENT_OUTPUT_THROTTLE:
+                show_output_flow(bridge);
+                break;
+            case UI_EVENT_CHILD_EXIT:
+                show_child_exit(bridge);
+                break;
+        }
+        g_free(event);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void
+process_changed(lterm_session *session, const lterm_proc_info *info, void *user_data)
+{
+    (void)session;
+    CoreBridge *bridge = user_data;
+    const char *home = g_get_home_dir();
+    size_t home_length = home ? strlen(home) : 0;
+    g_autofree char *title = NULL;
+    if (home_length > 1 && strncmp(info->cwd, home, home_length) == 0 &&
+        (info->cwd[home_length] == '/' || info->cwd[home_length] == '\0')) {
+        title = g_strdup_printf("%s: ~%s", info->name, info->cwd + home_length);
+    } else {
+        title = g_strdup_printf("%s: %s", info->name, info->cwd);
+    }
+    post_event(bridge, UI_EVENT_PROCESS, (const uint8_t *)title, strlen(title));
+}
+
+static bool
+handle_osc_cwd(int code, const uint8_t *payload, size_t length, void *user_data)
+{
+    (void)code;
+    CoreBridge *bridge = user_data;
+    lterm_proc_tracker_report_cwd(proc_tracker, bridge->session, (const char *)payload, length);
+    return true;
+}
+
+static bool
+handle_osc_title(int code, const uint8_t *payload, size_t length, void *user_data)
+{
+    (void)code;
+    CoreBridge *bridge = user_data;
+    if (!bridge || (!bridge->title_label && !bridge->window)) {
+        return false;
+    }
+    post_event(bridge, UI_EVENT_TITLE, payload, length);
+    return true;
+}
+
+static bool
+handle_clipboard(int code, const uint8_t *payload, size_t length, void *user_data)
+{
+    (void)code;
+    CoreBridge *bridge = user_data;
+    if (!bridge) {
+        return false;
+    }
+    post_event(bridge, UI_EVENT_CLIPBOARD, payload, length);
+    return true;
 }
 
 static void
@@ -265,20 +649,11 @@ parser_callback(const lterm_token *token, void *user_data)
         return;
     }
     switch (token->type) {
-        case LTERM_TOKEN_XTERM_WIN_TITLE:
-        case LTERM_TOKEN_XTERM_WINICON_TITLE:
-        case LTERM_TOKEN_XTERM_ICON_TITLE:
-            handle_osc_title(bridge, token);
-            break;
-        case LTERM_TOKEN_CLIPBOARD_CONTROL:
-            handle_clipboard(bridge, token);
-            break;
         case LTERM_TOKEN_TMUX:
         case LTERM_TOKEN_DCS:
-            handle_tmux(bridge, token);
+            post_event(bridge, UI_EVENT_TMUX, token->ascii.buffer, token->ascii.length);
             break;
         default:
-            handle_text(bridge, token);
             break;
     }
 }
@@ -288,18 +663,57 @@ core_bridge_new(GtkWindow *window,
                 GtkWidget *terminal_view,
                 GtkWidget *title_label,
                 GtkWidget *clipboard_label,
-                GtkWidget *tmux_label)
+                GtkWidget *tmux_label,
+                GtkWidget *input_label,
+                GtkWidget *output_label)
 {
+    if (!shared_loop) {
+        shared_loop = lterm_session_loop_new(CORE_BRIDGE_PARSE_WORKERS);
+        if (shared_loop && !lterm_session_loop_start(shared_loop)) {
+            lterm_session_loop_free(shared_loop);
+            shared_loop = NULL;
+        }
+    }
+    if (!proc_tracker) {
+        proc_tracker = lterm_proc_tracker_new(0);
+    }
+    if (!shell_pool) {
+        const char *size = g_getenv("LTERM_SHELL_POOL");
+        guint64 count = size ? g_ascii_strtoull(size, NULL, 10) : CORE_BRIDGE_SHELL_POOL;
+        if (count > 0) {
+            shell_pool = lterm_pty_pool_new(NULL, (size_t)count, 24, 80);
+        }
+    }
+    shared_loop_users++;
+
     CoreBridge *bridge = g_new0(CoreBridge, 1);
-    lterm_screen_init(&bridge->screen, 24, 80);
-    lterm_pty_init(&bridge->pty);
-    bridge->parser = lterm_parser_new(&bridge->screen);
+    bridge->events = g_async_queue_new();
+    bridge->session = lterm_session_new(24, 80);
+    lterm_session_set_token_callback(bridge->session, parser_callback, bridge);
+    lterm_session_set_event_callback(bridge->session, session_event_cb, bridge);
+    lterm_parser *parser = lterm_session_parser(bridge->session);
+    lterm_parser_register_osc_handler(parser, LTERM_OSC_WINICON_TITLE, handle_osc_title, bridge);
+    lterm_parser_register_osc_handler(parser, LTERM_OSC_ICON_TITLE, handle_osc_title, bridge);
+    lterm_parser_register_osc_handler(parser, LTERM_OSC_WIN_TITLE, handle_osc_title, bridge);
+    lterm_parser_register_osc_handler(parser, LTERM_OSC_CURRENT_DIRECTORY, handle_osc_cwd, bridge);
+    lterm_parser_register_osc_handler(parser, LTERM_OSC_CLIPBOARD, handle_clipboard, bridge);
+    lterm_resize_coordinator_init(&bridge->resize, 0);
+    const char *predict = g_getenv("LTERM_PREDICTIVE_ECHO");
+    if (!predict || strcmp(predict, "0") != 0) {
+        bridge->predictor = lterm_predictor_new();
+        lterm_session_set_predictor(bridge->session, bridge->predictor);
+        terminal_view_set_predictor(terminal_view, bridge->predictor);
+    }
     bridge->window = window;
     bridge->terminal_view = terminal_view;
     terminal_view_set_resize_callback(terminal_view, terminal_view_handle_resize, bridge);
     bridge->title_label = title_label;
     bridge->clipboard_label = clipboard_label;
     bridge->tmux_label = tmux_label;
+    bridge->input_label = input_label;
+    bridge->output_label = output_label;
+    bridge->active_handler =
+        g_signal_connect(window, "notify::is-active", G_CALLBACK(window_active_changed), bridge);
     attach_screen(bridge);
     return bridge;
 }
@@ -310,18 +724,40 @@ core_bridge_free(CoreBridge *bridge)
     if (!bridge) {
         return;
     }
+    g_signal_handler_disconnect(bridge->window, bridge->active_handler);
+    if (bridge->resize_tick) {
+        gtk_widget_remove_tick_callback(bridge->terminal_view, bridge->resize_tick);
+    }
     stop_pty(bridge);
-    if (bridge->parser) {
-        lterm_parser_free(bridge->parser);
+    while (g_idle_remove_by_data(bridge)) {
+    }
+    if (bridge->terminal_view) {
+        terminal_view_set_session(bridge->terminal_view, NULL);
+        terminal_view_set_predictor(bridge->terminal_view, NULL);
+    }
+    lterm_session_free(bridge->session);
+    lterm_predictor_free(bridge->predictor);
+    UiEvent *event = NULL;
+    while ((event = g_async_queue_try_pop(bridge->events))) {
+        g_free(event);
     }
-    lterm_screen_free(&bridge->screen);
+    g_async_queue_unref(bridge->events);
     g_free(bridge);
+
+    if (--shared_loop_users == 0) {
+        lterm_session_loop_free(shared_loop);
+        shared_loop = NULL;
+        lterm_pty_pool_free(shell_pool);
+        shell_pool = NULL;
+        lterm_proc_tracker_free(proc_tracker);
+        proc_tracker = NULL;
+    }
 }
 
 void
 core_bridge_feed_demo(CoreBridge *bridge)
 {
-    if (!bridge || !bridge->parser) {
+    if (!bridge || !bridge->session) {
         return;
     }
 
@@ -329,11 +765,8 @@ core_bridge_feed_demo(CoreBridge *bridge)
                        "Welcome to lTerm2 on Linux!\nEnjoy the new GTK shell.\n"
                        "\x1b]52;c;c29weQ==\x07"
                        "\x1bPtmux;session-ready%exit\x1b\\";
-    lterm_parser_feed(bridge->parser,
-                      (const uint8_t *)demo,
-                      strlen(demo),
-                      parser_callback,
-                      bridge);
+    lterm_session_ingest(bridge->session, (const uint8_t *)demo, strlen(demo));
+    lterm_session_process(bridge->session, strlen(demo));
     attach_screen(bridge);
 }
 
@@ -346,17 +779,20 @@ core_bridge_start_shell(CoreBridge *bridge, const char *shell_path)
 
     stop_pty(bridge);
 
-    if (!lterm_pty_spawn_shell(&bridge->pty, shell_path)) {
+    const lterm_pty_pool_spec spec = {.shell_path = shell_path};
+    if (!lterm_session_spawn_pooled(bridge->session, shell_pool, &spec) &&
+        !lterm_session_spawn_shell(bridge->session, shell_path)) {
         g_warning("Failed to spawn shell for PTY session");
         return false;
     }
-
-    bridge->pty_channel = g_io_channel_unix_new(lterm_pty_get_fd(&bridge->pty));
-    g_io_channel_set_encoding(bridge->pty_channel, NULL, NULL);
-    g_io_channel_set_buffered(bridge->pty_channel, FALSE);
-    g_io_channel_set_close_on_unref(bridge->pty_channel, FALSE);
-    bridge->pty_watch_id =
-        g_io_add_watch(bridge->pty_channel, G_IO_IN | G_IO_HUP | G_IO_ERR, pty_watch_cb, bridge);
+    start_log(bridge);
+    if (!lterm_session_loop_add(shared_loop, bridge->session)) {
+        g_warning("Failed to attach PTY session to the session loop");
+        stop_pty(bridge);
+        return false;
+    }
+    lterm_proc_tracker_add(proc_tracker, bridge->session, process_changed, bridge);
+    window_active_changed(G_OBJECT(bridge->window), NULL, bridge);
 
     attach_screen(bridge);
     return true;
@@ -381,16 +817,25 @@ handle_control_combo(uint8_t *buffer, size_t *length, guint keyval)
 bool
 core_bridge_handle_key(CoreBridge *bridge, guint keyval, GdkModifierType state)
 {
-    if (!bridge || !lterm_pty_is_active(&bridge->pty)) {
+    if (!bridge || !lterm_pty_is_active(lterm_session_pty(bridge->session))) {
         return false;
     }
 
     const bool ctrl = (state & GDK_CONTROL_MASK) != 0;
     const bool alt = (state & GDK_ALT_MASK) != 0;
+    const bool shift = (state & GDK_SHIFT_MASK) != 0;
     uint8_t buffer[8] = {0};
     size_t length = 0;
     const char *sequence = NULL;
 
+    if (ctrl && shift && (keyval == GDK_KEY_V || keyval == GDK_KEY_v)) {
+        return paste_clipboard(bridge);
+    }
+    if (bridge->paste_job && keyval == GDK_KEY_Escape) {
+        cancel_paste(bridge);
+        return true;
+    }
+
     if (ctrl && handle_control_combo(buffer, &length, keyval)) {
         return send_bytes_with_alt(bridge, buffer, length, alt);
     }
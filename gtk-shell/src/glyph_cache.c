@@ -0,0 +1,317 @@
+#include "glyph_cache.h"
+
+#define GLYPH_CACHE_ATLAS_PIXELS 1024
+#define GLYPH_CACHE_MAX_ATLASES 8
+
+typedef struct GlyphEntry {
+    guint key;
+    guint slot;
+    // View of the slot inside the atlas, so a blit needs no clip.
+    cairo_surface_t *mask;
+    struct GlyphEntry *prev;
+    struct GlyphEntry *next;
+} GlyphEntry;
+
+typedef struct GlyphAtlas {
+    PangoFontDescription *fonts[4];
+    PangoFontMap *font_map;
+    double resolution;
+    cairo_font_options_t *options;
+    int cell_width;
+    int cell_height;
+    int scale;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    PangoContext *context;
+    PangoLayout *layout;
+    int slot_width;
+    int slot_height;
+    guint columns;
+    guint slots;
+    guint used;
+    GHashTable *entries;
+    // Most recently drawn first.
+    GlyphEntry *lru_head;
+    GlyphEntry *lru_tail;
+    struct GlyphAtlas *next;
+} GlyphAtlas;
+
+static GlyphAtlas *atlases;
+static GlyphCacheStats cache_stats;
+
+static void
+entry_free(gpointer data)
+{
+    GlyphEntry *entry = data;
+    cairo_surface_destroy(entry->mask);
+    g_free(entry);
+}
+
+static void
+atlas_free(GlyphAtlas *atlas)
+{
+    g_hash_table_destroy(atlas->entries);
+    g_object_unref(atlas->layout);
+    g_object_unref(atlas->context);
+    g_object_unref(atlas->font_map);
+    if (atlas->options) {
+        cairo_font_options_destroy(atlas->options);
+    }
+    cairo_destroy(atlas->cr);
+    cairo_surface_destroy(atlas->surface);
+    for (size_t i = 0; i < G_N_ELEMENTS(atlas->fonts); ++i) {
+        pango_font_description_free(atlas->fonts[i]);
+    }
+    g_free(atlas);
+}
+
+static bool
+same_font_options(const cairo_font_options_t *a, const cairo_font_options_t *b)
+{
+    if (!a || !b) {
+        return a == b;
+    }
+    return cairo_font_options_equal(a, b);
+}
+
+static GlyphAtlas *
+atlas_new(PangoContext *context, const PangoFontDescription *font, int cell_width, int cell_height, int scale)
+{
+    GlyphAtlas *atlas = g_new0(GlyphAtlas, 1);
+    for (guint style = 0; style < G_N_ELEMENTS(atlas->fonts); ++style) {
+        atlas->fonts[style] = pango_font_description_copy(font);
+        if (style & GLYPH_CACHE_BOLD) {
+            pango_font_description_set_weight(atlas->fonts[style], PANGO_WEIGHT_BOLD);
+        }
+        if (style & GLYPH_CACHE_ITALIC) {
+            pango_font_description_set_style(atlas->fonts[style], PANGO_STYLE_ITALIC);
+        }
+    }
+    atlas->font_map = g_object_ref(pango_context_get_font_map(context));
+    atlas->resolution = pango_cairo_context_get_resolution(context);
+    const cairo_font_options_t *options = pango_cairo_context_get_font_options(context);
+    atlas->options = options ? cairo_font_options_copy(options) : NULL;
+    atlas->cell_width = cell_width;
+    atlas->cell_height = cell_height;
+    atlas->scale = scale;
+    // Two cells per slot so wide characters and italic overhang fit.
+    atlas->slot_width = cell_width * 2;
+    atlas->slot_height = cell_height;
+    const int side = GLYPH_CACHE_ATLAS_PIXELS / scale;
+    atlas->columns = (guint)MAX(1, side / atlas->slot_width);
+    const guint rows = (guint)MAX(1, side / atlas->slot_height);
+    atlas->slots = atlas->columns * rows;
+    atlas->surface = cairo_image_surface_create(CAIRO_FORMAT_A8,
+                                                (int)atlas->columns * atlas->slot_width * scale,
+                                                (int)rows * atlas->slot_height * scale);
+    cairo_surface_set_device_scale(atlas->surface, scale, scale);
+    atlas->cr = cairo_create(atlas->surface);
+    // Shape with the widget's font map, DPI and hinting/antialias options so
+    // glyphs match the cell grid the view measured.
+    atlas->context = pango_font_map_create_context(atlas->font_map);
+    pango_cairo_context_set_resolution(atlas->context, atlas->resolution);
+    pango_cairo_context_set_font_options(atlas->context, atlas->options);
+    pango_cairo_update_context(atlas->cr, atlas->context);
+    atlas->layout = pango_layout_new(atlas->context);
+    atlas->entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, entry_free);
+    return atlas;
+}
+
+static GlyphAtlas *
+find_atlas(PangoContext *context, const PangoFontDescription *font, int cell_width, int cell_height, int scale)
+{
+    PangoFontMap *font_map = pango_context_get_font_map(context);
+    const double resolution = pango_cairo_context_get_resolution(context);
+    const cairo_font_options_t *options = pango_cairo_context_get_font_options(context);
+    GlyphAtlas **link = &atlases;
+    guint count = 0;
+    for (GlyphAtlas *atlas = atlases; atlas; link = &atlas->next, atlas = atlas->next, ++count) {
+        if (atlas->scale == scale && atlas->cell_width == cell_width &&
+            atlas->cell_height == cell_height && atlas->font_map == font_map &&
+            atlas->resolution == resolution && same_font_options(atlas->options, options) &&
+            pango_font_description_equal(atlas->fonts[0], font)) {
+            // Keep the list in use order so the stale tail is what gets dropped.
+            *link = atlas->next;
+            atlas->next = atlases;
+            atlases = atlas;
+            return atlas;
+        }
+    }
+    if (count >= GLYPH_CACHE_MAX_ATLASES) {
+        GlyphAtlas **last = &atlases;
+        while ((*last)->next) {
+            last = &(*last)->next;
+        }
+        cache_stats.entries -= g_hash_table_size((*last)->entries);
+        cache_stats.atlases--;
+        atlas_free(*last);
+        *last = NULL;
+    }
+    GlyphAtlas *atlas = atlas_new(context, font, cell_width, cell_height, scale);
+    atlas->next = atlases;
+    atlases = atlas;
+    cache_stats.atlases++;
+    return atlas;
+}
+
+static void
+lru_unlink(GlyphAtlas *atlas, GlyphEntry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        atlas->lru_head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        atlas->lru_tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+static void
+lru_push(GlyphAtlas *atlas, GlyphEntry *entry)
+{
+    entry->next = atlas->lru_head;
+    if (atlas->lru_head) {
+        atlas->lru_head->prev = entry;
+    } else {
+        atlas->lru_tail = entry;
+    }
+    atlas->lru_head = entry;
+}
+
+static void
+slot_origin(const GlyphAtlas *atlas, guint slot, double *x, double *y)
+{
+    *x = (double)(slot % atlas->columns) * atlas->slot_width;
+    *y = (double)(slot / atlas->columns) * atlas->slot_height;
+}
+
+static GlyphEntry *
+rasterize(GlyphAtlas *atlas, guint key, gunichar codepoint, guint style)
+{
+    guint slot;
+    if (atlas->used < atlas->slots) {
+        slot = atlas->used++;
+    } else {
+        GlyphEntry *victim = atlas->lru_tail;
+        slot = victim->slot;
+        lru_unlink(atlas, victim);
+        g_hash_table_remove(atlas->entries, GUINT_TO_POINTER(victim->key));
+        cache_stats.evictions++;
+        cache_stats.entries--;
+    }
+
+    double x, y;
+    slot_origin(atlas, slot, &x, &y);
+    cairo_t *cr = atlas->cr;
+    cairo_save(cr);
+    cairo_rectangle(cr, x, y, atlas->slot_width, atlas->slot_height);
+    cairo_clip(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    char utf8[8];
+    gint len = g_unichar_to_utf8(codepoint, utf8);
+    utf8[len] = '\0';
+    pango_layout_set_font_description(atlas->layout, atlas->fonts[style]);
+    pango_layout_set_text(atlas->layout, utf8, -1);
+    cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 1.0);
+    cairo_move_to(cr, x, y);
+    pango_cairo_show_layout(cr, atlas->layout);
+    cairo_restore(cr);
+
+    GlyphEntry *entry = g_new0(GlyphEntry, 1);
+    entry->key = key;
+    entry->slot = slot;
+    entry->mask = cairo_surface_create_for_rectangle(atlas->surface, x, y,
+                                                     atlas->slot_width, atlas->slot_height);
+    g_hash_table_insert(atlas->entries, GUINT_TO_POINTER(key), entry);
+    cache_stats.entries++;
+    return entry;
+}
+
+static GlyphEntry *
+lookup(GlyphAtlas *atlas, gunichar codepoint, guint style)
+{
+    const guint key = codepoint | (style << 21);
+    GlyphEntry *entry = g_hash_table_lookup(atlas->entries, GUINT_TO_POINTER(key));
+    if (entry) {
+        cache_stats.hits++;
+        lru_unlink(atlas, entry);
+    } else {
+        cache_stats.misses++;
+        entry = rasterize(atlas, key, codepoint, style);
+    }
+    lru_push(atlas, entry);
+    return entry;
+}
+
+void
+glyph_cache_draw_run(cairo_t *cr,
+                     PangoContext *context,
+                     const PangoFontDescription *font,
+                     int cell_width,
+                     int cell_height,
+                     int scale,
+                     const gunichar *codepoints,
+                     size_t count,
+                     guint style,
+                     double x,
+                     double y)
+{
+    if (!cr || !context || !font || !codepoints || cell_width <= 0 || cell_height <= 0) {
+        return;
+    }
+    if (scale < 1) {
+        scale = 1;
+    }
+    style &= GLYPH_CACHE_BOLD | GLYPH_CACHE_ITALIC;
+    GlyphAtlas *atlas = find_atlas(context, font, cell_width, cell_height, scale);
+    for (size_t i = 0; i < count; ++i) {
+        const gunichar codepoint = codepoints[i];
+        if (codepoint == 0 || codepoint == ' ' || codepoint > 0x10ffff) {
+            continue;
+        }
+        GlyphEntry *entry = lookup(atlas, codepoint, style);
+        cairo_mask_surface(cr, entry->mask, x + (double)i * cell_width, y);
+    }
+}
+
+void
+glyph_cache_draw(cairo_t *cr,
+                 PangoContext *context,
+                 const PangoFontDescription *font,
+                 int cell_width,
+                 int cell_height,
+                 int scale,
+                 gunichar codepoint,
+                 guint style,
+                 double x,
+                 double y)
+{
+    glyph_cache_draw_run(cr, context, font, cell_width, cell_height, scale, &codepoint, 1, style, x, y);
+}
+
+void
+glyph_cache_get_stats(GlyphCacheStats *stats)
+{
+    if (stats) {
+        *stats = cache_stats;
+    }
+}
+
+void
+glyph_cache_clear(void)
+{
+    while (atlases) {
+        GlyphAtlas *next = atlases->next;
+        atlas_free(atlases);
+        atlases = next;
+    }
+    cache_stats.atlases = 0;
+    cache_stats.entries = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <gtk/gtk.h>
+#include <pango/pangocairo.h>
+
+enum {
+    GLYPH_CACHE_BOLD = 1 << 0,
+    GLYPH_CACHE_ITALIC = 1 << 1,
+};
+
+typedef struct {
+    guint64 hits;
+    guint64 misses;
+    guint64 evictions;
+    guint atlases;
+    guint entries;
+} GlyphCacheStats;
+
+// Process-wide cache of rasterized glyphs shared by every terminal view. Each
+// (font, cell size, scale, and the font map, resolution and font options of
+// the widget's PangoContext) gets an A8 atlas of two-cell slots; a glyph is
+// shaped once, then drawn with cairo_mask_surface() using the current source.
+// Least recently drawn glyphs are evicted when an atlas fills up. Main thread
+// only, like the rest of GTK.
+void glyph_cache_draw(cairo_t *cr,
+                      PangoContext *context,
+                      const PangoFontDescription *font,
+                      int cell_width,
+                      int cell_height,
+                      int scale,
+                      gunichar codepoint,
+                      guint style,
+                      double x,
+                      double y);
+// Draws count cells starting at (x, y), one cell_width apart, with a single
+// atlas lookup for the whole run. Codepoints 0 and ' ' are skipped.
+void glyph_cache_draw_run(cairo_t *cr,
+                          PangoContext *context,
+                          const PangoFontDescription *font,
+                          int cell_width,
+                          int cell_height,
+                          int scale,
+                          const gunichar *codepoints,
+                          size_t count,
+                          guint style,
+                          double x,
+                          double y);
+void glyph_cache_get_stats(GlyphCacheStats *stats);
+// Drops every atlas, e.g. after a font or theme change.
+void glyph_cache_clear(void);
@@ -1,5 +1,7 @@
 #include "terminal_view.h"
 
+#include "glyph_cache.h"
+
 #include <pango/pangocairo.h>
 #include <string.h>
 
@@ -8,15 +10,47 @@ typedef struct {
     GString *buffer;
     PangoFontDescription *font;
     lterm_screen *screen;
+    lterm_session *session;
+    lterm_predictor *predictor;
+    // Redraws once the oldest prediction times out, in case no echo arrives.
+    guint prediction_timeout;
     terminal_view_resize_cb resize_cb;
     void *resize_data;
     size_t cached_cols;
     size_t cached_rows;
+    int char_width;
+    int char_height;
+    // Text settings the cell size was measured with.
+    double resolution;
+    cairo_font_options_t *font_options;
+    gunichar *run;
+    size_t run_capacity;
+    // The rendered grid; draws repaint only the rows the screen reports
+    // dirty and then blit it.
+    cairo_surface_t *backing;
+    int backing_width;
+    int backing_height;
+    int backing_scale;
+    bool backing_stale;
+    size_t backing_rows;
+    size_t backing_cols;
+    uint8_t *dirty;
+    size_t dirty_capacity;
 } TerminalView;
 
+#define TERMINAL_VIEW_PADDING 6.0
+#define TERMINAL_VIEW_BACKGROUND 0.07
+
 static void
-color_from_index(uint8_t index, double *r, double *g, double *b)
+color_from_index(lterm_color color, double *r, double *g, double *b)
 {
+    if (LTERM_COLOR_IS_RGB(color)) {
+        *r = ((color >> 16) & 0xff) / 255.0;
+        *g = ((color >> 8) & 0xff) / 255.0;
+        *b = (color & 0xff) / 255.0;
+        return;
+    }
+    uint8_t index = (uint8_t)(color & 0xff);
     static const double basic[16][3] = {
         {0.0, 0.0, 0.0},       {0.5, 0.0, 0.0},       {0.0, 0.5, 0.0},       {0.5, 0.5, 0.0},
         {0.0, 0.0, 0.5},       {0.5, 0.0, 0.5},       {0.0, 0.5, 0.5},       {0.75, 0.75, 0.75},
@@ -82,126 +116,358 @@ terminal_view_destroy(gpointer data)
     if (view->buffer) {
         g_string_free(view->buffer, TRUE);
     }
+    if (view->backing) {
+        cairo_surface_destroy(view->backing);
+    }
+    if (view->prediction_timeout) {
+        g_source_remove(view->prediction_timeout);
+    }
+    if (view->font_options) {
+        cairo_font_options_destroy(view->font_options);
+    }
+    g_free(view->dirty);
+    g_free(view->run);
     g_free(view);
 }
 
 static void
-terminal_view_draw(GtkDrawingArea *area,
-                   cairo_t *cr,
-                   int width,
-                   int height,
-                   gpointer user_data)
+measure_cell(TerminalView *view)
+{
+    if (view->char_width > 0) {
+        return;
+    }
+    PangoLayout *layout = gtk_widget_create_pango_layout(view->area, "M");
+    if (view->font) {
+        pango_layout_set_font_description(layout, view->font);
+    }
+    pango_layout_get_pixel_size(layout, &view->char_width, &view->char_height);
+    g_object_unref(layout);
+    if (view->char_width <= 0) {
+        view->char_width = 10;
+    }
+    if (view->char_height <= 0) {
+        view->char_height = 18;
+    }
+}
+
+// Geometry follows the allocation, not the draw: the callback hears about
+// every size change once and decides when to apply it.
+static void
+terminal_view_resize(GtkDrawingArea *area, int width, int height, gpointer user_data)
 {
+    (void)area;
     TerminalView *view = user_data;
     if (!view) {
         return;
     }
+    measure_cell(view);
+    int usable_width = width - (int)(TERMINAL_VIEW_PADDING * 2);
+    int usable_height = height - (int)(TERMINAL_VIEW_PADDING * 2);
+    if (usable_width < view->char_width) {
+        usable_width = view->char_width;
+    }
+    if (usable_height < view->char_height) {
+        usable_height = view->char_height;
+    }
+    size_t cols_fit = (size_t)((usable_width + view->char_width - 1) / view->char_width);
+    size_t rows_fit = (size_t)((usable_height + view->char_height - 1) / view->char_height);
+    if (cols_fit == view->cached_cols && rows_fit == view->cached_rows) {
+        return;
+    }
+    view->cached_cols = cols_fit;
+    view->cached_rows = rows_fit;
+    if (view->resize_cb) {
+        view->resize_cb(cols_fit, rows_fit, view->resize_data);
+    }
+}
 
-    cairo_set_source_rgb(cr, 0.07, 0.07, 0.07);
-    cairo_paint(cr);
+static guint
+glyph_style(uint16_t flags)
+{
+    guint style = 0;
+    if (flags & LTERM_CELL_FLAG_BOLD) {
+        style |= GLYPH_CACHE_BOLD;
+    }
+    if (flags & LTERM_CELL_FLAG_ITALIC) {
+        style |= GLYPH_CACHE_ITALIC;
+    }
+    return style;
+}
 
-    cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+// Adds the decoration rectangles to the current path; the caller fills a
+// whole row's worth at once.
+static void
+add_decorations(cairo_t *cr, uint16_t flags, double x, double y, double width, double height)
+{
+    const double thickness = MAX(1.0, height / 16.0);
+    const double underline_y = y + height - thickness * 2.0;
+    if (flags & LTERM_CELL_FLAG_UNDERLINE) {
+        cairo_rectangle(cr, x, underline_y, width, thickness);
+    } else if (flags & LTERM_CELL_FLAG_DOUBLE_UNDERLINE) {
+        cairo_rectangle(cr, x, underline_y, width, thickness);
+        cairo_rectangle(cr, x, underline_y - thickness * 2.0, width, thickness);
+    } else if (flags & LTERM_CELL_FLAG_CURLY_UNDERLINE) {
+        const double step = height / 4.0;
+        for (double offset = 0.0; offset < width; offset += step) {
+            const double rise = ((int)(offset / step) % 2) * thickness;
+            cairo_rectangle(cr, x + offset, underline_y - rise, MIN(step, width - offset), thickness);
+        }
+    }
+    if (flags & LTERM_CELL_FLAG_STRIKETHROUGH) {
+        cairo_rectangle(cr, x, y + height / 2.0, width, thickness);
+    }
+}
 
-    if (view->screen && view->screen->grid.cells) {
-        PangoLayout *layout = gtk_widget_create_pango_layout(GTK_WIDGET(area), "");
-        if (view->font) {
-            pango_layout_set_font_description(layout, view->font);
+static bool
+same_style(const lterm_cell *a, const lterm_cell *b)
+{
+    return a->fg == b->fg && a->bg == b->bg && a->flags == b->flags;
+}
+
+// One row as runs of identically styled cells: a background rectangle per
+// run (none for the default background, already painted), one glyph run per
+// run, and every decoration of the same colour filled as a single path.
+static void
+draw_row(TerminalView *view, cairo_t *cr, int scale, const lterm_cell *line, size_t cols, double y)
+{
+    const double char_width = view->char_width;
+    const double char_height = view->char_height;
+    const uint16_t decorated = LTERM_CELL_FLAG_STRIKETHROUGH | LTERM_CELL_UNDERLINE_MASK;
+    bool decoration_pending = false;
+    double decoration[3] = {0.0, 0.0, 0.0};
+    size_t start = 0;
+    while (start < cols) {
+        const lterm_cell *cell = &line[start];
+        size_t end = start + 1;
+        while (end < cols && same_style(cell, &line[end])) {
+            ++end;
         }
-        pango_layout_set_text(layout, "M", -1);
-        int char_width = 0;
-        int char_height = 0;
-        pango_layout_get_pixel_size(layout, &char_width, &char_height);
-        if (char_width <= 0) {
-            char_width = 10;
+        const size_t count = end - start;
+        const double x = TERMINAL_VIEW_PADDING + (double)start * char_width;
+
+        double bg_r = TERMINAL_VIEW_BACKGROUND, bg_g = TERMINAL_VIEW_BACKGROUND, bg_b = TERMINAL_VIEW_BACKGROUND;
+        if (cell->bg != LTERM_COLOR_DEFAULT_BG) {
+            color_from_index(cell->bg, &bg_r, &bg_g, &bg_b);
+            cairo_set_source_rgb(cr, bg_r, bg_g, bg_b);
+            cairo_rectangle(cr, x, y, count * char_width, char_height);
+            cairo_fill(cr);
         }
-        if (char_height <= 0) {
-            char_height = 18;
+        if (cell->flags & LTERM_CELL_FLAG_INVISIBLE) {
+            start = end;
+            continue;
         }
-        const double padding_x = 6.0;
-        const double padding_y = 6.0;
-        int usable_width = width - (int)(padding_x * 2);
-        int usable_height = height - (int)(padding_y * 2);
-        if (usable_width < char_width) {
-            usable_width = char_width;
+
+        double fg_r = 0.8, fg_g = 0.8, fg_b = 0.8;
+        color_from_index(cell->fg, &fg_r, &fg_g, &fg_b);
+        if (cell->flags & LTERM_CELL_FLAG_DIM) {
+            fg_r = (fg_r + bg_r) / 2.0;
+            fg_g = (fg_g + bg_g) / 2.0;
+            fg_b = (fg_b + bg_b) / 2.0;
         }
-        if (usable_height < char_height) {
-            usable_height = char_height;
+        if (count > view->run_capacity) {
+            view->run_capacity = MAX(count, cols);
+            view->run = g_renew(gunichar, view->run, view->run_capacity);
         }
-        size_t cols_fit = (size_t)((usable_width + char_width - 1) / char_width);
-        size_t rows_fit = (size_t)((usable_height + char_height - 1) / char_height);
-        if (cols_fit == 0) {
-            cols_fit = 1;
+        bool visible = false;
+        for (size_t i = 0; i < count; ++i) {
+            view->run[i] = line[start + i].codepoint;
+            visible = visible || (view->run[i] != 0 && view->run[i] != ' ');
         }
-        if (rows_fit == 0) {
-            rows_fit = 1;
+        if (visible) {
+            cairo_set_source_rgb(cr, fg_r, fg_g, fg_b);
+            glyph_cache_draw_run(cr, gtk_widget_get_pango_context(view->area), view->font,
+                                 view->char_width, view->char_height, scale, view->run, count,
+                                 glyph_style(cell->flags), x, y);
         }
-        if (view->resize_cb &&
-            (cols_fit != view->cached_cols || rows_fit != view->cached_rows)) {
-            view->cached_cols = cols_fit;
-            view->cached_rows = rows_fit;
-            view->resize_cb(cols_fit, rows_fit, view->resize_data);
+
+        if (cell->flags & decorated) {
+            if (decoration_pending &&
+                (decoration[0] != fg_r || decoration[1] != fg_g || decoration[2] != fg_b)) {
+                cairo_set_source_rgb(cr, decoration[0], decoration[1], decoration[2]);
+                cairo_fill(cr);
+            }
+            add_decorations(cr, cell->flags, x, y, count * char_width, char_height);
+            decoration[0] = fg_r;
+            decoration[1] = fg_g;
+            decoration[2] = fg_b;
+            decoration_pending = true;
         }
-        const lterm_screen *screen = view->screen;
-        if (screen && screen->grid.cells) {
-            size_t rows = screen->grid.rows;
-            size_t cols = screen->grid.cols;
-            for (size_t row = 0; row < rows; ++row) {
-                for (size_t col = 0; col < cols; ++col) {
-                    const lterm_cell cell = screen->grid.cells[row * cols + col];
-                    double fg_r = 0.8, fg_g = 0.8, fg_b = 0.8;
-                    double bg_r = 0.07, bg_g = 0.07, bg_b = 0.07;
-                    color_from_index(cell.fg, &fg_r, &fg_g, &fg_b);
-                    color_from_index(cell.bg, &bg_r, &bg_g, &bg_b);
-
-                    const double x = padding_x + (double)col * char_width;
-                    const double y = padding_y + (double)row * char_height;
-                    cairo_save(cr);
-                    cairo_rectangle(cr, x, y, char_width, char_height);
-                    cairo_set_source_rgb(cr, bg_r, bg_g, bg_b);
-                    cairo_fill(cr);
-                    cairo_restore(cr);
-
-                    gunichar ch = cell.codepoint ? cell.codepoint : ' ';
-                    char utf8[8];
-                    gint len = g_unichar_to_utf8(ch, utf8);
-                    utf8[len] = '\0';
-                    pango_layout_set_text(layout, utf8, -1);
-
-                    PangoAttrList *attrs = NULL;
-                    if ((cell.flags & LTERM_CELL_FLAG_BOLD) ||
-                        (cell.flags & LTERM_CELL_FLAG_UNDERLINE)) {
-                        attrs = pango_attr_list_new();
-                        if (cell.flags & LTERM_CELL_FLAG_BOLD) {
-                            PangoAttribute *weight = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
-                            weight->start_index = 0;
-                            weight->end_index = G_MAXUINT;
-                            pango_attr_list_insert(attrs, weight);
-                        }
-                        if (cell.flags & LTERM_CELL_FLAG_UNDERLINE) {
-                            PangoAttribute *underline = pango_attr_underline_new(PANGO_UNDERLINE_SINGLE);
-                            underline->start_index = 0;
-                            underline->end_index = G_MAXUINT;
-                            pango_attr_list_insert(attrs, underline);
-                        }
-                        pango_layout_set_attributes(layout, attrs);
-                    } else {
-                        pango_layout_set_attributes(layout, NULL);
-                    }
-
-                    cairo_set_source_rgb(cr, fg_r, fg_g, fg_b);
-                    cairo_move_to(cr, x, y);
-                    pango_cairo_show_layout(cr, layout);
-
-                    if (attrs) {
-                        pango_attr_list_unref(attrs);
-                    }
-                }
+        start = end;
+    }
+    if (decoration_pending) {
+        cairo_set_source_rgb(cr, decoration[0], decoration[1], decoration[2]);
+        cairo_fill(cr);
+    }
+}
+
+static gboolean
+predictions_expired(gpointer user_data)
+{
+    TerminalView *view = user_data;
+    view->prediction_timeout = 0;
+    gtk_widget_queue_draw(view->area);
+    return G_SOURCE_REMOVE;
+}
+
+// Speculative echo goes on top of the grid, underlined until the real echo
+// replaces it.
+static void
+draw_predictions(TerminalView *view, cairo_t *cr, int scale, const lterm_screen *screen)
+{
+    lterm_prediction predictions[64];
+    const gint64 now_ns = g_get_monotonic_time() * 1000;
+    size_t count = lterm_predictor_overlay(view->predictor, predictions, G_N_ELEMENTS(predictions), now_ns);
+    if (count > 0 && !view->prediction_timeout) {
+        const gint64 expires_ns = predictions[0].typed_ns + LTERM_PREDICT_TIMEOUT_MS * 1000000ll;
+        view->prediction_timeout =
+            g_timeout_add((guint)MAX(1, (expires_ns - now_ns) / 1000000 + 1), predictions_expired, view);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (predictions[i].row >= screen->grid.rows || predictions[i].col >= screen->grid.cols) {
+            continue;
+        }
+        const double x = TERMINAL_VIEW_PADDING + (double)predictions[i].col * view->char_width;
+        const double y = TERMINAL_VIEW_PADDING + (double)predictions[i].row * view->char_height;
+        cairo_set_source_rgb(cr, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND);
+        cairo_rectangle(cr, x, y, view->char_width, view->char_height);
+        cairo_fill(cr);
+        cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+        glyph_cache_draw(cr, gtk_widget_get_pango_context(view->area), view->font,
+                         view->char_width, view->char_height, scale,
+                         predictions[i].codepoint, 0, x, y);
+        add_decorations(cr, LTERM_CELL_FLAG_UNDERLINE, x, y, view->char_width, view->char_height);
+        cairo_fill(cr);
+    }
+}
+
+// DPI, hinting and antialiasing reach the widget's PangoContext from
+// GtkSettings. When they change, the measured cell size and every rendered
+// row are stale; the glyph cache keys its atlases on the same values.
+static bool
+text_settings_changed(TerminalView *view)
+{
+    PangoContext *context = gtk_widget_get_pango_context(view->area);
+    const double resolution = pango_cairo_context_get_resolution(context);
+    const cairo_font_options_t *options = pango_cairo_context_get_font_options(context);
+    const bool same_options = options && view->font_options ? cairo_font_options_equal(options, view->font_options)
+                                                            : options == view->font_options;
+    if (resolution == view->resolution && same_options) {
+        return false;
+    }
+    view->resolution = resolution;
+    if (view->font_options) {
+        cairo_font_options_destroy(view->font_options);
+    }
+    view->font_options = options ? cairo_font_options_copy(options) : NULL;
+    view->char_width = 0;
+    view->char_height = 0;
+    view->backing_stale = true;
+    return true;
+}
+
+static bool
+ensure_backing(TerminalView *view, int width, int height, int scale)
+{
+    if (view->backing && view->backing_width == width && view->backing_height == height &&
+        view->backing_scale == scale) {
+        return true;
+    }
+    if (view->backing) {
+        cairo_surface_destroy(view->backing);
+        view->backing = NULL;
+    }
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    // An image surface rather than one similar to the target: GTK hands the
+    // draw function a recording surface.
+    view->backing = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width * scale, height * scale);
+    cairo_surface_set_device_scale(view->backing, scale, scale);
+    view->backing_width = width;
+    view->backing_height = height;
+    view->backing_scale = scale;
+    view->backing_stale = true;
+    return true;
+}
+
+// Brings the backing surface up to date with the screen. Called with the
+// session locked.
+static void
+render_backing(TerminalView *view, lterm_screen *screen, int scale)
+{
+    const size_t rows = screen->grid.rows;
+    const size_t cols = screen->grid.cols;
+    if (rows != view->backing_rows || cols != view->backing_cols) {
+        view->backing_rows = rows;
+        view->backing_cols = cols;
+        view->backing_stale = true;
+    }
+    if (rows > view->dirty_capacity) {
+        view->dirty = g_renew(uint8_t, view->dirty, rows);
+        view->dirty_capacity = rows;
+    }
+    // Always taken, so a full repaint does not leave stale flags behind.
+    const size_t dirty = lterm_screen_take_dirty(screen, view->dirty, rows);
+    if (!view->backing_stale && dirty == 0) {
+        return;
+    }
+
+    cairo_t *cr = cairo_create(view->backing);
+    cairo_set_source_rgb(cr, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND);
+    if (view->backing_stale) {
+        cairo_paint(cr);
+    }
+    for (size_t row = 0; row < rows; ++row) {
+        const double y = TERMINAL_VIEW_PADDING + (double)row * view->char_height;
+        if (!view->backing_stale) {
+            if (!view->dirty[row]) {
+                continue;
             }
+            cairo_set_source_rgb(cr, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND);
+            cairo_rectangle(cr, 0, y, view->backing_width, view->char_height);
+            cairo_fill(cr);
         }
-        g_object_unref(layout);
+        draw_row(view, cr, scale, &screen->grid.cells[row * cols], cols, y);
+    }
+    cairo_destroy(cr);
+    view->backing_stale = false;
+}
+
+static void
+terminal_view_draw(GtkDrawingArea *area,
+                   cairo_t *cr,
+                   int width,
+                   int height,
+                   gpointer user_data)
+{
+    TerminalView *view = user_data;
+    if (!view) {
+        return;
+    }
+
+    if (text_settings_changed(view) && view->cached_cols) {
+        terminal_view_resize(area, width, height, view);
+    }
+    const int scale = gtk_widget_get_scale_factor(GTK_WIDGET(area));
+    if (view->screen && view->screen->grid.cells && ensure_backing(view, width, height, scale)) {
+        measure_cell(view);
+        lterm_session_lock(view->session);
+        lterm_session_frame_done(view->session);
+        lterm_screen *screen = view->screen;
+        if (screen && screen->grid.cells) {
+            render_backing(view, screen, scale);
+            cairo_set_source_surface(cr, view->backing, 0, 0);
+            cairo_paint(cr);
+            draw_predictions(view, cr, scale, screen);
+        }
+        lterm_session_unlock(view->session);
         return;
     }
 
+    cairo_set_source_rgb(cr, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND, TERMINAL_VIEW_BACKGROUND);
+    cairo_paint(cr);
+    cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+
     if (view->buffer && view->buffer->len > 0) {
         PangoLayout *layout = gtk_widget_create_pango_layout(GTK_WIDGET(area), view->buffer->str);
         pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
@@ -225,6 +491,7 @@ terminal_view_new(void)
     GtkWidget *area = gtk_drawing_area_new();
     gtk_widget_add_css_class(area, "terminal-view");
     gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(area), terminal_view_draw, view, terminal_view_destroy);
+    g_signal_connect(area, "resize", G_CALLBACK(terminal_view_resize), view);
     gtk_widget_set_hexpand(area, TRUE);
     gtk_widget_set_vexpand(area, TRUE);
     gtk_widget_set_focusable(area, TRUE);
@@ -264,6 +531,7 @@ terminal_view_set_screen(GtkWidget *widget, lterm_screen *screen)
         return;
     }
     view->screen = screen;
+    view->backing_stale = true;
     if (screen) {
         view->cached_cols = screen->grid.cols;
         view->cached_rows = screen->grid.rows;
@@ -274,6 +542,27 @@ terminal_view_set_screen(GtkWidget *widget, lterm_screen *screen)
     gtk_widget_queue_draw(widget);
 }
 
+void
+terminal_view_set_session(GtkWidget *widget, lterm_session *session)
+{
+    TerminalView *view = g_object_get_data(G_OBJECT(widget), "terminal-view");
+    if (!view) {
+        return;
+    }
+    view->session = session;
+    terminal_view_set_screen(widget, lterm_session_screen(session));
+}
+
+void
+terminal_view_set_predictor(GtkWidget *widget, lterm_predictor *predictor)
+{
+    TerminalView *view = g_object_get_data(G_OBJECT(widget), "terminal-view");
+    if (!view) {
+        return;
+    }
+    view->predictor = predictor;
+}
+
 void
 terminal_view_set_resize_callback(GtkWidget *widget,
                                   terminal_view_resize_cb callback,
@@ -285,5 +574,8 @@ terminal_view_set_resize_callback(GtkWidget *widget,
     }
     view->resize_cb = callback;
     view->resize_data = user_data;
+    if (callback && view->cached_cols) {
+        callback(view->cached_cols, view->cached_rows, user_data);
+    }
 }
 
@@ -1,13 +1,18 @@
 #pragma once
 
 #include <gtk/gtk.h>
+#include "lterm_predict.h"
 #include "lterm_screen.h"
+#include "lterm_session.h"
 
 typedef void (*terminal_view_resize_cb)(size_t cols, size_t rows, void *user_data);
 
 GtkWidget *terminal_view_new(void);
 void terminal_view_append_text(GtkWidget *view, const char *text);
 void terminal_view_set_screen(GtkWidget *view, lterm_screen *screen);
+void terminal_view_set_session(GtkWidget *view, lterm_session *session);
+// Draws the predictor's speculative echo over the screen (NULL: none).
+void terminal_view_set_predictor(GtkWidget *view, lterm_predictor *predictor);
 void terminal_view_set_resize_callback(GtkWidget *view,
                                        terminal_view_resize_cb callback,
                                        void *user_data);